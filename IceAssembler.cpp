@@ -0,0 +1,92 @@
+/* Copyright 2014 The Native Client Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can
+ * be found in the LICENSE file.
+ */
+
+#include "IceAssembler.h"
+#include "IceCfg.h"
+
+void IceAsmSection::emitInt32(uint32_t Value) {
+  for (unsigned i = 0; i < 4; ++i)
+    emitByte((Value >> (8 * i)) & 0xff);
+}
+
+void IceAsmSection::putInt32(uint32_t Offset, uint32_t Value) {
+  assert(Offset + 4 <= getSize());
+  for (unsigned i = 0; i < 4; ++i)
+    Bytes[Offset + i] = (Value >> (8 * i)) & 0xff;
+}
+
+void IceAsmSection::emitFixup(IceFixup::FixupKind Kind,
+                              const IceString &Symbol, int32_t Addend) {
+  addFixup(IceFixup(Kind, getSize(), Symbol, Addend));
+  emitInt32(Addend);
+}
+
+void IceAsmSection::align(uint32_t Log2Align) {
+  requireAlignment(Log2Align);
+  while (getSize() & ((1u << Log2Align) - 1))
+    emitByte(0);
+}
+
+// Prints the section's bytes as .byte directives, its fixups as
+// .long directives and its labels as labels.  The fixups and labels
+// are in order of their offsets.
+static void emitSectionContents(IceOstream &Str, const IceAsmSection &Section) {
+  const uint32_t BytesPerLine = 16;
+  const IceByteList &Bytes = Section.getBytes();
+  const IceFixupList &Fixups = Section.getFixups();
+  const IceAsmLabelList &Labels = Section.getLabels();
+  IceFixupList::const_iterator Fixup = Fixups.begin();
+  IceAsmLabelList::const_iterator Label = Labels.begin();
+  uint32_t BytesOnLine = 0;
+  uint32_t Offset = 0;
+  while (true) {
+    bool EndLine = (BytesOnLine == BytesPerLine || Offset == Bytes.size());
+    if (Label != Labels.end() && Label->second == Offset)
+      EndLine = true;
+    if (Fixup != Fixups.end() && Fixup->getOffset() == Offset)
+      EndLine = true;
+    if (EndLine && BytesOnLine) {
+      Str << "\n";
+      BytesOnLine = 0;
+    }
+    for (; Label != Labels.end() && Label->second == Offset; ++Label)
+      Str << Label->first << ":\n";
+    if (Offset == Bytes.size())
+      break;
+    if (Fixup != Fixups.end() && Fixup->getOffset() == Offset) {
+      Str << "\t.long\t" << Fixup->getSymbol();
+      int32_t Addend = Fixup->getAddend();
+      if (Addend > 0)
+        Str << "+";
+      if (Addend)
+        Str << Addend;
+      if (Fixup->getKind() == IceFixup::Fixup_PCRel32)
+        Str << "-.";
+      Str << "\n";
+      Offset += 4;
+      ++Fixup;
+      continue;
+    }
+    char buf[8];
+    sprintf(buf, "0x%02x", Bytes[Offset]);
+    Str << (BytesOnLine ? ", " : "\t.byte\t") << buf;
+    ++BytesOnLine;
+    ++Offset;
+  }
+  assert(Fixup == Fixups.end());
+}
+
+void IceAssembler::emit(IceOstream &Str) const {
+  if (Text.getAlignment())
+    Str << "\t.p2align\t" << Text.getAlignment() << "\n";
+  Str << Cfg->getName() << ":\n";
+  emitSectionContents(Str, Text);
+  if (RoData.getSize()) {
+    Str << "\t.section\t.rodata,\"a\",@progbits\n";
+    Str << "\t.p2align\t" << RoData.getAlignment() << "\n";
+    emitSectionContents(Str, RoData);
+    Str << "\t.text\n";
+  }
+}
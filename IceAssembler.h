@@ -0,0 +1,105 @@
+// -*- Mode: c++ -*-
+/* Copyright 2014 The Native Client Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can
+ * be found in the LICENSE file.
+ */
+
+#ifndef _IceAssembler_h
+#define _IceAssembler_h
+
+#include "IceDefs.h"
+
+// IceFixup marks a 32-bit field within a section that is patched with
+// the address of Symbol plus Addend, either as is (Fixup_Abs32) or
+// relative to the address of the field itself (Fixup_PCRel32).  The
+// Addend is also stored in the field, which is where ELF REL
+// relocations expect it.
+class IceFixup {
+public:
+  enum FixupKind { Fixup_Abs32, Fixup_PCRel32 };
+  IceFixup(FixupKind Kind, uint32_t Offset, const IceString &Symbol,
+           int32_t Addend)
+      : Kind(Kind), Offset(Offset), Symbol(Symbol), Addend(Addend) {}
+  FixupKind getKind(void) const { return Kind; }
+  uint32_t getOffset(void) const { return Offset; }
+  void setOffset(uint32_t NewOffset) { Offset = NewOffset; }
+  const IceString &getSymbol(void) const { return Symbol; }
+  int32_t getAddend(void) const { return Addend; }
+
+private:
+  FixupKind Kind;
+  uint32_t Offset;
+  IceString Symbol;
+  int32_t Addend;
+};
+
+typedef std::vector<uint8_t> IceByteList;
+typedef std::vector<IceFixup> IceFixupList;
+typedef std::vector<std::pair<IceString, uint32_t> > IceAsmLabelList;
+
+// IceAsmSection holds one function's contribution to a section: the
+// encoded bytes, the fixups within them, and the local labels that
+// fixups can refer to.  Alignment is the log2 of the alignment that
+// the contents need at their start.
+class IceAsmSection {
+public:
+  IceAsmSection(void) : Alignment(0) {}
+  uint32_t getSize(void) const { return Bytes.size(); }
+  const IceByteList &getBytes(void) const { return Bytes; }
+  const IceFixupList &getFixups(void) const { return Fixups; }
+  const IceAsmLabelList &getLabels(void) const { return Labels; }
+  uint32_t getAlignment(void) const { return Alignment; }
+
+  void emitByte(uint8_t Byte) { Bytes.push_back(Byte); }
+  void emitInt32(uint32_t Value);
+  void putInt32(uint32_t Offset, uint32_t Value);
+  // Emits a field holding Addend, to be patched as described by Kind.
+  void emitFixup(IceFixup::FixupKind Kind, const IceString &Symbol,
+                 int32_t Addend);
+  void addFixup(const IceFixup &Fixup) { Fixups.push_back(Fixup); }
+  void addLabel(const IceString &Name) {
+    Labels.push_back(std::make_pair(Name, getSize()));
+  }
+  // Pads with zeros up to a multiple of 2^Log2Align, which also
+  // becomes the minimum alignment of the section.
+  void align(uint32_t Log2Align);
+  void requireAlignment(uint32_t Log2Align) {
+    if (Log2Align > Alignment)
+      Alignment = Log2Align;
+  }
+
+private:
+  IceByteList Bytes;
+  IceFixupList Fixups;
+  IceAsmLabelList Labels;
+  uint32_t Alignment;
+};
+
+// IceAssembler is the target-independent part of an integrated
+// assembler, which encodes a function's instructions directly into
+// bytes instead of printing them for an external assembler.  A target
+// subclass encodes the instructions, calling bindNode() at the start
+// of each node in layout order, and then finalize() resolves the
+// branches and labels.  The result is the function's .text and
+// .rodata contributions, with fixups for the external symbols they
+// reference.
+class IceAssembler {
+public:
+  virtual ~IceAssembler() {}
+  virtual void bindNode(const IceCfgNode *Node) = 0;
+  virtual void finalize(void) = 0;
+  IceCfg *getCfg(void) const { return Cfg; }
+  const IceAsmSection &getText(void) const { return Text; }
+  const IceAsmSection &getRoData(void) const { return RoData; }
+  // Prints the encoded function as data directives, starting with its
+  // label, which can be assembled instead of the textual instructions.
+  void emit(IceOstream &Str) const;
+
+protected:
+  IceAssembler(IceCfg *Cfg) : Cfg(Cfg) {}
+  IceCfg *const Cfg;
+  IceAsmSection Text;
+  IceAsmSection RoData;
+};
+
+#endif // _IceAssembler_h
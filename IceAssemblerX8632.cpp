@@ -0,0 +1,612 @@
+/* Copyright 2014 The Native Client Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can
+ * be found in the LICENSE file.
+ */
+
+#include "llvm/Support/MathExtras.h"
+
+#include "IceCfg.h"
+#include "IceCfgNode.h"
+#include "IceAssemblerX8632.h"
+#include "IceOperand.h"
+#include "IceTargetLoweringX8632.h"
+
+static bool isByteType(IceType Type) {
+  return Type == IceType_i1 || Type == IceType_i8;
+}
+
+static const IceVariable *asRegister(const IceOperand *Operand) {
+  const IceVariable *Var = llvm::dyn_cast<IceVariable>(Operand);
+  if (Var && Var->getRegNum() >= 0)
+    return Var;
+  return NULL;
+}
+
+static bool isImmediate(const IceOperand *Operand) {
+  return llvm::isa<IceConstantInteger>(Operand) ||
+         llvm::isa<IceConstantRelocatable>(Operand);
+}
+
+static bool isFloatingConstant(const IceOperand *Operand) {
+  return llvm::isa<IceConstantFloat>(Operand) ||
+         llvm::isa<IceConstantDouble>(Operand);
+}
+
+static bool isInt8(int32_t Value) { return Value >= -128 && Value <= 127; }
+
+static bool isInt8Immediate(const IceOperand *Operand) {
+  const IceConstantInteger *Imm = llvm::dyn_cast<IceConstantInteger>(Operand);
+  return Imm && isInt8(static_cast<int32_t>(Imm->getIntValue()));
+}
+
+// Returns the bits of a floating-point constant as a value of Type,
+// which may differ from the constant's own type.
+static uint64_t getFloatingBits(const IceOperand *Constant, IceType Type) {
+  double Value = 0;
+  if (const IceConstantFloat *Float =
+          llvm::dyn_cast<IceConstantFloat>(Constant))
+    Value = Float->getFloatValue();
+  else
+    Value = llvm::cast<IceConstantDouble>(Constant)->getDoubleValue();
+  if (Type == IceType_f32)
+    return llvm::FloatToBits(static_cast<float>(Value));
+  return llvm::DoubleToBits(Value);
+}
+
+// Values narrower than 32 bits are held in 32-bit registers and
+// stack slots, which the textual output also treats as 32-bit, so
+// only a memory operand makes an operation narrow.
+IceType IceAssemblerX8632::getOperationType(IceType Type,
+                                            const IceOperand *Operand0,
+                                            const IceOperand *Operand1) {
+  if (Type != IceType_i1 && Type != IceType_i8 && Type != IceType_i16)
+    return Type;
+  if (llvm::isa<IceOperandX8632Mem>(Operand0) ||
+      (Operand1 && llvm::isa<IceOperandX8632Mem>(Operand1)))
+    return Type;
+  return IceType_i32;
+}
+
+void IceAssemblerX8632::setError(const IceString &Message) {
+  Cfg->setError(Message);
+}
+
+void IceAssemblerX8632::emitInt16(uint16_t Value) {
+  emitByte(Value & 0xff);
+  emitByte(Value >> 8);
+}
+
+void IceAssemblerX8632::emitOperandSizePrefix(IceType Type) {
+  if (Type == IceType_i16)
+    emitByte(0x66);
+}
+
+unsigned IceAssemblerX8632::getRegEncoding(const IceOperand *Operand,
+                                           IceType Type) {
+  const IceVariable *Var = asRegister(Operand);
+  if (Var == NULL) {
+    setError("Expected a register operand");
+    return 0;
+  }
+  int RegNum = Var->getRegNum();
+  if (RegNum >= IceTargetX8632::Reg_xmm0)
+    return RegNum - IceTargetX8632::Reg_xmm0;
+  if (isByteType(Type) && RegNum > IceTargetX8632::Reg_ebx) {
+    setError("Register " + Cfg->physicalRegName(RegNum) +
+             " has no byte form");
+    return 0;
+  }
+  return RegNum;
+}
+
+void IceAssemblerX8632::emitAddress(unsigned RegField, int Base, int Index,
+                                    unsigned Shift, int32_t Disp,
+                                    const IceConstantRelocatable *Symbol) {
+  const int Esp = IceTargetX8632::Reg_esp;
+  const int Ebp = IceTargetX8632::Reg_ebp;
+  if (Index == Esp) {
+    setError("esp can't be an index register");
+    return;
+  }
+  // Without a base register, the address has a disp32.  A symbol
+  // also needs the disp32 to hold its fixup.
+  unsigned Mod = 2;
+  if (Base < 0 || (Symbol == NULL && Disp == 0 && Base != Ebp))
+    Mod = 0;
+  else if (Symbol == NULL && isInt8(Disp))
+    Mod = 1;
+  if (Index >= 0 || Base == Esp) {
+    emitModRM(Mod, RegField, 4);
+    emitByte((Shift << 6) | ((Index >= 0 ? Index : 4) << 3) |
+             (Base >= 0 ? Base : 5));
+  } else {
+    emitModRM(Mod, RegField, Base >= 0 ? Base : 5);
+  }
+  if (Mod == 1)
+    emitByte(Disp & 0xff);
+  else if (Symbol)
+    Code.emitFixup(IceFixup::Fixup_Abs32, Symbol->getName(),
+                   Symbol->getOffset() + Disp);
+  else if (Mod == 2 || Base < 0)
+    emitInt32(Disp);
+}
+
+void IceAssemblerX8632::emitOperand(unsigned RegField,
+                                    const IceOperand *Operand, IceType Type,
+                                    int32_t Disp) {
+  if (const IceVariable *Var = llvm::dyn_cast<IceVariable>(Operand)) {
+    if (Var->getRegNum() >= 0) {
+      assert(Disp == 0);
+      emitModRM(3, RegField, getRegEncoding(Var, Type));
+      return;
+    }
+    IceTargetLowering *Target = Cfg->getTarget();
+    int32_t Offset = Var->getStackOffset() + Target->getStackAdjustment();
+    emitAddress(RegField, Target->getFrameOrStackReg(), -1, 0, Offset + Disp,
+                NULL);
+    return;
+  }
+  if (const IceOperandX8632Mem *Mem =
+          llvm::dyn_cast<IceOperandX8632Mem>(Operand)) {
+    int Base = -1;
+    int Index = -1;
+    if (Mem->getBase())
+      Base = getRegEncoding(Mem->getBase());
+    if (Mem->getIndex())
+      Index = getRegEncoding(Mem->getIndex());
+    const IceConstantRelocatable *Symbol = NULL;
+    if (const IceConstant *Offset = Mem->getOffset()) {
+      if (const IceConstantInteger *Imm =
+              llvm::dyn_cast<IceConstantInteger>(Offset))
+        Disp += static_cast<int32_t>(Imm->getIntValue());
+      else
+        Symbol = llvm::cast<IceConstantRelocatable>(Offset);
+    }
+    emitAddress(RegField, Base, Index, Mem->getShift(), Disp, Symbol);
+    return;
+  }
+  if (isFloatingConstant(Operand)) {
+    // The constant is read from the function's constant pool.
+    emitModRM(0, RegField, 5);
+    Code.emitFixup(IceFixup::Fixup_Abs32, getPoolLabel(Operand), Disp);
+    return;
+  }
+  setError("Unexpected operand in instruction encoding");
+}
+
+void IceAssemblerX8632::emitStackTopOperand(unsigned RegField) {
+  emitAddress(RegField, IceTargetX8632::Reg_esp, -1, 0, 0, NULL);
+}
+
+void IceAssemblerX8632::emitImmediate(IceType Type, const IceOperand *Imm) {
+  if (const IceConstantRelocatable *Symbol =
+          llvm::dyn_cast<IceConstantRelocatable>(Imm)) {
+    if (isByteType(Type) || Type == IceType_i16) {
+      setError("Symbol in a narrow immediate");
+      return;
+    }
+    Code.emitFixup(IceFixup::Fixup_Abs32, Symbol->getName(),
+                   Symbol->getOffset());
+    return;
+  }
+  uint64_t Value = 0;
+  if (isFloatingConstant(Imm))
+    Value = getFloatingBits(Imm, IceType_f32);
+  else
+    Value = llvm::cast<IceConstantInteger>(Imm)->getIntValue();
+  if (isByteType(Type))
+    emitByte(Value & 0xff);
+  else if (Type == IceType_i16)
+    emitInt16(Value & 0xffff);
+  else
+    emitInt32(Value & 0xffffffff);
+}
+
+// Returns the label of Constant in the constant pool, adding it to
+// RoData the first time.  Constants are shared by their bits and
+// size, so e.g. 0.0 and -0.0 get separate entries.
+IceString IceAssemblerX8632::getPoolLabel(const IceOperand *Constant) {
+  IceType Type = Constant->getType();
+  uint32_t Size = iceTypeWidth(Type);
+  std::pair<uint64_t, uint32_t> Key(getFloatingBits(Constant, Type), Size);
+  std::map<std::pair<uint64_t, uint32_t>, IceString>::const_iterator I =
+      PoolLabels.find(Key);
+  if (I != PoolLabels.end())
+    return I->second;
+  char buf[30];
+  sprintf(buf, "%u", NextPoolLabel++);
+  IceString Name = ".L" + Cfg->getName() + "$__fp" + buf;
+  RoData.align(Size == 8 ? 3 : 2);
+  RoData.addLabel(Name);
+  RoData.emitInt32(Key.first & 0xffffffff);
+  if (Size == 8)
+    RoData.emitInt32(Key.first >> 32);
+  PoolLabels[Key] = Name;
+  return Name;
+}
+
+void IceAssemblerX8632::emitAlu(AluOp Op, IceType Type,
+                                const IceOperand *Dest,
+                                const IceOperand *Src) {
+  Type = getOperationType(Type, Dest, Src);
+  bool IsByte = isByteType(Type);
+  emitOperandSizePrefix(Type);
+  if (isImmediate(Src)) {
+    if (IsByte) {
+      emitByte(0x80);
+      emitOperand(Op, Dest, Type);
+      emitImmediate(Type, Src);
+    } else if (isInt8Immediate(Src)) {
+      emitByte(0x83);
+      emitOperand(Op, Dest, Type);
+      emitImmediate(IceType_i8, Src);
+    } else {
+      emitByte(0x81);
+      emitOperand(Op, Dest, Type);
+      emitImmediate(Type, Src);
+    }
+  } else if (asRegister(Src)) {
+    emitByte((Op << 3) | (IsByte ? 0x00 : 0x01));
+    emitOperand(getRegEncoding(Src, Type), Dest, Type);
+  } else if (asRegister(Dest)) {
+    emitByte((Op << 3) | (IsByte ? 0x02 : 0x03));
+    emitOperand(getRegEncoding(Dest, Type), Src, Type);
+  } else {
+    setError("No encoding for a memory-to-memory operation");
+  }
+}
+
+void IceAssemblerX8632::emitShift(ShiftOp Op, IceType Type,
+                                  const IceOperand *Dest,
+                                  const IceOperand *Src) {
+  Type = getOperationType(Type, Dest);
+  bool IsByte = isByteType(Type);
+  emitOperandSizePrefix(Type);
+  if (const IceConstantInteger *Count =
+          llvm::dyn_cast<IceConstantInteger>(Src)) {
+    emitByte(IsByte ? 0xc0 : 0xc1);
+    emitOperand(Op, Dest, Type);
+    emitByte(Count->getIntValue() & 0xff);
+    return;
+  }
+  const IceVariable *Reg = asRegister(Src);
+  if (Reg == NULL || Reg->getRegNum() != IceTargetX8632::Reg_ecx) {
+    setError("Shift count must be an immediate or in ecx");
+    return;
+  }
+  emitByte(IsByte ? 0xd2 : 0xd3);
+  emitOperand(Op, Dest, Type);
+}
+
+void IceAssemblerX8632::emitUnary(UnaryOp Op, IceType Type,
+                                  const IceOperand *Operand) {
+  Type = getOperationType(Type, Operand);
+  emitOperandSizePrefix(Type);
+  emitByte(isByteType(Type) ? 0xf6 : 0xf7);
+  emitOperand(Op, Operand, Type);
+}
+
+void IceAssemblerX8632::emitMov(IceType Type, const IceOperand *Dest,
+                                const IceOperand *Src) {
+  if (Type == IceType_f32 || Type == IceType_f64) {
+    uint8_t Prefix = (Type == IceType_f32 ? 0xf3 : 0xf2);
+    if (asRegister(Dest)) {
+      emitSse(Prefix, 0x10, Dest, Src);
+    } else if (asRegister(Src)) {
+      emitSse(Prefix, 0x11, Src, Dest);
+    } else if (isFloatingConstant(Src)) {
+      // Store the bits as one or two 32-bit immediates.
+      uint64_t Bits = getFloatingBits(Src, Type);
+      emitByte(0xc7);
+      emitOperand(0, Dest);
+      emitInt32(Bits & 0xffffffff);
+      if (Type == IceType_f64) {
+        emitByte(0xc7);
+        emitOperand(0, Dest, IceType_i32, 4);
+        emitInt32(Bits >> 32);
+      }
+    } else {
+      setError("No encoding for a memory-to-memory operation");
+    }
+    return;
+  }
+  Type = getOperationType(Type, Dest, Src);
+  bool IsByte = isByteType(Type);
+  emitOperandSizePrefix(Type);
+  if (isImmediate(Src)) {
+    if (asRegister(Dest)) {
+      emitByte((IsByte ? 0xb0 : 0xb8) + getRegEncoding(Dest, Type));
+    } else {
+      emitByte(IsByte ? 0xc6 : 0xc7);
+      emitOperand(0, Dest, Type);
+    }
+    emitImmediate(Type, Src);
+  } else if (asRegister(Src)) {
+    emitByte(IsByte ? 0x88 : 0x89);
+    emitOperand(getRegEncoding(Src, Type), Dest, Type);
+  } else if (asRegister(Dest)) {
+    emitByte(IsByte ? 0x8a : 0x8b);
+    emitOperand(getRegEncoding(Dest, Type), Src, Type);
+  } else {
+    setError("No encoding for a memory-to-memory operation");
+  }
+}
+
+void IceAssemblerX8632::emitTest(IceType Type, const IceOperand *Src0,
+                                 const IceOperand *Src1) {
+  Type = getOperationType(Type, Src0, Src1);
+  bool IsByte = isByteType(Type);
+  emitOperandSizePrefix(Type);
+  if (isImmediate(Src1)) {
+    emitByte(IsByte ? 0xf6 : 0xf7);
+    emitOperand(0, Src0, Type);
+    emitImmediate(Type, Src1);
+    return;
+  }
+  // test is commutative, so either operand can be the register.
+  if (!asRegister(Src1))
+    std::swap(Src0, Src1);
+  emitByte(IsByte ? 0x84 : 0x85);
+  emitOperand(getRegEncoding(Src1, Type), Src0, Type);
+}
+
+void IceAssemblerX8632::emitSse(uint8_t Prefix, uint8_t Opcode,
+                                const IceOperand *Reg,
+                                const IceOperand *RM) {
+  if (Prefix)
+    emitByte(Prefix);
+  emitByte(0x0f);
+  emitByte(Opcode);
+  emitOperand(getRegEncoding(Reg), RM);
+}
+
+void IceAssemblerX8632::emitAdjustEsp(int32_t Amount) {
+  IceVariable *Esp =
+      Cfg->getTarget()->getPhysicalRegister(IceTargetX8632::Reg_esp);
+  if (Amount < 0)
+    emitAlu(Alu_sub, IceType_i32, Esp,
+            Cfg->getConstantInt(IceType_i32, -Amount));
+  else
+    emitAlu(Alu_add, IceType_i32, Esp,
+            Cfg->getConstantInt(IceType_i32, Amount));
+}
+
+unsigned
+IceAssemblerX8632::getConditionCode(IceInstX8632Br::BrCond Condition) {
+  switch (Condition) {
+  case IceInstX8632Br::Br_a:
+    return 0x7;
+  case IceInstX8632Br::Br_ae:
+    return 0x3;
+  case IceInstX8632Br::Br_b:
+    return 0x2;
+  case IceInstX8632Br::Br_be:
+    return 0x6;
+  case IceInstX8632Br::Br_e:
+    return 0x4;
+  case IceInstX8632Br::Br_g:
+    return 0xf;
+  case IceInstX8632Br::Br_ge:
+    return 0xd;
+  case IceInstX8632Br::Br_l:
+    return 0xc;
+  case IceInstX8632Br::Br_le:
+    return 0xe;
+  case IceInstX8632Br::Br_ne:
+    return 0x5;
+  case IceInstX8632Br::Br_np:
+    return 0xb;
+  case IceInstX8632Br::Br_p:
+    return 0xa;
+  case IceInstX8632Br::Br_None:
+    break;
+  }
+  assert(0 && "Unconditional branch has no condition code");
+  return 0;
+}
+
+uint32_t IceAssemblerX8632::getLabelId(const void *Key) {
+  std::map<const void *, uint32_t>::const_iterator I = LabelIds.find(Key);
+  if (I != LabelIds.end())
+    return I->second;
+  uint32_t Id = Labels.size();
+  LabelPosition Position = { 0, 0, false };
+  Labels.push_back(Position);
+  LabelIds[Key] = Id;
+  return Id;
+}
+
+void IceAssemblerX8632::bindLabelId(uint32_t Id) {
+  assert(!Labels[Id].IsBound);
+  Labels[Id].Offset = Code.getSize();
+  Labels[Id].NumRelaxables = Relaxables.size();
+  Labels[Id].IsBound = true;
+}
+
+void IceAssemblerX8632::emitBranchToLabel(IceInstX8632Br::BrCond Condition,
+                                          uint32_t Id) {
+  Relaxable Branch = { Code.getSize(), true, Condition, Id, false, 0, 0 };
+  Relaxables.push_back(Branch);
+}
+
+void IceAssemblerX8632::emitBranch(IceInstX8632Br::BrCond Condition,
+                                   const IceCfgNode *Target) {
+  emitBranchToLabel(Condition, getLabelId(Target));
+}
+
+void IceAssemblerX8632::emitBranch(IceInstX8632Br::BrCond Condition,
+                                   const IceInstX8632Label *Label) {
+  emitBranchToLabel(Condition, getLabelId(Label));
+}
+
+void IceAssemblerX8632::bindLabel(const IceInstX8632Label *Label) {
+  bindLabelId(getLabelId(Label));
+}
+
+void IceAssemblerX8632::bindNode(const IceCfgNode *Node) {
+  if (uint32_t Log2Align = Node->getAlignment()) {
+    Relaxable Padding = { Code.getSize(), false, IceInstX8632Br::Br_None, 0,
+                          false, Log2Align, 0 };
+    Relaxables.push_back(Padding);
+    Text.requireAlignment(Log2Align);
+  }
+  bindLabelId(getLabelId(Node));
+}
+
+// The jump is "jmp dword ptr [Name+4*Index]", and the table holds the
+// address of each target, which finalize() fills in.
+void IceAssemblerX8632::emitJumpTable(const IceString &Name,
+                                      const IceOperand *Index,
+                                      const IceNodeList &Targets) {
+  emitByte(0xff);
+  emitModRM(0, 4, 4);
+  emitByte((2 << 6) | (getRegEncoding(Index) << 3) | 5);
+  Code.emitFixup(IceFixup::Fixup_Abs32, Name, 0);
+  RoData.align(2);
+  RoData.addLabel(Name);
+  for (IceNodeList::const_iterator I = Targets.begin(), E = Targets.end();
+       I != E; ++I) {
+    LabelRefs.push_back(std::make_pair(RoData.getSize(), getLabelId(*I)));
+    RoData.emitInt32(0);
+  }
+}
+
+void IceAssemblerX8632::emitCall(const IceOperand *Target, bool IsJump) {
+  if (const IceConstantRelocatable *Symbol =
+          llvm::dyn_cast<IceConstantRelocatable>(Target)) {
+    // The displacement is relative to the end of the instruction,
+    // which is 4 bytes past the field.
+    emitByte(IsJump ? 0xe9 : 0xe8);
+    Code.emitFixup(IceFixup::Fixup_PCRel32, Symbol->getName(),
+                   Symbol->getOffset() - 4);
+    return;
+  }
+  emitByte(0xff);
+  emitOperand(IsJump ? 4 : 2, Target);
+}
+
+// Returns the final offset of a label in .text, given the current
+// sizes of the relaxable items.
+uint32_t IceAssemblerX8632::getLabelAddress(uint32_t Id) const {
+  const LabelPosition &Position = Labels[Id];
+  return Position.Offset + Inserted[Position.NumRelaxables];
+}
+
+// Emits Size bytes of nops, using the recommended multi-byte forms.
+static void emitNops(IceAsmSection &Section, uint32_t Size) {
+  static const uint8_t Nops[][8] = {
+    { 0x90 },
+    { 0x66, 0x90 },
+    { 0x0f, 0x1f, 0x00 },
+    { 0x0f, 0x1f, 0x40, 0x00 },
+    { 0x0f, 0x1f, 0x44, 0x00, 0x00 },
+    { 0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00 },
+    { 0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00 },
+    { 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 }
+  };
+  const uint32_t MaxNop = 8;
+  while (Size) {
+    uint32_t Length = (Size < MaxNop ? Size : MaxNop);
+    for (uint32_t i = 0; i < Length; ++i)
+      Section.emitByte(Nops[Length - 1][i]);
+    Size -= Length;
+  }
+}
+
+void IceAssemblerX8632::finalize(void) {
+  for (uint32_t i = 0; i < Labels.size(); ++i) {
+    if (!Labels[i].IsBound) {
+      setError("Branch to a label outside the function");
+      return;
+    }
+  }
+  // Start with every branch short, and make each branch near whose
+  // target is out of range.  Branches only grow, so this terminates,
+  // but growing one can push others out of range and change the
+  // padding, so repeat until nothing changes.
+  uint32_t NumRelaxables = Relaxables.size();
+  Inserted.resize(NumRelaxables + 1);
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    uint32_t Total = 0;
+    for (uint32_t i = 0; i < NumRelaxables; ++i) {
+      Relaxable &Item = Relaxables[i];
+      Inserted[i] = Total;
+      if (Item.IsBranch) {
+        if (!Item.IsNear)
+          Item.Size = 2;
+        else
+          Item.Size = (Item.Condition == IceInstX8632Br::Br_None ? 5 : 6);
+      } else {
+        uint32_t Mask = (1u << Item.Log2Align) - 1;
+        Item.Size = (Mask + 1 - ((Item.Offset + Total) & Mask)) & Mask;
+      }
+      Total += Item.Size;
+    }
+    Inserted[NumRelaxables] = Total;
+    for (uint32_t i = 0; i < NumRelaxables; ++i) {
+      Relaxable &Item = Relaxables[i];
+      if (!Item.IsBranch || Item.IsNear)
+        continue;
+      int32_t End = Item.Offset + Inserted[i] + Item.Size;
+      int32_t Disp = getLabelAddress(Item.Label) - End;
+      if (!isInt8(Disp)) {
+        Item.IsNear = true;
+        Changed = true;
+      }
+    }
+  }
+
+  // Lay out .text, inserting the branches and padding between the
+  // pieces of the scratch buffer.
+  const IceByteList &Bytes = Code.getBytes();
+  uint32_t Pos = 0;
+  for (uint32_t i = 0; i < NumRelaxables; ++i) {
+    const Relaxable &Item = Relaxables[i];
+    for (; Pos < Item.Offset; ++Pos)
+      Text.emitByte(Bytes[Pos]);
+    if (!Item.IsBranch) {
+      emitNops(Text, Item.Size);
+      continue;
+    }
+    int32_t Disp = getLabelAddress(Item.Label) - (Text.getSize() + Item.Size);
+    if (Item.Condition == IceInstX8632Br::Br_None) {
+      Text.emitByte(Item.IsNear ? 0xe9 : 0xeb);
+    } else if (Item.IsNear) {
+      Text.emitByte(0x0f);
+      Text.emitByte(0x80 + getConditionCode(Item.Condition));
+    } else {
+      Text.emitByte(0x70 + getConditionCode(Item.Condition));
+    }
+    if (Item.IsNear)
+      Text.emitInt32(Disp);
+    else
+      Text.emitByte(Disp & 0xff);
+  }
+  for (; Pos < Bytes.size(); ++Pos)
+    Text.emitByte(Bytes[Pos]);
+
+  // Move the fixups to their final offsets.  No relaxable item sits
+  // at a fixup's offset, since a fixup never starts an instruction.
+  const IceFixupList &Fixups = Code.getFixups();
+  uint32_t Item = 0;
+  for (IceFixupList::const_iterator I = Fixups.begin(), E = Fixups.end();
+       I != E; ++I) {
+    while (Item < NumRelaxables && Relaxables[Item].Offset <= I->getOffset())
+      ++Item;
+    IceFixup Fixup = *I;
+    Fixup.setOffset(I->getOffset() + Inserted[Item]);
+    Text.addFixup(Fixup);
+  }
+
+  // Fill in the jump tables, whose entries are relative to the
+  // function's symbol.
+  for (uint32_t i = 0; i < LabelRefs.size(); ++i) {
+    uint32_t Offset = LabelRefs[i].first;
+    uint32_t Address = getLabelAddress(LabelRefs[i].second);
+    RoData.putInt32(Offset, Address);
+    RoData.addFixup(
+        IceFixup(IceFixup::Fixup_Abs32, Offset, Cfg->getName(), Address));
+  }
+}
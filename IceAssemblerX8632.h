@@ -0,0 +1,139 @@
+// -*- Mode: c++ -*-
+/* Copyright 2014 The Native Client Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can
+ * be found in the LICENSE file.
+ */
+
+#ifndef _IceAssemblerX8632_h
+#define _IceAssemblerX8632_h
+
+#include "IceDefs.h"
+#include "IceAssembler.h"
+#include "IceInstX8632.h"
+
+// IceAssemblerX8632 encodes x86-32 instructions.  The IceInstX8632
+// subclasses choose the opcodes, and the helpers here take care of
+// operand sizes, ModRM/SIB bytes, immediates and fixups.  Operands
+// are physical registers, stack slots (variables without a register),
+// IceOperandX8632Mem addresses, integer or relocatable immediates,
+// and floating-point constants, which are placed in .rodata.
+//
+// Instructions are first encoded into a scratch buffer with each
+// branch and alignment left out.  finalize() then picks the short
+// form of every branch whose target is in range, growing the others
+// to the near form until nothing changes, and lays out the final
+// .text contents.
+class IceAssemblerX8632 : public IceAssembler {
+public:
+  static IceAssemblerX8632 *create(IceCfg *Cfg) {
+    return new IceAssemblerX8632(Cfg);
+  }
+  void setError(const IceString &Message);
+
+  // The opcode extensions of the ALU group (opcodes 0x00-0x3f and
+  // 0x80-0x83), the shift group (0xc1, 0xd3) and the unary group
+  // (0xf7).
+  enum AluOp { Alu_add, Alu_or, Alu_adc, Alu_sbb, Alu_and, Alu_sub, Alu_xor,
+               Alu_cmp };
+  enum ShiftOp { Shift_shl = 4, Shift_shr = 5, Shift_sar = 7 };
+  enum UnaryOp { Unary_test, Unary_not = 2, Unary_neg, Unary_mul,
+                 Unary_imul, Unary_div, Unary_idiv };
+
+  void emitByte(uint8_t Byte) { Code.emitByte(Byte); }
+  void emitInt16(uint16_t Value);
+  void emitInt32(uint32_t Value) { Code.emitInt32(Value); }
+  // Emits 0x66 for 16-bit operations.
+  void emitOperandSizePrefix(IceType Type);
+  // Emits the ModRM byte, plus any SIB byte and displacement, for
+  // Operand with RegField in the reg bits.  Type is the operation's
+  // size, which matters only for a register Operand.  Disp is added
+  // to the operand's displacement, e.g. to address the upper half of
+  // a 64-bit slot.
+  void emitOperand(unsigned RegField, const IceOperand *Operand,
+                   IceType Type = IceType_i32, int32_t Disp = 0);
+  // Emits the ModRM byte for [esp] with RegField in the reg bits.
+  void emitStackTopOperand(unsigned RegField);
+  void emitImmediate(IceType Type, const IceOperand *Imm);
+  // Returns the encoding of a physical register, which must have a
+  // byte form for an i8 Type.
+  unsigned getRegEncoding(const IceOperand *Operand,
+                          IceType Type = IceType_i32);
+
+  void emitAlu(AluOp Op, IceType Type, const IceOperand *Dest,
+               const IceOperand *Src);
+  void emitShift(ShiftOp Op, IceType Type, const IceOperand *Dest,
+                 const IceOperand *Src);
+  void emitUnary(UnaryOp Op, IceType Type, const IceOperand *Operand);
+  void emitMov(IceType Type, const IceOperand *Dest, const IceOperand *Src);
+  void emitTest(IceType Type, const IceOperand *Src0, const IceOperand *Src1);
+  // Emits an SSE instruction with an optional mandatory prefix (0xf3,
+  // 0xf2 or 0x66) and the 0x0f escape.  Reg is a register that goes
+  // in the reg bits, and RM goes in the r/m bits.
+  void emitSse(uint8_t Prefix, uint8_t Opcode, const IceOperand *Reg,
+               const IceOperand *RM);
+  // Adds Amount to esp, leaving the stack adjustment alone.
+  void emitAdjustEsp(int32_t Amount);
+  static unsigned getConditionCode(IceInstX8632Br::BrCond Condition);
+  // Returns the size of an integer operation of Type on the operands.
+  static IceType getOperationType(IceType Type, const IceOperand *Operand0,
+                                  const IceOperand *Operand1 = NULL);
+
+  void emitBranch(IceInstX8632Br::BrCond Condition, const IceCfgNode *Target);
+  void emitBranch(IceInstX8632Br::BrCond Condition,
+                  const IceInstX8632Label *Label);
+  void emitJumpTable(const IceString &Name, const IceOperand *Index,
+                     const IceNodeList &Targets);
+  // Emits a call, or a jmp for a tail call.
+  void emitCall(const IceOperand *Target, bool IsJump);
+  void bindLabel(const IceInstX8632Label *Label);
+  virtual void bindNode(const IceCfgNode *Node);
+  virtual void finalize(void);
+
+private:
+  IceAssemblerX8632(IceCfg *Cfg) : IceAssembler(Cfg), NextPoolLabel(0) {}
+  void emitModRM(unsigned Mod, unsigned RegField, unsigned RM) {
+    emitByte((Mod << 6) | (RegField << 3) | RM);
+  }
+  void emitAddress(unsigned RegField, int Base, int Index, unsigned Shift,
+                   int32_t Disp, const IceConstantRelocatable *Symbol);
+  IceString getPoolLabel(const IceOperand *Constant);
+  uint32_t getLabelId(const void *Key);
+  void bindLabelId(uint32_t Id);
+  void emitBranchToLabel(IceInstX8632Br::BrCond Condition, uint32_t Id);
+  uint32_t getLabelAddress(uint32_t Id) const;
+
+  // A Relaxable is an item of variable size at Offset in the scratch
+  // buffer: a branch to a label, or padding to an alignment.  Items
+  // are kept in order of their offsets.
+  struct Relaxable {
+    uint32_t Offset;
+    bool IsBranch;
+    IceInstX8632Br::BrCond Condition;
+    uint32_t Label;     // label id, for a branch
+    bool IsNear;        // for a branch, whether it needs a rel32
+    uint32_t Log2Align; // for padding
+    uint32_t Size;
+  };
+  std::vector<Relaxable> Relaxables;
+  // Where each label is bound, as an offset in the scratch buffer and
+  // the number of relaxable items before it.
+  struct LabelPosition {
+    uint32_t Offset;
+    uint32_t NumRelaxables;
+    bool IsBound;
+  };
+  // The number of bytes that the relaxable items insert before each
+  // item, plus a final entry for the total.
+  std::vector<uint32_t> Inserted;
+  std::vector<LabelPosition> Labels;
+  std::map<const void *, uint32_t> LabelIds;
+  // Jump table entries in RoData, each holding a label's address.
+  std::vector<std::pair<uint32_t, uint32_t> > LabelRefs;
+  // Floating-point constant pool, keyed by the constant's bits and
+  // size.
+  std::map<std::pair<uint64_t, uint32_t>, IceString> PoolLabels;
+  uint32_t NextPoolLabel;
+  IceAsmSection Code; // the scratch buffer
+};
+
+#endif // _IceAssemblerX8632_h
@@ -3,12 +3,15 @@
  * be found in the LICENSE file.
  */
 
-#include <iostream> // std::cout
+#include <algorithm> // std::min, std::max
 
+#include "IceAssembler.h"
 #include "IceCfg.h"
 #include "IceCfgNode.h"
 #include "IceDefs.h"
+#include "IceELFObjectWriter.h"
 #include "IceInst.h"
+#include "IceJIT.h"
 #include "IceLiveness.h"
 #include "IceOperand.h"
 #include "IceRegAlloc.h"
@@ -20,7 +23,8 @@ public:
   IceConstantRelocatable *getOrAddRelocatable(IceType Type, const void *Handle,
                                               int64_t Offset,
                                               const IceString &Name) {
-    uint32_t Index = NameToIndex.translate(KeyType(Name, Type));
+    uint32_t Index =
+        NameToIndex.translate(KeyType(NameType(Name, Type), Offset));
     if (Index >= RelocatablePool.size()) {
       RelocatablePool.resize(Index + 1);
       void *Handle = NULL;
@@ -38,13 +42,15 @@ public:
   }
 
 private:
-  typedef std::pair<IceString, IceType> KeyType;
+  typedef std::pair<IceString, IceType> NameType;
+  typedef std::pair<NameType, int64_t> KeyType;
   // TODO: Cfg is being captured primarily for arena allocation for
   // new IceConstants.  If IceConstants live beyond a function/Cfg,
   // they need to be allocated from a global arena and there needs to
   // be appropriate locking.
   IceCfg *Cfg;
-  // Use IceValueTranslation<> to map (Name,Type) pairs to an index.
+  // Use IceValueTranslation<> to map (Name,Type,Offset) triples to an
+  // index.  Symbol+Offset entries come from address mode folding.
   IceValueTranslation<KeyType> NameToIndex;
   std::vector<IceConstantRelocatable *> RelocatablePool;
 };
@@ -52,8 +58,8 @@ private:
 IceOstream *GlobalStr;
 
 IceCfg::IceCfg(void)
-    : Str(std::cout, this), HasError(false), ErrorMessage(""),
-      Type(IceType_void), Target(NULL), Entry(NULL), Liveness(NULL),
+    : Str(this), HasError(false), ErrorMessage(""), Type(IceType_void),
+      OptSize(false), LoopAlign(0), Target(NULL), Entry(NULL), Liveness(NULL),
       NextInstNumber(1) {
   GlobalStr = &Str;
   ConstantPool = new IceConstantPool(this);
@@ -65,6 +71,7 @@ IceCfg::~IceCfg() {
   // using arena-based allocation.
   delete ConstantPool;
   delete Liveness;
+  delete Target;
 }
 
 void IceCfg::setError(const IceString &Message) {
@@ -188,7 +195,7 @@ int IceCfg::newInstNumber(void) {
   return Result;
 }
 
-IceString IceCfg::physicalRegName(int Reg) const {
+const IceString &IceCfg::physicalRegName(int Reg) const {
   assert(getTarget());
   return getTarget()->getRegName(Reg);
 }
@@ -229,13 +236,451 @@ void IceCfg::deletePhis(void) {
   }
 }
 
+// A CFG edge considered for block layout, weighted by its estimated
+// execution frequency.  Ties are broken in favor of back edges, which
+// rotates a loop so that its latch falls into the header, then edges
+// that already fall through in the original layout, and then by
+// Order, the edge's position in a walk over the original layout.
+struct IceLayoutEdge {
+  IceLayoutEdge(IceCfgNode *From, IceCfgNode *To, double Weight,
+                bool IsBackEdge, bool IsFallthrough, uint32_t Order)
+      : From(From), To(To), Weight(Weight), IsBackEdge(IsBackEdge),
+        IsFallthrough(IsFallthrough), Order(Order) {}
+  IceCfgNode *From;
+  IceCfgNode *To;
+  double Weight;
+  bool IsBackEdge;
+  bool IsFallthrough;
+  uint32_t Order;
+};
+
+static bool compareLayoutEdges(const IceLayoutEdge &A,
+                               const IceLayoutEdge &B) {
+  if (A.Weight != B.Weight)
+    return A.Weight > B.Weight;
+  if (A.IsBackEdge != B.IsBackEdge)
+    return A.IsBackEdge;
+  if (A.IsFallthrough != B.IsFallthrough)
+    return A.IsFallthrough;
+  return A.Order < B.Order;
+}
+
+static bool isBackEdge(const std::vector<IceLayoutEdge> &BackEdges,
+                       const IceCfgNode *From, const IceCfgNode *To) {
+  for (uint32_t i = 0; i < BackEdges.size(); ++i) {
+    if (BackEdges[i].From == From && BackEdges[i].To == To)
+      return true;
+  }
+  return false;
+}
+
+// Returns the probability of taking the edge From->To.  Profile
+// weights on a conditional branch take precedence.  Otherwise an edge
+// that leaves a loop is assumed to be taken one time in eight, and the
+// remaining edges share the rest equally.
+static double getEdgeProbability(IceCfgNode *From, IceCfgNode *To) {
+  const IceNodeList &OutEdges = From->getOutEdges();
+  const IceInstBr *Br = llvm::dyn_cast<IceInstBr>(From->getInsts().back());
+  if (Br && Br->getTargetTrue() &&
+      Br->getTargetTrue() != Br->getTargetFalse()) {
+    double WeightTrue = Br->getWeightTrue();
+    double WeightFalse = Br->getWeightFalse();
+    if (WeightTrue + WeightFalse > 0) {
+      double Weight = (To == Br->getTargetTrue()) ? WeightTrue : WeightFalse;
+      return Weight / (WeightTrue + WeightFalse);
+    }
+  }
+  uint32_t Sum = 0, Mine = 0;
+  for (IceNodeList::const_iterator I = OutEdges.begin(), E = OutEdges.end();
+       I != E; ++I) {
+    uint32_t Weight = ((*I)->getLoopDepth() < From->getLoopDepth()) ? 1 : 7;
+    Sum += Weight;
+    if (*I == To)
+      Mine = Weight;
+  }
+  return Sum ? (double)Mine / Sum : 0;
+}
+
+// Computes a new block layout (LNodes order) that maximizes
+// fallthrough along the most frequently executed edges.
+//
+// Node frequencies are estimated statically: they flow from the entry
+// along forward edges, split by the edge probabilities, and a loop
+// header is assumed to run eight times per entry into the loop.
+// Edges are then visited from hottest to coldest, and each one glues
+// the chain ending at its source to the chain starting at its target.
+// Finally the chains are placed starting with the entry chain, each
+// time choosing the chain most frequently entered from what has
+// already been placed.  Unreachable nodes keep their relative order at
+// the end.
+void IceCfg::reorderNodes(void) {
+  uint32_t NumNodes = Nodes.size();
+
+  // Find the back edges, and a reverse postorder of the reachable
+  // nodes, with a depth-first search from the entry.  The target of a
+  // back edge is a loop header.
+  std::vector<bool> Visited(NumNodes), OnStack(NumNodes);
+  std::vector<IceLayoutEdge> BackEdges;
+  IceNodeList PostOrder;
+  std::vector<std::pair<IceCfgNode *, uint32_t> > Stack;
+  Stack.push_back(std::make_pair(Entry, 0));
+  Visited[Entry->getIndex()] = true;
+  OnStack[Entry->getIndex()] = true;
+  while (!Stack.empty()) {
+    IceCfgNode *Node = Stack.back().first;
+    uint32_t EdgeIndex = Stack.back().second++;
+    const IceNodeList &OutEdges = Node->getOutEdges();
+    if (EdgeIndex >= OutEdges.size()) {
+      OnStack[Node->getIndex()] = false;
+      PostOrder.push_back(Node);
+      Stack.pop_back();
+      continue;
+    }
+    IceCfgNode *Succ = OutEdges[EdgeIndex];
+    if (OnStack[Succ->getIndex()]) {
+      BackEdges.push_back(IceLayoutEdge(Node, Succ, 0, true, false, 0));
+    } else if (!Visited[Succ->getIndex()]) {
+      Visited[Succ->getIndex()] = true;
+      OnStack[Succ->getIndex()] = true;
+      Stack.push_back(std::make_pair(Succ, 0));
+    }
+  }
+
+  // Each back edge contributes the nodes that reach its source without
+  // passing through the header to the header's loop body.  A body that
+  // reaches the entry belongs to an irreducible region and is ignored.
+  Loops.clear();
+  for (uint32_t i = 0; i < LNodes.size(); ++i)
+    LNodes[i]->setLoopDepth(0);
+  std::vector<bool> IsHeader(NumNodes);
+  for (uint32_t i = 0; i < BackEdges.size(); ++i) {
+    IceCfgNode *Header = BackEdges[i].To;
+    if (IsHeader[Header->getIndex()])
+      continue;
+    std::vector<bool> InLoop(NumNodes);
+    InLoop[Header->getIndex()] = true;
+    IceNodeList Worklist;
+    for (uint32_t j = i; j < BackEdges.size(); ++j) {
+      IceCfgNode *Latch = BackEdges[j].From;
+      if (BackEdges[j].To == Header && !InLoop[Latch->getIndex()]) {
+        InLoop[Latch->getIndex()] = true;
+        Worklist.push_back(Latch);
+      }
+    }
+    bool Irreducible = false;
+    IceNodeList Body(1, Header);
+    while (!Worklist.empty()) {
+      IceCfgNode *Node = Worklist.back();
+      Worklist.pop_back();
+      Body.push_back(Node);
+      if (Node == Entry)
+        Irreducible = true;
+      const IceNodeList &InEdges = Node->getInEdges();
+      for (IceNodeList::const_iterator I = InEdges.begin(), E = InEdges.end();
+           I != E; ++I) {
+        if (!InLoop[(*I)->getIndex()]) {
+          InLoop[(*I)->getIndex()] = true;
+          Worklist.push_back(*I);
+        }
+      }
+    }
+    if (Irreducible)
+      continue;
+    IsHeader[Header->getIndex()] = true;
+    Loops.push_back(Body);
+    for (IceNodeList::iterator I = Body.begin(), E = Body.end(); I != E; ++I)
+      (*I)->setLoopDepth((*I)->getLoopDepth() + 1);
+  }
+
+  // Propagate the node frequencies in reverse postorder, so that every
+  // forward predecessor of a node is done before the node itself.
+  const double LoopScale = 8;
+  std::vector<double> Frequency(NumNodes);
+  for (IceNodeList::reverse_iterator I = PostOrder.rbegin(),
+                                     E = PostOrder.rend();
+       I != E; ++I) {
+    IceCfgNode *Node = *I;
+    double Sum = (Node == Entry) ? 1 : 0;
+    const IceNodeList &InEdges = Node->getInEdges();
+    for (IceNodeList::const_iterator PI = InEdges.begin(),
+                                     PE = InEdges.end();
+         PI != PE; ++PI) {
+      IceCfgNode *Pred = *PI;
+      if (Visited[Pred->getIndex()] && !isBackEdge(BackEdges, Pred, Node))
+        Sum += Frequency[Pred->getIndex()] * getEdgeProbability(Pred, Node);
+    }
+    if (IsHeader[Node->getIndex()])
+      Sum *= LoopScale;
+    Frequency[Node->getIndex()] = Sum;
+    Node->setFrequency(Sum);
+  }
+
+  std::vector<IceLayoutEdge> Edges;
+  for (uint32_t i = 0; i < LNodes.size(); ++i) {
+    IceCfgNode *From = LNodes[i];
+    IceCfgNode *Next = (i + 1 < LNodes.size()) ? LNodes[i + 1] : NULL;
+    if (!Visited[From->getIndex()])
+      continue;
+    const IceNodeList &OutEdges = From->getOutEdges();
+    for (IceNodeList::const_iterator I = OutEdges.begin(), E = OutEdges.end();
+         I != E; ++I) {
+      double Weight =
+          Frequency[From->getIndex()] * getEdgeProbability(From, *I);
+      Edges.push_back(IceLayoutEdge(From, *I, Weight,
+                                    isBackEdge(BackEdges, From, *I),
+                                    *I == Next, Edges.size()));
+    }
+  }
+  std::sort(Edges.begin(), Edges.end(), compareLayoutEdges);
+
+  // Grow chains along the hottest edges.
+  std::vector<IceNodeList> Chains(NumNodes);
+  std::vector<uint32_t> ChainOf(NumNodes);
+  for (uint32_t i = 0; i < LNodes.size(); ++i) {
+    uint32_t Index = LNodes[i]->getIndex();
+    Chains[Index].push_back(LNodes[i]);
+    ChainOf[Index] = Index;
+  }
+  for (uint32_t i = 0; i < Edges.size(); ++i) {
+    uint32_t FromChain = ChainOf[Edges[i].From->getIndex()];
+    uint32_t ToChain = ChainOf[Edges[i].To->getIndex()];
+    if (FromChain == ToChain || Edges[i].To == Entry ||
+        Chains[FromChain].back() != Edges[i].From ||
+        Chains[ToChain].front() != Edges[i].To)
+      continue;
+    for (IceNodeList::iterator I = Chains[ToChain].begin(),
+                               E = Chains[ToChain].end();
+         I != E; ++I) {
+      Chains[FromChain].push_back(*I);
+      ChainOf[(*I)->getIndex()] = FromChain;
+    }
+    Chains[ToChain].clear();
+  }
+
+  // Place the chains.  EntryWeight[C] is the heaviest edge from a
+  // placed node into the head of chain C.
+  std::vector<double> EntryWeight(NumNodes);
+  std::vector<bool> Placed(NumNodes);
+  IceNodeList NewLNodes;
+  uint32_t Next = ChainOf[Entry->getIndex()];
+  while (true) {
+    Placed[Next] = true;
+    for (IceNodeList::iterator I = Chains[Next].begin(),
+                               E = Chains[Next].end();
+         I != E; ++I) {
+      NewLNodes.push_back(*I);
+    }
+    for (uint32_t i = 0; i < Edges.size(); ++i) {
+      uint32_t ToChain = ChainOf[Edges[i].To->getIndex()];
+      if (ChainOf[Edges[i].From->getIndex()] == Next && !Placed[ToChain] &&
+          Chains[ToChain].front() == Edges[i].To)
+        EntryWeight[ToChain] = std::max(EntryWeight[ToChain], Edges[i].Weight);
+    }
+    // Pick the unplaced chain with the highest entry weight, preferring
+    // reachable chains, then the earliest in the original layout.
+    bool Found = false;
+    uint32_t Best = 0;
+    for (uint32_t i = 0; i < LNodes.size(); ++i) {
+      uint32_t Chain = ChainOf[LNodes[i]->getIndex()];
+      if (Placed[Chain] || Chains[Chain].front() != LNodes[i])
+        continue;
+      if (!Found) {
+        Found = true;
+        Best = Chain;
+        continue;
+      }
+      bool BestReachable = Visited[Chains[Best].front()->getIndex()];
+      bool Reachable = Visited[LNodes[i]->getIndex()];
+      if ((Reachable && !BestReachable) ||
+          (Reachable == BestReachable &&
+           EntryWeight[Chain] > EntryWeight[Best]))
+        Best = Chain;
+    }
+    if (!Found)
+      break;
+    Next = Best;
+  }
+  assert(NewLNodes.size() == LNodes.size());
+  LNodes = NewLNodes;
+}
+
+// The address mode optimization follows variables back to their
+// definitions, so first recompute DefInst for every variable from
+// scratch.  Unlike the incremental setDefinition(), this also tracks
+// variables that live across blocks, and it gives up on variables
+// with more than one definition, such as lowered phi temporaries.
 void IceCfg::doAddressOpt(void) {
+  for (IceVarList::iterator I = Variables.begin(), E = Variables.end();
+       I != E; ++I) {
+    if (*I)
+      (*I)->resetDefinition();
+  }
+  for (IceNodeList::iterator I = LNodes.begin(), E = LNodes.end(); I != E;
+       ++I) {
+    IceInstList &Insts = (*I)->getInsts();
+    for (IceInstList::iterator II = Insts.begin(), IE = Insts.end(); II != IE;
+         ++II) {
+      IceInst *Inst = *II;
+      if (!Inst->isDeleted() && Inst->getDest())
+        Inst->getDest()->addDefinition(Inst);
+    }
+  }
   for (IceNodeList::iterator I = LNodes.begin(), E = LNodes.end(); I != E;
        ++I) {
     (*I)->doAddressOpt();
   }
 }
 
+void IceCfg::doLoadFolding(void) {
+  for (IceNodeList::iterator I = LNodes.begin(), E = LNodes.end(); I != E;
+       ++I) {
+    (*I)->doLoadFolding();
+  }
+}
+
+// Returns the representative of Var's coalescing group, compressing
+// the path along the way.
+static uint32_t findLeader(std::vector<uint32_t> &Leaders, uint32_t Var) {
+  uint32_t Leader = Var;
+  while (Leaders[Leader] != Leader)
+    Leader = Leaders[Leader];
+  while (Leaders[Var] != Leader) {
+    uint32_t Next = Leaders[Var];
+    Leaders[Var] = Leader;
+    Var = Next;
+  }
+  return Leader;
+}
+
+static bool canCoalesce(const IceVariable *Var) {
+  // Arguments have a fixed home location, and precolored variables
+  // have a fixed register, so leave them alone.
+  return !Var->getIsArg() && Var->getRegNum() < 0 &&
+         !Var->getLiveRange().isEmpty();
+}
+
+// Merges the two sides of an assignment into a single variable when
+// their live ranges don't overlap, and deletes the assignment.  This
+// mostly cleans up after phi lowering, so that a loop-carried value
+// stays in one variable instead of being copied through a "_phi"
+// temporary on every back edge.  Requires live ranges from
+// liveness(IceLiveness_RangesFull).  Coalesced variables are no
+// longer in SSA form, so a merged variable with several definitions
+// is marked multi-def and getDefinition() returns NULL for it.
+void IceCfg::coalesceCopies(void) {
+  uint32_t NumVars = Variables.size();
+  std::vector<uint32_t> Leaders(NumVars);
+  for (uint32_t i = 0; i < NumVars; ++i)
+    Leaders[i] = i;
+  // Target lowering may write an instruction's Dest before it has
+  // read all the sources (e.g. select), so a variable must not be
+  // coalesced with any variable that appears as a source of an
+  // instruction it is the Dest of, even if the live ranges merely
+  // touch.  Conflicts[] records these pairs, indexed by group leader.
+  std::vector<std::vector<uint32_t> > Conflicts(NumVars);
+  std::vector<IceInst *> Copies;
+  for (IceNodeList::iterator I = LNodes.begin(), E = LNodes.end(); I != E;
+       ++I) {
+    IceInstList &Insts = (*I)->getInsts();
+    for (IceInstList::iterator II = Insts.begin(), IE = Insts.end(); II != IE;
+         ++II) {
+      IceInst *Inst = *II;
+      if (Inst->isDeleted())
+        continue;
+      IceVariable *Dest = Inst->getDest();
+      if (Dest == NULL)
+        continue;
+      if (llvm::isa<IceInstAssign>(Inst) &&
+          llvm::isa<IceVariable>(Inst->getSrc(0))) {
+        Copies.push_back(Inst);
+        continue;
+      }
+      for (unsigned i = 0; i < Inst->getSrcSize(); ++i) {
+        IceOperand *Src = Inst->getSrc(i);
+        for (unsigned j = 0; j < Src->getNumVars(); ++j) {
+          uint32_t SrcIndex = Src->getVar(j)->getIndex();
+          Conflicts[Dest->getIndex()].push_back(SrcIndex);
+          Conflicts[SrcIndex].push_back(Dest->getIndex());
+        }
+      }
+    }
+  }
+
+  bool Coalesced = false;
+  for (std::vector<IceInst *>::iterator I = Copies.begin(), E = Copies.end();
+       I != E; ++I) {
+    IceInst *Copy = *I;
+    IceVariable *Dest = Copy->getDest();
+    IceVariable *Src = llvm::cast<IceVariable>(Copy->getSrc(0));
+    if (Dest->getType() != Src->getType() || !canCoalesce(Dest) ||
+        !canCoalesce(Src))
+      continue;
+    uint32_t DestLeader = findLeader(Leaders, Dest->getIndex());
+    uint32_t SrcLeader = findLeader(Leaders, Src->getIndex());
+    if (DestLeader != SrcLeader) {
+      IceVariable *Keep = Variables[std::min(DestLeader, SrcLeader)];
+      IceVariable *Drop = Variables[std::max(DestLeader, SrcLeader)];
+      if (Keep->getLiveRange().overlaps(Drop->getLiveRange()))
+        continue;
+      const std::vector<uint32_t> &KeepConflicts = Conflicts[Keep->getIndex()];
+      bool HasConflict = false;
+      for (std::vector<uint32_t>::const_iterator CI = KeepConflicts.begin(),
+                                                 CE = KeepConflicts.end();
+           CI != CE; ++CI) {
+        if (findLeader(Leaders, *CI) == Drop->getIndex()) {
+          HasConflict = true;
+          break;
+        }
+      }
+      if (HasConflict)
+        continue;
+      IceLiveRange Merged = Keep->getLiveRange();
+      Merged.merge(Drop->getLiveRange());
+      Keep->setLiveRange(Merged);
+      Leaders[Drop->getIndex()] = Keep->getIndex();
+      std::vector<uint32_t> &DropConflicts = Conflicts[Drop->getIndex()];
+      Conflicts[Keep->getIndex()].insert(Conflicts[Keep->getIndex()].end(),
+                                         DropConflicts.begin(),
+                                         DropConflicts.end());
+      DropConflicts.clear();
+    }
+    Copy->setDeleted();
+    Coalesced = true;
+  }
+  if (!Coalesced)
+    return;
+
+  IceVarList Replacements(NumVars);
+  llvm::BitVector Merged(NumVars);
+  for (uint32_t i = 0; i < NumVars; ++i) {
+    uint32_t Leader = findLeader(Leaders, i);
+    if (Leader != i) {
+      Replacements[i] = Variables[Leader];
+      Merged[Leader] = true;
+    }
+  }
+  for (IceNodeList::iterator I = LNodes.begin(), E = LNodes.end(); I != E;
+       ++I) {
+    (*I)->replaceVars(Replacements);
+  }
+  // replaceVars() leaves each merged variable with whichever
+  // definition it saw last, so recompute DefInst for them from
+  // scratch, marking the ones that now have several definitions.
+  for (int i = Merged.find_first(); i != -1; i = Merged.find_next(i))
+    Variables[i]->resetDefinition();
+  for (IceNodeList::iterator I = LNodes.begin(), E = LNodes.end(); I != E;
+       ++I) {
+    IceInstList &Insts = (*I)->getInsts();
+    for (IceInstList::iterator II = Insts.begin(), IE = Insts.end(); II != IE;
+         ++II) {
+      IceInst *Inst = *II;
+      IceVariable *Dest = Inst->getDest();
+      if (!Inst->isDeleted() && Dest && Merged[Dest->getIndex()])
+        Dest->addDefinition(Inst);
+    }
+  }
+}
+
 void IceCfg::genCode(void) {
   if (Target == NULL) {
     setError("IceCfg::makeTarget() wasn't called.");
@@ -363,7 +808,11 @@ bool IceCfg::validateLiveness(void) const {
         continue;
       int InstNumber = Inst->getNumber();
       IceVariable *Dest = Inst->getDest();
-      if (Dest) {
+      // An instruction with side effects, like a call, is kept even
+      // if its Dest is never used, in which case Dest has an empty
+      // live range.
+      if (Dest &&
+          !(Inst->hasSideEffects() && Dest->getLiveRange().isEmpty())) {
         // TODO: This instruction should actually begin Dest's live
         // range, so we could probably test that this instruction is
         // the beginning of some segment of Dest's live range.  But
@@ -391,6 +840,53 @@ bool IceCfg::validateLiveness(void) const {
   return Valid;
 }
 
+// Returns the number of callee-saved registers that the tentative
+// register assignment uses.
+static uint32_t countCalleeSaves(const IceVarList &Variables,
+                                 const llvm::SmallBitVector &CalleeSaves) {
+  llvm::SmallBitVector Used(CalleeSaves.size());
+  for (IceVarList::const_iterator I = Variables.begin(), E = Variables.end();
+       I != E; ++I) {
+    const IceVariable *Var = *I;
+    if (Var && !Var->getLiveRange().isEmpty() && Var->getRegNumTmp() >= 0)
+      Used[Var->getRegNumTmp()] = true;
+  }
+  return (Used & CalleeSaves).count();
+}
+
+// Returns the instruction numbers of the nodes that are part of a
+// loop, as a live range.
+static IceLiveRange getLoopRange(const std::vector<IceNodeList> &Loops) {
+  std::vector<IceLiveRange::RangeElementType> Segments;
+  for (std::vector<IceNodeList>::const_iterator I = Loops.begin(),
+                                                E = Loops.end();
+       I != E; ++I) {
+    for (IceNodeList::const_iterator N = I->begin(), NE = I->end(); N != NE;
+         ++N) {
+      int First = -1, Last = -1;
+      const IceInstList &Insts = (*N)->getInsts();
+      for (IceInstList::const_iterator II = Insts.begin(), IE = Insts.end();
+           II != IE; ++II) {
+        if ((*II)->isDeleted())
+          continue;
+        if (First < 0)
+          First = (*II)->getNumber();
+        Last = (*II)->getNumber();
+      }
+      if (First >= 0)
+        Segments.push_back(std::make_pair(First, Last + 1));
+    }
+  }
+  // Nested loops list their nodes more than once.
+  std::sort(Segments.begin(), Segments.end());
+  Segments.erase(std::unique(Segments.begin(), Segments.end()),
+                 Segments.end());
+  IceLiveRange Range;
+  for (unsigned i = 0; i < Segments.size(); ++i)
+    Range.addSegment(Segments[i].first, Segments[i].second);
+  return Range;
+}
+
 void IceCfg::regAlloc(void) {
   IceLinearScan LinearScan(this);
   IceTargetLowering::RegSetMask RegInclude = 0, RegExclude = 0;
@@ -401,7 +897,53 @@ void IceCfg::regAlloc(void) {
     RegExclude |= IceTargetLowering::RegMask_FramePointer;
   llvm::SmallBitVector RegMask =
       getTarget()->getRegisterSet(RegInclude, RegExclude);
-  LinearScan.scan(RegMask);
+  bool Success = LinearScan.scan(RegMask);
+
+  // In a function without calls, a callee-saved register costs a push
+  // and a pop but is never needed to survive a call.  If the scan used
+  // one, scan again with only the caller-saved registers.  The second
+  // result is kept if it uses fewer callee-saved registers, and every
+  // variable that it leaves without a register is an argument, which
+  // already lives on the stack, and is not live in a loop, where it
+  // would be reloaded on each iteration.
+  llvm::SmallBitVector CalleeSaves = getTarget()->getRegisterSet(
+      IceTargetLowering::RegMask_CalleeSave, RegExclude);
+  uint32_t NumCalleeSaves = countCalleeSaves(Variables, CalleeSaves);
+  if (Success && NumCalleeSaves && !getTarget()->hasCalls()) {
+    std::vector<int> Saved(Variables.size(), -1);
+    for (unsigned i = 0; i < Variables.size(); ++i) {
+      if (Variables[i])
+        Saved[i] = Variables[i]->getRegNumTmp();
+    }
+    if (Str.isVerbose(IceV_LinearScan))
+      Str << "Retrying without callee-saved registers\n";
+    RegMask = getTarget()->getRegisterSet(
+        RegInclude, RegExclude | IceTargetLowering::RegMask_CalleeSave);
+    bool Keep = LinearScan.scan(RegMask) &&
+                countCalleeSaves(Variables, CalleeSaves) < NumCalleeSaves;
+    IceLiveRange LoopRange = getLoopRange(Loops);
+    for (unsigned i = 0; Keep && i < Variables.size(); ++i) {
+      IceVariable *Var = Variables[i];
+      if (Var == NULL || Var->getLiveRange().isEmpty() || Saved[i] < 0 ||
+          Var->getRegNumTmp() >= 0)
+        continue;
+      if (!Var->getIsArg() || Var->getLiveRange().overlaps(LoopRange))
+        Keep = false;
+    }
+    if (!Keep) {
+      if (Str.isVerbose(IceV_LinearScan))
+        Str << "Keeping the first assignment\n";
+      for (unsigned i = 0; i < Variables.size(); ++i) {
+        if (Variables[i])
+          Variables[i]->setRegNumTmp(Saved[i]);
+      }
+    }
+  }
+
+  LinearScan.assign();
+  if (!Success)
+    setError("Unable to find a physical register for an "
+             "infinite-weight live range");
 }
 
 // Compute the stack frame layout.
@@ -418,6 +960,50 @@ void IceCfg::genFrame(void) {
   }
 }
 
+// Now that the layout is final, simplify each node's terminating
+// branch given the node that follows it.
+void IceCfg::doBranchOpt(void) {
+  for (IceNodeList::iterator I = LNodes.begin(), E = LNodes.end(); I != E;
+       ++I) {
+    IceNodeList::iterator Next = I + 1;
+    (*I)->doBranchOpt(Next == E ? NULL : *Next);
+  }
+}
+
+// Aligns the first node of each loop in the layout, which after loop
+// rotation is not necessarily the header, so that the loop starts on
+// a fresh fetch block.  Loops that are rarely entered, or that have
+// too few instructions for the padding to pay off, are skipped, as is
+// everything when optimizing for size.
+void IceCfg::alignLoops(void) {
+  if (LoopAlign == 0 || OptSize)
+    return;
+  // A loop is cold if it is entered less than once every eight calls,
+  // i.e. its header runs less often than the function's entry.
+  const double MinHeaderFrequency = 1;
+  // A loop of fewer instructions fits in about one 16-byte fetch block
+  // wherever it starts.
+  const uint32_t MinLoopInsts = 6;
+  std::vector<uint32_t> Position(Nodes.size());
+  for (uint32_t i = 0; i < LNodes.size(); ++i)
+    Position[LNodes[i]->getIndex()] = i;
+  for (uint32_t i = 0; i < Loops.size(); ++i) {
+    const IceNodeList &Body = Loops[i];
+    if (Body.front()->getFrequency() < MinHeaderFrequency)
+      continue;
+    IceCfgNode *Top = Body.front();
+    uint32_t NumInsts = 0;
+    for (IceNodeList::const_iterator I = Body.begin(), E = Body.end(); I != E;
+         ++I) {
+      NumInsts += (*I)->getNumEmittedInsts();
+      if (Position[(*I)->getIndex()] < Position[Top->getIndex()])
+        Top = *I;
+    }
+    if (NumInsts >= MinLoopInsts)
+      Top->setAlignment(LoopAlign);
+  }
+}
+
 void IceCfg::translate(IceTargetArch TargetArch) {
   makeTarget(TargetArch);
   if (hasError())
@@ -438,8 +1024,9 @@ void IceCfg::translate(IceTargetArch TargetArch) {
 
 // ======================== Dump routines ======================== //
 
-void IceCfg::emit(uint32_t Option) const {
-  IceTimer T_emit;
+// Prints the start of the function's assembly, and the declarations
+// of the symbols that it references.
+void IceCfg::emitPreamble(void) const {
   if (!HasEmittedFirstMethod) {
     HasEmittedFirstMethod = true;
     // Print a helpful command for assembling the output.
@@ -459,7 +1046,8 @@ void IceCfg::emit(uint32_t Option) const {
   uint32_t NumConsts = ConstantPool->getSize();
   for (uint32_t i = 0; i < NumConsts; ++i) {
     IceConstantRelocatable *Const = ConstantPool->getEntry(i);
-    if (Const == NULL)
+    // Declare each symbol once, via its entry without an offset.
+    if (Const == NULL || Const->getOffset() != 0)
       continue;
     Str << "\t.type\t" << Const->getName() << ",@object\n";
     // TODO: .comm is necessary only when defining vs. declaring?
@@ -467,6 +1055,11 @@ void IceCfg::emit(uint32_t Option) const {
     Str << "\t.comm\t" << Const->getName() << "," << Width << "," << Width
         << "\n";
   }
+}
+
+void IceCfg::emit(uint32_t Option) const {
+  IceTimer T_emit;
+  emitPreamble();
   for (IceNodeList::const_iterator I = LNodes.begin(), E = LNodes.end(); I != E;
        ++I) {
     (*I)->emit(Str, Option);
@@ -476,6 +1069,71 @@ void IceCfg::emit(uint32_t Option) const {
   T_emit.printElapsedUs(Str, "emit()");
 }
 
+IceAssembler *IceCfg::assemble(void) {
+  IceAssembler *Asm = getTarget()->createAssembler();
+  if (Asm == NULL) {
+    setError("Target has no integrated assembler");
+    return NULL;
+  }
+  for (IceNodeList::const_iterator I = LNodes.begin(), E = LNodes.end(); I != E;
+       ++I) {
+    (*I)->emitIAS(Asm);
+    if (hasError())
+      break;
+  }
+  if (!hasError())
+    Asm->finalize();
+  return Asm;
+}
+
+// Like emit(), but the instructions are encoded by the integrated
+// assembler and printed as data.
+void IceCfg::emitIAS(void) {
+  IceTimer T_emit;
+  IceAssembler *Asm = assemble();
+  if (Asm && !hasError()) {
+    emitPreamble();
+    Asm->emit(Str);
+    Str << "\n";
+  }
+  delete Asm;
+  T_emit.printElapsedUs(Str, "emitIAS()");
+}
+
+template <typename T> void IceCfg::declareSymbols(T *Consumer) const {
+  // Declare the symbols with the sizes of the .comm directives of
+  // emitPreamble().
+  uint32_t NumConsts = ConstantPool->getSize();
+  for (uint32_t i = 0; i < NumConsts; ++i) {
+    IceConstantRelocatable *Const = ConstantPool->getEntry(i);
+    if (Const == NULL || Const->getOffset() != 0)
+      continue;
+    Consumer->declareSymbol(Const->getName(), iceTypeWidth(Const->getType()));
+  }
+}
+
+void IceCfg::emitELF(IceELFObjectWriter *Writer) {
+  IceTimer T_emit;
+  IceAssembler *Asm = assemble();
+  if (Asm && !hasError()) {
+    Writer->writeFunction(Name, Asm);
+    declareSymbols(Writer);
+  }
+  delete Asm;
+  T_emit.printElapsedUs(Str, "emitELF()");
+}
+
+void IceCfg::emitJIT(IceJIT *JIT) {
+  IceTimer T_emit;
+  IceAssembler *Asm = assemble();
+  if (Asm && !hasError()) {
+    JIT->addFunction(Name, Asm);
+    declareSymbols(JIT);
+  }
+  delete Asm;
+  T_emit.printElapsedUs(Str, "emitJIT()");
+}
+
 void IceCfg::dump(void) const {
   Str.setCurrentNode(getEntryNode());
   // Print function name+args
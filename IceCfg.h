@@ -23,6 +23,15 @@ public:
   void setName(const IceString &FunctionName) { Name = FunctionName; }
   IceString getName(void) const { return Name; }
   void setReturnType(IceType ReturnType) { Type = ReturnType; }
+  IceType getReturnType(void) const { return Type; }
+  // When OptSize is set, lowering prefers smaller code, e.g. helper
+  // calls over long inline sequences.
+  void setOptSize(bool NewOptSize) { OptSize = NewOptSize; }
+  bool getOptSize(void) const { return OptSize; }
+  // LoopAlign is the log2 of the alignment requested for the start of
+  // each loop, or 0 for none.
+  void setLoopAlign(uint32_t NewLoopAlign) { LoopAlign = NewLoopAlign; }
+  uint32_t getLoopAlign(void) const { return LoopAlign; }
   IceTargetLowering *getTarget(void) const { return Target; }
   void addArg(IceVariable *Arg);
   void setEntryNode(IceCfgNode *EntryNode);
@@ -53,19 +62,32 @@ public:
   IceLiveness *getLiveness(void) const { return Liveness; }
   int newInstNumber(void);
 
-  IceString physicalRegName(int Reg) const;
+  const IceString &physicalRegName(int Reg) const;
   void translate(IceTargetArch TargetArch);
   void renumberInstructions(void);
   void placePhiLoads(void);
   void placePhiStores(void);
   void deletePhis(void);
+  void reorderNodes(void);
   void doAddressOpt(void);
+  void doLoadFolding(void);
+  void coalesceCopies(void);
   void genCode(void);
   void genFrame(void);
+  void doBranchOpt(void);
+  void alignLoops(void);
   void liveness(IceLivenessMode Mode);
   bool validateLiveness(void) const;
   void regAlloc(void);
   void emit(uint32_t Option) const;
+  // Encodes the function with the target's integrated assembler,
+  // returning NULL if there is none.  The caller owns the result.
+  IceAssembler *assemble(void);
+  void emitIAS(void);
+  // Assembles the function and adds it to an ELF object file.
+  void emitELF(IceELFObjectWriter *Writer);
+  // Assembles the function and adds it to a JIT.
+  void emitJIT(IceJIT *JIT);
   void dump(void) const;
 
   // Allocate an instruction of type T using the per-Cfg instruction allocator.
@@ -90,6 +112,8 @@ private:
   IceString ErrorMessage;
   IceString Name; // function name
   IceType Type;   // return type
+  bool OptSize;
+  uint32_t LoopAlign;
   IceTargetLowering *Target;
   IceCfgNode *Entry; // entry basic block
   // Difference between Nodes and LNodes.  Nodes is the master list;
@@ -100,6 +124,9 @@ private:
   // ideally a list container.
   IceNodeList Nodes;  // node list
   IceNodeList LNodes; // linearized node list; Entry should be first
+  // The loops found by reorderNodes(), each one the list of nodes in
+  // the loop body with the header first.
+  std::vector<IceNodeList> Loops;
   IceVarList Variables;
   IceVarList Args; // densely packed vector, subset of Variables
   class IceConstantPool *ConstantPool;
@@ -107,6 +134,10 @@ private:
 
   int NextInstNumber;
   void makeTarget(IceTargetArch Arch);
+  void emitPreamble(void) const;
+  // Declares the symbols that the function references, with their
+  // sizes, to an object writer or JIT.
+  template <typename T> void declareSymbols(T *Consumer) const;
 
   // TODO: This is a hack, and should be moved into a global context
   // guarded with a mutex.
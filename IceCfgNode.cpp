@@ -3,6 +3,9 @@
  * be found in the LICENSE file.
  */
 
+#include <algorithm> // std::find
+
+#include "IceAssembler.h"
 #include "IceCfg.h"
 #include "IceCfgNode.h"
 #include "IceInst.h"
@@ -13,7 +16,8 @@
 
 IceCfgNode::IceCfgNode(IceCfg *Cfg, uint32_t LabelNumber, IceString Name)
     : Cfg(Cfg), Number(LabelNumber), Name(Name), ArePhiLoadsPlaced(false),
-      ArePhiStoresPlaced(false), HasReturn(false) {}
+      ArePhiStoresPlaced(false), HasReturn(false), LoopDepth(0),
+      Frequency(0), Alignment(0) {}
 
 void IceCfgNode::appendInst(IceInst *Inst) {
   if (IceInstPhi *Phi = llvm::dyn_cast<IceInstPhi>(Inst)) {
@@ -95,23 +99,6 @@ void IceCfgNode::registerEdges(void) {
   }
 }
 
-// TODO: Make IceInstList into its own class that wraps the
-// std::list<IceInst*> and provides its own STL iterators.  Provide
-// normal iterators, plus an iterator that automatically skips deleted
-// instructions.  This way, target lowering can get full lookahead
-// instead of just one instruction lookahead.
-// IceTargetLowering::lower() would take Cur and End iterators instead
-// of Inst and Next IceInsts, for the purpose of pre-lowering peephole
-// optimizations such as compare/branch fusing or load/binop fusing.
-static IceInst *getNextInst(IceInstList::iterator I,
-                            const IceInstList::iterator &E) {
-  while (I != E && (*I)->isDeleted())
-    ++I;
-  if (I == E)
-    return NULL;
-  return *I;
-}
-
 void IceCfgNode::placePhiLoads(void) {
   if (ArePhiLoadsPlaced) {
     Cfg->setError("placePhiLoads() called more than once");
@@ -187,6 +174,28 @@ void IceCfgNode::placePhiStores(void) {
     }
   }
   insertInsts(InsertionPoint, NewPhiStores);
+  // If the phi stores were placed above a compare, have the compare
+  // read the phi temporaries instead of the phi sources.  This ends
+  // the sources' live ranges at the phi stores, so that copy
+  // coalescing can merge e.g. a loop induction variable's increment
+  // with its phi temporary.
+  if (InsertionPoint == Insts.end() || llvm::isa<IceInstBr>(*InsertionPoint))
+    return;
+  IceInst *Compare = *InsertionPoint;
+  bool Changed = false;
+  for (unsigned i = 0; i < Compare->getSrcSize(); ++i) {
+    for (IceInstList::iterator I = NewPhiStores.begin(),
+                               E = NewPhiStores.end();
+         I != E; ++I) {
+      if ((*I)->getSrc(0) == Compare->getSrc(i)) {
+        Compare->replaceSource(i, (*I)->getDest());
+        Changed = true;
+        break;
+      }
+    }
+  }
+  if (Changed)
+    Compare->updateVars(this);
 }
 
 void IceCfgNode::deletePhis(void) {
@@ -211,6 +220,112 @@ void IceCfgNode::doAddressOpt(void) {
   }
 }
 
+// Returns true if Inst uses or redefines any variable in Vars.
+static bool referencesVars(const IceInst *Inst, const IceVarList &Vars) {
+  if (std::find(Vars.begin(), Vars.end(), Inst->getDest()) != Vars.end())
+    return true;
+  for (unsigned I = 0; I < Inst->getSrcSize(); ++I) {
+    IceOperand *Src = Inst->getSrc(I);
+    for (unsigned J = 0; J < Src->getNumVars(); ++J) {
+      if (std::find(Vars.begin(), Vars.end(), Src->getVar(J)) != Vars.end())
+        return true;
+    }
+  }
+  return false;
+}
+
+// Finds the instruction that a Load's Dest can be folded into: the
+// Dest's only remaining use, later in the same block, with nothing in
+// between that might write memory or touch the Load's variables.
+// Returns NULL if there is no such instruction.
+static IceInst *findLoadUser(const IceInstLoad *Load,
+                             IceInstList::iterator I,
+                             const IceInstList::iterator &E) {
+  IceVariable *Dest = Load->getDest();
+  IceVarList Vars;
+  Vars.push_back(Dest);
+  IceOperand *Addr = Load->getSrc(0);
+  for (unsigned J = 0; J < Addr->getNumVars(); ++J)
+    Vars.push_back(Addr->getVar(J));
+  for (; I != E; ++I) {
+    IceInst *Inst = *I;
+    if (Inst->isDeleted())
+      continue;
+    if (!referencesVars(Inst, Vars)) {
+      // Another Load can be skipped over, but a Store might alias,
+      // and anything else with side effects might write memory.
+      if (llvm::isa<IceInstStore>(Inst) || Inst->hasSideEffects())
+        return NULL;
+      continue;
+    }
+    if (Inst->getDest() == Dest || !Inst->isLastUse(Dest))
+      return NULL;
+    unsigned NumUses = 0;
+    for (unsigned J = 0; J < Inst->getSrcSize(); ++J) {
+      if (Inst->getSrc(J) == Dest)
+        ++NumUses;
+    }
+    return NumUses == 1 ? Inst : NULL;
+  }
+  return NULL;
+}
+
+// Folds each single-use Load into the memory operand of its user,
+// where the target allows it.  This must run after liveness analysis,
+// since the Load's Dest must not be live after its user.
+void IceCfgNode::doLoadFolding(void) {
+  IceTargetLowering *Target = Cfg->getTarget();
+  Target->setCurrentNode(this);
+  IceInstList::iterator I = Insts.begin(), E = Insts.end();
+  while (I != E) {
+    IceInstLoad *Load = llvm::dyn_cast<IceInstLoad>(*I++);
+    if (Load == NULL || Load->isDeleted() || Load->hasSideEffects())
+      continue;
+    IceInst *User = findLoadUser(Load, I, E);
+    if (User && Target->foldLoad(Load, User))
+      Load->setDeleted();
+  }
+}
+
+void IceCfgNode::replaceVars(const IceVarList &Replacements) {
+  for (IceInstList::iterator I = Insts.begin(), E = Insts.end(); I != E; ++I) {
+    IceInst *Inst = *I;
+    if (Inst->isDeleted())
+      continue;
+    bool Changed = false;
+    if (IceVariable *Dest = Inst->getDest()) {
+      IceVariable *Replacement = Replacements[Dest->getIndex()];
+      if (Replacement) {
+        Inst->replaceDest(Replacement);
+        Changed = true;
+      }
+    }
+    for (unsigned i = 0; i < Inst->getSrcSize(); ++i) {
+      IceOperand *Src = Inst->getSrc(i);
+      IceOperand *Replacement = Src->replaceVars(Cfg, Replacements);
+      if (Replacement != Src) {
+        Inst->replaceSource(i, Replacement);
+        Changed = true;
+      }
+    }
+    if (Changed)
+      Inst->updateVars(this);
+  }
+}
+
+// Lets the target optimize the last instruction, typically a branch,
+// now that NextNode is known to follow this node in the layout.
+void IceCfgNode::doBranchOpt(const IceCfgNode *NextNode) {
+  IceTargetLowering *Target = Cfg->getTarget();
+  for (IceInstList::reverse_iterator I = Insts.rbegin(), E = Insts.rend();
+       I != E; ++I) {
+    if (!(*I)->isDeleted()) {
+      Target->doBranchOpt(*I, NextNode);
+      return;
+    }
+  }
+}
+
 void IceCfgNode::genCode(void) {
   IceTargetLowering *Target = Cfg->getTarget();
   Target->setCurrentNode(this);
@@ -218,17 +333,17 @@ void IceCfgNode::genCode(void) {
   IceInstList::iterator I = Insts.begin(), E = Insts.end();
   while (I != E) {
     IceInst *Inst = *I++;
-    IceInst *Next = getNextInst(I, E);
     if (Inst->isDeleted())
       continue;
     if (llvm::isa<IceInstRet>(Inst))
       setHasReturn();
-    bool DeleteNextInst = false;
-    IceInstList NewInsts = Target->lower(Inst, Next, DeleteNextInst);
+    // The cursor gives lowering full lookahead over the instructions
+    // after Inst.  Any that it consumes are marked deleted and are
+    // skipped by this loop.
+    IceLoweringCursor Cursor(I, E);
+    IceInstList NewInsts = Target->lower(Inst, Cursor);
     insertInsts(I, NewInsts);
     Inst->setDeleted();
-    if (DeleteNextInst)
-      Next->setDeleted();
   }
 }
 
@@ -416,11 +531,27 @@ void IceCfgNode::livenessPostprocess(IceLivenessMode Mode,
 
 // ======================== Dump routines ======================== //
 
+// Counts the target instructions that emit() will print.
+uint32_t IceCfgNode::getNumEmittedInsts(void) const {
+  uint32_t NumInsts = 0;
+  for (IceInstList::const_iterator I = Insts.begin(), E = Insts.end(); I != E;
+       ++I) {
+    IceInst *Inst = *I;
+    if (Inst->isDeleted() || Inst->isRedundantAssign())
+      continue;
+    if (Inst->getKind() >= IceInst::Target)
+      ++NumInsts;
+  }
+  return NumInsts;
+}
+
 void IceCfgNode::emit(IceOstream &Str, uint32_t Option) const {
   Str.setCurrentNode(this);
   if (Cfg->getEntryNode() == this) {
     Str << Cfg->getName() << ":\n";
   }
+  if (Alignment)
+    Str << "\t.p2align\t" << Alignment << "\n";
   Str << getAsmName() << ":\n";
   // TODO: emit() should blow up in some way if any live phi
   // instructions remain.
@@ -442,6 +573,22 @@ void IceCfgNode::emit(IceOstream &Str, uint32_t Option) const {
   }
 }
 
+// Encodes the node's instructions, skipping the same ones as emit().
+void IceCfgNode::emitIAS(IceAssembler *Asm) const {
+  Asm->bindNode(this);
+  for (IceInstList::const_iterator I = Insts.begin(), E = Insts.end(); I != E;
+       ++I) {
+    IceInst *Inst = *I;
+    if (Inst->isDeleted())
+      continue;
+    if (Inst->isRedundantAssign())
+      continue;
+    Inst->emitIAS(Asm);
+    if (Cfg->hasError())
+      return;
+  }
+}
+
 void IceCfgNode::dump(IceOstream &Str) const {
   Str.setCurrentNode(this);
   IceLiveness *Liveness = Str.Cfg->getLiveness();
@@ -25,6 +25,17 @@ public:
   // instruction and therefore needs an epilog.
   void setHasReturn(void) { HasReturn = true; }
   bool hasReturn(void) const { return HasReturn; }
+  // The loop nesting depth, computed by IceCfg::reorderNodes().
+  void setLoopDepth(uint32_t Depth) { LoopDepth = Depth; }
+  uint32_t getLoopDepth(void) const { return LoopDepth; }
+  // The estimated number of executions per call of the function, also
+  // computed by IceCfg::reorderNodes().
+  void setFrequency(double NewFrequency) { Frequency = NewFrequency; }
+  double getFrequency(void) const { return Frequency; }
+  // The log2 of the alignment to emit before the node's label, or 0.
+  void setAlignment(uint32_t Log2) { Alignment = Log2; }
+  uint32_t getAlignment(void) const { return Alignment; }
+  uint32_t getNumEmittedInsts(void) const;
   const IceNodeList &getInEdges(void) const { return InEdges; }
   const IceNodeList &getOutEdges(void) const { return OutEdges; }
   void renumberInstructions(void);
@@ -34,10 +45,14 @@ public:
   void placePhiStores(void);
   void deletePhis(void);
   void doAddressOpt(void);
+  void doLoadFolding(void);
+  void replaceVars(const IceVarList &Replacements);
   void genCode(void);
+  void doBranchOpt(const IceCfgNode *NextNode);
   bool liveness(IceLivenessMode Mode, IceLiveness *Liveness);
   void livenessPostprocess(IceLivenessMode Mode, IceLiveness *Liveness);
   void emit(IceOstream &Str, uint32_t Option) const;
+  void emitIAS(IceAssembler *Asm) const;
   void dump(IceOstream &Str) const;
 
 private:
@@ -52,6 +67,9 @@ private:
   bool ArePhiLoadsPlaced;
   bool ArePhiStoresPlaced;
   bool HasReturn;
+  uint32_t LoopDepth;
+  double Frequency;
+  uint32_t Alignment;
 };
 
 #endif // _IceCfgNode_h
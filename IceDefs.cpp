@@ -0,0 +1,98 @@
+/* Copyright 2014 The Native Client Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can
+ * be found in the LICENSE file.
+ */
+
+#include <errno.h>
+#include <limits.h> // IOV_MAX
+#include <sys/uio.h>
+
+#include <algorithm> // std::min
+
+#include "IceDefs.h"
+
+void IceOutputBuffer::appendSlow(const char *Data, size_t Size) {
+  while (Size) {
+    if (Cur == End) {
+      Chunks.push_back(new char[ChunkSize]);
+      Cur = Chunks.back();
+      End = Cur + ChunkSize;
+    }
+    size_t Part = std::min(Size, static_cast<size_t>(End - Cur));
+    memcpy(Cur, Data, Part);
+    Cur += Part;
+    Data += Part;
+    Size -= Part;
+  }
+}
+
+void IceOutputBuffer::appendUnsigned(uint64_t Value) {
+  char Buf[20];
+  char *Start = Buf + sizeof(Buf);
+  do {
+    *--Start = '0' + Value % 10;
+    Value /= 10;
+  } while (Value);
+  append(Start, Buf + sizeof(Buf) - Start);
+}
+
+void IceOutputBuffer::appendSigned(int64_t Value) {
+  if (Value >= 0) {
+    appendUnsigned(Value);
+    return;
+  }
+  append("-", 1);
+  // Negate as unsigned so that INT64_MIN does not overflow.
+  appendUnsigned(-static_cast<uint64_t>(Value));
+}
+
+void IceOutputBuffer::appendDouble(double Value) {
+  // "%g" matches what std::ostream prints by default.
+  char Buf[32];
+  int Size = snprintf(Buf, sizeof(Buf), "%g", Value);
+  append(Buf, Size);
+}
+
+bool IceOutputBuffer::flush(int FD) {
+  std::vector<struct iovec> Iov(Chunks.size());
+  for (size_t i = 0; i < Chunks.size(); ++i) {
+    Iov[i].iov_base = Chunks[i];
+    Iov[i].iov_len = i + 1 < Chunks.size() ? ChunkSize : Cur - Chunks[i];
+  }
+  bool Success = true;
+  size_t First = 0;
+  while (First < Iov.size()) {
+    if (Iov[First].iov_len == 0) {
+      ++First;
+      continue;
+    }
+    int Count = std::min(Iov.size() - First, static_cast<size_t>(IOV_MAX));
+    ssize_t Written = writev(FD, &Iov[First], Count);
+    if (Written < 0) {
+      if (errno == EINTR)
+        continue;
+      Success = false;
+      break;
+    }
+    // Skip past what was written, in case the write came up short.
+    for (size_t Left = Written; Left;) {
+      size_t Part = std::min(Left, Iov[First].iov_len);
+      Iov[First].iov_base = static_cast<char *>(Iov[First].iov_base) + Part;
+      Iov[First].iov_len -= Part;
+      Left -= Part;
+      if (Iov[First].iov_len == 0)
+        ++First;
+    }
+  }
+  clear();
+  return Success;
+}
+
+void IceOutputBuffer::clear(void) {
+  for (std::vector<char *>::iterator I = Chunks.begin(), E = Chunks.end();
+       I != E; ++I) {
+    delete[] *I;
+  }
+  Chunks.clear();
+  Cur = End = NULL;
+}
@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h> // sprintf
+#include <string.h> // memcpy, strlen
 
 #include <list>
 #include <map>
@@ -24,11 +25,14 @@
 #include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/SmallBitVector.h"
 
+class IceAssembler;
 class IceCfg;
 class IceCfgNode;
+class IceELFObjectWriter;
 class IceInst;
 class IceInstPhi;
 class IceInstTarget;
+class IceJIT;
 class IceLiveness;
 class IceLiveRange;
 class IceOperand;
@@ -47,9 +51,9 @@ typedef std::vector<IceOperand *> IceOpList;
 typedef std::vector<IceVariable *> IceVarList;
 typedef std::vector<IceCfgNode *> IceNodeList;
 
-// The IceOstream class wraps a std::ostream and an IceCfg pointer, so
-// that dump routines have access to the IceCfg object and can print
-// labels and variable names.
+// The IceOstream class wraps an IceOutputBuffer and an IceCfg
+// pointer, so that dump routines have access to the IceCfg object and
+// can print labels and variable names.
 
 enum IceVerbose {
   IceV_None = 0,
@@ -111,11 +115,56 @@ private:
   ContainerType Entries;
 };
 
+// IceOutputBuffer is an append-only text buffer made of fixed-size
+// chunks, so appending never moves what was already written.  Each
+// IceCfg has its own, which collects everything printed for the
+// function until the driver flushes it.  Integers are formatted
+// directly rather than through a locale.  Because the buffers are
+// independent, functions translated concurrently can still be
+// written out in module order by flushing their buffers in that
+// order.
+class IceOutputBuffer {
+public:
+  IceOutputBuffer(void) : Cur(NULL), End(NULL) {}
+  ~IceOutputBuffer(void) { clear(); }
+  void append(const char *Data, size_t Size) {
+    if (Size <= static_cast<size_t>(End - Cur)) {
+      memcpy(Cur, Data, Size);
+      Cur += Size;
+      return;
+    }
+    appendSlow(Data, Size);
+  }
+  void append(const char *S) { append(S, strlen(S)); }
+  void append(const IceString &S) { append(S.data(), S.size()); }
+  void appendUnsigned(uint64_t Value);
+  void appendSigned(int64_t Value);
+  void appendDouble(double Value);
+  // Writes the contents to the file descriptor FD, with a single
+  // writev() unless it comes up short, and empties the buffer.
+  // Returns false if the write failed.
+  bool flush(int FD);
+  // Empties the buffer and releases its chunks.
+  void clear(void);
+
+private:
+  // Not copyable.
+  IceOutputBuffer(const IceOutputBuffer &);
+  IceOutputBuffer &operator=(const IceOutputBuffer &);
+  enum { ChunkSize = 16 * 1024 };
+  void appendSlow(const char *Data, size_t Size);
+  // All chunks but the last are full.  Cur and End delimit the unused
+  // part of the last one.
+  std::vector<char *> Chunks;
+  char *Cur;
+  char *End;
+};
+
 class IceOstream {
 public:
-  IceOstream(std::ostream &Stream, IceCfg *Cfg)
-      : Stream(&Stream), Cfg(Cfg), Verbose(IceV_Instructions | IceV_Preds),
-        CurrentNode(NULL) {}
+  IceOstream(IceCfg *Cfg)
+      : Cfg(Cfg), Verbose(IceV_Instructions | IceV_Preds), CurrentNode(NULL) {
+  }
   bool isVerbose(IceVerboseMask Mask = (IceV_All & ~IceV_Timing)) {
     return Verbose & Mask;
   }
@@ -124,9 +173,9 @@ public:
   void subVerbose(IceVerboseMask Mask) { Verbose &= ~Mask; }
   void setCurrentNode(const IceCfgNode *Node) { CurrentNode = Node; }
   const IceCfgNode *getCurrentNode(void) const { return CurrentNode; }
-  // TODO: Use LLVM's raw_ostream instead.
-  // http://llvm.org/docs/CodingStandards.html#use-raw-ostream
-  std::ostream *Stream;
+  // Writes out everything printed so far; see IceOutputBuffer::flush().
+  bool flush(int FD) { return Buffer.flush(FD); }
+  IceOutputBuffer Buffer;
   IceCfg *const Cfg;
 
 private:
@@ -137,37 +186,37 @@ private:
 };
 
 inline IceOstream &operator<<(IceOstream &Str, const char *S) {
-  *(Str.Stream) << S;
+  Str.Buffer.append(S);
   return Str;
 }
 
 inline IceOstream &operator<<(IceOstream &Str, const IceString &S) {
-  *(Str.Stream) << S;
+  Str.Buffer.append(S);
   return Str;
 }
 
 inline IceOstream &operator<<(IceOstream &Str, uint32_t U) {
-  *(Str.Stream) << U;
+  Str.Buffer.appendUnsigned(U);
   return Str;
 }
 
 inline IceOstream &operator<<(IceOstream &Str, int32_t I) {
-  *(Str.Stream) << I;
+  Str.Buffer.appendSigned(I);
   return Str;
 }
 
 inline IceOstream &operator<<(IceOstream &Str, uint64_t U) {
-  *(Str.Stream) << U;
+  Str.Buffer.appendUnsigned(U);
   return Str;
 }
 
 inline IceOstream &operator<<(IceOstream &Str, int64_t I) {
-  *(Str.Stream) << I;
+  Str.Buffer.appendSigned(I);
   return Str;
 }
 
 inline IceOstream &operator<<(IceOstream &Str, double D) {
-  *(Str.Stream) << D;
+  Str.Buffer.appendDouble(D);
   return Str;
 }
 
@@ -0,0 +1,351 @@
+/* Copyright 2014 The Native Client Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can
+ * be found in the LICENSE file.
+ */
+
+#include <elf.h>
+
+#include "IceELFObjectWriter.h"
+
+// The sections of the object file, in order.
+enum {
+  Sec_Null,
+  Sec_Text,
+  Sec_RelText,
+  Sec_RoData,
+  Sec_RelRoData,
+  Sec_NoteGnuStack,
+  Sec_SymTab,
+  Sec_StrTab,
+  Sec_ShStrTab,
+  Sec_Num
+};
+
+// The local symbols, which come first in the symbol table.
+enum {
+  Sym_Null,
+  Sym_Text,
+  Sym_RoData,
+  Sym_FirstGlobal
+};
+
+// The ELF header is padded to HeaderSize, where .text starts.
+static const uint32_t HeaderSize = 64;
+
+static void appendInt(IceByteList &Bytes, uint32_t Value, uint32_t Size) {
+  for (uint32_t i = 0; i < Size; ++i)
+    Bytes.push_back((Value >> (8 * i)) & 0xff);
+}
+
+static void appendBytes(IceByteList &Bytes, const IceByteList &Other) {
+  Bytes.insert(Bytes.end(), Other.begin(), Other.end());
+}
+
+static void padBytes(IceByteList &Bytes, uint32_t Base, uint32_t Align) {
+  while ((Base + Bytes.size()) % Align)
+    Bytes.push_back(0);
+}
+
+static uint32_t readInt32(const IceByteList &Bytes, uint32_t Offset) {
+  uint32_t Value = 0;
+  for (uint32_t i = 0; i < 4; ++i)
+    Value |= Bytes[Offset + i] << (8 * i);
+  return Value;
+}
+
+static void writeInt32(IceByteList &Bytes, uint32_t Offset, uint32_t Value) {
+  for (uint32_t i = 0; i < 4; ++i)
+    Bytes[Offset + i] = (Value >> (8 * i)) & 0xff;
+}
+
+static uint32_t addString(IceString &Table, const IceString &Name) {
+  uint32_t Offset = Table.size();
+  Table += Name;
+  Table += '\0';
+  return Offset;
+}
+
+static void appendSymbol(IceByteList &Bytes, uint32_t Name, uint32_t Value,
+                         uint32_t Size, uint32_t Info, uint32_t Section) {
+  appendInt(Bytes, Name, 4);
+  appendInt(Bytes, Value, 4);
+  appendInt(Bytes, Size, 4);
+  appendInt(Bytes, Info, 1);
+  appendInt(Bytes, STV_DEFAULT, 1);
+  appendInt(Bytes, Section, 2);
+}
+
+static void appendSectionHeader(IceByteList &Bytes, uint32_t Name,
+                                uint32_t Type, uint32_t Flags,
+                                uint32_t Offset, uint32_t Size, uint32_t Link,
+                                uint32_t Info, uint32_t Log2Align,
+                                uint32_t EntrySize) {
+  appendInt(Bytes, Name, 4);
+  appendInt(Bytes, Type, 4);
+  appendInt(Bytes, Flags, 4);
+  appendInt(Bytes, 0, 4); // sh_addr
+  appendInt(Bytes, Offset, 4);
+  appendInt(Bytes, Size, 4);
+  appendInt(Bytes, Link, 4);
+  appendInt(Bytes, Info, 4);
+  appendInt(Bytes, 1u << Log2Align, 4);
+  appendInt(Bytes, EntrySize, 4);
+}
+
+IceELFObjectWriter::IceELFObjectWriter(std::ostream &Out)
+    : Out(Out), TextSize(0), TextAlignment(0), RoDataAlignment(0) {
+  // Reserve room for the ELF header, which finish() fills in.
+  IceByteList Header(HeaderSize, 0);
+  writeBytes(Header);
+}
+
+void IceELFObjectWriter::writeBytes(const IceByteList &Bytes) {
+  if (!Bytes.empty())
+    Out.write(reinterpret_cast<const char *>(&Bytes[0]), Bytes.size());
+}
+
+// Pads .text with nops, since the padding is never executed.
+void IceELFObjectWriter::padText(uint32_t Log2Align) {
+  if (Log2Align > TextAlignment)
+    TextAlignment = Log2Align;
+  IceByteList Padding;
+  while ((TextSize + Padding.size()) & ((1u << Log2Align) - 1))
+    Padding.push_back(0x90);
+  writeBytes(Padding);
+  TextSize += Padding.size();
+}
+
+IceELFObjectWriter::Relocation IceELFObjectWriter::makeRelocation(
+    const IceFixup &Fixup, uint32_t Base, IceByteList &Bytes,
+    const std::map<IceString, uint32_t> &RoDataLabels) {
+  Relocation Reloc;
+  Reloc.Offset = Base + Fixup.getOffset();
+  Reloc.Type =
+      Fixup.getKind() == IceFixup::Fixup_PCRel32 ? R_386_PC32 : R_386_32;
+  Reloc.Symbol = Fixup.getSymbol();
+  // A .rodata label becomes an offset from the .rodata section symbol,
+  // which is added to the addend in the field.
+  std::map<IceString, uint32_t>::const_iterator Label =
+      RoDataLabels.find(Fixup.getSymbol());
+  if (Label != RoDataLabels.end()) {
+    uint32_t Field = Fixup.getOffset();
+    writeInt32(Bytes, Field, readInt32(Bytes, Field) + Label->second);
+    Reloc.Symbol = "";
+  }
+  return Reloc;
+}
+
+void IceELFObjectWriter::addSymbolReference(const Relocation &Reloc) {
+  if (Reloc.Symbol.empty())
+    return;
+  if (IsAbsoluteReference.find(Reloc.Symbol) == IsAbsoluteReference.end()) {
+    References.push_back(Reloc.Symbol);
+    IsAbsoluteReference[Reloc.Symbol] = false;
+  }
+  if (Reloc.Type == R_386_32)
+    IsAbsoluteReference[Reloc.Symbol] = true;
+}
+
+void IceELFObjectWriter::writeFunction(const IceString &Name,
+                                       const IceAssembler *Asm) {
+  // Append .rodata first, so that the .text fixups can refer to its
+  // labels.
+  const IceAsmSection &FuncRoData = Asm->getRoData();
+  uint32_t RoDataAlign = FuncRoData.getAlignment();
+  if (RoDataAlign > RoDataAlignment)
+    RoDataAlignment = RoDataAlign;
+  padBytes(RoData, 0, 1u << RoDataAlign);
+  uint32_t RoDataBase = RoData.size();
+  std::map<IceString, uint32_t> RoDataLabels;
+  const IceAsmLabelList &Labels = FuncRoData.getLabels();
+  for (IceAsmLabelList::const_iterator I = Labels.begin(), E = Labels.end();
+       I != E; ++I) {
+    RoDataLabels[I->first] = RoDataBase + I->second;
+  }
+  IceByteList Bytes = FuncRoData.getBytes();
+  const IceFixupList &RoDataFixups = FuncRoData.getFixups();
+  for (IceFixupList::const_iterator I = RoDataFixups.begin(),
+                                    E = RoDataFixups.end();
+       I != E; ++I) {
+    RoDataRelocations.push_back(
+        makeRelocation(*I, RoDataBase, Bytes, RoDataLabels));
+    addSymbolReference(RoDataRelocations.back());
+  }
+  appendBytes(RoData, Bytes);
+
+  const IceAsmSection &Text = Asm->getText();
+  padText(Text.getAlignment());
+  uint32_t TextBase = TextSize;
+  Bytes = Text.getBytes();
+  const IceFixupList &TextFixups = Text.getFixups();
+  for (IceFixupList::const_iterator I = TextFixups.begin(),
+                                    E = TextFixups.end();
+       I != E; ++I) {
+    TextRelocations.push_back(
+        makeRelocation(*I, TextBase, Bytes, RoDataLabels));
+    addSymbolReference(TextRelocations.back());
+  }
+  writeBytes(Bytes);
+  TextSize += Bytes.size();
+
+  FunctionSymbol Symbol;
+  Symbol.Name = Name;
+  Symbol.Offset = TextBase;
+  Symbol.Size = Bytes.size();
+  Functions.push_back(Symbol);
+}
+
+void IceELFObjectWriter::declareSymbol(const IceString &Name, uint32_t Size) {
+  SymbolSizes[Name] = Size;
+}
+
+void IceELFObjectWriter::finish(void) {
+  // Everything after .text is built in Tail, whose file offset is
+  // TailBase.
+  const uint32_t TailBase = HeaderSize + TextSize;
+  IceByteList Tail;
+  uint32_t Offsets[Sec_Num] = { 0 };
+  uint32_t Sizes[Sec_Num] = { 0 };
+  Offsets[Sec_Text] = HeaderSize;
+  Sizes[Sec_Text] = TextSize;
+
+  padBytes(Tail, TailBase, 1u << RoDataAlignment);
+  Offsets[Sec_RoData] = TailBase + Tail.size();
+  Sizes[Sec_RoData] = RoData.size();
+  appendBytes(Tail, RoData);
+
+  // Build the symbol table: the section symbols, then the functions,
+  // then the symbols they reference.
+  IceString StrTab(1, '\0');
+  IceByteList SymTab;
+  appendSymbol(SymTab, 0, 0, 0, 0, SHN_UNDEF);
+  appendSymbol(SymTab, 0, 0, 0, ELF32_ST_INFO(STB_LOCAL, STT_SECTION),
+               Sec_Text);
+  appendSymbol(SymTab, 0, 0, 0, ELF32_ST_INFO(STB_LOCAL, STT_SECTION),
+               Sec_RoData);
+  std::map<IceString, uint32_t> SymbolIndex;
+  uint32_t NumSymbols = Sym_FirstGlobal;
+  for (std::vector<FunctionSymbol>::const_iterator I = Functions.begin(),
+                                                   E = Functions.end();
+       I != E; ++I) {
+    appendSymbol(SymTab, addString(StrTab, I->Name), I->Offset, I->Size,
+                 ELF32_ST_INFO(STB_GLOBAL, STT_FUNC), Sec_Text);
+    SymbolIndex[I->Name] = NumSymbols++;
+  }
+  for (std::vector<IceString>::const_iterator I = References.begin(),
+                                              E = References.end();
+       I != E; ++I) {
+    if (SymbolIndex.find(*I) != SymbolIndex.end())
+      continue;
+    uint32_t Name = addString(StrTab, *I);
+    if (IsAbsoluteReference[*I]) {
+      // For a common symbol, the value is the alignment.
+      uint32_t Size = 4;
+      if (SymbolSizes.find(*I) != SymbolSizes.end())
+        Size = SymbolSizes[*I];
+      appendSymbol(SymTab, Name, Size, Size,
+                   ELF32_ST_INFO(STB_GLOBAL, STT_OBJECT), SHN_COMMON);
+    } else {
+      appendSymbol(SymTab, Name, 0, 0, ELF32_ST_INFO(STB_GLOBAL, STT_NOTYPE),
+                   SHN_UNDEF);
+    }
+    SymbolIndex[*I] = NumSymbols++;
+  }
+
+  // Build the relocation sections.
+  const std::vector<Relocation> *Relocations[] = { &TextRelocations,
+                                                   &RoDataRelocations };
+  const uint32_t RelSections[] = { Sec_RelText, Sec_RelRoData };
+  for (uint32_t i = 0; i < 2; ++i) {
+    padBytes(Tail, TailBase, 4);
+    Offsets[RelSections[i]] = TailBase + Tail.size();
+    for (std::vector<Relocation>::const_iterator
+             I = Relocations[i]->begin(),
+             E = Relocations[i]->end();
+         I != E; ++I) {
+      uint32_t Symbol =
+          I->Symbol.empty() ? (uint32_t)Sym_RoData : SymbolIndex[I->Symbol];
+      appendInt(Tail, I->Offset, 4);
+      appendInt(Tail, ELF32_R_INFO(Symbol, I->Type), 4);
+    }
+    Sizes[RelSections[i]] =
+        TailBase + Tail.size() - Offsets[RelSections[i]];
+  }
+
+  // .note.GNU-stack is empty, and tells the linker that the code does
+  // not need an executable stack.
+  Offsets[Sec_NoteGnuStack] = TailBase + Tail.size();
+
+  padBytes(Tail, TailBase, 4);
+  Offsets[Sec_SymTab] = TailBase + Tail.size();
+  Sizes[Sec_SymTab] = SymTab.size();
+  appendBytes(Tail, SymTab);
+
+  Offsets[Sec_StrTab] = TailBase + Tail.size();
+  Sizes[Sec_StrTab] = StrTab.size();
+  Tail.insert(Tail.end(), StrTab.begin(), StrTab.end());
+
+  IceString ShStrTab(1, '\0');
+  uint32_t Names[Sec_Num] = { 0 };
+  Names[Sec_Text] = addString(ShStrTab, ".text");
+  Names[Sec_RelText] = addString(ShStrTab, ".rel.text");
+  Names[Sec_RoData] = addString(ShStrTab, ".rodata");
+  Names[Sec_RelRoData] = addString(ShStrTab, ".rel.rodata");
+  Names[Sec_NoteGnuStack] = addString(ShStrTab, ".note.GNU-stack");
+  Names[Sec_SymTab] = addString(ShStrTab, ".symtab");
+  Names[Sec_StrTab] = addString(ShStrTab, ".strtab");
+  Names[Sec_ShStrTab] = addString(ShStrTab, ".shstrtab");
+  Offsets[Sec_ShStrTab] = TailBase + Tail.size();
+  Sizes[Sec_ShStrTab] = ShStrTab.size();
+  Tail.insert(Tail.end(), ShStrTab.begin(), ShStrTab.end());
+
+  padBytes(Tail, TailBase, 4);
+  const uint32_t SectionHeaders = TailBase + Tail.size();
+  appendSectionHeader(Tail, 0, SHT_NULL, 0, 0, 0, 0, 0, 0, 0);
+  appendSectionHeader(Tail, Names[Sec_Text], SHT_PROGBITS,
+                      SHF_ALLOC | SHF_EXECINSTR, Offsets[Sec_Text],
+                      Sizes[Sec_Text], 0, 0, TextAlignment, 0);
+  appendSectionHeader(Tail, Names[Sec_RelText], SHT_REL, SHF_INFO_LINK,
+                      Offsets[Sec_RelText], Sizes[Sec_RelText], Sec_SymTab,
+                      Sec_Text, 2, sizeof(Elf32_Rel));
+  appendSectionHeader(Tail, Names[Sec_RoData], SHT_PROGBITS, SHF_ALLOC,
+                      Offsets[Sec_RoData], Sizes[Sec_RoData], 0, 0,
+                      RoDataAlignment, 0);
+  appendSectionHeader(Tail, Names[Sec_RelRoData], SHT_REL, SHF_INFO_LINK,
+                      Offsets[Sec_RelRoData], Sizes[Sec_RelRoData],
+                      Sec_SymTab, Sec_RoData, 2, sizeof(Elf32_Rel));
+  appendSectionHeader(Tail, Names[Sec_NoteGnuStack], SHT_PROGBITS, 0,
+                      Offsets[Sec_NoteGnuStack], 0, 0, 0, 0, 0);
+  appendSectionHeader(Tail, Names[Sec_SymTab], SHT_SYMTAB, 0,
+                      Offsets[Sec_SymTab], Sizes[Sec_SymTab], Sec_StrTab,
+                      Sym_FirstGlobal, 2, sizeof(Elf32_Sym));
+  appendSectionHeader(Tail, Names[Sec_StrTab], SHT_STRTAB, 0,
+                      Offsets[Sec_StrTab], Sizes[Sec_StrTab], 0, 0, 0, 0);
+  appendSectionHeader(Tail, Names[Sec_ShStrTab], SHT_STRTAB, 0,
+                      Offsets[Sec_ShStrTab], Sizes[Sec_ShStrTab], 0, 0, 0,
+                      0);
+  writeBytes(Tail);
+
+  // Fill in the ELF header.
+  IceByteList Header;
+  const uint8_t Ident[EI_NIDENT] = { ELFMAG0,       ELFMAG1,    ELFMAG2,
+                                     ELFMAG3,       ELFCLASS32, ELFDATA2LSB,
+                                     EV_CURRENT,    ELFOSABI_NONE };
+  Header.insert(Header.end(), Ident, Ident + EI_NIDENT);
+  appendInt(Header, ET_REL, 2);
+  appendInt(Header, EM_386, 2);
+  appendInt(Header, EV_CURRENT, 4);
+  appendInt(Header, 0, 4); // e_entry
+  appendInt(Header, 0, 4); // e_phoff
+  appendInt(Header, SectionHeaders, 4);
+  appendInt(Header, 0, 4); // e_flags
+  appendInt(Header, sizeof(Elf32_Ehdr), 2);
+  appendInt(Header, 0, 2); // e_phentsize
+  appendInt(Header, 0, 2); // e_phnum
+  appendInt(Header, sizeof(Elf32_Shdr), 2);
+  appendInt(Header, Sec_Num, 2);
+  appendInt(Header, Sec_ShStrTab, 2);
+  Out.seekp(0);
+  writeBytes(Header);
+  Out.flush();
+}
@@ -0,0 +1,72 @@
+// -*- Mode: c++ -*-
+/* Copyright 2014 The Native Client Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can
+ * be found in the LICENSE file.
+ */
+
+#ifndef _IceELFObjectWriter_h
+#define _IceELFObjectWriter_h
+
+#include "IceDefs.h"
+#include "IceAssembler.h"
+
+// IceELFObjectWriter writes a module's assembled functions as an ELF32
+// relocatable object for x86-32.  Each function's .text contents are
+// written to the output stream as soon as the function is added, so
+// only the much smaller .rodata contents, relocations and symbols are
+// kept until finish() writes the remaining sections and the section
+// headers.  The output stream must be seekable, since the ELF header
+// is patched last.
+//
+// Symbols are resolved as follows.  Functions added to the writer are
+// defined in .text.  Other symbols referenced by an absolute fixup are
+// global variables, which become common symbols, like the .comm
+// directives of the textual output.  The rest, e.g. helper functions,
+// are left undefined.
+class IceELFObjectWriter {
+public:
+  IceELFObjectWriter(std::ostream &Out);
+  // Appends a function's .text and .rodata contents.
+  void writeFunction(const IceString &Name, const IceAssembler *Asm);
+  // Records the size of a symbol referenced by a function, which is
+  // used if the symbol becomes a common symbol.
+  void declareSymbol(const IceString &Name, uint32_t Size);
+  // Writes the rest of the object file.
+  void finish(void);
+
+private:
+  struct Relocation {
+    uint32_t Offset;
+    uint32_t Type;
+    IceString Symbol; // empty for the .rodata section symbol
+  };
+  struct FunctionSymbol {
+    IceString Name;
+    uint32_t Offset;
+    uint32_t Size;
+  };
+  void writeBytes(const IceByteList &Bytes);
+  void padText(uint32_t Log2Align);
+  // Converts Fixup at Base in a section whose contents are Bytes into
+  // a relocation, resolving the function's .rodata labels.
+  Relocation
+  makeRelocation(const IceFixup &Fixup, uint32_t Base, IceByteList &Bytes,
+                 const std::map<IceString, uint32_t> &RoDataLabels);
+  void addSymbolReference(const Relocation &Reloc);
+
+  std::ostream &Out;
+  uint32_t TextSize;
+  uint32_t TextAlignment; // log2
+  IceByteList RoData;
+  uint32_t RoDataAlignment; // log2
+  std::vector<Relocation> TextRelocations;
+  std::vector<Relocation> RoDataRelocations;
+  std::vector<FunctionSymbol> Functions;
+  // Symbols referenced by relocations, in order of first reference,
+  // and whether any reference is absolute.
+  std::vector<IceString> References;
+  std::map<IceString, bool> IsAbsoluteReference;
+  std::map<IceString, uint32_t> SymbolSizes;
+};
+
+#endif // _IceELFObjectWriter_h
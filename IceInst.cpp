@@ -3,6 +3,9 @@
  * be found in the LICENSE file.
  */
 
+#include <algorithm> // std::find
+
+#include "IceAssembler.h"
 #include "IceCfg.h"
 #include "IceCfgNode.h"
 #include "IceInst.h"
@@ -44,6 +47,47 @@ bool IceInst::isLastUse(const IceOperand *TestSrc) const {
   return false;
 }
 
+// Replaces all the source operands, where some of the new operands
+// have been moved here from an earlier instruction From, and keeps
+// the last-use information consistent without recomputing liveness.
+// A variable's live range ends here if it ended either here or at
+// From.  The caller must ensure that no instruction between From and
+// this one uses a variable whose live range ended at From.
+void IceInst::replaceSources(const IceOpList &NewSrcs, const IceInst *From) {
+  assert(NewSrcs.size() == getSrcSize());
+  IceVarList Ended;
+  for (unsigned I = 0; I < getSrcSize(); ++I) {
+    IceOperand *Src = getSrc(I);
+    for (unsigned J = 0; J < Src->getNumVars(); ++J) {
+      IceVariable *Var = Src->getVar(J);
+      if (isLastUse(Var))
+        Ended.push_back(Var);
+    }
+  }
+  for (unsigned I = 0; I < From->getSrcSize(); ++I) {
+    IceOperand *Src = From->getSrc(I);
+    for (unsigned J = 0; J < Src->getNumVars(); ++J) {
+      IceVariable *Var = Src->getVar(J);
+      if (From->isLastUse(Var))
+        Ended.push_back(Var);
+    }
+  }
+  resetLastUses();
+  unsigned VarIndex = 0;
+  for (unsigned I = 0; I < getSrcSize(); ++I) {
+    Srcs[I] = NewSrcs[I];
+    for (unsigned J = 0; J < Srcs[I]->getNumVars(); ++J, ++VarIndex) {
+      IceVarList::iterator Found =
+          std::find(Ended.begin(), Ended.end(), Srcs[I]->getVar(J));
+      // Like liveness(), only the first use of a variable is marked.
+      if (Found != Ended.end()) {
+        setLastUse(VarIndex);
+        Ended.erase(Found);
+      }
+    }
+  }
+}
+
 void IceInst::renumber(IceCfg *Cfg) {
   Number = isDeleted() ? -1 : Cfg->newInstNumber();
 }
@@ -209,7 +253,7 @@ IceInstAssign::IceInstAssign(IceCfg *Cfg, IceVariable *Dest, IceOperand *Source)
 IceInstBr::IceInstBr(IceCfg *Cfg, IceOperand *Source, IceCfgNode *TargetTrue,
                      IceCfgNode *TargetFalse)
     : IceInst(Cfg, IceInst::Br, 1, NULL), TargetFalse(TargetFalse),
-      TargetTrue(TargetTrue) {
+      TargetTrue(TargetTrue), WeightTrue(0), WeightFalse(0) {
   if (TargetTrue != TargetFalse) {
     addSource(Source);
   }
@@ -217,7 +261,7 @@ IceInstBr::IceInstBr(IceCfg *Cfg, IceOperand *Source, IceCfgNode *TargetTrue,
 
 IceInstBr::IceInstBr(IceCfg *Cfg, IceCfgNode *Target)
     : IceInst(Cfg, IceInst::Br, 0, NULL), TargetFalse(Target),
-      TargetTrue(NULL) {}
+      TargetTrue(NULL), WeightTrue(0), WeightFalse(0) {}
 
 IceNodeList IceInstBr::getTerminatorEdges(void) const {
   IceNodeList OutEdges;
@@ -431,6 +475,10 @@ void IceInst::emit(IceOstream &Str, uint32_t Option) const {
   Str << "\n";
 }
 
+void IceInst::emitIAS(IceAssembler *Asm) const {
+  Asm->getCfg()->setError("Instruction has no encoding");
+}
+
 void IceInst::dump(IceOstream &Str) const {
   dumpDest(Str);
   Str << " =~ ";
@@ -43,6 +43,15 @@ public:
     return Srcs[I];
   }
   unsigned getSrcSize(void) const { return NumSrcs; }
+  // replaceDest() and replaceSource() are for passes that rename
+  // variables, like copy coalescing.  The caller is responsible for
+  // calling updateVars() afterwards.
+  void replaceDest(IceVariable *NewDest) { Dest = NewDest; }
+  void replaceSource(unsigned I, IceOperand *NewSrc) {
+    assert(I < getSrcSize());
+    Srcs[I] = NewSrc;
+  }
+  void replaceSources(const IceOpList &NewSrcs, const IceInst *From);
   virtual IceNodeList getTerminatorEdges(void) const {
     assert(0);
     return IceNodeList();
@@ -60,6 +69,8 @@ public:
   void liveness(IceLivenessMode Mode, int InstNumber, llvm::BitVector &Live,
                 IceLiveness *Liveness, const IceCfgNode *Node);
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  // Encodes the instruction with the integrated assembler.
+  virtual void emitIAS(IceAssembler *Asm) const;
   virtual void dump(IceOstream &Str) const;
   virtual void dumpExtras(IceOstream &Str) const;
   void dumpSources(IceOstream &Str) const;
@@ -188,6 +199,13 @@ public:
   }
   IceCfgNode *getTargetTrue(void) const { return TargetTrue; }
   IceCfgNode *getTargetFalse(void) const { return TargetFalse; }
+  // Relative branch weights from profile metadata, or 0 if unknown.
+  void setWeights(uint32_t True, uint32_t False) {
+    WeightTrue = True;
+    WeightFalse = False;
+  }
+  uint32_t getWeightTrue(void) const { return WeightTrue; }
+  uint32_t getWeightFalse(void) const { return WeightFalse; }
   virtual IceNodeList getTerminatorEdges(void) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return Inst->getKind() == Br; }
@@ -201,6 +219,8 @@ private:
 
   IceCfgNode *const TargetFalse;
   IceCfgNode *const TargetTrue; // NULL if unconditional branch
+  uint32_t WeightTrue;
+  uint32_t WeightFalse;
 };
 
 class IceInstCall : public IceInst {
@@ -451,6 +471,7 @@ public:
         IceInstFakeDef(Cfg, Dest, Src);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void emitIAS(IceAssembler *Asm) const {}
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) {
     return Inst->getKind() == FakeDef;
@@ -466,6 +487,7 @@ public:
     return new (Cfg->allocateInst<IceInstFakeUse>()) IceInstFakeUse(Cfg, Src);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void emitIAS(IceAssembler *Asm) const {}
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) {
     return Inst->getKind() == FakeUse;
@@ -484,6 +506,7 @@ public:
   }
   const IceInst *getLinked(void) const { return Linked; }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void emitIAS(IceAssembler *Asm) const {}
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) {
     return Inst->getKind() == FakeKill;
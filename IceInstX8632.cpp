@@ -5,6 +5,7 @@
 
 #include "IceCfg.h"
 #include "IceCfgNode.h"
+#include "IceAssemblerX8632.h"
 #include "IceInst.h"
 #include "IceInstX8632.h"
 #include "IceTargetLoweringX8632.h"
@@ -57,6 +58,20 @@ void IceOperandX8632Mem::setUse(const IceInst *Inst, const IceCfgNode *Node) {
     getIndex()->setUse(Inst, Node);
 }
 
+IceOperand *IceOperandX8632Mem::replaceVars(IceCfg *Cfg,
+                                            const IceVarList &Replacements) {
+  IceVariable *NewBase = Base;
+  IceVariable *NewIndex = Index;
+  if (Base && Replacements[Base->getIndex()])
+    NewBase = Replacements[Base->getIndex()];
+  if (Index && Replacements[Index->getIndex()])
+    NewIndex = Replacements[Index->getIndex()];
+  if (NewBase == Base && NewIndex == Index)
+    return this;
+  return IceOperandX8632Mem::create(Cfg, getType(), NewBase, Offset, NewIndex,
+                                    Shift);
+}
+
 IceInstX8632Add::IceInstX8632Add(IceCfg *Cfg, IceVariable *Dest,
                                  IceOperand *Source)
     : IceInstX8632(Cfg, IceInstX8632::Add, 2, Dest) {
@@ -127,9 +142,15 @@ IceInstX8632Imul::IceInstX8632Imul(IceCfg *Cfg, IceVariable *Dest,
   addSource(Source);
 }
 
+IceInstX8632Neg::IceInstX8632Neg(IceCfg *Cfg, IceVariable *Dest)
+    : IceInstX8632(Cfg, IceInstX8632::Neg, 1, Dest) {
+  addSource(Dest);
+}
+
 IceInstX8632Mul::IceInstX8632Mul(IceCfg *Cfg, IceVariable *Dest,
-                                 IceVariable *Source1, IceOperand *Source2)
-    : IceInstX8632(Cfg, IceInstX8632::Mul, 2, Dest) {
+                                 IceVariable *Source1, IceOperand *Source2,
+                                 bool Signed)
+    : IceInstX8632(Cfg, IceInstX8632::Mul, 2, Dest), Signed(Signed) {
   addSource(Source1);
   addSource(Source2);
 }
@@ -172,7 +193,7 @@ IceInstX8632Shl::IceInstX8632Shl(IceCfg *Cfg, IceVariable *Dest,
 }
 
 IceInstX8632Shld::IceInstX8632Shld(IceCfg *Cfg, IceVariable *Dest,
-                                   IceVariable *Source1, IceVariable *Source2)
+                                   IceVariable *Source1, IceOperand *Source2)
     : IceInstX8632(Cfg, IceInstX8632::Shld, 3, Dest) {
   addSource(Dest);
   addSource(Source1);
@@ -187,7 +208,7 @@ IceInstX8632Shr::IceInstX8632Shr(IceCfg *Cfg, IceVariable *Dest,
 }
 
 IceInstX8632Shrd::IceInstX8632Shrd(IceCfg *Cfg, IceVariable *Dest,
-                                   IceVariable *Source1, IceVariable *Source2)
+                                   IceVariable *Source1, IceOperand *Source2)
     : IceInstX8632(Cfg, IceInstX8632::Shrd, 3, Dest) {
   addSource(Dest);
   addSource(Source1);
@@ -218,6 +239,21 @@ IceInstX8632Br::IceInstX8632Br(IceCfg *Cfg, IceCfgNode *TargetTrue,
     : IceInstX8632(Cfg, IceInstX8632::Br, 0, NULL), Condition(Condition),
       TargetTrue(TargetTrue), TargetFalse(TargetFalse), Label(Label) {}
 
+IceInstX8632JumpTable::IceInstX8632JumpTable(IceCfg *Cfg,
+                                             IceTargetX8632 *Target,
+                                             IceVariable *Index,
+                                             const IceNodeList &Targets)
+    : IceInstX8632(Cfg, IceInstX8632::JumpTable, 1, NULL),
+      Number(Target->makeNextLabelNumber()), Targets(Targets) {
+  addSource(Index);
+}
+
+IceString IceInstX8632JumpTable::getName(IceCfg *Cfg) const {
+  char buf[30];
+  sprintf(buf, "%u", Number);
+  return ".L" + Cfg->getName() + "$__jt" + buf;
+}
+
 IceInstX8632Call::IceInstX8632Call(IceCfg *Cfg, IceVariable *Dest,
                                    IceOperand *CallTarget, bool Tail)
     : IceInstX8632(Cfg, IceInstX8632::Call, 1, Dest), Tail(Tail) {
@@ -225,6 +261,14 @@ IceInstX8632Call::IceInstX8632Call(IceCfg *Cfg, IceVariable *Dest,
   addSource(CallTarget);
 }
 
+IceInstX8632TailCall::IceInstX8632TailCall(IceCfg *Cfg,
+                                           IceOperand *CallTarget,
+                                           uint32_t ArgsSize)
+    : IceInstX8632(Cfg, IceInstX8632::TailCall, 1, NULL), ArgsSize(ArgsSize) {
+  HasSideEffects = true;
+  addSource(CallTarget);
+}
+
 IceInstX8632Cdq::IceInstX8632Cdq(IceCfg *Cfg, IceVariable *Dest,
                                  IceOperand *Source)
     : IceInstX8632(Cfg, IceInstX8632::Cdq, 1, Dest) {
@@ -269,6 +313,13 @@ IceInstX8632Store::IceInstX8632Store(IceCfg *Cfg, IceOperand *Value,
   addSource(Mem);
 }
 
+IceInstX8632Rmw::IceInstX8632Rmw(IceCfg *Cfg, IceInstArithmetic::OpKind Op,
+                                 IceOperandX8632Mem *Mem, IceOperand *Source)
+    : IceInstX8632(Cfg, IceInstX8632::Rmw, 2, NULL), Op(Op) {
+  addSource(Mem);
+  addSource(Source);
+}
+
 IceInstX8632Mov::IceInstX8632Mov(IceCfg *Cfg, IceVariable *Dest,
                                  IceOperand *Source)
     : IceInstX8632(Cfg, IceInstX8632::Mov, 1, Dest) {
@@ -287,19 +338,85 @@ IceInstX8632Movzx::IceInstX8632Movzx(IceCfg *Cfg, IceVariable *Dest,
   addSource(Source);
 }
 
+IceInstX8632Lea::IceInstX8632Lea(IceCfg *Cfg, IceVariable *Dest,
+                                 IceOperandX8632Mem *Source)
+    : IceInstX8632(Cfg, IceInstX8632::Lea, 1, Dest) {
+  addSource(Source);
+}
+
+IceInstX8632Setcc::IceInstX8632Setcc(IceCfg *Cfg, IceVariable *Dest,
+                                     IceInstX8632Br::BrCond Condition)
+    : IceInstX8632(Cfg, IceInstX8632::Setcc, 1, Dest), Condition(Condition) {
+  addSource(Dest);
+}
+
+IceInstX8632Cmov::IceInstX8632Cmov(IceCfg *Cfg, IceVariable *Dest,
+                                   IceOperand *Source,
+                                   IceInstX8632Br::BrCond Condition)
+    : IceInstX8632(Cfg, IceInstX8632::Cmov, 2, Dest), Condition(Condition) {
+  addSource(Dest);
+  addSource(Source);
+}
+
+IceInstX8632Movd::IceInstX8632Movd(IceCfg *Cfg, IceVariable *Dest,
+                                   IceVariable *Source)
+    : IceInstX8632(Cfg, IceInstX8632::Movd, 1, Dest) {
+  addSource(Source);
+}
+
+IceInstX8632Pshufd::IceInstX8632Pshufd(IceCfg *Cfg, IceVariable *Dest,
+                                       IceVariable *Source,
+                                       IceConstant *Order)
+    : IceInstX8632(Cfg, IceInstX8632::Pshufd, 2, Dest) {
+  addSource(Source);
+  addSource(Order);
+}
+
+IceInstX8632Pand::IceInstX8632Pand(IceCfg *Cfg, IceVariable *Dest,
+                                   IceVariable *Source)
+    : IceInstX8632(Cfg, IceInstX8632::Pand, 2, Dest) {
+  addSource(Dest);
+  addSource(Source);
+}
+
+IceInstX8632Pandn::IceInstX8632Pandn(IceCfg *Cfg, IceVariable *Dest,
+                                     IceVariable *Source)
+    : IceInstX8632(Cfg, IceInstX8632::Pandn, 2, Dest) {
+  addSource(Dest);
+  addSource(Source);
+}
+
+IceInstX8632Por::IceInstX8632Por(IceCfg *Cfg, IceVariable *Dest,
+                                 IceVariable *Source)
+    : IceInstX8632(Cfg, IceInstX8632::Por, 2, Dest) {
+  addSource(Dest);
+  addSource(Source);
+}
+
 IceInstX8632Fld::IceInstX8632Fld(IceCfg *Cfg, IceOperand *Src)
     : IceInstX8632(Cfg, IceInstX8632::Fld, 1, NULL) {
   addSource(Src);
 }
 
+IceInstX8632Fpu::IceInstX8632Fpu(IceCfg *Cfg, FpuOp Op,
+                                 IceOperandX8632Mem *Mem)
+    : IceInstX8632(Cfg, IceInstX8632::Fpu, 1, NULL), Op(Op) {
+  // The x87 register stack and control word are not modeled, so
+  // these must never be eliminated.
+  HasSideEffects = true;
+  addSource(Mem);
+}
+
 IceInstX8632Fstp::IceInstX8632Fstp(IceCfg *Cfg, IceVariable *Dest)
     : IceInstX8632(Cfg, IceInstX8632::Fstp, 0, Dest) {}
 
 IceInstX8632Pop::IceInstX8632Pop(IceCfg *Cfg, IceVariable *Dest)
     : IceInstX8632(Cfg, IceInstX8632::Pop, 1, Dest) {}
 
-IceInstX8632Push::IceInstX8632Push(IceCfg *Cfg, IceOperand *Source)
-    : IceInstX8632(Cfg, IceInstX8632::Push, 1, NULL) {
+IceInstX8632Push::IceInstX8632Push(IceCfg *Cfg, IceOperand *Source,
+                                   bool SuppressStackAdjustment)
+    : IceInstX8632(Cfg, IceInstX8632::Push, 1, NULL),
+      SuppressStackAdjustment(SuppressStackAdjustment) {
   addSource(Source);
 }
 
@@ -338,6 +455,59 @@ void IceInstX8632Label::dump(IceOstream &Str) const {
   Str << getName(Str.Cfg) << ":";
 }
 
+static IceInstX8632Br::BrCond
+getOppositeCondition(IceInstX8632Br::BrCond Condition) {
+  switch (Condition) {
+  case IceInstX8632Br::Br_a:
+    return IceInstX8632Br::Br_be;
+  case IceInstX8632Br::Br_ae:
+    return IceInstX8632Br::Br_b;
+  case IceInstX8632Br::Br_b:
+    return IceInstX8632Br::Br_ae;
+  case IceInstX8632Br::Br_be:
+    return IceInstX8632Br::Br_a;
+  case IceInstX8632Br::Br_e:
+    return IceInstX8632Br::Br_ne;
+  case IceInstX8632Br::Br_g:
+    return IceInstX8632Br::Br_le;
+  case IceInstX8632Br::Br_ge:
+    return IceInstX8632Br::Br_l;
+  case IceInstX8632Br::Br_l:
+    return IceInstX8632Br::Br_ge;
+  case IceInstX8632Br::Br_le:
+    return IceInstX8632Br::Br_g;
+  case IceInstX8632Br::Br_ne:
+    return IceInstX8632Br::Br_e;
+  case IceInstX8632Br::Br_np:
+    return IceInstX8632Br::Br_p;
+  case IceInstX8632Br::Br_p:
+    return IceInstX8632Br::Br_np;
+  case IceInstX8632Br::Br_None:
+    break;
+  }
+  return IceInstX8632Br::Br_None;
+}
+
+// Removes the part of the branch that jumps to NextNode, which
+// follows in the layout.  A conditional branch whose true target is
+// NextNode has its condition inverted so that it can fall through.
+void IceInstX8632Br::optimizeBranch(const IceCfgNode *NextNode) {
+  if (NextNode == NULL || Label || TargetFalse == NULL)
+    return;
+  if (Condition == Br_None) {
+    if (TargetFalse == NextNode)
+      setDeleted();
+    return;
+  }
+  if (TargetFalse == NextNode) {
+    TargetFalse = NULL;
+  } else if (TargetTrue == NextNode) {
+    Condition = getOppositeCondition(Condition);
+    TargetTrue = TargetFalse;
+    TargetFalse = NULL;
+  }
+}
+
 void IceInstX8632Br::emit(IceOstream &Str, unsigned Option) const {
   Str << "\t";
   switch (Condition) {
@@ -450,10 +620,42 @@ void IceInstX8632Br::dump(IceOstream &Str) const {
   }
 }
 
+void IceInstX8632JumpTable::emit(IceOstream &Str, uint32_t Option) const {
+  assert(getSrcSize() == 1);
+  Str << "\tjmp\tdword ptr [" << getName(Str.Cfg) << "+4*";
+  getSrc(0)->emit(Str, Option);
+  Str << "]\n";
+  Str << "\t.section\t.rodata,\"a\",@progbits\n";
+  Str << "\t.align\t4\n";
+  Str << getName(Str.Cfg) << ":\n";
+  for (IceNodeList::const_iterator I = Targets.begin(), E = Targets.end();
+       I != E; ++I) {
+    Str << "\t.long\t" << (*I)->getAsmName() << "\n";
+  }
+  Str << "\t.text\n";
+}
+
+void IceInstX8632JumpTable::dump(IceOstream &Str) const {
+  Str << "jmp [" << getName(Str.Cfg) << " + 4*";
+  dumpSources(Str);
+  Str << "] [";
+  for (IceNodeList::const_iterator I = Targets.begin(), E = Targets.end();
+       I != E; ++I) {
+    if (I != Targets.begin())
+      Str << ", ";
+    Str << "label %" << (*I)->getName();
+  }
+  Str << "]";
+}
+
 void IceInstX8632Call::emit(IceOstream &Str, uint32_t Option) const {
   assert(getSrcSize() == 1);
   Str << "\tcall\t";
-  getCallTarget()->emit(Str, Option);
+  if (IceConstantRelocatable *Symbol =
+          llvm::dyn_cast<IceConstantRelocatable>(getCallTarget()))
+    Symbol->emitWithoutPrefix(Str);
+  else
+    getCallTarget()->emit(Str, Option);
   if (Tail)
     Str << "\t# tail";
   Str << "\n";
@@ -470,6 +672,21 @@ void IceInstX8632Call::dump(IceOstream &Str) const {
   Str << "call " << getCallTarget();
 }
 
+void IceInstX8632TailCall::emit(IceOstream &Str, uint32_t Option) const {
+  assert(getSrcSize() == 1);
+  Str << "\tjmp\t";
+  if (IceConstantRelocatable *Symbol =
+          llvm::dyn_cast<IceConstantRelocatable>(getCallTarget()))
+    Symbol->emitWithoutPrefix(Str);
+  else
+    getCallTarget()->emit(Str, Option);
+  Str << "\n";
+}
+
+void IceInstX8632TailCall::dump(IceOstream &Str) const {
+  Str << "tailcall " << getCallTarget() << ", argsize=" << ArgsSize;
+}
+
 static void emitTwoAddress(const char *Opcode, const IceInst *Inst,
                            IceOstream &Str, uint32_t Option,
                            bool ShiftHack = false) {
@@ -593,20 +810,33 @@ void IceInstX8632Imul::dump(IceOstream &Str) const {
   dumpSources(Str);
 }
 
+void IceInstX8632Neg::emit(IceOstream &Str, uint32_t Option) const {
+  assert(getSrcSize() == 1);
+  Str << "\tneg\t";
+  getDest()->emit(Str, Option);
+  Str << "\n";
+}
+
+void IceInstX8632Neg::dump(IceOstream &Str) const {
+  dumpDest(Str);
+  Str << " = neg." << getDest()->getType() << " ";
+  dumpSources(Str);
+}
+
 void IceInstX8632Mul::emit(IceOstream &Str, uint32_t Option) const {
   assert(getSrcSize() == 2);
   assert(llvm::isa<IceVariable>(getSrc(0)));
   assert(llvm::dyn_cast<IceVariable>(getSrc(0))->getRegNum() ==
          IceTargetX8632::Reg_eax);
   assert(getDest()->getRegNum() == IceTargetX8632::Reg_eax); // TODO: allow edx?
-  Str << "\tmul\t";
+  Str << (Signed ? "\timul\t" : "\tmul\t");
   getSrc(1)->emit(Str, Option);
   Str << "\n";
 }
 
 void IceInstX8632Mul::dump(IceOstream &Str) const {
   dumpDest(Str);
-  Str << " = mul." << getDest()->getType() << " ";
+  Str << (Signed ? " = imul." : " = mul.") << getDest()->getType() << " ";
   dumpSources(Str);
 }
 
@@ -783,7 +1013,10 @@ static IceString getCvtTypeString(IceType Type) {
 
 void IceInstX8632Cvt::emit(IceOstream &Str, uint32_t Option) const {
   assert(getSrcSize() == 1);
-  Str << "\tcvts" << getCvtTypeString(getSrc(0)->getType()) << "2s"
+  // Conversions to an integer truncate, like fptosi and fptoui.
+  bool Truncate = (getCvtTypeString(getDest()->getType()) == "i");
+  Str << "\tcvt" << (Truncate ? "t" : "") << "s"
+      << getCvtTypeString(getSrc(0)->getType()) << "2s"
       << getCvtTypeString(getDest()->getType()) << "\t";
   getDest()->emit(Str, Option);
   Str << ", ";
@@ -843,9 +1076,157 @@ void IceInstX8632Test::dump(IceOstream &Str) const {
   dumpSources(Str);
 }
 
+// Returns the condition code suffix shared by the jcc, setcc and cmovcc
+// mnemonics.
+static const char *getConditionSuffix(IceInstX8632Br::BrCond Condition) {
+  switch (Condition) {
+  case IceInstX8632Br::Br_a:
+    return "a";
+  case IceInstX8632Br::Br_ae:
+    return "ae";
+  case IceInstX8632Br::Br_b:
+    return "b";
+  case IceInstX8632Br::Br_be:
+    return "be";
+  case IceInstX8632Br::Br_e:
+    return "e";
+  case IceInstX8632Br::Br_g:
+    return "g";
+  case IceInstX8632Br::Br_ge:
+    return "ge";
+  case IceInstX8632Br::Br_l:
+    return "l";
+  case IceInstX8632Br::Br_le:
+    return "le";
+  case IceInstX8632Br::Br_ne:
+    return "ne";
+  case IceInstX8632Br::Br_np:
+    return "np";
+  case IceInstX8632Br::Br_p:
+    return "p";
+  case IceInstX8632Br::Br_None:
+    break;
+  }
+  assert(0 && "Unconditional setcc/cmov");
+  return "";
+}
+
+void IceInstX8632Setcc::emit(IceOstream &Str, uint32_t Option) const {
+  // The emitter names registers by their 32-bit form, so the byte
+  // register is spelled out here.
+  static const char *ByteRegNames[] = { "al", "cl", "dl", "bl" };
+  assert(getSrcSize() == 1);
+  Str << "\tset" << getConditionSuffix(Condition) << "\t";
+  int RegNum = getDest()->getRegNum();
+  if (RegNum >= 0) {
+    assert(RegNum <= IceTargetX8632::Reg_ebx);
+    Str << ByteRegNames[RegNum];
+  } else {
+    Str << "byte ptr ";
+    getDest()->emit(Str, Option);
+  }
+  Str << "\n";
+}
+
+void IceInstX8632Setcc::dump(IceOstream &Str) const {
+  dumpDest(Str);
+  Str << " = set" << getConditionSuffix(Condition) << " ";
+  dumpSources(Str);
+}
+
+void IceInstX8632Cmov::emit(IceOstream &Str, uint32_t Option) const {
+  assert(getSrcSize() == 2);
+  assert(getDest()->getRegNum() >= 0);
+  Str << "\tcmov" << getConditionSuffix(Condition) << "\t";
+  getDest()->emit(Str, Option);
+  Str << ", ";
+  getSrc(1)->emit(Str, Option);
+  Str << "\n";
+}
+
+void IceInstX8632Cmov::dump(IceOstream &Str) const {
+  dumpDest(Str);
+  Str << " = cmov" << getConditionSuffix(Condition) << "."
+      << getDest()->getType() << " ";
+  dumpSources(Str);
+}
+
+void IceInstX8632Movd::emit(IceOstream &Str, uint32_t Option) const {
+  assert(getSrcSize() == 1);
+  Str << "\tmovd\t";
+  getDest()->emit(Str, Option);
+  Str << ", ";
+  getSrc(0)->emit(Str, Option);
+  Str << "\n";
+}
+
+void IceInstX8632Movd::dump(IceOstream &Str) const {
+  dumpDest(Str);
+  Str << " = movd." << getDest()->getType() << " ";
+  dumpSources(Str);
+}
+
+void IceInstX8632Pshufd::emit(IceOstream &Str, uint32_t Option) const {
+  assert(getSrcSize() == 2);
+  Str << "\tpshufd\t";
+  getDest()->emit(Str, Option);
+  Str << ", ";
+  getSrc(0)->emit(Str, Option);
+  Str << ", ";
+  getSrc(1)->emit(Str, Option);
+  Str << "\n";
+}
+
+void IceInstX8632Pshufd::dump(IceOstream &Str) const {
+  dumpDest(Str);
+  Str << " = pshufd." << getDest()->getType() << " ";
+  dumpSources(Str);
+}
+
+void IceInstX8632Pand::emit(IceOstream &Str, uint32_t Option) const {
+  emitTwoAddress("pand", this, Str, Option);
+}
+
+void IceInstX8632Pand::dump(IceOstream &Str) const {
+  dumpDest(Str);
+  Str << " = pand." << getDest()->getType() << " ";
+  dumpSources(Str);
+}
+
+void IceInstX8632Pandn::emit(IceOstream &Str, uint32_t Option) const {
+  emitTwoAddress("pandn", this, Str, Option);
+}
+
+void IceInstX8632Pandn::dump(IceOstream &Str) const {
+  dumpDest(Str);
+  Str << " = pandn." << getDest()->getType() << " ";
+  dumpSources(Str);
+}
+
+void IceInstX8632Por::emit(IceOstream &Str, uint32_t Option) const {
+  emitTwoAddress("por", this, Str, Option);
+}
+
+void IceInstX8632Por::dump(IceOstream &Str) const {
+  dumpDest(Str);
+  Str << " = por." << getDest()->getType() << " ";
+  dumpSources(Str);
+}
+
 void IceInstX8632Store::emit(IceOstream &Str, uint32_t Option) const {
   assert(getSrcSize() == 2);
-  Str << "\tmov\t";
+  Str << "\tmov";
+  switch (getSrc(0)->getType()) {
+  case IceType_f32:
+    Str << "ss"; // movss
+    break;
+  case IceType_f64:
+    Str << "sd"; // movsd
+    break;
+  default:
+    break; // mov
+  }
+  Str << "\t";
   getSrc(1)->emit(Str, Option);
   Str << ", ";
   getSrc(0)->emit(Str, Option);
@@ -857,6 +1238,39 @@ void IceInstX8632Store::dump(IceOstream &Str) const {
       << getSrc(0);
 }
 
+static const char *getRmwOpcode(IceInstArithmetic::OpKind Op) {
+  switch (Op) {
+  case IceInstArithmetic::Add:
+    return "add";
+  case IceInstArithmetic::Sub:
+    return "sub";
+  case IceInstArithmetic::And:
+    return "and";
+  case IceInstArithmetic::Or:
+    return "or";
+  case IceInstArithmetic::Xor:
+    return "xor";
+  default:
+    break;
+  }
+  assert(0 && "Unsupported read-modify-write operation");
+  return "";
+}
+
+void IceInstX8632Rmw::emit(IceOstream &Str, uint32_t Option) const {
+  assert(getSrcSize() == 2);
+  Str << "\t" << getRmwOpcode(Op) << "\t";
+  getSrc(0)->emit(Str, Option);
+  Str << ", ";
+  getSrc(1)->emit(Str, Option);
+  Str << "\n";
+}
+
+void IceInstX8632Rmw::dump(IceOstream &Str) const {
+  Str << getRmwOpcode(Op) << "." << getSrc(0)->getType() << " ";
+  dumpSources(Str);
+}
+
 void IceInstX8632Mov::emit(IceOstream &Str, uint32_t Option) const {
   assert(getSrcSize() == 1);
   Str << "\tmov";
@@ -924,6 +1338,21 @@ void IceInstX8632Movzx::dump(IceOstream &Str) const {
   dumpSources(Str);
 }
 
+void IceInstX8632Lea::emit(IceOstream &Str, uint32_t Option) const {
+  assert(getSrcSize() == 1);
+  Str << "\tlea\t";
+  getDest()->emit(Str, Option);
+  Str << ", ";
+  getSrc(0)->emit(Str, Option);
+  Str << "\n";
+}
+
+void IceInstX8632Lea::dump(IceOstream &Str) const {
+  dumpDest(Str);
+  Str << " = lea." << getDest()->getType() << " ";
+  dumpSources(Str);
+}
+
 void IceInstX8632Fld::emit(IceOstream &Str, uint32_t Option) const {
   assert(getSrcSize() == 1);
   bool isDouble = (getSrc(0)->getType() == IceType_f64);
@@ -941,6 +1370,9 @@ void IceInstX8632Fld::emit(IceOstream &Str, uint32_t Option) const {
     return;
   }
   Str << "\tfld\t";
+  // A stack slot, unlike a memory operand, carries no size.
+  if (Var)
+    Str << (isDouble ? "q" : "d") << "word ptr ";
   getSrc(0)->emit(Str, Option);
   Str << "\n";
 }
@@ -950,6 +1382,37 @@ void IceInstX8632Fld::dump(IceOstream &Str) const {
   dumpSources(Str);
 }
 
+static const char *getFpuOpcode(IceInstX8632Fpu::FpuOp Op) {
+  switch (Op) {
+  case IceInstX8632Fpu::Fadd:
+    return "fadd";
+  case IceInstX8632Fpu::Fild:
+    return "fild";
+  case IceInstX8632Fpu::Fistp:
+    return "fistp";
+  case IceInstX8632Fpu::Fldcw:
+    return "fldcw";
+  case IceInstX8632Fpu::Fnstcw:
+    return "fnstcw";
+  case IceInstX8632Fpu::Fstp:
+    return "fstp";
+  }
+  assert(0);
+  return "";
+}
+
+void IceInstX8632Fpu::emit(IceOstream &Str, uint32_t Option) const {
+  assert(getSrcSize() == 1);
+  Str << "\t" << getFpuOpcode(Op) << "\t";
+  getSrc(0)->emit(Str, Option);
+  Str << "\n";
+}
+
+void IceInstX8632Fpu::dump(IceOstream &Str) const {
+  Str << getFpuOpcode(Op) << "." << getSrc(0)->getType() << " ";
+  dumpSources(Str);
+}
+
 void IceInstX8632Fstp::emit(IceOstream &Str, uint32_t Option) const {
   assert(getSrcSize() == 0);
   if (getDest() == NULL) {
@@ -957,7 +1420,8 @@ void IceInstX8632Fstp::emit(IceOstream &Str, uint32_t Option) const {
     return;
   }
   if (getDest()->getRegNum() < 0) {
-    Str << "\tfstp\t";
+    Str << "\tfstp\t"
+        << (getDest()->getType() == IceType_f64 ? "q" : "d") << "word ptr ";
     getDest()->emit(Str, Option);
     Str << "\n";
     return;
@@ -1015,7 +1479,8 @@ void IceInstX8632Push::emit(IceOstream &Str, uint32_t Option) const {
     Str << "\tpush\t";
     getSrc(0)->emit(Str, Option);
     Str << "\n";
-    Str.Cfg->getTarget()->updateStackAdjustment(4);
+    if (!SuppressStackAdjustment)
+      Str.Cfg->getTarget()->updateStackAdjustment(4);
   }
 }
 
@@ -1067,8 +1532,8 @@ void IceOperandX8632Mem::emit(IceOstream &Str, uint32_t Option) const {
     Dumped = true;
   }
   if (Index) {
-    assert(Base);
-    Str << "+";
+    if (Dumped)
+      Str << "+";
     if (Shift > 0)
       Str << (1u << Shift) << "*";
     Index->emit(Str, Option);
@@ -1089,7 +1554,11 @@ void IceOperandX8632Mem::emit(IceOstream &Str, uint32_t Option) const {
       if (!OffsetIsNegative) // Suppress if Offset is known to be negative
         Str << "+";
     }
-    Offset->emit(Str, Option);
+    if (IceConstantRelocatable *Symbol =
+            llvm::dyn_cast<IceConstantRelocatable>(Offset))
+      Symbol->emitWithoutPrefix(Str);
+    else
+      Offset->emit(Str, Option);
   }
   Str << "]";
 }
@@ -1102,8 +1571,8 @@ void IceOperandX8632Mem::dump(IceOstream &Str) const {
     Dumped = true;
   }
   if (Index) {
-    assert(Base);
-    Str << "+";
+    if (Dumped)
+      Str << "+";
     if (Shift > 0)
       Str << (1u << Shift) << "*";
     Str << Index;
@@ -1128,3 +1597,490 @@ void IceOperandX8632Mem::dump(IceOstream &Str) const {
   }
   Str << "]";
 }
+
+// ======================== Encoding routines ======================== //
+
+void IceInstX8632::emitIAS(IceAssembler *Asm) const {
+  encode(static_cast<IceAssemblerX8632 *>(Asm));
+}
+
+void IceInstX8632Label::encode(IceAssemblerX8632 *Asm) const {
+  Asm->bindLabel(this);
+}
+
+void IceInstX8632Br::encode(IceAssemblerX8632 *Asm) const {
+  if (Label) {
+    Asm->emitBranch(Condition, Label);
+  } else if (Condition == Br_None) {
+    Asm->emitBranch(Br_None, getTargetFalse());
+  } else {
+    Asm->emitBranch(Condition, getTargetTrue());
+    if (getTargetFalse())
+      Asm->emitBranch(Br_None, getTargetFalse());
+  }
+}
+
+void IceInstX8632JumpTable::encode(IceAssemblerX8632 *Asm) const {
+  Asm->emitJumpTable(getName(Asm->getCfg()), getSrc(0), Targets);
+}
+
+void IceInstX8632Call::encode(IceAssemblerX8632 *Asm) const {
+  Asm->emitCall(getCallTarget(), false);
+  Asm->getCfg()->getTarget()->resetStackAdjustment();
+}
+
+void IceInstX8632TailCall::encode(IceAssemblerX8632 *Asm) const {
+  Asm->emitCall(getCallTarget(), true);
+}
+
+static void encodeTwoAddress(IceAssemblerX8632 *Asm,
+                             IceAssemblerX8632::AluOp Op,
+                             const IceInst *Inst) {
+  assert(Inst->getSrcSize() == 2);
+  assert(Inst->getDest() == Inst->getSrc(0));
+  Asm->emitAlu(Op, Inst->getDest()->getType(), Inst->getDest(),
+               Inst->getSrc(1));
+}
+
+// Encodes a scalar SSE arithmetic instruction, whose prefix selects
+// the single or double precision form.
+static void encodeSse(IceAssemblerX8632 *Asm, uint8_t Opcode,
+                      const IceInst *Inst) {
+  assert(Inst->getSrcSize() == 2);
+  uint8_t Prefix = (Inst->getDest()->getType() == IceType_f32 ? 0xf3 : 0xf2);
+  Asm->emitSse(Prefix, Opcode, Inst->getDest(), Inst->getSrc(1));
+}
+
+void IceInstX8632Add::encode(IceAssemblerX8632 *Asm) const {
+  encodeTwoAddress(Asm, IceAssemblerX8632::Alu_add, this);
+}
+
+void IceInstX8632Adc::encode(IceAssemblerX8632 *Asm) const {
+  encodeTwoAddress(Asm, IceAssemblerX8632::Alu_adc, this);
+}
+
+void IceInstX8632Addss::encode(IceAssemblerX8632 *Asm) const {
+  encodeSse(Asm, 0x58, this);
+}
+
+void IceInstX8632Sub::encode(IceAssemblerX8632 *Asm) const {
+  encodeTwoAddress(Asm, IceAssemblerX8632::Alu_sub, this);
+}
+
+void IceInstX8632Subss::encode(IceAssemblerX8632 *Asm) const {
+  encodeSse(Asm, 0x5c, this);
+}
+
+void IceInstX8632Sbb::encode(IceAssemblerX8632 *Asm) const {
+  encodeTwoAddress(Asm, IceAssemblerX8632::Alu_sbb, this);
+}
+
+void IceInstX8632And::encode(IceAssemblerX8632 *Asm) const {
+  encodeTwoAddress(Asm, IceAssemblerX8632::Alu_and, this);
+}
+
+void IceInstX8632Or::encode(IceAssemblerX8632 *Asm) const {
+  encodeTwoAddress(Asm, IceAssemblerX8632::Alu_or, this);
+}
+
+void IceInstX8632Xor::encode(IceAssemblerX8632 *Asm) const {
+  encodeTwoAddress(Asm, IceAssemblerX8632::Alu_xor, this);
+}
+
+// There is no 8-bit form of the two-operand imul.
+void IceInstX8632Imul::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 2);
+  const IceOperand *Src = getSrc(1);
+  IceType Type = IceAssemblerX8632::getOperationType(getDest()->getType(),
+                                                     getDest(), Src);
+  if (Type == IceType_i1 || Type == IceType_i8) {
+    Asm->setError("No encoding for an 8-bit imul from memory");
+    return;
+  }
+  Asm->emitOperandSizePrefix(Type);
+  unsigned Reg = Asm->getRegEncoding(getDest());
+  if (llvm::isa<IceConstant>(Src)) {
+    const IceConstantInteger *Imm = llvm::dyn_cast<IceConstantInteger>(Src);
+    int32_t Value = (Imm ? static_cast<int32_t>(Imm->getIntValue()) : 0);
+    bool IsImm8 = (Imm && Value >= -128 && Value <= 127);
+    Asm->emitByte(IsImm8 ? 0x6b : 0x69);
+    Asm->emitOperand(Reg, getDest(), Type);
+    Asm->emitImmediate(IsImm8 ? IceType_i8 : Type, Src);
+    return;
+  }
+  Asm->emitByte(0x0f);
+  Asm->emitByte(0xaf);
+  Asm->emitOperand(Reg, Src, Type);
+}
+
+void IceInstX8632Neg::encode(IceAssemblerX8632 *Asm) const {
+  Asm->emitUnary(IceAssemblerX8632::Unary_neg, getDest()->getType(),
+                 getDest());
+}
+
+// The one-operand multiply and divide instructions work on eax and
+// edx, so they always use the 32-bit form, as the lowering expects.
+static void encodeWideUnary(IceAssemblerX8632 *Asm,
+                            IceAssemblerX8632::UnaryOp Op,
+                            const IceOperand *Src) {
+  if (IceAssemblerX8632::getOperationType(Src->getType(), Src) !=
+      IceType_i32) {
+    Asm->setError("No encoding for a narrow multiply or divide from memory");
+    return;
+  }
+  Asm->emitUnary(Op, IceType_i32, Src);
+}
+
+void IceInstX8632Mul::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 2);
+  encodeWideUnary(Asm, Signed ? IceAssemblerX8632::Unary_imul
+                              : IceAssemblerX8632::Unary_mul,
+                  getSrc(1));
+}
+
+void IceInstX8632Mulss::encode(IceAssemblerX8632 *Asm) const {
+  encodeSse(Asm, 0x59, this);
+}
+
+void IceInstX8632Idiv::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 3);
+  encodeWideUnary(Asm, IceAssemblerX8632::Unary_idiv, getSrc(1));
+}
+
+void IceInstX8632Div::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 3);
+  encodeWideUnary(Asm, IceAssemblerX8632::Unary_div, getSrc(1));
+}
+
+void IceInstX8632Divss::encode(IceAssemblerX8632 *Asm) const {
+  encodeSse(Asm, 0x5e, this);
+}
+
+void IceInstX8632Shl::encode(IceAssemblerX8632 *Asm) const {
+  Asm->emitShift(IceAssemblerX8632::Shift_shl, getDest()->getType(),
+                 getDest(), getSrc(1));
+}
+
+// Encodes shld or shrd, whose count is an immediate or cl.
+static void encodeDoubleShift(IceAssemblerX8632 *Asm, uint8_t Opcode,
+                              const IceInst *Inst) {
+  assert(Inst->getSrcSize() == 3);
+  assert(Inst->getDest() == Inst->getSrc(0));
+  const IceConstantInteger *Count =
+      llvm::dyn_cast<IceConstantInteger>(Inst->getSrc(2));
+  if (Count == NULL) {
+    IceVariable *ShiftReg = llvm::dyn_cast<IceVariable>(Inst->getSrc(2));
+    if (ShiftReg == NULL || ShiftReg->getRegNum() != IceTargetX8632::Reg_ecx) {
+      Asm->setError("Shift count must be an immediate or in ecx");
+      return;
+    }
+  }
+  Asm->emitByte(0x0f);
+  Asm->emitByte(Count ? Opcode : Opcode + 1);
+  Asm->emitOperand(Asm->getRegEncoding(Inst->getSrc(1)), Inst->getDest());
+  if (Count)
+    Asm->emitByte(Count->getIntValue() & 0xff);
+}
+
+void IceInstX8632Shld::encode(IceAssemblerX8632 *Asm) const {
+  encodeDoubleShift(Asm, 0xa4, this);
+}
+
+void IceInstX8632Shr::encode(IceAssemblerX8632 *Asm) const {
+  Asm->emitShift(IceAssemblerX8632::Shift_shr, getDest()->getType(),
+                 getDest(), getSrc(1));
+}
+
+void IceInstX8632Shrd::encode(IceAssemblerX8632 *Asm) const {
+  encodeDoubleShift(Asm, 0xac, this);
+}
+
+void IceInstX8632Sar::encode(IceAssemblerX8632 *Asm) const {
+  Asm->emitShift(IceAssemblerX8632::Shift_sar, getDest()->getType(),
+                 getDest(), getSrc(1));
+}
+
+void IceInstX8632Cdq::encode(IceAssemblerX8632 *Asm) const {
+  Asm->emitByte(0x99);
+}
+
+void IceInstX8632Cvt::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 1);
+  IceType SrcType = getSrc(0)->getType();
+  IceType DestType = getDest()->getType();
+  bool SrcIsFloat = (SrcType == IceType_f32 || SrcType == IceType_f64);
+  bool DestIsFloat = (DestType == IceType_f32 || DestType == IceType_f64);
+  uint8_t Prefix = 0;
+  uint8_t Opcode = 0;
+  if (!SrcIsFloat) {
+    // cvtsi2ss, cvtsi2sd
+    Prefix = (DestType == IceType_f32 ? 0xf3 : 0xf2);
+    Opcode = 0x2a;
+  } else if (DestIsFloat) {
+    // cvtss2sd, cvtsd2ss
+    Prefix = (SrcType == IceType_f32 ? 0xf3 : 0xf2);
+    Opcode = 0x5a;
+  } else {
+    // cvttss2si, cvttsd2si
+    Prefix = (SrcType == IceType_f32 ? 0xf3 : 0xf2);
+    Opcode = 0x2c;
+  }
+  Asm->emitSse(Prefix, Opcode, getDest(), getSrc(0));
+}
+
+void IceInstX8632Icmp::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 2);
+  Asm->emitAlu(IceAssemblerX8632::Alu_cmp, getSrc(0)->getType(), getSrc(0),
+               getSrc(1));
+}
+
+void IceInstX8632Ucomiss::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 2);
+  uint8_t Prefix = (getSrc(0)->getType() == IceType_f32 ? 0 : 0x66);
+  Asm->emitSse(Prefix, 0x2e, getSrc(0), getSrc(1));
+}
+
+void IceInstX8632Test::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 2);
+  Asm->emitTest(getSrc(0)->getType(), getSrc(0), getSrc(1));
+}
+
+void IceInstX8632Setcc::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 1);
+  Asm->emitByte(0x0f);
+  Asm->emitByte(0x90 + IceAssemblerX8632::getConditionCode(Condition));
+  Asm->emitOperand(0, getDest(), IceType_i8);
+}
+
+// Like imul, cmov has no 8-bit form.
+void IceInstX8632Cmov::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 2);
+  const IceOperand *Src = getSrc(1);
+  IceType Type = IceAssemblerX8632::getOperationType(getDest()->getType(),
+                                                     getDest(), Src);
+  if (Type == IceType_i1 || Type == IceType_i8) {
+    Asm->setError("No encoding for an 8-bit cmov from memory");
+    return;
+  }
+  Asm->emitOperandSizePrefix(Type);
+  Asm->emitByte(0x0f);
+  Asm->emitByte(0x40 + IceAssemblerX8632::getConditionCode(Condition));
+  Asm->emitOperand(Asm->getRegEncoding(getDest()), Src);
+}
+
+void IceInstX8632Movd::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 1);
+  Asm->emitSse(0x66, 0x6e, getDest(), getSrc(0));
+}
+
+void IceInstX8632Pshufd::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 2);
+  Asm->emitSse(0x66, 0x70, getDest(), getSrc(0));
+  Asm->emitImmediate(IceType_i8, getSrc(1));
+}
+
+void IceInstX8632Pand::encode(IceAssemblerX8632 *Asm) const {
+  Asm->emitSse(0x66, 0xdb, getDest(), getSrc(1));
+}
+
+void IceInstX8632Pandn::encode(IceAssemblerX8632 *Asm) const {
+  Asm->emitSse(0x66, 0xdf, getDest(), getSrc(1));
+}
+
+void IceInstX8632Por::encode(IceAssemblerX8632 *Asm) const {
+  Asm->emitSse(0x66, 0xeb, getDest(), getSrc(1));
+}
+
+void IceInstX8632Store::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 2);
+  Asm->emitMov(getSrc(0)->getType(), getSrc(1), getSrc(0));
+}
+
+static IceAssemblerX8632::AluOp getRmwAluOp(IceInstArithmetic::OpKind Op) {
+  switch (Op) {
+  case IceInstArithmetic::Add:
+    return IceAssemblerX8632::Alu_add;
+  case IceInstArithmetic::Sub:
+    return IceAssemblerX8632::Alu_sub;
+  case IceInstArithmetic::And:
+    return IceAssemblerX8632::Alu_and;
+  case IceInstArithmetic::Or:
+    return IceAssemblerX8632::Alu_or;
+  case IceInstArithmetic::Xor:
+    return IceAssemblerX8632::Alu_xor;
+  default:
+    break;
+  }
+  assert(0 && "Unsupported read-modify-write operation");
+  return IceAssemblerX8632::Alu_add;
+}
+
+void IceInstX8632Rmw::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 2);
+  Asm->emitAlu(getRmwAluOp(Op), getSrc(0)->getType(), getSrc(0), getSrc(1));
+}
+
+void IceInstX8632Mov::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 1);
+  Asm->emitMov(getDest()->getType(), getDest(), getSrc(0));
+}
+
+// Encodes movsx or movzx.  Dest is a register, so this always
+// extends to 32 bits.
+static void encodeExtend(IceAssemblerX8632 *Asm, uint8_t Opcode,
+                         const IceInst *Inst) {
+  assert(Inst->getSrcSize() == 1);
+  IceType SrcType = Inst->getSrc(0)->getType();
+  Asm->emitByte(0x0f);
+  Asm->emitByte(SrcType == IceType_i16 ? Opcode + 1 : Opcode);
+  Asm->emitOperand(Asm->getRegEncoding(Inst->getDest()), Inst->getSrc(0),
+                   SrcType);
+}
+
+void IceInstX8632Movsx::encode(IceAssemblerX8632 *Asm) const {
+  encodeExtend(Asm, 0xbe, this);
+}
+
+void IceInstX8632Movzx::encode(IceAssemblerX8632 *Asm) const {
+  encodeExtend(Asm, 0xb6, this);
+}
+
+void IceInstX8632Lea::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 1);
+  Asm->emitByte(0x8d);
+  Asm->emitOperand(Asm->getRegEncoding(getDest()), getSrc(0));
+}
+
+void IceInstX8632Fld::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 1);
+  bool isDouble = (getSrc(0)->getType() == IceType_f64);
+  uint8_t Opcode = (isDouble ? 0xdd : 0xd9);
+  IceVariable *Var = llvm::dyn_cast<IceVariable>(getSrc(0));
+  if (Var && Var->getRegNum() >= 0) {
+    // Go through a temporary stack slot, as in emit().
+    int32_t Width = (isDouble ? 8 : 4);
+    Asm->emitAdjustEsp(-Width);
+    Asm->emitByte(isDouble ? 0xf2 : 0xf3);
+    Asm->emitByte(0x0f);
+    Asm->emitByte(0x11);
+    Asm->emitStackTopOperand(Asm->getRegEncoding(Var));
+    Asm->emitByte(Opcode);
+    Asm->emitStackTopOperand(0);
+    Asm->emitAdjustEsp(Width);
+    return;
+  }
+  Asm->emitByte(Opcode);
+  Asm->emitOperand(0, getSrc(0));
+}
+
+void IceInstX8632Fpu::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 1);
+  IceType Type = getSrc(0)->getType();
+  uint8_t Opcode = 0;
+  unsigned RegField = 0;
+  switch (Op) {
+  case Fadd:
+    Opcode = (Type == IceType_f64 ? 0xdc : 0xd8);
+    RegField = 0;
+    break;
+  case Fild:
+    Opcode = (Type == IceType_i32 ? 0xdb : 0xdf);
+    RegField = (Type == IceType_i64 ? 5 : 0);
+    break;
+  case Fistp:
+    Opcode = (Type == IceType_i32 ? 0xdb : 0xdf);
+    RegField = (Type == IceType_i64 ? 7 : 3);
+    break;
+  case Fldcw:
+    Opcode = 0xd9;
+    RegField = 5;
+    break;
+  case Fnstcw:
+    Opcode = 0xd9;
+    RegField = 7;
+    break;
+  case Fstp:
+    Opcode = (Type == IceType_f64 ? 0xdd : 0xd9);
+    RegField = 3;
+    break;
+  }
+  Asm->emitByte(Opcode);
+  Asm->emitOperand(RegField, getSrc(0));
+}
+
+void IceInstX8632Fstp::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 0);
+  if (getDest() == NULL) {
+    // fstp st(0)
+    Asm->emitByte(0xdd);
+    Asm->emitByte(0xd8);
+    return;
+  }
+  bool isDouble = (getDest()->getType() == IceType_f64);
+  uint8_t Opcode = (isDouble ? 0xdd : 0xd9);
+  if (getDest()->getRegNum() < 0) {
+    Asm->emitByte(Opcode);
+    Asm->emitOperand(3, getDest());
+    return;
+  }
+  // Go through a temporary stack slot, as in emit().
+  int32_t Width = (isDouble ? 8 : 4);
+  Asm->emitAdjustEsp(-Width);
+  Asm->emitByte(Opcode);
+  Asm->emitStackTopOperand(3);
+  Asm->emitByte(isDouble ? 0xf2 : 0xf3);
+  Asm->emitByte(0x0f);
+  Asm->emitByte(0x10);
+  Asm->emitStackTopOperand(Asm->getRegEncoding(getDest()));
+  Asm->emitAdjustEsp(Width);
+}
+
+void IceInstX8632Pop::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 0);
+  if (getDest()->getRegNum() >= 0) {
+    Asm->emitByte(0x58 + Asm->getRegEncoding(getDest()));
+  } else {
+    Asm->emitByte(0x8f);
+    Asm->emitOperand(0, getDest());
+  }
+}
+
+void IceInstX8632Push::encode(IceAssemblerX8632 *Asm) const {
+  assert(getSrcSize() == 1);
+  IceTargetLowering *Target = Asm->getCfg()->getTarget();
+  const IceOperand *Src = getSrc(0);
+  IceType Type = Src->getType();
+  const IceVariable *Var = llvm::dyn_cast<IceVariable>(Src);
+  if ((Type == IceType_f32 || Type == IceType_f64) && Var &&
+      Var->getRegNum() >= 0) {
+    Asm->emitAdjustEsp(-static_cast<int32_t>(iceTypeWidth(Type)));
+    Target->updateStackAdjustment(iceTypeWidth(Type));
+    Asm->emitByte(Type == IceType_f32 ? 0xf3 : 0xf2);
+    Asm->emitByte(0x0f);
+    Asm->emitByte(0x11);
+    Asm->emitStackTopOperand(Asm->getRegEncoding(Var));
+    return;
+  }
+  if (Type == IceType_f64) {
+    Asm->setError("Missing support for pushing doubles from memory");
+    return;
+  }
+  if (llvm::isa<IceConstant>(Src)) {
+    const IceConstantInteger *Imm = llvm::dyn_cast<IceConstantInteger>(Src);
+    int32_t Value = (Imm ? static_cast<int32_t>(Imm->getIntValue()) : 0);
+    bool IsImm8 = (Imm && Value >= -128 && Value <= 127);
+    Asm->emitByte(IsImm8 ? 0x6a : 0x68);
+    Asm->emitImmediate(IsImm8 ? IceType_i8 : IceType_i32, Src);
+  } else if (Var && Var->getRegNum() >= 0) {
+    Asm->emitByte(0x50 + Asm->getRegEncoding(Var));
+  } else {
+    Asm->emitByte(0xff);
+    Asm->emitOperand(6, Src);
+  }
+  if (!SuppressStackAdjustment)
+    Target->updateStackAdjustment(4);
+}
+
+void IceInstX8632Ret::encode(IceAssemblerX8632 *Asm) const {
+  Asm->emitByte(0xc3);
+}
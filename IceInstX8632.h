@@ -11,6 +11,7 @@
 #include "IceInst.h"
 #include "IceOperand.h"
 
+class IceAssemblerX8632;
 class IceTargetX8632;
 
 class IceOperandX8632 : public IceOperand {
@@ -37,6 +38,7 @@ public:
   IceVariable *getIndex(void) const { return Index; }
   unsigned getShift(void) const { return Shift; }
   virtual void setUse(const IceInst *Inst, const IceCfgNode *Node);
+  virtual IceOperand *replaceVars(IceCfg *Cfg, const IceVarList &Replacements);
   virtual void emit(IceOstream &Str, uint32_t Option) const;
   virtual void dump(IceOstream &Str) const;
 
@@ -64,27 +66,39 @@ public:
     Br,
     Call,
     Cdq,
+    Cmov,
     Cvt,
     Div,
     Divss,
     Fld,
+    Fpu,
     Fstp,
     Icmp,
     Idiv,
     Imul,
+    JumpTable,
     Label,
+    Lea,
     Load,
     Mov,
+    Movd,
     Movsx,
     Movzx,
     Mul,
     Mulss,
+    Neg,
     Or,
+    Pand,
+    Pandn,
     Pop,
+    Por,
+    Pshufd,
     Push,
     Ret,
+    Rmw,
     Sar,
     Sbb,
+    Setcc,
     Shl,
     Shld,
     Shr,
@@ -92,11 +106,14 @@ public:
     Store,
     Sub,
     Subss,
+    TailCall,
     Test,
     Ucomiss,
     Xor
   };
   virtual void emit(IceOstream &Str, uint32_t Option) const = 0;
+  virtual void emitIAS(IceAssembler *Asm) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const = 0;
   virtual void dump(IceOstream &Str) const;
 
 protected:
@@ -151,7 +168,9 @@ public:
   }
   IceString getName(IceCfg *Cfg) const;
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) { return isClassof(Inst, Label); }
 
 private:
   IceInstX8632Label(IceCfg *Cfg, IceTargetX8632 *Target);
@@ -192,7 +211,10 @@ public:
   }
   IceCfgNode *getTargetTrue(void) const { return TargetTrue; }
   IceCfgNode *getTargetFalse(void) const { return TargetFalse; }
+  IceInstX8632Label *getLabel(void) const { return Label; }
+  void optimizeBranch(const IceCfgNode *NextNode);
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Br); }
 
@@ -205,6 +227,33 @@ private:
   IceInstX8632Label *Label; // Intra-block branch target
 };
 
+// IceInstX8632JumpTable is an indirect jump through a table of basic
+// block addresses, indexed by a register that has already been
+// bounds-checked.  The table itself is emitted into the read-only data
+// section along with the jump.
+class IceInstX8632JumpTable : public IceInstX8632 {
+public:
+  static IceInstX8632JumpTable *create(IceCfg *Cfg, IceTargetX8632 *Target,
+                                       IceVariable *Index,
+                                       const IceNodeList &Targets) {
+    return new IceInstX8632JumpTable(Cfg, Target, Index, Targets);
+  }
+  IceString getName(IceCfg *Cfg) const;
+  const IceNodeList &getTargets(void) const { return Targets; }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) {
+    return isClassof(Inst, JumpTable);
+  }
+
+private:
+  IceInstX8632JumpTable(IceCfg *Cfg, IceTargetX8632 *Target,
+                        IceVariable *Index, const IceNodeList &Targets);
+  uint32_t Number; // used only for unique label string generation
+  const IceNodeList Targets;
+};
+
 class IceInstX8632Call : public IceInstX8632 {
 public:
   static IceInstX8632Call *create(IceCfg *Cfg, IceVariable *Dest,
@@ -213,6 +262,7 @@ public:
   }
   IceOperand *getCallTarget(void) const { return getSrc(0); }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Call); }
 
@@ -222,6 +272,31 @@ private:
   const bool Tail;
 };
 
+// IceInstX8632TailCall jumps to CallTarget in place of a call
+// followed by a return.  The epilog, which is inserted before it,
+// first copies the ArgsSize bytes of outgoing arguments into the
+// incoming-argument slots.
+class IceInstX8632TailCall : public IceInstX8632 {
+public:
+  static IceInstX8632TailCall *create(IceCfg *Cfg, IceOperand *CallTarget,
+                                      uint32_t ArgsSize) {
+    return new IceInstX8632TailCall(Cfg, CallTarget, ArgsSize);
+  }
+  IceOperand *getCallTarget(void) const { return getSrc(0); }
+  uint32_t getArgsSize(void) const { return ArgsSize; }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) {
+    return isClassof(Inst, TailCall);
+  }
+
+private:
+  IceInstX8632TailCall(IceCfg *Cfg, IceOperand *CallTarget,
+                       uint32_t ArgsSize);
+  const uint32_t ArgsSize;
+};
+
 class IceInstX8632Add : public IceInstX8632 {
 public:
   static IceInstX8632Add *create(IceCfg *Cfg, IceVariable *Dest,
@@ -229,6 +304,7 @@ public:
     return new IceInstX8632Add(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Add); }
 
@@ -243,6 +319,7 @@ public:
     return new IceInstX8632Adc(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Adc); }
 
@@ -257,6 +334,7 @@ public:
     return new IceInstX8632Addss(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Addss); }
 
@@ -271,6 +349,7 @@ public:
     return new IceInstX8632Sub(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Sub); }
 
@@ -285,6 +364,7 @@ public:
     return new IceInstX8632Sbb(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Sbb); }
 
@@ -299,6 +379,7 @@ public:
     return new IceInstX8632Subss(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Subss); }
 
@@ -313,6 +394,7 @@ public:
     return new IceInstX8632And(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, And); }
 
@@ -327,6 +409,7 @@ public:
     return new IceInstX8632Or(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Or); }
 
@@ -341,6 +424,7 @@ public:
     return new IceInstX8632Xor(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Xor); }
 
@@ -355,6 +439,7 @@ public:
     return new IceInstX8632Imul(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Imul); }
 
@@ -362,19 +447,38 @@ private:
   IceInstX8632Imul(IceCfg *Cfg, IceVariable *Dest, IceOperand *Source);
 };
 
+class IceInstX8632Neg : public IceInstX8632 {
+public:
+  static IceInstX8632Neg *create(IceCfg *Cfg, IceVariable *Dest) {
+    return new IceInstX8632Neg(Cfg, Dest);
+  }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) { return isClassof(Inst, Neg); }
+
+private:
+  IceInstX8632Neg(IceCfg *Cfg, IceVariable *Dest);
+};
+
+// IceInstX8632Mul is the one-operand widening multiply, edx:eax =
+// eax * Source2, either unsigned (mul) or signed (imul).
 class IceInstX8632Mul : public IceInstX8632 {
 public:
   static IceInstX8632Mul *create(IceCfg *Cfg, IceVariable *Dest,
-                                 IceVariable *Source1, IceOperand *Source2) {
-    return new IceInstX8632Mul(Cfg, Dest, Source1, Source2);
+                                 IceVariable *Source1, IceOperand *Source2,
+                                 bool Signed = false) {
+    return new IceInstX8632Mul(Cfg, Dest, Source1, Source2, Signed);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Mul); }
 
 private:
   IceInstX8632Mul(IceCfg *Cfg, IceVariable *Dest, IceVariable *Source1,
-                  IceOperand *Source2);
+                  IceOperand *Source2, bool Signed);
+  const bool Signed;
 };
 
 class IceInstX8632Mulss : public IceInstX8632 {
@@ -384,6 +488,7 @@ public:
     return new IceInstX8632Mulss(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Mulss); }
 
@@ -398,6 +503,7 @@ public:
     return new IceInstX8632Idiv(Cfg, Dest, Source, Other);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Idiv); }
 
@@ -413,6 +519,7 @@ public:
     return new IceInstX8632Div(Cfg, Dest, Source, Other);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Div); }
 
@@ -428,6 +535,7 @@ public:
     return new IceInstX8632Divss(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Divss); }
 
@@ -442,6 +550,7 @@ public:
     return new IceInstX8632Shl(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Shl); }
 
@@ -452,16 +561,17 @@ private:
 class IceInstX8632Shld : public IceInstX8632 {
 public:
   static IceInstX8632Shld *create(IceCfg *Cfg, IceVariable *Dest,
-                                  IceVariable *Source1, IceVariable *Source2) {
+                                  IceVariable *Source1, IceOperand *Source2) {
     return new IceInstX8632Shld(Cfg, Dest, Source1, Source2);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Shld); }
 
 private:
   IceInstX8632Shld(IceCfg *Cfg, IceVariable *Dest, IceVariable *Source1,
-                   IceVariable *Source2);
+                   IceOperand *Source2);
 };
 
 class IceInstX8632Shr : public IceInstX8632 {
@@ -471,6 +581,7 @@ public:
     return new IceInstX8632Shr(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Shr); }
 
@@ -481,16 +592,17 @@ private:
 class IceInstX8632Shrd : public IceInstX8632 {
 public:
   static IceInstX8632Shrd *create(IceCfg *Cfg, IceVariable *Dest,
-                                  IceVariable *Source1, IceVariable *Source2) {
+                                  IceVariable *Source1, IceOperand *Source2) {
     return new IceInstX8632Shrd(Cfg, Dest, Source1, Source2);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Shrd); }
 
 private:
   IceInstX8632Shrd(IceCfg *Cfg, IceVariable *Dest, IceVariable *Source1,
-                   IceVariable *Source2);
+                   IceOperand *Source2);
 };
 
 class IceInstX8632Sar : public IceInstX8632 {
@@ -500,6 +612,7 @@ public:
     return new IceInstX8632Sar(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Sar); }
 
@@ -515,6 +628,7 @@ public:
     return new IceInstX8632Cdq(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Cdq); }
 
@@ -533,6 +647,7 @@ public:
     return new IceInstX8632Cvt(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Cvt); }
 
@@ -547,6 +662,7 @@ public:
     return new IceInstX8632Icmp(Cfg, Src1, Src2);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Icmp); }
 
@@ -561,6 +677,7 @@ public:
     return new IceInstX8632Ucomiss(Cfg, Src1, Src2);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Ucomiss); }
 
@@ -568,6 +685,49 @@ private:
   IceInstX8632Ucomiss(IceCfg *Cfg, IceOperand *Src1, IceOperand *Src2);
 };
 
+// IceInstX8632Setcc sets the low byte of Dest to 1 if Condition holds
+// and to 0 otherwise.  The rest of Dest is unchanged, so Dest is also
+// a source, and the caller is responsible for zeroing it beforehand.
+// A register Dest must have a byte form, which the i1 register class
+// ensures.
+class IceInstX8632Setcc : public IceInstX8632 {
+public:
+  static IceInstX8632Setcc *create(IceCfg *Cfg, IceVariable *Dest,
+                                   IceInstX8632Br::BrCond Condition) {
+    return new IceInstX8632Setcc(Cfg, Dest, Condition);
+  }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) { return isClassof(Inst, Setcc); }
+
+private:
+  IceInstX8632Setcc(IceCfg *Cfg, IceVariable *Dest,
+                    IceInstX8632Br::BrCond Condition);
+  const IceInstX8632Br::BrCond Condition;
+};
+
+// IceInstX8632Cmov copies Source into Dest if Condition holds, and
+// otherwise leaves Dest unchanged.  Dest must be a register, and
+// Source can't be an immediate.
+class IceInstX8632Cmov : public IceInstX8632 {
+public:
+  static IceInstX8632Cmov *create(IceCfg *Cfg, IceVariable *Dest,
+                                  IceOperand *Source,
+                                  IceInstX8632Br::BrCond Condition) {
+    return new IceInstX8632Cmov(Cfg, Dest, Source, Condition);
+  }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) { return isClassof(Inst, Cmov); }
+
+private:
+  IceInstX8632Cmov(IceCfg *Cfg, IceVariable *Dest, IceOperand *Source,
+                   IceInstX8632Br::BrCond Condition);
+  const IceInstX8632Br::BrCond Condition;
+};
+
 class IceInstX8632Test : public IceInstX8632 {
 public:
   static IceInstX8632Test *create(IceCfg *Cfg, IceOperand *Source1,
@@ -575,6 +735,7 @@ public:
     return new IceInstX8632Test(Cfg, Source1, Source2);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Test); }
 
@@ -592,6 +753,7 @@ public:
     return new IceInstX8632Store(Cfg, Value, Mem);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Store); }
 
@@ -599,6 +761,26 @@ private:
   IceInstX8632Store(IceCfg *Cfg, IceOperand *Value, IceOperandX8632Mem *Mem);
 };
 
+// IceInstX8632Rmw is the memory-destination form of an integer
+// arithmetic instruction, e.g. "add dword ptr [eax], 1".
+class IceInstX8632Rmw : public IceInstX8632 {
+public:
+  static IceInstX8632Rmw *create(IceCfg *Cfg, IceInstArithmetic::OpKind Op,
+                                 IceOperandX8632Mem *Mem,
+                                 IceOperand *Source) {
+    return new IceInstX8632Rmw(Cfg, Op, Mem, Source);
+  }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) { return isClassof(Inst, Rmw); }
+
+private:
+  IceInstX8632Rmw(IceCfg *Cfg, IceInstArithmetic::OpKind Op,
+                  IceOperandX8632Mem *Mem, IceOperand *Source);
+  const IceInstArithmetic::OpKind Op;
+};
+
 class IceInstX8632Mov : public IceInstX8632 {
 public:
   static IceInstX8632Mov *create(IceCfg *Cfg, IceVariable *Dest,
@@ -607,6 +789,7 @@ public:
   }
   virtual bool isRedundantAssign(void) const;
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Mov); }
 
@@ -621,6 +804,7 @@ public:
     return new IceInstX8632Movsx(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Movsx); }
 
@@ -628,6 +812,23 @@ private:
   IceInstX8632Movsx(IceCfg *Cfg, IceVariable *Dest, IceOperand *Source);
 };
 
+// IceInstX8632Lea computes the address of a memory operand into Dest,
+// without accessing memory.  It is used for small multiplications.
+class IceInstX8632Lea : public IceInstX8632 {
+public:
+  static IceInstX8632Lea *create(IceCfg *Cfg, IceVariable *Dest,
+                                 IceOperandX8632Mem *Source) {
+    return new IceInstX8632Lea(Cfg, Dest, Source);
+  }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) { return isClassof(Inst, Lea); }
+
+private:
+  IceInstX8632Lea(IceCfg *Cfg, IceVariable *Dest, IceOperandX8632Mem *Source);
+};
+
 class IceInstX8632Movzx : public IceInstX8632 {
 public:
   static IceInstX8632Movzx *create(IceCfg *Cfg, IceVariable *Dest,
@@ -635,6 +836,7 @@ public:
     return new IceInstX8632Movzx(Cfg, Dest, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Movzx); }
 
@@ -642,12 +844,94 @@ private:
   IceInstX8632Movzx(IceCfg *Cfg, IceVariable *Dest, IceOperand *Source);
 };
 
+// IceInstX8632Movd moves a 32-bit general register into the low
+// element of an xmm register, zeroing the rest.
+class IceInstX8632Movd : public IceInstX8632 {
+public:
+  static IceInstX8632Movd *create(IceCfg *Cfg, IceVariable *Dest,
+                                  IceVariable *Source) {
+    return new IceInstX8632Movd(Cfg, Dest, Source);
+  }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) { return isClassof(Inst, Movd); }
+
+private:
+  IceInstX8632Movd(IceCfg *Cfg, IceVariable *Dest, IceVariable *Source);
+};
+
+class IceInstX8632Pshufd : public IceInstX8632 {
+public:
+  static IceInstX8632Pshufd *create(IceCfg *Cfg, IceVariable *Dest,
+                                    IceVariable *Source, IceConstant *Order) {
+    return new IceInstX8632Pshufd(Cfg, Dest, Source, Order);
+  }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) { return isClassof(Inst, Pshufd); }
+
+private:
+  IceInstX8632Pshufd(IceCfg *Cfg, IceVariable *Dest, IceVariable *Source,
+                     IceConstant *Order);
+};
+
+// The bitwise xmm operations work on the whole register regardless
+// of the f32 or f64 type of their operands.
+class IceInstX8632Pand : public IceInstX8632 {
+public:
+  static IceInstX8632Pand *create(IceCfg *Cfg, IceVariable *Dest,
+                                  IceVariable *Source) {
+    return new IceInstX8632Pand(Cfg, Dest, Source);
+  }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) { return isClassof(Inst, Pand); }
+
+private:
+  IceInstX8632Pand(IceCfg *Cfg, IceVariable *Dest, IceVariable *Source);
+};
+
+// Dest = ~Dest & Source
+class IceInstX8632Pandn : public IceInstX8632 {
+public:
+  static IceInstX8632Pandn *create(IceCfg *Cfg, IceVariable *Dest,
+                                   IceVariable *Source) {
+    return new IceInstX8632Pandn(Cfg, Dest, Source);
+  }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) { return isClassof(Inst, Pandn); }
+
+private:
+  IceInstX8632Pandn(IceCfg *Cfg, IceVariable *Dest, IceVariable *Source);
+};
+
+class IceInstX8632Por : public IceInstX8632 {
+public:
+  static IceInstX8632Por *create(IceCfg *Cfg, IceVariable *Dest,
+                                 IceVariable *Source) {
+    return new IceInstX8632Por(Cfg, Dest, Source);
+  }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) { return isClassof(Inst, Por); }
+
+private:
+  IceInstX8632Por(IceCfg *Cfg, IceVariable *Dest, IceVariable *Source);
+};
+
 class IceInstX8632Fld : public IceInstX8632 {
 public:
   static IceInstX8632Fld *create(IceCfg *Cfg, IceOperand *Src) {
     return new IceInstX8632Fld(Cfg, Src);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Fld); }
 
@@ -655,12 +939,40 @@ private:
   IceInstX8632Fld(IceCfg *Cfg, IceOperand *Src);
 };
 
+// IceInstX8632Fpu is an x87 instruction whose only operand is in
+// memory, e.g. "fild qword ptr [esp]".  The operand size comes from
+// the type of Mem.
+class IceInstX8632Fpu : public IceInstX8632 {
+public:
+  enum FpuOp {
+    Fadd,
+    Fild,
+    Fistp,
+    Fldcw,
+    Fnstcw,
+    Fstp
+  };
+  static IceInstX8632Fpu *create(IceCfg *Cfg, FpuOp Op,
+                                 IceOperandX8632Mem *Mem) {
+    return new IceInstX8632Fpu(Cfg, Op, Mem);
+  }
+  virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
+  virtual void dump(IceOstream &Str) const;
+  static bool classof(const IceInst *Inst) { return isClassof(Inst, Fpu); }
+
+private:
+  IceInstX8632Fpu(IceCfg *Cfg, FpuOp Op, IceOperandX8632Mem *Mem);
+  const FpuOp Op;
+};
+
 class IceInstX8632Fstp : public IceInstX8632 {
 public:
   static IceInstX8632Fstp *create(IceCfg *Cfg, IceVariable *Dest) {
     return new IceInstX8632Fstp(Cfg, Dest);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Fstp); }
 
@@ -674,6 +986,7 @@ public:
     return new IceInstX8632Pop(Cfg, Dest);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Pop); }
 
@@ -683,15 +996,22 @@ private:
 
 class IceInstX8632Push : public IceInstX8632 {
 public:
-  static IceInstX8632Push *create(IceCfg *Cfg, IceOperand *Source) {
-    return new IceInstX8632Push(Cfg, Source);
+  // SuppressStackAdjustment is for pushes that the frame layout
+  // already accounts for, i.e. the prolog's pushes of preserved
+  // registers, as opposed to pushes of outgoing call arguments.
+  static IceInstX8632Push *create(IceCfg *Cfg, IceOperand *Source,
+                                  bool SuppressStackAdjustment = false) {
+    return new IceInstX8632Push(Cfg, Source, SuppressStackAdjustment);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Push); }
 
 private:
-  IceInstX8632Push(IceCfg *Cfg, IceOperand *Source);
+  IceInstX8632Push(IceCfg *Cfg, IceOperand *Source,
+                   bool SuppressStackAdjustment);
+  const bool SuppressStackAdjustment;
 };
 
 class IceInstX8632Ret : public IceInstX8632 {
@@ -700,6 +1020,7 @@ public:
     return new IceInstX8632Ret(Cfg, Source);
   }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  virtual void encode(IceAssemblerX8632 *Asm) const;
   virtual void dump(IceOstream &Str) const;
   static bool classof(const IceInst *Inst) { return isClassof(Inst, Ret); }
 
@@ -0,0 +1,246 @@
+/* Copyright 2014 The Native Client Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can
+ * be found in the LICENSE file.
+ */
+
+#include <dlfcn.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "IceJIT.h"
+
+#if defined(__i386__)
+// The runtime helpers that the x86-32 lowering calls.  The i64
+// division routines come from libgcc.
+extern "C" {
+int64_t __divdi3(int64_t, int64_t);
+uint64_t __udivdi3(uint64_t, uint64_t);
+int64_t __moddi3(int64_t, int64_t);
+uint64_t __umoddi3(uint64_t, uint64_t);
+}
+
+static int64_t cvtftosi64(float Value) { return Value; }
+static int64_t cvtdtosi64(double Value) { return Value; }
+static uint64_t cvtftoui64(float Value) { return Value; }
+static uint64_t cvtdtoui64(double Value) { return Value; }
+static float cvtsi64tof(int64_t Value) { return Value; }
+static double cvtsi64tod(int64_t Value) { return Value; }
+static float cvtui64tof(uint64_t Value) { return Value; }
+static double cvtui64tod(uint64_t Value) { return Value; }
+#endif // __i386__
+
+static uint32_t alignTo(uint32_t Value, uint32_t Align) {
+  return (Value + Align - 1) / Align * Align;
+}
+
+IceJIT::IceJIT(void) : Memory(NULL), MemorySize(0) { addRuntimeHelpers(); }
+
+IceJIT::~IceJIT(void) {
+  if (Memory)
+    munmap(Memory, MemorySize);
+}
+
+void IceJIT::addRuntimeHelpers(void) {
+#if defined(__i386__)
+  addSymbol("__divdi3", reinterpret_cast<const void *>(__divdi3));
+  addSymbol("__udivdi3", reinterpret_cast<const void *>(__udivdi3));
+  addSymbol("__moddi3", reinterpret_cast<const void *>(__moddi3));
+  addSymbol("__umoddi3", reinterpret_cast<const void *>(__umoddi3));
+  float (*Fmodf)(float, float) = fmodf;
+  double (*Fmod)(double, double) = fmod;
+  addSymbol("fmodf", reinterpret_cast<const void *>(Fmodf));
+  addSymbol("fmod", reinterpret_cast<const void *>(Fmod));
+  addSymbol("cvtftosi64", reinterpret_cast<const void *>(cvtftosi64));
+  addSymbol("cvtdtosi64", reinterpret_cast<const void *>(cvtdtosi64));
+  addSymbol("cvtftoui64", reinterpret_cast<const void *>(cvtftoui64));
+  addSymbol("cvtdtoui64", reinterpret_cast<const void *>(cvtdtoui64));
+  addSymbol("cvtsi64tof", reinterpret_cast<const void *>(cvtsi64tof));
+  addSymbol("cvtsi64tod", reinterpret_cast<const void *>(cvtsi64tod));
+  addSymbol("cvtui64tof", reinterpret_cast<const void *>(cvtui64tof));
+  addSymbol("cvtui64tod", reinterpret_cast<const void *>(cvtui64tod));
+#endif // __i386__
+}
+
+void IceJIT::addFunction(const IceString &Name, const IceAssembler *Asm) {
+  assert(Memory == NULL);
+  Function Func;
+  Func.Name = Name;
+  Func.Text = Asm->getText();
+  Func.RoData = Asm->getRoData();
+  Func.TextOffset = 0;
+  Func.RoDataOffset = 0;
+  FunctionIndex[Name] = Functions.size();
+  Functions.push_back(Func);
+}
+
+void IceJIT::declareSymbol(const IceString &Name, uint32_t Size) {
+  SymbolSizes[Name] = Size;
+}
+
+void IceJIT::addSymbol(const IceString &Name, const void *Address) {
+  Symbols[Name] = Address;
+}
+
+bool IceJIT::lookup(const IceString &Symbol, uint64_t &Address) const {
+  std::map<IceString, uint32_t>::const_iterator Func =
+      FunctionIndex.find(Symbol);
+  if (Func != FunctionIndex.end()) {
+    Address = reinterpret_cast<uintptr_t>(Memory) +
+              Functions[Func->second].TextOffset;
+    return true;
+  }
+  std::map<IceString, uint32_t>::const_iterator Common = Commons.find(Symbol);
+  if (Common != Commons.end()) {
+    Address = reinterpret_cast<uintptr_t>(Memory) + Common->second;
+    return true;
+  }
+  std::map<IceString, const void *>::const_iterator Known =
+      Symbols.find(Symbol);
+  if (Known != Symbols.end()) {
+    Address = reinterpret_cast<uintptr_t>(Known->second);
+    return true;
+  }
+  if (void *Exported = dlsym(RTLD_DEFAULT, Symbol.c_str())) {
+    Address = reinterpret_cast<uintptr_t>(Exported);
+    return true;
+  }
+  return false;
+}
+
+void IceJIT::applyFixups(const IceAsmSection &Section, uint8_t *Base,
+                         const std::map<IceString, uint64_t> &Labels) {
+  const IceFixupList &Fixups = Section.getFixups();
+  for (IceFixupList::const_iterator I = Fixups.begin(), E = Fixups.end();
+       I != E; ++I) {
+    const IceString &Symbol = I->getSymbol();
+    uint64_t Target;
+    std::map<IceString, uint64_t>::const_iterator Label = Labels.find(Symbol);
+    if (Label != Labels.end()) {
+      Target = Label->second;
+    } else if (!lookup(Symbol, Target)) {
+      Error = "Undefined symbol " + Symbol;
+      return;
+    }
+    uint8_t *Field = Base + I->getOffset();
+    uint64_t FieldAddress = reinterpret_cast<uintptr_t>(Field);
+    if (Target > 0xffffffffu || FieldAddress > 0xffffffffu) {
+      Error = "Symbol " + Symbol + " is out of range of x86-32 code";
+      return;
+    }
+    uint32_t Value = Target + I->getAddend();
+    if (I->getKind() == IceFixup::Fixup_PCRel32)
+      Value -= FieldAddress;
+    for (uint32_t i = 0; i < 4; ++i)
+      Field[i] = (Value >> (8 * i)) & 0xff;
+  }
+}
+
+bool IceJIT::finalize(void) {
+  assert(Memory == NULL);
+  // Lay out .text, then .rodata, then the storage for unresolved
+  // global variables, each starting on a new page so that it can be
+  // protected separately.
+  const uint32_t PageSize = sysconf(_SC_PAGESIZE);
+  uint32_t Size = 0;
+  for (std::vector<Function>::iterator I = Functions.begin(),
+                                       E = Functions.end();
+       I != E; ++I) {
+    Size = alignTo(Size, 1u << I->Text.getAlignment());
+    I->TextOffset = Size;
+    Size += I->Text.getSize();
+  }
+  const uint32_t RoDataStart = alignTo(Size, PageSize);
+  Size = RoDataStart;
+  for (std::vector<Function>::iterator I = Functions.begin(),
+                                       E = Functions.end();
+       I != E; ++I) {
+    Size = alignTo(Size, 1u << I->RoData.getAlignment());
+    I->RoDataOffset = Size;
+    Size += I->RoData.getSize();
+  }
+  const uint32_t DataStart = alignTo(Size, PageSize);
+  Size = DataStart;
+  for (std::vector<Function>::const_iterator I = Functions.begin(),
+                                             E = Functions.end();
+       I != E; ++I) {
+    std::set<IceString> Labels;
+    const IceAsmLabelList &RoDataLabels = I->RoData.getLabels();
+    for (IceAsmLabelList::const_iterator L = RoDataLabels.begin(),
+                                         LE = RoDataLabels.end();
+         L != LE; ++L) {
+      Labels.insert(L->first);
+    }
+    const IceAsmSection *Sections[] = { &I->Text, &I->RoData };
+    for (uint32_t i = 0; i < 2; ++i) {
+      const IceFixupList &Fixups = Sections[i]->getFixups();
+      for (IceFixupList::const_iterator F = Fixups.begin(), FE = Fixups.end();
+           F != FE; ++F) {
+        const IceString &Symbol = F->getSymbol();
+        uint64_t Address;
+        if (F->getKind() != IceFixup::Fixup_Abs32 || Labels.count(Symbol) ||
+            lookup(Symbol, Address))
+          continue;
+        uint32_t SymbolSize = 4;
+        if (SymbolSizes.find(Symbol) != SymbolSizes.end())
+          SymbolSize = SymbolSizes[Symbol];
+        Size = alignTo(Size, SymbolSize);
+        Commons[Symbol] = Size;
+        Size += SymbolSize;
+      }
+    }
+  }
+  MemorySize = alignTo(Size, PageSize);
+  if (MemorySize == 0)
+    return true;
+
+  int Flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_32BIT)
+  // Keep the code within reach of its 32-bit fixups on a 64-bit host.
+  if (sizeof(void *) > 4)
+    Flags |= MAP_32BIT;
+#endif // MAP_32BIT
+  void *Map = mmap(NULL, MemorySize, PROT_READ | PROT_WRITE, Flags, -1, 0);
+  if (Map == MAP_FAILED) {
+    Error = "Cannot map memory for the JIT";
+    return false;
+  }
+  Memory = static_cast<uint8_t *>(Map);
+
+  for (std::vector<Function>::const_iterator I = Functions.begin(),
+                                             E = Functions.end();
+       I != E; ++I) {
+    uint8_t *Text = Memory + I->TextOffset;
+    uint8_t *RoData = Memory + I->RoDataOffset;
+    if (I->Text.getSize())
+      memcpy(Text, &I->Text.getBytes()[0], I->Text.getSize());
+    if (I->RoData.getSize())
+      memcpy(RoData, &I->RoData.getBytes()[0], I->RoData.getSize());
+    std::map<IceString, uint64_t> Labels;
+    const IceAsmLabelList &RoDataLabels = I->RoData.getLabels();
+    for (IceAsmLabelList::const_iterator L = RoDataLabels.begin(),
+                                         LE = RoDataLabels.end();
+         L != LE; ++L) {
+      Labels[L->first] = reinterpret_cast<uintptr_t>(RoData + L->second);
+    }
+    applyFixups(I->Text, Text, Labels);
+    applyFixups(I->RoData, RoData, Labels);
+    if (hasError())
+      return false;
+  }
+
+  if (mprotect(Memory, RoDataStart, PROT_READ | PROT_EXEC) ||
+      mprotect(Memory + RoDataStart, DataStart - RoDataStart, PROT_READ)) {
+    Error = "Cannot make the JIT code executable";
+    return false;
+  }
+  return true;
+}
+
+void *IceJIT::getFunctionAddress(const IceString &Name) const {
+  std::map<IceString, uint32_t>::const_iterator Func = FunctionIndex.find(Name);
+  if (Memory == NULL || Func == FunctionIndex.end())
+    return NULL;
+  return Memory + Functions[Func->second].TextOffset;
+}
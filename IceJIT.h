@@ -0,0 +1,76 @@
+// -*- Mode: c++ -*-
+/* Copyright 2014 The Native Client Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can
+ * be found in the LICENSE file.
+ */
+
+#ifndef _IceJIT_h
+#define _IceJIT_h
+
+#include "IceDefs.h"
+#include "IceAssembler.h"
+
+// IceJIT loads assembled functions into the running process, so that
+// they can be called without writing an object file.  Functions are
+// added one at a time, and finalize() then maps them into memory,
+// resolves their fixups and makes the code executable.
+//
+// A symbol is resolved, in order, to a function added to the JIT, a
+// symbol given to addSymbol(), one of the runtime helpers that the
+// lowering calls (e.g. __divdi3, fmod, cvtftosi64), or a symbol that
+// the process exports.  An unresolved symbol that is referenced by an
+// absolute fixup is a global variable, for which the JIT allocates
+// zeroed storage like a common symbol.  Any other unresolved symbol is
+// an error.
+//
+// The code is x86-32 code, so calling it requires an x86-32 host
+// process.  On other hosts, finalize() still maps and relocates the
+// code below 4GB when it can, which is enough to inspect the result.
+class IceJIT {
+public:
+  IceJIT(void);
+  ~IceJIT(void);
+  // Copies a function's .text and .rodata contents.
+  void addFunction(const IceString &Name, const IceAssembler *Asm);
+  // Records the size of a symbol referenced by a function, which is
+  // used if the JIT has to allocate its storage.
+  void declareSymbol(const IceString &Name, uint32_t Size);
+  // Resolves Name to Address, overriding the helpers and the process.
+  void addSymbol(const IceString &Name, const void *Address);
+  // Maps and relocates the functions, returning false on an error.
+  bool finalize(void);
+  // Returns the address of a function after finalize(), or NULL.
+  void *getFunctionAddress(const IceString &Name) const;
+  bool hasError(void) const { return !Error.empty(); }
+  const IceString &getError(void) const { return Error; }
+
+private:
+  struct Function {
+    IceString Name;
+    IceAsmSection Text;
+    IceAsmSection RoData;
+    uint32_t TextOffset;
+    uint32_t RoDataOffset;
+  };
+  void addRuntimeHelpers(void);
+  // Looks up a symbol other than a .rodata label, returning false if
+  // it is unresolved.
+  bool lookup(const IceString &Symbol, uint64_t &Address) const;
+  // Patches the fixups of Section, whose contents are at Base.  Labels
+  // maps the function's .rodata labels to their addresses.
+  void applyFixups(const IceAsmSection &Section, uint8_t *Base,
+                   const std::map<IceString, uint64_t> &Labels);
+
+  std::vector<Function> Functions;
+  std::map<IceString, const void *> Symbols;
+  std::map<IceString, uint32_t> SymbolSizes;
+  std::map<IceString, uint32_t> FunctionIndex;
+  // The offsets within Memory of the storage allocated for unresolved
+  // global variables.
+  std::map<IceString, uint32_t> Commons;
+  uint8_t *Memory;
+  uint32_t MemorySize;
+  IceString Error;
+};
+
+#endif // _IceJIT_h
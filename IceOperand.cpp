@@ -23,7 +23,7 @@ void IceVariable::setUse(const IceInst *Inst, const IceCfgNode *Node) {
 }
 
 void IceVariable::setDefinition(IceInst *Inst, const IceCfgNode *Node) {
-  if (DefOrUseNode == NULL)
+  if (DefOrUseNode == NULL || IsMultiDef)
     return;
   // Can first check preexisting DefInst if we care about multi-def vars.
   DefInst = Inst;
@@ -36,6 +36,20 @@ void IceVariable::replaceDefinition(IceInst *Inst, const IceCfgNode *Node) {
   setDefinition(Inst, Node);
 }
 
+// Unlike setDefinition(), this keeps tracking the definition after
+// the variable becomes multi-block, and gives up on a variable with
+// more than one definition, such as a lowered phi temporary.
+void IceVariable::addDefinition(IceInst *Inst) {
+  if (IsMultiDef || DefInst == Inst)
+    return;
+  if (DefInst) {
+    DefInst = NULL;
+    IsMultiDef = true;
+    return;
+  }
+  DefInst = Inst;
+}
+
 void IceVariable::setIsArg(IceCfg *Cfg) {
   IsArgument = true;
   if (DefOrUseNode == NULL)
@@ -143,6 +157,23 @@ bool IceLiveRange::containsValue(int Value) const {
   return false;
 }
 
+// Adds Other's segments and weight to this live range.  The two
+// ranges must not overlap.
+void IceLiveRange::merge(const IceLiveRange &Other) {
+  assert(!overlaps(Other));
+  RangeType Merged;
+  RangeType::const_iterator I1 = Range.begin(), I2 = Other.Range.begin();
+  RangeType::const_iterator E1 = Range.end(), E2 = Other.Range.end();
+  while (I1 != E1 || I2 != E2) {
+    if (I2 == E2 || (I1 != E1 && I1->first < I2->first))
+      Merged.insert(Merged.end(), *I1++);
+    else
+      Merged.insert(Merged.end(), *I2++);
+  }
+  Range.swap(Merged);
+  Weight.addWeight(Other.Weight);
+}
+
 // ======================== dump routines ======================== //
 
 IceOstream &operator<<(IceOstream &Str, const IceOperand *O) {
@@ -219,7 +250,14 @@ void IceConstantDouble::emit(IceOstream &Str, uint32_t Option) const {
 
 void IceConstantDouble::dump(IceOstream &Str) const { Str << DoubleValue; }
 
+// As an immediate operand, a symbol needs the "offset" prefix;
+// otherwise the assembler would read it as a memory reference.
 void IceConstantRelocatable::emit(IceOstream &Str, uint32_t Option) const {
+  Str << "offset ";
+  emitWithoutPrefix(Str);
+}
+
+void IceConstantRelocatable::emitWithoutPrefix(IceOstream &Str) const {
   Str << Name;
   if (Offset) {
     if (Offset > 0)
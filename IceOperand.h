@@ -44,6 +44,12 @@ public:
   }
   unsigned getNumVars(void) const { return NumVars; }
   virtual void setUse(const IceInst *Inst, const IceCfgNode *Node) {}
+  // Returns an operand with each variable V replaced by
+  // Replacements[V->getIndex()], or the operand itself if none of its
+  // variables are replaced.  A NULL entry means no replacement.
+  virtual IceOperand *replaceVars(IceCfg *Cfg, const IceVarList &Replacements) {
+    return this;
+  }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
   virtual void dump(IceOstream &Str) const;
 
@@ -137,7 +143,7 @@ public:
 
 private:
   IceConstantDouble(IceCfg *Cfg, double DoubleValue)
-      : IceConstant(Cfg, ConstantDouble, IceType_f32),
+      : IceConstant(Cfg, ConstantDouble, IceType_f64),
         DoubleValue(DoubleValue) {}
   const double DoubleValue;
 };
@@ -155,6 +161,8 @@ public:
   int64_t getOffset(void) const { return Offset; }
   IceString getName(void) const { return Name; }
   virtual void emit(IceOstream &Str, uint32_t Option) const;
+  // Emits the symbol as a displacement or call target.
+  void emitWithoutPrefix(IceOstream &Str) const;
   virtual void dump(IceOstream &Str) const;
 
   static bool classof(const IceOperand *Operand) {
@@ -205,6 +213,7 @@ class IceLiveRange {
 public:
   IceLiveRange(void) : Weight(0) {}
   int getStart(void) const { return Range.empty() ? -1 : Range.begin()->first; }
+  int getEnd(void) const { return Range.empty() ? -1 : Range.rbegin()->second; }
   void reset(void) {
     Range.clear();
     Weight.setWeight(0);
@@ -213,19 +222,24 @@ public:
   bool endsBefore(const IceLiveRange &Other) const;
   bool overlaps(const IceLiveRange &Other) const;
   bool containsValue(int Value) const;
+  void merge(const IceLiveRange &Other);
   bool isEmpty(void) const { return Range.empty(); }
   IceRegWeight getWeight(void) const { return Weight; }
   void setWeight(const IceRegWeight &NewWeight) { Weight = NewWeight; }
   void addWeight(uint32_t Delta) { Weight.addWeight(Delta); }
   void dump(IceOstream &Str) const;
 
-private:
+  // Each segment is a half-open interval [first, second) of
+  // instruction numbers, and segments are kept in increasing order.
   typedef std::pair<int, int> RangeElementType;
 #ifdef USE_SET
   typedef std::set<RangeElementType> RangeType;
 #else
   typedef std::list<RangeElementType> RangeType;
 #endif
+  const RangeType &getSegments(void) const { return Range; }
+
+private:
   RangeType Range;
   IceRegWeight Weight;
 };
@@ -240,10 +254,19 @@ public:
     return new IceVariable(Cfg, Type, Node, Index, Name);
   }
   void setUse(const IceInst *Inst, const IceCfgNode *Node);
+  virtual IceOperand *replaceVars(IceCfg *Cfg, const IceVarList &Replacements) {
+    IceVariable *Replacement = Replacements[Number];
+    return Replacement ? Replacement : this;
+  }
   uint32_t getIndex(void) const { return Number; }
   IceInst *getDefinition(void) const { return DefInst; }
   void setDefinition(IceInst *Inst, const IceCfgNode *Node);
   void replaceDefinition(IceInst *Inst, const IceCfgNode *Node);
+  void resetDefinition(void) {
+    DefInst = NULL;
+    IsMultiDef = false;
+  }
+  void addDefinition(IceInst *Inst);
   // TODO: consider initializing IsArgument in the ctor.
   bool getIsArg(void) const { return IsArgument; }
   void setIsArg(IceCfg *Cfg);
@@ -304,9 +327,10 @@ private:
   IceVariable(IceCfg *Cfg, IceType Type, const IceCfgNode *Node, uint32_t Index,
               const IceString &Name)
       : IceOperand(Cfg, Variable, Type), Number(Index), Name(Name),
-        DefInst(NULL), DefOrUseNode(Node), IsArgument(false), StackOffset(0),
-        RegNum(-1), RegNumTmp(-1), Weight(1), RegisterPreference(NULL),
-        AllowRegisterOverlap(false), LowVar(NULL), HighVar(NULL) {
+        DefInst(NULL), IsMultiDef(false), DefOrUseNode(Node),
+        IsArgument(false), StackOffset(0), RegNum(-1), RegNumTmp(-1),
+        Weight(1), RegisterPreference(NULL), AllowRegisterOverlap(false),
+        LowVar(NULL), HighVar(NULL) {
     Vars = new IceVariable *[1];
     Vars[0] = this;
     NumVars = 1;
@@ -318,6 +342,7 @@ private:
   // here so that they can all be deleted when this variable's use
   // count reaches zero.
   IceInst *DefInst;
+  bool IsMultiDef; // more than one definition; DefInst is NULL
   const IceCfgNode *DefOrUseNode; // for detecting isMultiblockLife()
   bool IsArgument;
   int
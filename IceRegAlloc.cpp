@@ -4,68 +4,309 @@
  */
 
 #include "IceCfg.h"
+#include "IceCfgNode.h"
 #include "IceInst.h"
 #include "IceOperand.h"
 #include "IceRegAlloc.h"
 #include "IceTargetLowering.h"
 
+#include <algorithm>
+
+void IceRegSegmentIndex::add(int RegNum, const IceLiveRange &Range) {
+  assert(RegNum >= 0);
+  if (Segments.size() <= (unsigned)RegNum)
+    Segments.resize(RegNum + 1);
+  const IceLiveRange::RangeType &RangeSegments = Range.getSegments();
+  Segments[RegNum].insert(Segments[RegNum].end(), RangeSegments.begin(),
+                          RangeSegments.end());
+}
+
+// Merges overlapping or abutting segments of a list sorted by start
+// point in place, so that the list is sorted by both start and end
+// point.  The segments before Begin must already be merged.
+static void
+coalesceSegments(std::vector<IceLiveRange::RangeElementType> &List,
+                 unsigned Begin) {
+  if (List.empty())
+    return;
+  unsigned Last = Begin > 0 ? Begin - 1 : 0;
+  for (unsigned i = Last + 1; i < List.size(); ++i) {
+    if (List[i].first <= List[Last].second) {
+      List[Last].second = std::max(List[Last].second, List[i].second);
+    } else {
+      List[++Last] = List[i];
+    }
+  }
+  List.resize(Last + 1);
+}
+
+void IceRegSegmentIndex::finalize(void) {
+  for (std::vector<SegmentList>::iterator I = Segments.begin(),
+                                          E = Segments.end();
+       I != E; ++I) {
+    SegmentList &List = *I;
+    std::sort(List.begin(), List.end());
+    coalesceSegments(List, 0);
+  }
+}
+
+void IceRegSegmentIndex::insert(int RegNum, const IceLiveRange &Range) {
+  assert(RegNum >= 0);
+  if (Segments.size() <= (unsigned)RegNum)
+    Segments.resize(RegNum + 1);
+  const IceLiveRange::RangeType &RangeSegments = Range.getSegments();
+  if (RangeSegments.empty())
+    return;
+  SegmentList &List = Segments[RegNum];
+  unsigned OldSize = List.size();
+  List.insert(List.end(), RangeSegments.begin(), RangeSegments.end());
+  // Both parts are sorted, and the existing segments that start
+  // before Range don't move, so only the tail from there on needs to
+  // be merged and coalesced.  Spill slots are filled in order of
+  // start point, so usually that tail is just Range itself.
+  SegmentList::iterator Middle = List.begin() + OldSize;
+  SegmentList::iterator First =
+      std::upper_bound(List.begin(), Middle, *Middle);
+  if (First != Middle) {
+    if (List.end() - Middle == 1)
+      std::rotate(First, Middle, List.end());
+    else
+      std::inplace_merge(First, Middle, List.end());
+  }
+  coalesceSegments(List, First - List.begin());
+}
+
+// Compares a segment's end point against an instruction number, for
+// finding the first segment that ends after a given point.
+static bool segmentEndsBefore(const IceLiveRange::RangeElementType &Segment,
+                              int Value) {
+  return Segment.second <= Value;
+}
+
+bool IceRegSegmentIndex::overlaps(int RegNum, const IceLiveRange &Range) const {
+  assert(RegNum >= 0);
+  if (Segments.size() <= (unsigned)RegNum)
+    return false;
+  const SegmentList &List = Segments[RegNum];
+  if (List.empty())
+    return false;
+  const IceLiveRange::RangeType &RangeSegments = Range.getSegments();
+  SegmentList::const_iterator Begin = List.begin(), End = List.end();
+  for (IceLiveRange::RangeType::const_iterator I = RangeSegments.begin(),
+                                               E = RangeSegments.end();
+       I != E; ++I) {
+    // Both lists are sorted, so each search can start where the
+    // previous one left off.
+    Begin = std::lower_bound(Begin, End, I->first, segmentEndsBefore);
+    if (Begin == End)
+      return false;
+    if (Begin->first < I->second)
+      return true;
+  }
+  return false;
+}
+
+// Removes the element at position Index from an unordered range list
+// in constant time, by moving the last element into its place.
+static void removeRange(std::vector<IceLiveRangeWrapper> &Ranges,
+                        unsigned Index) {
+  assert(Index < Ranges.size());
+  Ranges[Index] = Ranges.back();
+  Ranges.pop_back();
+}
+
+// Fills the Unhandled list with the live ranges of all variables,
+// sorted in reverse order of starting point.  Starting points are
+// instruction numbers, which are dense and bounded by the number of
+// instructions, so a counting sort does this in linear time rather
+// than the O(N log N) of a comparison-based sort.  Variables are
+// visited in increasing index order and the counting sort is stable,
+// so ties are broken by variable number.
+void IceLinearScan::initUnhandled(void) {
+  Precolored.clear();
+  std::vector<IceVariable *> Ranged;
+  const IceVarList &Vars = Cfg->getVariables();
+  Ranged.reserve(Vars.size());
+  int MinStart = 0, MaxStart = -1;
+  for (IceVarList::const_iterator I = Vars.begin(), E = Vars.end(); I != E;
+       ++I) {
+    IceVariable *Var = *I;
+    if (Var == NULL)
+      continue;
+    if (Var->getLiveRange().isEmpty())
+      continue;
+    int Start = Var->getLiveRange().getStart();
+    if (Ranged.empty() || Start < MinStart)
+      MinStart = Start;
+    if (Ranged.empty() || Start > MaxStart)
+      MaxStart = Start;
+    Ranged.push_back(Var);
+    // Forget any tentative register from an earlier scan.
+    Var->setRegNumTmp(-1);
+    if (Var->getRegNum() >= 0) {
+      Var->setLiveRangeInfiniteWeight();
+      Precolored.add(Var->getRegNum(), Var->getLiveRange());
+    }
+  }
+  Precolored.finalize();
+
+  // A call kills the caller-saved registers with a FakeKill, unless
+  // the call itself was deleted.
+  CallPoints.clear();
+  const IceNodeList &Nodes = Cfg->getLNodes();
+  for (IceNodeList::const_iterator I = Nodes.begin(), E = Nodes.end(); I != E;
+       ++I) {
+    IceInstList &Insts = (*I)->getInsts();
+    for (IceInstList::const_iterator II = Insts.begin(), IE = Insts.end();
+         II != IE; ++II) {
+      const IceInstFakeKill *Kill = llvm::dyn_cast<IceInstFakeKill>(*II);
+      if (Kill && !Kill->isDeleted() && !Kill->getLinked()->isDeleted())
+        CallPoints.push_back(Kill->getNumber());
+    }
+  }
+  std::sort(CallPoints.begin(), CallPoints.end());
+
+  // Counts[S-MinStart] is first set to the number of ranges starting
+  // before S, i.e. the sorted position of the first range starting at
+  // S, and then incremented as each such range is placed.
+  std::vector<unsigned> Counts(MaxStart - MinStart + 2);
+  for (std::vector<IceVariable *>::const_iterator I = Ranged.begin(),
+                                                  E = Ranged.end();
+       I != E; ++I) {
+    ++Counts[(*I)->getLiveRange().getStart() - MinStart + 1];
+  }
+  for (unsigned i = 1; i < Counts.size(); ++i)
+    Counts[i] += Counts[i - 1];
+  unsigned NumRanges = Ranged.size();
+  Unhandled.assign(NumRanges, IceLiveRangeWrapper(NULL));
+  for (std::vector<IceVariable *>::const_iterator I = Ranged.begin(),
+                                                  E = Ranged.end();
+       I != E; ++I) {
+    unsigned Pos = Counts[(*I)->getLiveRange().getStart() - MinStart]++;
+    Unhandled[NumRanges - 1 - Pos] = IceLiveRangeWrapper(*I);
+  }
+}
+
+// Returns true if Range is live across a call, i.e. some call point
+// lies strictly inside one of its segments.  This matches how the
+// call's FakeKill segments overlap other live ranges.
+bool IceLinearScan::crossesCall(const IceLiveRange &Range) const {
+  const IceLiveRange::RangeType &Segments = Range.getSegments();
+  for (IceLiveRange::RangeType::const_iterator I = Segments.begin(),
+                                               E = Segments.end();
+       I != E; ++I) {
+    std::vector<int>::const_iterator Call =
+        std::upper_bound(CallPoints.begin(), CallPoints.end(), I->first);
+    if (Call != CallPoints.end() && *Call < I->second)
+      return true;
+  }
+  return false;
+}
+
+// Cur crosses a call and none of the callee-saved registers in
+// Candidates is free.  If one of them is held by a single range that
+// could have used a caller-saved register for its whole lifetime,
+// that range is moved to the caller-saved register, and the
+// callee-saved register is returned for Cur.  Returns -1 otherwise.
+int IceLinearScan::moveToCallerSave(const IceLiveRangeWrapper &Cur,
+                                    const llvm::SmallBitVector &Candidates,
+                                    const llvm::SmallBitVector &CallerSaves,
+                                    std::vector<int> &RegUses) {
+  for (UnorderedRanges::const_iterator I = Active.begin(), E = Active.end();
+       I != E; ++I) {
+    IceLiveRangeWrapper Item = *I;
+    int RegNum = Item.Var->getRegNumTmp();
+    if (Item.Var->getRegNum() >= 0 || !Candidates[RegNum] ||
+        RegUses[RegNum] != 1 || Precolored.overlaps(RegNum, Cur.range()))
+      continue;
+    llvm::SmallBitVector Targets =
+        CallerSaves &
+        Cfg->getTarget()->getRegisterSetForVariable(Item.Var);
+    for (int NewReg = Targets.find_first(); NewReg != -1;
+         NewReg = Targets.find_next(NewReg)) {
+      if (RegUses[NewReg] > 0 ||
+          HandledEnd[NewReg] > Item.range().getStart() ||
+          Precolored.overlaps(NewReg, Item.range()))
+        continue;
+      bool Conflict = false;
+      for (UnorderedRanges::const_iterator J = Inactive.begin(),
+                                           JE = Inactive.end();
+           J != JE && !Conflict; ++J) {
+        if (J->Var->getRegNumTmp() == NewReg && J->overlaps(Item))
+          Conflict = true;
+      }
+      if (Conflict)
+        continue;
+      Item.Var->setRegNumTmp(NewReg);
+      --RegUses[RegNum];
+      ++RegUses[NewReg];
+      if (Cfg->Str.isVerbose(IceV_LinearScan))
+        Cfg->Str << "Moving       " << Item << "\n";
+      return RegNum;
+    }
+  }
+  return -1;
+}
+
 // Implements the linear-scan algorithm.  Based on "Linear Scan
 // Register Allocation in the Context of SSA Form and Register
 // Constraints" by Hanspeter Mössenböck and Michael Pfeiffer,
 // ftp://ftp.ssw.uni-linz.ac.at/pub/Papers/Moe02.PDF .  This
 // implementation is modified to take affinity into account and allow
 // two interfering variables to share the same register in certain
-// cases.
+// cases.  It is also aware of calls: a free register is chosen
+// caller-saved first, then a callee-saved register that is already
+// used (and therefore already saved and restored by the prolog and
+// epilog), and only then a callee-saved register that would add a
+// push/pop pair.  A range that crosses a call and finds no free
+// callee-saved register may take one from a call-free range that can
+// move to a caller-saved register.
 //
 // Requires running IceCfg::liveness(IceLiveness_RangesFull) in
-// preparation.  Results are assigned to IceVariable::RegNum for each
-// IceVariable.
-void IceLinearScan::scan(const llvm::SmallBitVector &RegMask) {
+// preparation.  Results are left in IceVariable::RegNumTmp for each
+// IceVariable until assign() is called, so the scan can be repeated
+// with a different RegMask.  Returns false if some infinite-weight
+// live range did not get a register.
+bool IceLinearScan::scan(const llvm::SmallBitVector &RegMask) {
   if (!RegMask.any())
-    return;
+    return true;
   Unhandled.clear();
   Handled.clear();
   Inactive.clear();
   Active.clear();
 
-  // Gather the live ranges of all variables and add them to the
-  // Unhandled set.  TODO: Unhandled is a set<> which is based on a
-  // balanced binary tree, so inserting live ranges for N variables is
-  // O(N log N) complexity.  N may be proportional to the number of
-  // instructions, thanks to temporary generation during lowering.  As
-  // a result, it may be useful to design a better data structure for
-  // storing Cfg->getVariables().
-  const IceVarList &Vars = Cfg->getVariables();
-  for (IceVarList::const_iterator I = Vars.begin(), E = Vars.end(); I != E;
-       ++I) {
-    IceVariable *Var = *I;
-    if (Var == NULL)
-      continue;
-    if (Var->getLiveRange().isEmpty())
-      continue;
-    Unhandled.insert(IceLiveRangeWrapper(Var));
-    if (Var->getRegNum() >= 0)
-      Var->setLiveRangeInfiniteWeight();
-  }
+  // Gather the live ranges of all variables into Unhandled.
+  initUnhandled();
 
   // RegUses[I] is the number of live ranges (variables) that register
   // I is currently assigned to.  It can be greater than 1 as a result
   // of IceVariable::AllowRegisterOverlap.
   std::vector<int> RegUses(RegMask.size());
-  // Unhandled is already set to all ranges in increasing order of
+  HandledEnd.assign(RegMask.size(), 0);
+  // Touched is the set of registers assigned to some range so far.
+  // Using an untouched callee-saved register costs an extra push and
+  // pop in the prolog and epilog.
+  llvm::SmallBitVector CallerSaves =
+      RegMask &
+      Cfg->getTarget()->getRegisterSet(IceTargetLowering::RegMask_CallerSave);
+  llvm::SmallBitVector CalleeSaves =
+      RegMask &
+      Cfg->getTarget()->getRegisterSet(IceTargetLowering::RegMask_CalleeSave);
+  llvm::SmallBitVector Touched(RegMask.size());
+  bool Success = true;
+  // Unhandled is already set to all ranges in decreasing order of
   // start points.
   assert(Active.empty());
   assert(Inactive.empty());
   assert(Handled.empty());
-  UnorderedRanges::iterator Next;
 
   while (!Unhandled.empty()) {
-    IceLiveRangeWrapper Cur = *Unhandled.begin();
-    Unhandled.erase(Unhandled.begin());
+    IceLiveRangeWrapper Cur = Unhandled.back();
+    Unhandled.pop_back();
     if (Cfg->Str.isVerbose(IceV_LinearScan))
       Cfg->Str << "\nConsidering  " << Cur << "\n";
     const llvm::SmallBitVector &TypeMask =
-        Cfg->getTarget()->getRegisterSetForType(Cur.Var->getType());
+        Cfg->getTarget()->getRegisterSetForVariable(Cur.Var);
 
     // Check for precolored ranges.  If Cur is precolored, it
     // definitely gets that register.  Previously processed live
@@ -80,28 +321,31 @@ void IceLinearScan::scan(const llvm::SmallBitVector &RegMask) {
       Active.push_back(Cur);
       assert(RegUses[RegNum] >= 0);
       ++RegUses[RegNum];
+      Touched[RegNum] = true;
       continue;
     }
 
     // Check for active ranges that have expired or become inactive.
-    for (UnorderedRanges::iterator I = Active.begin(), E = Active.end(); I != E;
-         I = Next) {
-      Next = I;
-      ++Next;
-      IceLiveRangeWrapper Item = *I;
+    // Removal moves the last element into slot I, so I is only
+    // advanced when Item stays in place.
+    for (unsigned I = 0; I < Active.size();) {
+      IceLiveRangeWrapper Item = Active[I];
       bool Moved = false;
       if (Item.endsBefore(Cur)) {
         // Move Item from Active to Handled list.
         if (Cfg->Str.isVerbose(IceV_LinearScan))
           Cfg->Str << "Expiring     " << Item << "\n";
-        Active.erase(I);
+        removeRange(Active, I);
         Handled.push_back(Item);
+        int RegNum = Item.Var->getRegNumTmp();
+        HandledEnd[RegNum] =
+            std::max(HandledEnd[RegNum], Item.range().getEnd());
         Moved = true;
       } else if (!Item.overlaps(Cur)) {
         // Move Item from Active to Inactive list.
         if (Cfg->Str.isVerbose(IceV_LinearScan))
           Cfg->Str << "Inactivating " << Item << "\n";
-        Active.erase(I);
+        removeRange(Active, I);
         Inactive.push_back(Item);
         Moved = true;
       }
@@ -111,70 +355,61 @@ void IceLinearScan::scan(const llvm::SmallBitVector &RegMask) {
         assert(RegNum >= 0);
         --RegUses[RegNum];
         assert(RegUses[RegNum] >= 0);
+      } else {
+        ++I;
       }
     }
 
     // Check for inactive ranges that have expired or reactivated.
-    for (UnorderedRanges::iterator I = Inactive.begin(), E = Inactive.end();
-         I != E; I = Next) {
-      Next = I;
-      ++Next;
-      IceLiveRangeWrapper Item = *I;
+    for (unsigned I = 0; I < Inactive.size();) {
+      IceLiveRangeWrapper Item = Inactive[I];
       if (Item.endsBefore(Cur)) {
         // Move Item from Inactive to Handled list.
         if (Cfg->Str.isVerbose(IceV_LinearScan))
           Cfg->Str << "Expiring     " << Item << "\n";
-        Inactive.erase(I);
+        removeRange(Inactive, I);
         Handled.push_back(Item);
+        int RegNum = Item.Var->getRegNumTmp();
+        HandledEnd[RegNum] =
+            std::max(HandledEnd[RegNum], Item.range().getEnd());
       } else if (Item.overlaps(Cur)) {
         // Move Item from Inactive to Active list.
         if (Cfg->Str.isVerbose(IceV_LinearScan))
           Cfg->Str << "Reactivating " << Item << "\n";
-        Inactive.erase(I);
+        removeRange(Inactive, I);
         Active.push_back(Item);
         // Increment Item in RegUses[].
         int RegNum = Item.Var->getRegNumTmp();
         assert(RegNum >= 0);
         assert(RegUses[RegNum] >= 0);
         ++RegUses[RegNum];
+      } else {
+        ++I;
       }
     }
 
-    // Calculate available registers into Free[].
+    // Calculate available registers into Free[].  RegUses[] is the
+    // per-register occupancy of Active, so this doesn't need to look
+    // at the Active ranges themselves.
     llvm::SmallBitVector Free = RegMask & TypeMask;
     for (unsigned i = 0; i < RegMask.size(); ++i) {
       if (RegUses[i] > 0)
         Free[i] = false;
     }
 
-    // Remove registers from the Free[] list where an Inactive range
-    // overlaps with the current range.
-    for (UnorderedRanges::const_iterator I = Inactive.begin(),
-                                         E = Inactive.end();
-         I != E; ++I) {
-      IceLiveRangeWrapper Item = *I;
-      if (Item.overlaps(Cur)) {
-        int RegNum = Item.Var->getRegNumTmp();
-        // Don't assert(Free[RegNum]) because in theory (though
-        // probably never in practice) there could be two inactive
-        // variables that were allowed marked with
-        // AllowRegisterOverlap.
-        Free[RegNum] = false;
-      }
-    }
+    // There is no need to remove registers from the Free[] list where
+    // an Inactive range overlaps with the current range, because any
+    // such range was just reactivated and is counted in RegUses[].
 
-    // Remove registers from the Free[] list where an Unhandled range
-    // overlaps with the current range and is precolored.
-    // Cur.endsBefore(*I) is an early exit check that turns a
-    // guaranteed O(N^2) algorithm into expected linear complexity.
-    for (OrderedRanges::const_iterator I = Unhandled.begin(),
-                                       E = Unhandled.end();
-         I != E && !Cur.endsBefore(*I); ++I) {
-      IceLiveRangeWrapper Item = *I;
-      int RegNum = Item.Var->getRegNum(); // Note: getRegNum not getRegNumTmp
-      if (RegNum >= 0 && Item.overlaps(Cur)) {
+    // Remove registers from the Free[] list where a precolored range
+    // overlaps with the current range.  Precolored ranges that were
+    // already processed are in Active if they overlap, so this only
+    // matters for the ones still in Unhandled, but querying the index
+    // for all of them gives the same answer.
+    for (int RegNum = Free.find_first(); RegNum != -1;
+         RegNum = Free.find_next(RegNum)) {
+      if (Precolored.overlaps(RegNum, Cur.range()))
         Free[RegNum] = false;
-      }
     }
 
     // Print info about physical register availability.
@@ -188,9 +423,30 @@ void IceLinearScan::scan(const llvm::SmallBitVector &RegMask) {
       Cfg->Str << "\n";
     }
 
+    // A range that crosses a call can only use a callee-saved
+    // register, because of the call's FakeKill, so if the callee-saved
+    // registers are all taken, try to move a call-free range off one.
+    // An already touched register is worth a move even if an untouched
+    // one is free.
+    bool CrossesCall = crossesCall(Cur.range());
+    int MovedReg = -1;
+    if (CrossesCall) {
+      llvm::SmallBitVector Candidates = CalleeSaves & TypeMask;
+      if ((Free & Touched).none())
+        MovedReg = moveToCallerSave(Cur, Candidates & Touched, CallerSaves,
+                                    RegUses);
+      if (MovedReg < 0 && Free.none())
+        MovedReg = moveToCallerSave(Cur, Candidates, CallerSaves, RegUses);
+      if (MovedReg >= 0) {
+        Free.reset();
+        Free[MovedReg] = true;
+      }
+    }
+
     IceVariable *Prefer = Cur.Var->getPreferredRegister();
     int PreferReg = Prefer ? Prefer->getRegNumTmp() : -1;
-    if (PreferReg >= 0 && (Cur.Var->getRegisterOverlap() || Free[PreferReg])) {
+    if (MovedReg < 0 && PreferReg >= 0 && TypeMask[PreferReg] &&
+        (Cur.Var->getRegisterOverlap() || Free[PreferReg])) {
       // First choice: a preferred register that is either free or is
       // allowed to overlap with its linked variable.
       Cur.Var->setRegNumTmp(PreferReg);
@@ -198,13 +454,20 @@ void IceLinearScan::scan(const llvm::SmallBitVector &RegMask) {
         Cfg->Str << "Preferring   " << Cur << "\n";
       assert(RegUses[PreferReg] >= 0);
       ++RegUses[PreferReg];
+      Touched[PreferReg] = true;
       Active.push_back(Cur);
     } else if (Free.any()) {
-      // Second choice: any free register.  TODO: After explicit
-      // affinity is considered, is there a strategy better than just
-      // picking the lowest-numbered available register?
-      int RegNum = Free.find_first();
+      // Second choice: any free register, caller-saved ones first so
+      // that callee-saved registers stay available for ranges that
+      // cross calls, then callee-saved registers that already need
+      // saving.
+      int RegNum = (Free & CallerSaves).find_first();
+      if (RegNum < 0)
+        RegNum = (Free & Touched).find_first();
+      if (RegNum < 0)
+        RegNum = Free.find_first();
       Cur.Var->setRegNumTmp(RegNum);
+      Touched[RegNum] = true;
       if (Cfg->Str.isVerbose(IceV_LinearScan))
         Cfg->Str << "Allocating   " << Cur << "\n";
       assert(RegUses[RegNum] >= 0);
@@ -224,82 +487,79 @@ void IceLinearScan::scan(const llvm::SmallBitVector &RegMask) {
         Weights[RegNum].addWeight(Item.range().getWeight());
       }
       // Same as above, but check Inactive ranges instead of Active.
+      // An Inactive range that doesn't overlap Cur doesn't compete for
+      // its register.
       for (UnorderedRanges::const_iterator I = Inactive.begin(),
                                            E = Inactive.end();
            I != E; ++I) {
         IceLiveRangeWrapper Item = *I;
+        if (!Item.overlaps(Cur))
+          continue;
         int RegNum = Item.Var->getRegNumTmp();
         assert(RegNum >= 0);
         Weights[RegNum].addWeight(Item.range().getWeight());
       }
-      // Check Unhandled ranges that overlap Cur and are precolored.
-      // Cur.endsBefore(*I) is an early exit check that turns a
-      // guaranteed O(N^2) algorithm into expected linear complexity.
-      for (OrderedRanges::const_iterator I = Unhandled.begin(),
-                                         E = Unhandled.end();
-           I != E && !Cur.endsBefore(*I); ++I) {
-        IceLiveRangeWrapper Item = *I;
-        int RegNum = Item.Var->getRegNumTmp();
-        if (RegNum < 0)
-          continue;
-        if (Item.overlaps(Cur))
+      // Check precolored ranges that overlap Cur.  A precolored range
+      // in Unhandled doesn't have its tentative register set yet, so
+      // the index (which uses the final register) is the only way to
+      // see that it will claim its register later.
+      for (unsigned RegNum = 0; RegNum < Weights.size(); ++RegNum) {
+        if (RegMask[RegNum] && Precolored.overlaps(RegNum, Cur.range()))
           Weights[RegNum].setWeight(IceRegWeight::Inf);
       }
 
       // All the weights are now calculated.  Find the register with
-      // smallest weight.
-      int MinWeightIndex = RegMask.find_first();
-      // MinWeightIndex must be valid because of the initial
-      // RegMask.any() test.
-      assert(MinWeightIndex >= 0);
-      for (unsigned i = MinWeightIndex + 1; i < Weights.size(); ++i) {
-        if (RegMask[i] && TypeMask[i] && Weights[i] < Weights[MinWeightIndex])
+      // smallest weight, among the registers that can hold Cur's type.
+      // MinWeightIndex is -1 if there are none.
+      llvm::SmallBitVector Candidates = RegMask & TypeMask;
+      int MinWeightIndex = Candidates.find_first();
+      for (int i = MinWeightIndex; i != -1; i = Candidates.find_next(i)) {
+        if (Weights[i] < Weights[MinWeightIndex])
           MinWeightIndex = i;
       }
 
-      if (Cur.range().getWeight() <= Weights[MinWeightIndex]) {
+      if (MinWeightIndex < 0 ||
+          Cur.range().getWeight() <= Weights[MinWeightIndex]) {
         // Cur doesn't have priority over any other live ranges, so
         // don't allocate any register to it, and move it to the
         // Handled state.
         Handled.push_back(Cur);
-        if (Cur.range().getWeight().isInf()) {
-          Cfg->setError("Unable to find a physical register for an "
-                        "infinite-weight live range");
-        }
+        if (Cur.range().getWeight().isInf())
+          Success = false;
       } else {
         // Evict all live ranges in Active that register number
         // MinWeightIndex is assigned to.
-        for (UnorderedRanges::iterator I = Active.begin(), E = Active.end();
-             I != E; I = Next) {
-          Next = I;
-          ++Next;
-          IceLiveRangeWrapper Item = *I;
+        for (unsigned I = 0; I < Active.size();) {
+          IceLiveRangeWrapper Item = Active[I];
           if (Item.Var->getRegNumTmp() == MinWeightIndex) {
             if (Cfg->Str.isVerbose(IceV_LinearScan))
               Cfg->Str << "Evicting     " << Item << "\n";
             --RegUses[MinWeightIndex];
             assert(RegUses[MinWeightIndex] >= 0);
             Item.Var->setRegNumTmp(-1);
-            Active.erase(I);
+            removeRange(Active, I);
             Handled.push_back(Item);
+          } else {
+            ++I;
           }
         }
-        // Do the same for Inactive.
-        for (UnorderedRanges::iterator I = Inactive.begin(), E = Inactive.end();
-             I != E; I = Next) {
-          Next = I;
-          ++Next;
-          IceLiveRangeWrapper Item = *I;
-          if (Item.Var->getRegNumTmp() == MinWeightIndex) {
+        // Do the same for the Inactive ranges that overlap Cur.
+        for (unsigned I = 0; I < Inactive.size();) {
+          IceLiveRangeWrapper Item = Inactive[I];
+          if (Item.Var->getRegNumTmp() == MinWeightIndex &&
+              Item.overlaps(Cur)) {
             if (Cfg->Str.isVerbose(IceV_LinearScan))
               Cfg->Str << "Evicting     " << Item << "\n";
             Item.Var->setRegNumTmp(-1);
-            Inactive.erase(I);
+            removeRange(Inactive, I);
             Handled.push_back(Item);
+          } else {
+            ++I;
           }
         }
         // Assign the register to Cur.
         Cur.Var->setRegNumTmp(MinWeightIndex);
+        Touched[MinWeightIndex] = true;
         ++RegUses[MinWeightIndex];
         assert(RegUses[MinWeightIndex] >= 0);
         Active.push_back(Cur);
@@ -310,23 +570,17 @@ void IceLinearScan::scan(const llvm::SmallBitVector &RegMask) {
     dump(Cfg->Str);
   }
   // Move anything Active or Inactive to Handled for easier handling.
-  for (UnorderedRanges::iterator I = Active.begin(), E = Active.end(); I != E;
-       I = Next) {
-    Next = I;
-    ++Next;
-    Handled.push_back(*I);
-    Active.erase(I);
-  }
-  for (UnorderedRanges::iterator I = Inactive.begin(), E = Inactive.end();
-       I != E; I = Next) {
-    Next = I;
-    ++Next;
-    Handled.push_back(*I);
-    Inactive.erase(I);
-  }
+  Handled.insert(Handled.end(), Active.begin(), Active.end());
+  Active.clear();
+  Handled.insert(Handled.end(), Inactive.begin(), Inactive.end());
+  Inactive.clear();
   dump(Cfg->Str);
+  return Success;
+}
 
-  // Finish up by assigning RegNumTmp->RegNum for each IceVariable.
+// Finishes up by assigning RegNumTmp->RegNum for each IceVariable
+// handled by the last scan().
+void IceLinearScan::assign(void) {
   for (UnorderedRanges::const_iterator I = Handled.begin(), E = Handled.end();
        I != E; ++I) {
     IceLiveRangeWrapper Item = *I;
@@ -381,7 +635,8 @@ void IceLinearScan::dump(IceOstream &Str) const {
     Cfg->Str << *I << "\n";
   }
   Str << "++++++ Unhandled:\n";
-  for (OrderedRanges::const_iterator I = Unhandled.begin(), E = Unhandled.end();
+  for (OrderedRanges::const_reverse_iterator I = Unhandled.rbegin(),
+                                             E = Unhandled.rend();
        I != E; ++I) {
     Cfg->Str << *I << "\n";
   }
@@ -25,36 +25,74 @@ public:
   bool overlaps(const IceLiveRangeWrapper &Other) const {
     return range().overlaps(Other.range());
   }
-  IceVariable *const Var;
+  IceVariable *Var;
   void dump(IceOstream &Str) const;
 };
 IceOstream &operator<<(IceOstream &Str, const IceLiveRangeWrapper &R);
 
+// IceRegSegmentIndex keeps, for each physical register, the union of
+// the live range segments of a set of variables assigned to that
+// register, as a sorted vector of disjoint segments.  Whether a live
+// range overlaps anything on a given register is then answered with a
+// binary search per segment of the live range, rather than by walking
+// the individual variables.  The key doesn't have to be a register;
+// any small non-negative number works, e.g. a stack slot.
+class IceRegSegmentIndex {
+public:
+  void clear(void) { Segments.clear(); }
+  void add(int RegNum, const IceLiveRange &Range);
+  // Sorts and merges the segments of each register.  Must be called
+  // after the last add() and before any overlaps() query.
+  void finalize(void);
+  // Adds Range and merges it into the register's segments right away,
+  // so that overlaps() queries can be interleaved with insertions
+  // without finalize().  Only the segments from Range's start onward
+  // are touched.
+  void insert(int RegNum, const IceLiveRange &Range);
+  bool overlaps(int RegNum, const IceLiveRange &Range) const;
+
+private:
+  typedef std::vector<IceLiveRange::RangeElementType> SegmentList;
+  std::vector<SegmentList> Segments;
+};
+
 class IceLinearScan {
 public:
   IceLinearScan(IceCfg *Cfg) : Cfg(Cfg) {}
-  void scan(const llvm::SmallBitVector &RegMask);
+  bool scan(const llvm::SmallBitVector &RegMask);
+  void assign(void);
   void dump(IceOstream &Str) const;
 
 private:
   IceCfg *const Cfg;
-  // RangeCompare is the comparator for sorting an IceLiveRangeWrapper
-  // by starting point in a std::set<>.  Ties are broken by variable
-  // number so that sorting is stable.
-  struct RangeCompare {
-    bool operator()(const IceLiveRangeWrapper &L,
-                    const IceLiveRangeWrapper &R) const {
-      int Lstart = L.Var->getLiveRange().getStart();
-      int Rstart = R.Var->getLiveRange().getStart();
-      if (Lstart == Rstart)
-        return L.Var->getIndex() < R.Var->getIndex();
-      return Lstart < Rstart;
-    }
-  };
-  typedef std::set<IceLiveRangeWrapper, RangeCompare> OrderedRanges;
-  typedef std::list<IceLiveRangeWrapper> UnorderedRanges;
+  void initUnhandled(void);
+  bool crossesCall(const IceLiveRange &Range) const;
+  int moveToCallerSave(const IceLiveRangeWrapper &Cur,
+                       const llvm::SmallBitVector &Candidates,
+                       const llvm::SmallBitVector &CallerSaves,
+                       std::vector<int> &RegUses);
+  // Unhandled is sorted in decreasing order of starting point, with
+  // ties broken by decreasing variable number, so that the next range
+  // to process is always at the back of the vector and can be popped
+  // in constant time.  Active, Inactive, and Handled have no
+  // particular order, and an element is removed by overwriting it
+  // with the last element.
+  typedef std::vector<IceLiveRangeWrapper> OrderedRanges;
+  typedef std::vector<IceLiveRangeWrapper> UnorderedRanges;
   OrderedRanges Unhandled;
   UnorderedRanges Active, Inactive, Handled;
+  // Precolored indexes the live ranges of all precolored variables by
+  // register, so that excluding registers needed by precolored ranges
+  // doesn't require walking Unhandled.
+  IceRegSegmentIndex Precolored;
+  // CallPoints holds the instruction numbers of the calls, in
+  // increasing order.  A live range that is live across one of them
+  // can only be given a callee-saved register.
+  std::vector<int> CallPoints;
+  // HandledEnd[I] is the latest end point of a range that expired
+  // while assigned to register I.  No Handled range on register I
+  // overlaps a range that starts at or after that point.
+  std::vector<int> HandledEnd;
 };
 
 #endif // _IceRegAlloc_h
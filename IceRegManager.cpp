@@ -3,8 +3,6 @@
  * be found in the LICENSE file.
  */
 
-#include <string.h>
-
 #include "IceCfg.h"
 #include "IceCfgNode.h"
 #include "IceInst.h"
@@ -13,156 +11,234 @@
 #include "IceTargetLowering.h"
 #include "IceTypes.h"
 
-IceRegManagerEntry::IceRegManagerEntry(IceCfg *Cfg, IceVariable *Var,
-                                       unsigned NumReg)
-    : Var(Var) {}
+// Only variables without a register and constants are tracked as
+// register contents.  Memory operands may be changed by stores, and a
+// register's own contents are tracked by its entry.
+static bool isTrackable(const IceOperand *Operand) {
+  if (const IceVariable *Var = llvm::dyn_cast<IceVariable>(Operand))
+    return Var->getRegNum() < 0;
+  return llvm::isa<IceConstantInteger>(Operand) ||
+         llvm::isa<IceConstantRelocatable>(Operand);
+}
+
+// Integer constants are not pooled, so they are compared by value.
+// Relocatables are pooled and can be compared by pointer.
+static bool isSameOperand(const IceOperand *A, const IceOperand *B) {
+  if (A == B)
+    return true;
+  const IceConstantInteger *ConstA = llvm::dyn_cast<IceConstantInteger>(A);
+  const IceConstantInteger *ConstB = llvm::dyn_cast<IceConstantInteger>(B);
+  if (ConstA && ConstB)
+    return ConstA->getType() == ConstB->getType() &&
+           ConstA->getIntValue() == ConstB->getIntValue();
+  return false;
+}
+
+IceRegManagerEntry::IceRegManagerEntry(IceCfg *Cfg, int RegNum)
+    : RegNum(RegNum) {}
 
 IceRegManagerEntry::IceRegManagerEntry(IceCfg *Cfg,
-                                       const IceRegManagerEntry &Other,
-                                       unsigned NumReg)
-    : Var(Other.Var), Available(Other.Available) {}
+                                       const IceRegManagerEntry &Other)
+    : RegNum(Other.RegNum), Available(Other.Available) {}
 
-// An Operand is loaded into this virtual register.  Its Available set
-// is cleared and then set to contain the Operand.
-void IceRegManagerEntry::load(IceInst *Inst) {
+// An Operand is loaded into this register.  Its Available set is
+// cleared and then set to contain the Operand.  A NULL Operand means
+// the register was changed in some way that is not tracked.
+void IceRegManagerEntry::load(IceOperand *Operand) {
   Available.clear();
-  if (Inst) {
-    IceOperand *Operand = Inst->getSrc(0);
+  if (Operand && isTrackable(Operand))
     Available.push_back(Operand);
-  }
 }
 
-// This virtual register is stored into a Variable, and the Variable
-// is added to the virtual register's Available set.  If the Variable
-// is a physical register managed by this RegManager (e.g., specific
-// register requirements for instructions like x86 idiv), then all
-// Available sets must be killed.
-void IceRegManagerEntry::store(IceInst *Inst) {
-  // TODO: Kill all Available sets when necessary.
-  IceVariable *Variable = Inst->getDest();
+// The register is copied from another register, and takes over the
+// other register's Available set.
+void IceRegManagerEntry::copy(const IceRegManagerEntry &Other) {
+  Available = Other.Available;
+}
+
+// This register is stored into a Variable, and the Variable is added
+// to the register's Available set.  The caller is responsible for
+// removing the Variable from other registers' Available sets.
+void IceRegManagerEntry::store(IceVariable *Variable) {
   assert(Variable);
-  Available.push_back(Variable);
+  if (isTrackable(Variable) && !contains(Variable))
+    Available.push_back(Variable);
+}
+
+void IceRegManagerEntry::remove(const IceOperand *Operand) {
+  for (IceOpList::iterator I = Available.begin(), E = Available.end(); I != E;
+       ++I) {
+    if (*I == Operand) {
+      Available.erase(I);
+      return;
+    }
+  }
+}
+
+// Keeps only the operands that are also available in Other, for
+// merging the states of two paths.
+void IceRegManagerEntry::intersect(const IceRegManagerEntry &Other) {
+  IceOpList Kept;
+  for (IceOpList::const_iterator I = Available.begin(), E = Available.end();
+       I != E; ++I) {
+    if (Other.contains(*I))
+      Kept.push_back(*I);
+  }
+  Available.swap(Kept);
 }
 
 bool IceRegManagerEntry::contains(const IceOperand *Operand) const {
-  if (getVar() == Operand)
-    return true;
   for (IceOpList::const_iterator I = Available.begin(), E = Available.end();
        I != E; ++I) {
-    if (*I == Operand)
+    if (isSameOperand(*I, Operand))
       return true;
-    // TODO: Make it work for IceConstant pointers.
   }
   return false;
 }
 
-IceRegManager::IceRegManager(IceCfg *Cfg, IceCfgNode *Node, unsigned NumReg)
-    : NumReg(NumReg), Cfg(Cfg) {
-  // TODO: Config flag to use physical registers directly.
-  for (unsigned i = 0; i < NumReg; ++i) {
-    char Buf[100];
-    sprintf(Buf, "r%u_%u", i + 1, Node->getIndex());
-    IceVariable *Reg =
-        Cfg->makeVariable(IceType_i32, Node, Cfg->getNumVariables(), Buf);
-    Queue.push_back(IceRegManagerEntry::create(Cfg, Reg, NumReg));
+IceRegManager::IceRegManager(IceCfg *Cfg,
+                             const llvm::SmallBitVector &Registers)
+    : Cfg(Cfg) {
+  for (int RegNum = Registers.find_first(); RegNum != -1;
+       RegNum = Registers.find_next(RegNum)) {
+    Queue.push_back(IceRegManagerEntry::create(Cfg, RegNum));
   }
 }
 
-IceRegManager::IceRegManager(const IceRegManager &Other)
-    : NumReg(Other.NumReg), Cfg(Other.Cfg) {
+IceRegManager::IceRegManager(const IceRegManager &Other) : Cfg(Other.Cfg) {
   for (QueueType::const_iterator I = Other.Queue.begin(), E = Other.Queue.end();
        I != E; ++I) {
-    Queue.push_back(IceRegManagerEntry::create(Cfg, **I, NumReg));
+    Queue.push_back(IceRegManagerEntry::create(Cfg, **I));
   }
 }
 
-// Prefer[0] is highest preference, Prefer[1] is second, etc.
-IceVariable *IceRegManager::getRegister(IceType Type, const IceOpList &Prefer,
-                                        const IceVarList &Avoid)
-    // TODO: "Avoid" is actually a set of virtual or physical registers.
-    // Wait - no it's not.  For an Arithmetic instruction, the load of the
-    // first operand should avoid using a register that contains the
-    // second operand.
-    const {
-  // Check each register in LRU order.  If it's in the Avoid list,
-  // continue.  If a non-preferred candidate hasn't been seen, set it
-  // to this register.  If its index into the Prefer list is better
-  // than the current best, update the current best.
-  // TODO: implement this policy
-  IceRegManagerEntry *Good = NULL;
-  IceRegManagerEntry *Best = NULL;
-  for (QueueType::const_iterator I1 = Queue.begin(), E1 = Queue.end(); I1 != E1;
-       ++I1) {
-    IceRegManagerEntry *Entry = *I1;
-    bool AvoidEntry = false;
-    for (IceVarList::const_iterator I2 = Avoid.begin(), E2 = Avoid.end();
-         I2 != E2; ++I2) {
-      if (Entry->contains(*I2)) {
-        AvoidEntry = true;
-        break;
-      }
-    }
-    if (AvoidEntry)
+IceRegManager::~IceRegManager() {
+  for (QueueType::iterator I = Queue.begin(), E = Queue.end(); I != E; ++I)
+    delete *I;
+}
+
+IceRegManager::QueueType::iterator IceRegManager::find(int RegNum) {
+  for (QueueType::iterator I = Queue.begin(), E = Queue.end(); I != E; ++I) {
+    if ((*I)->getRegNum() == RegNum)
+      return I;
+  }
+  return Queue.end();
+}
+
+IceRegManager::QueueType::const_iterator IceRegManager::find(int RegNum) const {
+  for (QueueType::const_iterator I = Queue.begin(), E = Queue.end(); I != E;
+       ++I) {
+    if ((*I)->getRegNum() == RegNum)
+      return I;
+  }
+  return Queue.end();
+}
+
+// Returns the least recently used register in Allowed, preferring a
+// register that holds nothing of value over one whose contents could
+// still be reused.  Returns -1 if no register in Allowed is managed.
+int IceRegManager::getRegister(const llvm::SmallBitVector &Allowed) const {
+  const IceRegManagerEntry *Good = NULL;
+  for (QueueType::const_iterator I = Queue.begin(), E = Queue.end(); I != E;
+       ++I) {
+    const IceRegManagerEntry *Entry = *I;
+    if (!Allowed[Entry->getRegNum()])
       continue;
+    if (Entry->isEmpty())
+      return Entry->getRegNum();
     if (Good == NULL)
       Good = Entry;
-    for (IceOpList::const_iterator I2 = Prefer.begin(), E2 = Prefer.end();
-         I2 != E2; ++I2) {
-      if (Entry->contains(*I2)) {
-        // TODO: Only set Best if it is better than the previous Best.
-        Best = Entry;
-      }
-    }
   }
-  if (Best == NULL)
-    Best = Good;
-  if (Best == NULL)
-    Best = Queue.front();
-  return Best->getVar();
+  return Good ? Good->getRegNum() : -1;
 }
 
-bool IceRegManager::registerContains(const IceVariable *Reg,
-                                     const IceOperand *Op) const {
-  for (QueueType::const_iterator I = Queue.begin(), E = Queue.end(); I != E;
-       ++I) {
-    if ((*I)->getVar() == Reg)
-      return (*I)->contains(Op);
+// Returns the most recently used register in Allowed that holds
+// Operand, or -1 if there is none.
+int IceRegManager::findRegister(const IceOperand *Operand,
+                                const llvm::SmallBitVector &Allowed) const {
+  if (!isTrackable(Operand))
+    return -1;
+  for (QueueType::const_reverse_iterator I = Queue.rbegin(), E = Queue.rend();
+       I != E; ++I) {
+    const IceRegManagerEntry *Entry = *I;
+    if (Allowed[Entry->getRegNum()] && Entry->contains(Operand))
+      return Entry->getRegNum();
   }
-  assert(false);
-  return false;
+  return -1;
 }
 
-void IceRegManager::notifyLoad(IceInst *Inst, bool IsAssign) {
-  IceVariable *Reg = Inst->getDest();
-  IceRegManagerEntry *Entry = NULL;
-  for (QueueType::iterator I = Queue.begin(), E = Queue.end(); I != E; ++I) {
-    if ((*I)->getVar() == Reg) {
-      Entry = *I;
-      Queue.erase(I);
-      break;
-    }
+bool IceRegManager::registerContains(int RegNum, const IceOperand *Op) const {
+  QueueType::const_iterator I = find(RegNum);
+  assert(I != Queue.end());
+  return (*I)->contains(Op);
+}
+
+// Operand is loaded into the register, which becomes the most
+// recently used.  If Operand is itself a managed register, its
+// Available set is copied.
+void IceRegManager::notifyLoad(int RegNum, IceOperand *Operand) {
+  QueueType::iterator I = find(RegNum);
+  if (I == Queue.end())
+    return;
+  IceRegManagerEntry *Entry = *I;
+  const IceVariable *Var = llvm::dyn_cast_or_null<IceVariable>(Operand);
+  QueueType::const_iterator Src =
+      (Var && Var->getRegNum() >= 0) ? find(Var->getRegNum()) : Queue.end();
+  if (Src != Queue.end()) {
+    if (*Src != Entry)
+      Entry->copy(**Src);
+  } else {
+    Entry->load(Operand);
   }
-  assert(Entry);
+  Queue.erase(I);
+  Queue.push_back(Entry);
+}
+
+// The register is stored into Variable, which now lives only in this
+// register (and in its home location).
+void IceRegManager::notifyStore(int RegNum, IceVariable *Variable) {
+  notifyDef(Variable);
+  QueueType::iterator I = find(RegNum);
+  if (I == Queue.end())
+    return;
+  IceRegManagerEntry *Entry = *I;
+  Queue.erase(I);
+  Queue.push_back(Entry);
+  Entry->store(Variable);
+}
+
+// The register's contents are reused, making it the most recently
+// used.
+void IceRegManager::notifyUse(int RegNum) {
+  QueueType::iterator I = find(RegNum);
+  if (I == Queue.end())
+    return;
+  IceRegManagerEntry *Entry = *I;
+  Queue.erase(I);
   Queue.push_back(Entry);
-  Entry->load(IsAssign ? Inst : NULL);
 }
 
-void IceRegManager::notifyStore(IceInst *Inst) {
-  IceVariable *Reg = llvm::cast<IceVariable>(Inst->getSrc(0));
-  IceRegManagerEntry *Entry = NULL;
+// Variable is assigned a new value, so no register holds it anymore.
+void IceRegManager::notifyDef(const IceVariable *Variable) {
+  for (QueueType::iterator I = Queue.begin(), E = Queue.end(); I != E; ++I)
+    (*I)->remove(Variable);
+}
+
+void IceRegManager::killAll(void) {
+  for (QueueType::iterator I = Queue.begin(), E = Queue.end(); I != E; ++I)
+    (*I)->load(NULL);
+}
+
+// Keeps only the register contents that are the same in both states.
+// The LRU order of this state is retained.
+void IceRegManager::intersect(const IceRegManager &Other) {
   for (QueueType::iterator I = Queue.begin(), E = Queue.end(); I != E; ++I) {
-    if ((*I)->getVar() == Reg) {
-      Entry = *I;
-      Queue.erase(I);
-      break;
-    }
+    QueueType::const_iterator OtherEntry = Other.find((*I)->getRegNum());
+    if (OtherEntry == Other.Queue.end())
+      (*I)->load(NULL);
+    else
+      (*I)->intersect(**OtherEntry);
   }
-  assert(Entry);
-  Queue.push_back(Entry);
-  Entry->store(Inst);
-  // TODO: See the TODO in IceRegManagerEntry::store().  For the
-  // instruction "a=reg", "a" must be removed from all other Available
-  // sets.  But is this actually possible with SSA form?
 }
 
 // ======================== Dump routines ======================== //
@@ -175,7 +251,7 @@ void IceRegManager::dump(IceOstream &Str) const {
 }
 
 void IceRegManagerEntry::dump(IceOstream &Str) const {
-  Str << " " << getVar() << "={";
+  Str << " " << Str.Cfg->physicalRegName(getRegNum()) << "={";
   for (IceOpList::const_iterator I = Available.begin(), E = Available.end();
        I != E; ++I) {
     if (I != Available.begin())
@@ -10,104 +10,104 @@
 #include "IceDefs.h"
 #include "IceTypes.h"
 
+// The register manager tracks the contents of a set of physical
+// registers over a single pass through a basic block, for targets
+// that lower without a global register allocator.
+//
 // Maintain LRU allocation order.
-// Track which variables are available in which registers.
-//   Each register has a bitmap of variables.
-// Track which constants are available in which registers.
-//   Each register has a constant.
-// Track which registers contain which variables.
-//   Each variable has a bitmap of registers.
-// First variable loaded into each register in the block.
+// Track which variables and constants are available in which
+// registers.  Each register has a list of operands whose values it
+// currently holds.
 //
-// Select register for loading specific variable or constant.
-// Pass a list of preferences and a list of anti-preferences.
+// Select a register for loading a specific variable or constant.  If
+// some allowed register already holds it, the load can be skipped.
+// Otherwise pick the least recently used allowed register, favoring
+// one that holds nothing of value.
 //
 // Notify of a load or other change to a register's contents ("other
 // change": e.g. a function call destroys the scratch registers'
-// contents).  Record it if this is the first load/change in the block
-// to the register.  Remove the old register/operand availabilities
-// and add the new.
+// contents).  Remove the old register/operand availabilities and add
+// the new.
 //
 // Notify of a store of the register into a variable.  Add the new
-// register/operand availability.
+// register/operand availability, after removing the variable from
+// every other register.
 //
+// The state at the end of a block can be captured for an extended
+// basic block: a successor with a single predecessor starts with the
+// register contents that its predecessor had when branching to it.
 //
-// Examples:
-//   a = b + c
-// r1 = b; r1 += c; a = r1;   -or-   r1 = c; r1 += b; a = r1;
-// r1 is destroyed in both cases.  So when asking for an r1, our
-// preferences are:
-// 1. Register holding b if this instruction ends b's live range.
-//    (r1==b); r1 += c; a = r1;
-// 2. Register holding c if this instruction ends c's live range.
-//    And only if the operator is commutative.
-//    (r1==c); r1 += b; a = r1;
-// 3. Register not holding b or c.
-//    r1 = b; r1 += c; a = r1;
-// 4. Any register.
-//    r1 = b; r1 += c; a = r1;
-// May want to prioritize #1 and #2 by LRU.
-// #3 and #4 could use the lea instruction if b and c are already in
-// registers.
-// The cmp/fcmp instruction is like a commutative arithmetic instruction.
+// Example:
+//   a = b + c; d = a + b
+// r1 = b; r1 += c; a = r1;   r2 = (r1==a); r2 += b; d = r2;
+// The second instruction reuses r1 instead of reloading a, and "b"
+// could come from any other register that still holds it.
 
 class IceRegManagerEntry {
 public:
-  static IceRegManagerEntry *create(IceCfg *Cfg, IceVariable *Var,
-                                    unsigned NumReg) {
-    return new IceRegManagerEntry(Cfg, Var, NumReg);
+  static IceRegManagerEntry *create(IceCfg *Cfg, int RegNum) {
+    return new IceRegManagerEntry(Cfg, RegNum);
   }
-  static IceRegManagerEntry *
-  create(IceCfg *Cfg, const IceRegManagerEntry &Other, unsigned NumReg) {
-    return new IceRegManagerEntry(Cfg, Other, NumReg);
+  static IceRegManagerEntry *create(IceCfg *Cfg,
+                                    const IceRegManagerEntry &Other) {
+    return new IceRegManagerEntry(Cfg, Other);
   }
-  void load(IceInst *Inst);
-  void store(IceInst *Inst);
+  void load(IceOperand *Operand);
+  void copy(const IceRegManagerEntry &Other);
+  void store(IceVariable *Variable);
+  void remove(const IceOperand *Operand);
+  void intersect(const IceRegManagerEntry &Other);
   bool contains(const IceOperand *Operand) const;
-  IceVariable *getVar(void) const { return Var; }
+  bool isEmpty(void) const { return Available.empty(); }
+  int getRegNum(void) const { return RegNum; }
   void dump(IceOstream &Str) const;
 
 private:
-  IceRegManagerEntry(IceCfg *Cfg, IceVariable *Var, unsigned NumReg);
-  IceRegManagerEntry(IceCfg *Cfg, const IceRegManagerEntry &Other,
-                     unsigned NumReg);
+  IceRegManagerEntry(IceCfg *Cfg, int RegNum);
+  IceRegManagerEntry(IceCfg *Cfg, const IceRegManagerEntry &Other);
 
-  // Virtual register.
-  IceVariable *const Var;
+  // Physical register.
+  const int RegNum;
 
-  // Set of operands currently available in the virtual register.
+  // Set of operands currently available in the register.
   IceOpList Available;
 };
 
-// TODO: Use some "virtual register" subclass of IceVariable.
 class IceRegManager {
 public:
   typedef std::vector<IceRegManagerEntry *> QueueType;
-  // Initialize a brand new register manager.
-  static IceRegManager *create(IceCfg *Cfg, IceCfgNode *Node, unsigned NumReg) {
-    return new IceRegManager(Cfg, Node, NumReg);
+  // Initialize a brand new register manager for the given physical
+  // registers, none of which hold anything yet.
+  static IceRegManager *create(IceCfg *Cfg,
+                               const llvm::SmallBitVector &Registers) {
+    return new IceRegManager(Cfg, Registers);
   }
   // Capture the predecessor's end-of-block state for an extended
   // basic block.
   static IceRegManager *create(const IceRegManager &Other) {
     return new IceRegManager(Other);
   }
-  // TODO: Are these IceVariable instances duplicated across
-  // IceRegManager objects?
-  IceVariable *getRegister(IceType Type, const IceOpList &Prefer,
-                           const IceVarList &Avoid) const;
-  bool registerContains(const IceVariable *Reg, const IceOperand *Op) const;
-  void notifyLoad(IceInst *Inst, bool IsAssign = true);
-  void notifyStore(IceInst *Inst);
+  ~IceRegManager();
+  int getRegister(const llvm::SmallBitVector &Allowed) const;
+  int findRegister(const IceOperand *Operand,
+                   const llvm::SmallBitVector &Allowed) const;
+  bool registerContains(int RegNum, const IceOperand *Op) const;
+  void notifyLoad(int RegNum, IceOperand *Operand);
+  void notifyStore(int RegNum, IceVariable *Variable);
+  void notifyUse(int RegNum);
+  void notifyDef(const IceVariable *Variable);
+  void notifyKill(int RegNum) { notifyLoad(RegNum, NULL); }
+  void killAll(void);
+  void intersect(const IceRegManager &Other);
   void dump(IceOstream &Str) const;
 
 private:
-  IceRegManager(IceCfg *Cfg, IceCfgNode *Node, unsigned NumReg);
+  IceRegManager(IceCfg *Cfg, const llvm::SmallBitVector &Registers);
   IceRegManager(const IceRegManager &Other);
-  const unsigned NumReg;
+  QueueType::iterator find(int RegNum);
+  QueueType::const_iterator find(int RegNum) const;
   // The LRU register queue.  The front element is the least recently
   // used and the next to be assigned.
-  // TODO: Multiple queues by type.
   QueueType Queue;
   IceCfg *Cfg;
 };
@@ -4,6 +4,7 @@
  */
 
 #include "IceCfg.h" // setError()
+#include "IceOperand.h"
 #include "IceTargetLowering.h"
 #include "IceTargetLoweringX8632.h"
 
@@ -27,6 +28,54 @@ IceTargetLowering *IceTargetLowering::createLowering(IceTargetArch Target,
   return NULL;
 }
 
+const llvm::SmallBitVector &
+IceTargetLowering::getRegisterSetForVariable(const IceVariable *Var) const {
+  return getRegisterSetForType(Var->getType());
+}
+
+IceInst *IceLoweringCursor::peek(unsigned Index) const {
+  if (!HasLookahead)
+    return NULL;
+  for (IceInstList::iterator I = Cur; I != End; ++I) {
+    if ((*I)->isDeleted())
+      continue;
+    if (Index == 0)
+      return *I;
+    --Index;
+  }
+  return NULL;
+}
+
+void IceLoweringCursor::consume(unsigned Count) const {
+  for (; Count > 0; --Count) {
+    IceInst *Inst = peek();
+    assert(Inst);
+    Inst->setDeleted();
+  }
+}
+
+bool IceLoweringCursor::isOnlyUseWithin(const IceVariable *Var,
+                                        unsigned Count) const {
+  if (!HasLookahead)
+    return false;
+  for (IceInstList::iterator Iter = Cur; Iter != End && Count > 0; ++Iter) {
+    IceInst *Inst = *Iter;
+    if (Inst->isDeleted())
+      continue;
+    --Count;
+    for (unsigned I = 0; I < Inst->getSrcSize(); ++I) {
+      IceOperand *Src = Inst->getSrc(I);
+      for (unsigned J = 0; J < Src->getNumVars(); ++J) {
+        if (Src->getVar(J) == Var)
+          return Inst->isLastUse(Var);
+      }
+    }
+    if (Inst->getDest() == Var)
+      return false;
+  }
+  return false;
+}
+
 IceInstList IceTargetLowering::doAddressOpt(const IceInst *Inst) {
   if (const IceInstLoad *I = llvm::dyn_cast<const IceInstLoad>(Inst))
     return doAddressOptLoad(I);
@@ -35,64 +84,52 @@ IceInstList IceTargetLowering::doAddressOpt(const IceInst *Inst) {
   return IceInstList();
 }
 
-IceInstList IceTargetLowering::lower(const IceInst *Inst, const IceInst *Next,
-                                     bool &DeleteNextInst) {
+IceInstList IceTargetLowering::lower(const IceInst *Inst,
+                                     const IceLoweringCursor &Cursor) {
   IceInstList Expansion;
   switch (Inst->getKind()) {
   case IceInst::Alloca:
-    Expansion =
-        lowerAlloca(llvm::dyn_cast<IceInstAlloca>(Inst), Next, DeleteNextInst);
+    Expansion = lowerAlloca(llvm::dyn_cast<IceInstAlloca>(Inst), Cursor);
     break;
   case IceInst::Arithmetic:
-    Expansion = lowerArithmetic(llvm::dyn_cast<IceInstArithmetic>(Inst), Next,
-                                DeleteNextInst);
+    Expansion =
+        lowerArithmetic(llvm::dyn_cast<IceInstArithmetic>(Inst), Cursor);
     break;
   case IceInst::Assign:
-    Expansion =
-        lowerAssign(llvm::dyn_cast<IceInstAssign>(Inst), Next, DeleteNextInst);
+    Expansion = lowerAssign(llvm::dyn_cast<IceInstAssign>(Inst), Cursor);
     break;
   case IceInst::Br:
-    Expansion = lowerBr(llvm::dyn_cast<IceInstBr>(Inst), Next, DeleteNextInst);
+    Expansion = lowerBr(llvm::dyn_cast<IceInstBr>(Inst), Cursor);
     break;
   case IceInst::Call:
-    Expansion =
-        lowerCall(llvm::dyn_cast<IceInstCall>(Inst), Next, DeleteNextInst);
+    Expansion = lowerCall(llvm::dyn_cast<IceInstCall>(Inst), Cursor);
     break;
   case IceInst::Cast:
-    Expansion =
-        lowerCast(llvm::dyn_cast<IceInstCast>(Inst), Next, DeleteNextInst);
+    Expansion = lowerCast(llvm::dyn_cast<IceInstCast>(Inst), Cursor);
     break;
   case IceInst::Fcmp:
-    Expansion =
-        lowerFcmp(llvm::dyn_cast<IceInstFcmp>(Inst), Next, DeleteNextInst);
+    Expansion = lowerFcmp(llvm::dyn_cast<IceInstFcmp>(Inst), Cursor);
     break;
   case IceInst::Icmp:
-    Expansion =
-        lowerIcmp(llvm::dyn_cast<IceInstIcmp>(Inst), Next, DeleteNextInst);
+    Expansion = lowerIcmp(llvm::dyn_cast<IceInstIcmp>(Inst), Cursor);
     break;
   case IceInst::Load:
-    Expansion =
-        lowerLoad(llvm::dyn_cast<IceInstLoad>(Inst), Next, DeleteNextInst);
+    Expansion = lowerLoad(llvm::dyn_cast<IceInstLoad>(Inst), Cursor);
     break;
   case IceInst::Phi:
-    Expansion =
-        lowerPhi(llvm::dyn_cast<IceInstPhi>(Inst), Next, DeleteNextInst);
+    Expansion = lowerPhi(llvm::dyn_cast<IceInstPhi>(Inst), Cursor);
     break;
   case IceInst::Ret:
-    Expansion =
-        lowerRet(llvm::dyn_cast<IceInstRet>(Inst), Next, DeleteNextInst);
+    Expansion = lowerRet(llvm::dyn_cast<IceInstRet>(Inst), Cursor);
     break;
   case IceInst::Select:
-    Expansion =
-        lowerSelect(llvm::dyn_cast<IceInstSelect>(Inst), Next, DeleteNextInst);
+    Expansion = lowerSelect(llvm::dyn_cast<IceInstSelect>(Inst), Cursor);
     break;
   case IceInst::Store:
-    Expansion =
-        lowerStore(llvm::dyn_cast<IceInstStore>(Inst), Next, DeleteNextInst);
+    Expansion = lowerStore(llvm::dyn_cast<IceInstStore>(Inst), Cursor);
     break;
   case IceInst::Switch:
-    Expansion =
-        lowerSwitch(llvm::dyn_cast<IceInstSwitch>(Inst), Next, DeleteNextInst);
+    Expansion = lowerSwitch(llvm::dyn_cast<IceInstSwitch>(Inst), Cursor);
     break;
   case IceInst::FakeDef:
   case IceInst::FakeUse:
@@ -12,6 +12,33 @@
 
 #include "IceInst.h" // for the names of the IceInst subtypes
 
+// IceLoweringCursor gives target lowering a view of the instructions
+// that follow the one being lowered, for peephole optimizations such
+// as compare/branch fusing.  Deleted instructions are skipped, so
+// lowering can look arbitrarily far ahead, and it can consume the
+// instructions that it fuses into the current expansion.  A
+// default-constructed cursor has no lookahead, which is what the
+// lowering of a synthesized instruction should get.
+class IceLoweringCursor {
+public:
+  IceLoweringCursor(void) : Cur(), End(), HasLookahead(false) {}
+  IceLoweringCursor(IceInstList::iterator Cur, IceInstList::iterator End)
+      : Cur(Cur), End(End), HasLookahead(true) {}
+  // Returns the Index'th instruction after the current one, counting
+  // from 0, or NULL if the block ends before that.
+  IceInst *peek(unsigned Index = 0) const;
+  // Deletes the next Count instructions, which have been folded into
+  // the current instruction's expansion.
+  void consume(unsigned Count = 1) const;
+  // Returns true if the first of the next Count instructions that
+  // mentions Var uses it and ends its live range.
+  bool isOnlyUseWithin(const IceVariable *Var, unsigned Count) const;
+
+private:
+  IceInstList::iterator Cur, End;
+  bool HasLookahead;
+};
+
 class IceTargetLowering {
 public:
   static IceTargetLowering *createLowering(IceTargetArch Target, IceCfg *Cfg);
@@ -20,11 +47,22 @@ public:
   }
 
   IceInstList doAddressOpt(const IceInst *Inst);
-  IceInstList lower(const IceInst *Inst, const IceInst *Next,
-                    bool &DeleteNextInst);
+  // Folds the Load into User, which must be the last use of the
+  // Load's Dest, and returns true if the target can use the loaded
+  // memory operand directly.  The Load is then deleted by the caller.
+  virtual bool foldLoad(const IceInstLoad *Load, IceInst *User) {
+    return false;
+  }
+  IceInstList lower(const IceInst *Inst, const IceLoweringCursor &Cursor);
   virtual IceVariable *getPhysicalRegister(unsigned RegNum) = 0;
-  virtual IceString getRegName(int RegNum) const = 0;
+  virtual const IceString &getRegName(int RegNum) const = 0;
   virtual bool hasFramePointer(void) const { return false; }
+  // Returns true if the lowered code calls other functions, which
+  // makes the callee-saved registers worth saving.
+  virtual bool hasCalls(void) const { return true; }
+  // Returns true if addProlog() found no need for a stack frame
+  // beyond the callee-save pushes.
+  virtual bool hasLeafFrame(void) const { return false; }
   virtual unsigned getFrameOrStackReg(void) const = 0;
   virtual uint32_t typeWidthOnStack(IceType Type) = 0;
   bool hasComputedFrame(void) const { return HasComputedFrame; }
@@ -47,8 +85,17 @@ public:
                  RegSetMask Exclude = RegMask_None) const = 0;
   virtual const llvm::SmallBitVector &
   getRegisterSetForType(IceType Type) const = 0;
+  // Returns the registers that the register allocator may assign to
+  // Var, which by default are the ones for its type.
+  virtual const llvm::SmallBitVector &
+  getRegisterSetForVariable(const IceVariable *Var) const;
   virtual void addProlog(IceCfgNode *Node) = 0;
   virtual void addEpilog(IceCfgNode *Node) = 0;
+  // Optimizes a branch in light of the node laid out next, if any.
+  virtual void doBranchOpt(IceInst *Inst, const IceCfgNode *NextNode) {}
+  // Returns a new integrated assembler, or NULL if the target has
+  // none.
+  virtual IceAssembler *createAssembler(void) { return NULL; }
 
   virtual ~IceTargetLowering() {}
 
@@ -57,38 +104,33 @@ protected:
       : Cfg(Cfg), HasComputedFrame(false), StackAdjustment(0),
         CurrentNode(NULL) {}
   virtual IceInstList lowerAlloca(const IceInstAlloca *Inst,
-                                  const IceInst *Next,
-                                  bool &DeleteNextInst) = 0;
+                                  const IceLoweringCursor &Cursor) = 0;
   virtual IceInstList lowerArithmetic(const IceInstArithmetic *Inst,
-                                      const IceInst *Next,
-                                      bool &DeleteNextInst) = 0;
+                                      const IceLoweringCursor &Cursor) = 0;
   virtual IceInstList lowerAssign(const IceInstAssign *Inst,
-                                  const IceInst *Next,
-                                  bool &DeleteNextInst) = 0;
-  virtual IceInstList lowerBr(const IceInstBr *Inst, const IceInst *Next,
-                              bool &DeleteNextInst) = 0;
-  virtual IceInstList lowerCall(const IceInstCall *Inst, const IceInst *Next,
-                                bool &DeleteNextInst) = 0;
-  virtual IceInstList lowerCast(const IceInstCast *Inst, const IceInst *Next,
-                                bool &DeleteNextInst) = 0;
-  virtual IceInstList lowerFcmp(const IceInstFcmp *Inst, const IceInst *Next,
-                                bool &DeleteNextInst) = 0;
-  virtual IceInstList lowerIcmp(const IceInstIcmp *Inst, const IceInst *Next,
-                                bool &DeleteNextInst) = 0;
-  virtual IceInstList lowerLoad(const IceInstLoad *Inst, const IceInst *Next,
-                                bool &DeleteNextInst) = 0;
-  virtual IceInstList lowerPhi(const IceInstPhi *Inst, const IceInst *Next,
-                               bool &DeleteNextInst) = 0;
-  virtual IceInstList lowerRet(const IceInstRet *Inst, const IceInst *Next,
-                               bool &DeleteNextInst) = 0;
+                                  const IceLoweringCursor &Cursor) = 0;
+  virtual IceInstList lowerBr(const IceInstBr *Inst,
+                              const IceLoweringCursor &Cursor) = 0;
+  virtual IceInstList lowerCall(const IceInstCall *Inst,
+                                const IceLoweringCursor &Cursor) = 0;
+  virtual IceInstList lowerCast(const IceInstCast *Inst,
+                                const IceLoweringCursor &Cursor) = 0;
+  virtual IceInstList lowerFcmp(const IceInstFcmp *Inst,
+                                const IceLoweringCursor &Cursor) = 0;
+  virtual IceInstList lowerIcmp(const IceInstIcmp *Inst,
+                                const IceLoweringCursor &Cursor) = 0;
+  virtual IceInstList lowerLoad(const IceInstLoad *Inst,
+                                const IceLoweringCursor &Cursor) = 0;
+  virtual IceInstList lowerPhi(const IceInstPhi *Inst,
+                               const IceLoweringCursor &Cursor) = 0;
+  virtual IceInstList lowerRet(const IceInstRet *Inst,
+                               const IceLoweringCursor &Cursor) = 0;
   virtual IceInstList lowerSelect(const IceInstSelect *Inst,
-                                  const IceInst *Next,
-                                  bool &DeleteNextInst) = 0;
-  virtual IceInstList lowerStore(const IceInstStore *Inst, const IceInst *Next,
-                                 bool &DeleteNextInst) = 0;
+                                  const IceLoweringCursor &Cursor) = 0;
+  virtual IceInstList lowerStore(const IceInstStore *Inst,
+                                 const IceLoweringCursor &Cursor) = 0;
   virtual IceInstList lowerSwitch(const IceInstSwitch *Inst,
-                                  const IceInst *Next,
-                                  bool &DeleteNextInst) = 0;
+                                  const IceLoweringCursor &Cursor) = 0;
 
   virtual IceInstList doAddressOptLoad(const IceInstLoad *Inst) {
     return IceInstList();
@@ -3,26 +3,39 @@
  * be found in the LICENSE file.
  */
 
+#include <algorithm> // std::reverse, std::sort, etc.
+
 #include "IceDefs.h"
 #include "IceCfg.h"
 #include "IceCfgNode.h"
+#include "IceAssemblerX8632.h"
 #include "IceInstX8632.h"
 #include "IceOperand.h"
+#include "IceRegAlloc.h"
 #include "IceTargetLoweringX8632.h"
 
 IceTargetX8632::IceTargetX8632(IceCfg *Cfg)
     : IceTargetLowering(Cfg), IsEbpBasedFrame(false), FrameSizeLocals(0),
-      LocalsSizeBytes(0), NextLabelNumber(0), ComputedLiveRanges(false),
+      InArgsOffset(0), HasCalls(false), IsLeafFrame(false), HasAllocas(false),
+      HasDynamicAllocas(false), MaxOutArgsSize(0), StaticAllocaSize(0),
+      StaticAllocaAlign(1),
+      NextLabelNumber(0), ComputedLiveRanges(false),
       PhysicalRegisters(IceVarList(Reg_NUM)) {
   llvm::SmallBitVector IntegerRegisters(Reg_NUM);
   llvm::SmallBitVector FloatRegisters(Reg_NUM);
   llvm::SmallBitVector InvalidRegisters(Reg_NUM);
+  ByteRegisters.resize(Reg_NUM);
   for (unsigned i = Reg_eax; i <= Reg_edi; ++i)
     IntegerRegisters[i] = true;
+  for (unsigned i = Reg_eax; i <= Reg_ebx; ++i)
+    ByteRegisters[i] = true;
   for (unsigned i = Reg_xmm0; i <= Reg_xmm7; ++i)
     FloatRegisters[i] = true;
   TypeToRegisterSet[IceType_void] = InvalidRegisters;
-  TypeToRegisterSet[IceType_i1] = IntegerRegisters;
+  // setcc can only write a byte register.  Other 8-bit values are
+  // held in 32-bit registers, and only the instructions that have to
+  // name the byte register get a temporary from makeByteReg().
+  TypeToRegisterSet[IceType_i1] = ByteRegisters;
   TypeToRegisterSet[IceType_i8] = IntegerRegisters;
   TypeToRegisterSet[IceType_i16] = IntegerRegisters;
   TypeToRegisterSet[IceType_i32] = IntegerRegisters;
@@ -51,6 +64,11 @@ void IceTargetX8632::translate(void) {
   if (Cfg->hasError())
     return;
   T_deletePhis.printElapsedUs(Cfg->Str, "deletePhis()");
+  IceTimer T_reorderNodes;
+  Cfg->reorderNodes();
+  if (Cfg->hasError())
+    return;
+  T_reorderNodes.printElapsedUs(Cfg->Str, "reorderNodes()");
   IceTimer T_renumber1;
   Cfg->renumberInstructions();
   if (Cfg->hasError())
@@ -69,13 +87,11 @@ void IceTargetX8632::translate(void) {
   if (Cfg->hasError())
     return;
   T_renumber2.printElapsedUs(Cfg->Str, "renumberInstructions()");
-  // TODO: It should be sufficient to use the fastest livness
-  // calculation, i.e. IceLiveness_LREndLightweight.  However,
-  // currently this breaks one test (icmp-simple.ll) because with
-  // IceLiveness_LREndFull, the problematic instructions get dead-code
-  // eliminated.
+  // Copy coalescing needs full live ranges.  The LREnd information
+  // computed along the way remains valid after coalescing, since
+  // coalescing only merges variables whose live ranges don't overlap.
   IceTimer T_liveness1;
-  Cfg->liveness(IceLiveness_LREndFull);
+  Cfg->liveness(IceLiveness_RangesFull);
   if (Cfg->hasError())
     return;
   T_liveness1.printElapsedUs(Cfg->Str, "liveness()");
@@ -83,6 +99,18 @@ void IceTargetX8632::translate(void) {
     Cfg->Str
         << "================ After x86 address mode opt ================\n";
   Cfg->dump();
+  IceTimer T_coalesceCopies;
+  Cfg->coalesceCopies();
+  if (Cfg->hasError())
+    return;
+  T_coalesceCopies.printElapsedUs(Cfg->Str, "coalesceCopies()");
+  if (Cfg->Str.isVerbose())
+    Cfg->Str << "================ After copy coalescing ================\n";
+  Cfg->dump();
+  IceTimer T_doLoadFolding;
+  Cfg->doLoadFolding();
+  T_doLoadFolding.printElapsedUs(Cfg->Str, "doLoadFolding()");
+  findFrameRequirements();
   IceTimer T_genCode;
   Cfg->genCode();
   if (Cfg->hasError())
@@ -119,6 +147,16 @@ void IceTargetX8632::translate(void) {
   if (Cfg->hasError())
     return;
   T_genFrame.printElapsedUs(Cfg->Str, "genFrame()");
+  IceTimer T_doBranchOpt;
+  Cfg->doBranchOpt();
+  if (Cfg->hasError())
+    return;
+  T_doBranchOpt.printElapsedUs(Cfg->Str, "doBranchOpt()");
+  IceTimer T_alignLoops;
+  Cfg->alignLoops();
+  if (Cfg->hasError())
+    return;
+  T_alignLoops.printElapsedUs(Cfg->Str, "alignLoops()");
   if (Cfg->Str.isVerbose())
     Cfg->Str << "================ After stack frame mapping ================\n";
   Cfg->dump();
@@ -176,6 +214,53 @@ void IceTargetX8632::setArgOffsetAndCopy(IceVariable *Arg,
   InArgsSizeBytes += typeWidthOnStack(Type);
 }
 
+// Sorts variables by the start of their live ranges.
+static bool compareLiveRangeStart(const IceVariable *A, const IceVariable *B) {
+  return A->getLiveRange().getStart() < B->getLiveRange().getStart();
+}
+
+// Assigns stack slots to the variables in Spilled, letting variables
+// whose live ranges don't overlap share a slot.  Slots are colored
+// separately for each stack width, so an f64 never shares with a pair
+// of i32 variables.  The 8-byte slots come first so that they stay
+// 8-byte aligned relative to the start of the area.  On return,
+// SlotEnd[Var->getIndex()] is the offset of the end of Var's slot
+// from the start of the spill area, and the size of the area is
+// returned.
+int IceTargetX8632::assignSpillSlots(IceVarList &Spilled,
+                                     std::vector<int> &SlotEnd) {
+  std::stable_sort(Spilled.begin(), Spilled.end(), compareLiveRangeStart);
+  const unsigned NumWidths = 2; // 4 and 8 bytes
+  // Slots[w] holds the live range segments of each slot's occupants,
+  // keyed by slot number.
+  IceRegSegmentIndex Slots[NumWidths];
+  uint32_t NumSlots[NumWidths] = { 0, 0 };
+  std::vector<uint32_t> SlotIndex(Spilled.size());
+  for (unsigned i = 0; i < Spilled.size(); ++i) {
+    IceVariable *Var = Spilled[i];
+    unsigned Width = typeWidthOnStack(Var->getType());
+    assert(Width == 4 || Width == 8);
+    const unsigned W = Width / 8;
+    const IceLiveRange &Range = Var->getLiveRange();
+    uint32_t Slot = 0;
+    while (Slot < NumSlots[W] && Slots[W].overlaps(Slot, Range))
+      ++Slot;
+    if (Slot == NumSlots[W])
+      ++NumSlots[W];
+    Slots[W].insert(Slot, Range);
+    SlotIndex[i] = Slot;
+  }
+  int Size8 = 8 * NumSlots[1];
+  for (unsigned i = 0; i < Spilled.size(); ++i) {
+    IceVariable *Var = Spilled[i];
+    if (typeWidthOnStack(Var->getType()) == 8)
+      SlotEnd[Var->getIndex()] = 8 * (SlotIndex[i] + 1);
+    else
+      SlotEnd[Var->getIndex()] = Size8 + 4 * (SlotIndex[i] + 1);
+  }
+  return Size8 + 4 * NumSlots[0];
+}
+
 void IceTargetX8632::addProlog(IceCfgNode *Node) {
   const bool SimpleCoalescing = true;
   IceInstList Expansion;
@@ -193,13 +278,17 @@ void IceTargetX8632::addProlog(IceCfgNode *Node) {
   // A middle ground approach is to leverage sparsity and allocate one
   // block of space on the frame for globals (variables with
   // multi-block lifetime), and one block to share for locals
-  // (single-block lifetime).
+  // (single-block lifetime).  That is what is done when live ranges
+  // haven't been computed.  Otherwise, assignSpillSlots() lets any
+  // variables with non-overlapping live ranges share a slot.
 
   llvm::SmallBitVector CalleeSaves =
       getRegisterSet(IceTargetLowering::RegMask_CalleeSave);
 
   int GlobalsSize = 0;
   std::vector<int> LocalsSize(Cfg->getNumNodes());
+  IceVarList Spilled;
+  std::vector<int> SlotEnd;
 
   // Prepass.  Compute RegsUsed, PreservedRegsSizeBytes, and
   // LocalsSizeBytes.
@@ -220,7 +309,9 @@ void IceTargetX8632::addProlog(IceCfgNode *Node) {
     if (ComputedLiveRanges && Var->getLiveRange().isEmpty())
       continue;
     int Increment = typeWidthOnStack(Var->getType());
-    if (SimpleCoalescing) {
+    if (ComputedLiveRanges) {
+      Spilled.push_back(Var);
+    } else if (SimpleCoalescing) {
       if (Var->isMultiblockLife()) {
         GlobalsSize += Increment;
       } else {
@@ -234,13 +325,26 @@ void IceTargetX8632::addProlog(IceCfgNode *Node) {
     }
   }
   LocalsSizeBytes += GlobalsSize;
+  if (ComputedLiveRanges) {
+    SlotEnd.resize(Variables.size());
+    LocalsSizeBytes = assignSpillSlots(Spilled, SlotEnd);
+  }
+  // The static alloca area, which begins with the outgoing-argument
+  // area, goes below the spill area, at esp.
+  int StaticAllocaSizeBytes = (StaticAllocaSize + 3) & ~3;
+  LocalsSizeBytes += StaticAllocaSizeBytes;
+
+  // A leaf function that needs no stack slots gets no frame beyond
+  // the callee-save pushes, and its arguments are addressed directly
+  // from esp.
+  IsLeafFrame = !HasCalls && !IsEbpBasedFrame && LocalsSizeBytes == 0;
 
   // Add push instructions for preserved registers.
   for (unsigned i = 0; i < CalleeSaves.size(); ++i) {
     if (CalleeSaves[i] && RegsUsed[i]) {
       PreservedRegsSizeBytes += 4;
       Expansion.push_back(
-          IceInstX8632Push::create(Cfg, getPhysicalRegister(i)));
+          IceInstX8632Push::create(Cfg, getPhysicalRegister(i), true));
     }
   }
 
@@ -250,7 +354,7 @@ void IceTargetX8632::addProlog(IceCfgNode *Node) {
                .count() == 0);
     PreservedRegsSizeBytes += 4;
     Expansion.push_back(
-        IceInstX8632Push::create(Cfg, getPhysicalRegister(Reg_ebp)));
+        IceInstX8632Push::create(Cfg, getPhysicalRegister(Reg_ebp), true));
     Expansion.push_back(IceInstX8632Mov::create(
         Cfg, getPhysicalRegister(Reg_ebp), getPhysicalRegister(Reg_esp)));
   }
@@ -261,6 +365,15 @@ void IceTargetX8632::addProlog(IceCfgNode *Node) {
         Cfg, getPhysicalRegister(Reg_esp),
         Cfg->getConstantInt(IceType_i32, LocalsSizeBytes)));
 
+  // Generate "and esp, -StaticAllocaAlign" to align the static alloca
+  // area.  The ebp-based frame restores esp in the epilog.
+  if (StaticAllocaAlign > 4) {
+    assert(IsEbpBasedFrame);
+    Expansion.push_back(IceInstX8632And::create(
+        Cfg, getPhysicalRegister(Reg_esp),
+        Cfg->getConstantInt(IceType_i32, -StaticAllocaAlign)));
+  }
+
   resetStackAdjustment();
 
   // Fill in stack offsets for locals.
@@ -282,7 +395,9 @@ void IceTargetX8632::addProlog(IceCfgNode *Node) {
     if (ComputedLiveRanges && Var->getLiveRange().isEmpty())
       continue;
     int Increment = typeWidthOnStack(Var->getType());
-    if (SimpleCoalescing) {
+    if (ComputedLiveRanges) {
+      NextStackOffset = SlotEnd[Var->getIndex()];
+    } else if (SimpleCoalescing) {
       if (Var->isMultiblockLife()) {
         GlobalsSize += Increment;
         NextStackOffset = GlobalsSize;
@@ -299,8 +414,7 @@ void IceTargetX8632::addProlog(IceCfgNode *Node) {
     else
       Var->setStackOffset(LocalsSizeBytes - NextStackOffset);
   }
-  LocalsSizeBytes = NextStackOffset;
-  this->FrameSizeLocals = NextStackOffset;
+  this->FrameSizeLocals = LocalsSizeBytes;
   this->HasComputedFrame = true;
 
   // Fill in stack offsets for args, and copy args into registers for
@@ -317,21 +431,20 @@ void IceTargetX8632::addProlog(IceCfgNode *Node) {
   int BasicFrameOffset = PreservedRegsSizeBytes + RetIpSizeBytes;
   if (!IsEbpBasedFrame)
     BasicFrameOffset += LocalsSizeBytes;
+  InArgsOffset = BasicFrameOffset;
   for (unsigned i = 0; i < Args.size(); ++i) {
     IceVariable *Arg = Args[i];
     setArgOffsetAndCopy(Arg, FramePtr, BasicFrameOffset, InArgsSizeBytes,
                         Expansion);
   }
 
-  // TODO: If esp is adjusted during out-arg writing for a Call, any
-  // accesses to stack variables need to have their esp or ebp offsets
-  // adjusted accordingly.  This should be tracked by the assembler or
-  // emitter.
-
   if (Cfg->Str.isVerbose(IceV_Frame)) {
     Cfg->Str << "LocalsSizeBytes=" << LocalsSizeBytes << "\n"
+             << "StaticAllocaSizeBytes=" << StaticAllocaSizeBytes << "\n"
+             << "OutArgsSizeBytes=" << MaxOutArgsSize << "\n"
              << "InArgsSizeBytes=" << InArgsSizeBytes << "\n"
-             << "PreservedRegsSizeBytes=" << PreservedRegsSizeBytes << "\n";
+             << "PreservedRegsSizeBytes=" << PreservedRegsSizeBytes << "\n"
+             << "LeafFrame=" << IsLeafFrame << "\n";
   }
 
   Node->insertInsts(Node->getInsts().begin(), Expansion);
@@ -342,12 +455,34 @@ void IceTargetX8632::addEpilog(IceCfgNode *Node) {
   IceInstList &Insts = Node->getInsts();
   IceInstList::reverse_iterator RI, E;
   for (RI = Insts.rbegin(), E = Insts.rend(); RI != E; ++RI) {
-    if (llvm::isa<IceInstX8632Ret>(*RI))
+    if (llvm::isa<IceInstX8632Ret>(*RI) ||
+        llvm::isa<IceInstX8632TailCall>(*RI))
       break;
   }
   if (RI == E)
     return;
 
+  // A tail call's arguments are copied from the outgoing-argument
+  // area into the incoming-argument slots, through eax since the
+  // call's own result registers are dead here.
+  if (const IceInstX8632TailCall *TailCall =
+          llvm::dyn_cast<IceInstX8632TailCall>(*RI)) {
+    IceVariable *Esp = getPhysicalRegister(Reg_esp);
+    IceVariable *FramePtr = getPhysicalRegister(getFrameOrStackReg());
+    IceVariable *Eax = getPhysicalRegister(Reg_eax);
+    for (uint32_t Offset = 0; Offset < TailCall->getArgsSize(); Offset += 4) {
+      Expansion.push_back(IceInstX8632Mov::create(
+          Cfg, Eax, IceOperandX8632Mem::create(
+                        Cfg, IceType_i32, Esp,
+                        Cfg->getConstantInt(IceType_i32, Offset))));
+      Expansion.push_back(IceInstX8632Store::create(
+          Cfg, Eax,
+          IceOperandX8632Mem::create(
+              Cfg, IceType_i32, FramePtr,
+              Cfg->getConstantInt(IceType_i32, InArgsOffset + Offset))));
+    }
+  }
+
   if (IsEbpBasedFrame) {
     // mov esp, ebp
     Expansion.push_back(IceInstX8632Mov::create(
@@ -357,7 +492,7 @@ void IceTargetX8632::addEpilog(IceCfgNode *Node) {
         IceInstX8632Pop::create(Cfg, getPhysicalRegister(Reg_ebp)));
   } else {
     // add esp, FrameSizeLocals
-    if (LocalsSizeBytes)
+    if (FrameSizeLocals)
       Expansion.push_back(IceInstX8632Add::create(
           Cfg, getPhysicalRegister(Reg_esp),
           Cfg->getConstantInt(IceType_i32, FrameSizeLocals)));
@@ -382,6 +517,15 @@ void IceTargetX8632::addEpilog(IceCfgNode *Node) {
   Node->insertInsts(InsertPoint, Expansion);
 }
 
+void IceTargetX8632::doBranchOpt(IceInst *Inst, const IceCfgNode *NextNode) {
+  if (IceInstX8632Br *Br = llvm::dyn_cast<IceInstX8632Br>(Inst))
+    Br->optimizeBranch(NextNode);
+}
+
+IceAssembler *IceTargetX8632::createAssembler(void) {
+  return IceAssemblerX8632::create(Cfg);
+}
+
 void IceTargetX8632::split64(IceVariable *Var) {
   switch (Var->getType()) {
   default:
@@ -492,25 +636,665 @@ llvm::SmallBitVector IceTargetX8632::getRegisterSet(RegSetMask Include,
   return Registers;
 }
 
+// Bytes of scratch memory, at the bottom of the outgoing-argument
+// area, used by the inline i64/floating-point conversions.
+static const uint32_t Cast64ScratchSize = 16;
+
+// Returns the size of the outgoing arguments of the call that Inst
+// lowers to, or 0 if Inst is not lowered to a call.  This must cover
+// every helper call that the lowering may generate, as well as any
+// scratch memory that an expansion takes from the area.
+uint32_t IceTargetX8632::getOutArgsSize(const IceInst *Inst) {
+  if (const IceInstCall *Call = llvm::dyn_cast<IceInstCall>(Inst)) {
+    uint32_t Size = 0;
+    for (unsigned i = 0; i < Call->getNumArgs(); ++i)
+      Size += typeWidthOnStack(Call->getArg(i)->getType());
+    return Size;
+  }
+  if (const IceInstArithmetic *Arith =
+          llvm::dyn_cast<IceInstArithmetic>(Inst)) {
+    IceType Type = Arith->getDest()->getType();
+    switch (Arith->getOp()) {
+    case IceInstArithmetic::Frem:
+      return 2 * typeWidthOnStack(Type);
+    case IceInstArithmetic::Udiv:
+    case IceInstArithmetic::Sdiv:
+    case IceInstArithmetic::Urem:
+    case IceInstArithmetic::Srem:
+      return Type == IceType_i64 ? 2 * typeWidthOnStack(Type) : 0;
+    default:
+      return 0;
+    }
+  }
+  if (const IceInstCast *Cast = llvm::dyn_cast<IceInstCast>(Inst)) {
+    IceType SrcType = Cast->getSrc(0)->getType();
+    switch (Cast->getCastKind()) {
+    case IceInstCast::Fptosi:
+    case IceInstCast::Fptoui:
+      if (Cast->getDest()->getType() != IceType_i64)
+        return 0;
+      break;
+    case IceInstCast::Sitofp:
+    case IceInstCast::Uitofp:
+      if (SrcType != IceType_i64)
+        return 0;
+      break;
+    default:
+      return 0;
+    }
+    // The inline sequence uses the area as scratch memory.
+    if (Cfg->getOptSize())
+      return typeWidthOnStack(SrcType);
+    return Cast64ScratchSize;
+  }
+  return 0;
+}
+
+// Allocas are static unless some alloca has a non-constant size or
+// is outside the entry block, and thus may run more than once.  The
+// outgoing-argument area is sized for the largest call, and sits at
+// esp below the static alloca area.
+void IceTargetX8632::findFrameRequirements(void) {
+  HasCalls = false;
+  HasAllocas = false;
+  HasDynamicAllocas = false;
+  MaxOutArgsSize = 0;
+  const IceNodeList &Nodes = Cfg->getLNodes();
+  for (IceNodeList::const_iterator I = Nodes.begin(), E = Nodes.end(); I != E;
+       ++I) {
+    const IceInstList &Insts = (*I)->getInsts();
+    for (IceInstList::const_iterator II = Insts.begin(), IE = Insts.end();
+         II != IE; ++II) {
+      const IceInst *Inst = *II;
+      if (Inst->isDeleted())
+        continue;
+      MaxOutArgsSize = std::max(MaxOutArgsSize, getOutArgsSize(Inst));
+      if (!llvm::isa<IceInstAlloca>(Inst))
+        continue;
+      HasAllocas = true;
+      if (*I != Cfg->getEntryNode() ||
+          !llvm::isa<IceConstantInteger>(Inst->getSrc(0)))
+        HasDynamicAllocas = true;
+    }
+  }
+  StaticAllocaSize = MaxOutArgsSize;
+}
+
 IceInstList IceTargetX8632::lowerAlloca(const IceInstAlloca *Inst,
-                                        const IceInst *Next,
-                                        bool &DeleteNextInst) {
+                                        const IceLoweringCursor &Cursor) {
   IceInstList Expansion;
-  IsEbpBasedFrame = true;
-  // TODO(sehr,stichnot): align allocated memory, keep stack aligned, minimize
-  // the number of adjustments of esp, etc.
   IceVariable *Esp = Cfg->getTarget()->getPhysicalRegister(Reg_esp);
+  IceVariable *Dest = Inst->getDest();
   IceOperand *ByteCount = Inst->getSrc(0);
+  uint32_t Align = std::max(Inst->getAlign(), 1u);
+  assert((Align & (Align - 1)) == 0);
+  if (!HasDynamicAllocas) {
+    // a=alloca N ==> t=lea [esp+Offset]; a=t
+    //
+    // The static alloca area is sized and aligned by addProlog().
+    // Realigning esp needs an ebp-based frame.
+    uint32_t Size = llvm::cast<IceConstantInteger>(ByteCount)->getIntValue();
+    uint32_t Offset = (StaticAllocaSize + Align - 1) & ~(Align - 1);
+    StaticAllocaSize = Offset + Size;
+    if (Align > StaticAllocaAlign)
+      StaticAllocaAlign = Align;
+    if (Align > 4)
+      IsEbpBasedFrame = true;
+    IceVariable *T = Cfg->makeVariable(IceType_i32, CurrentNode);
+    T->setWeightInfinite();
+    Expansion.push_back(IceInstX8632Lea::create(
+        Cfg, T,
+        IceOperandX8632Mem::create(Cfg, IceType_i32, Esp,
+                                   Cfg->getConstantInt(IceType_i32, Offset))));
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, T));
+    return Expansion;
+  }
+  // a=alloca n ==> sub esp, n; and esp, -Align; a=esp; sub esp, OutArgs
+  IsEbpBasedFrame = true;
   IceOperand *TotalSize = legalizeOperand(ByteCount, Legal_All, Expansion);
   Expansion.push_back(IceInstX8632Sub::create(Cfg, Esp, TotalSize));
-  Expansion.push_back(IceInstX8632Mov::create(Cfg, Inst->getDest(), Esp));
+  // Keep esp at least 4-byte aligned.
+  uint32_t EspAlign = std::max(Align, 4u);
+  IceConstantInteger *ConstSize = llvm::dyn_cast<IceConstantInteger>(ByteCount);
+  if (ConstSize == NULL || EspAlign > 4 || ConstSize->getIntValue() % 4)
+    Expansion.push_back(IceInstX8632And::create(
+        Cfg, Esp, Cfg->getConstantInt(IceType_i32, -EspAlign)));
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, Esp));
+  // Move the outgoing-argument area below the new allocation.
+  if (MaxOutArgsSize)
+    Expansion.push_back(IceInstX8632Sub::create(
+        Cfg, Esp, Cfg->getConstantInt(IceType_i32, MaxOutArgsSize)));
   return Expansion;
 }
 
+// Computes the magic number for unsigned division by D, which must
+// not be a power of 2, following Granlund and Montgomery, "Division
+// by Invariant Integers using Multiplication" (PLDI 1994).  If the
+// return value is false, n/D = mulhi(n, Multiplier) >> Shift.
+// Otherwise the multiplier needs 33 bits, and with t = mulhi(n,
+// Multiplier), n/D = (t + ((n - t) >> 1)) >> (Shift - 1).
+static bool getUnsignedMagic(uint32_t D, uint32_t &Multiplier,
+                             unsigned &Shift) {
+  for (Shift = 0; Shift < 32; ++Shift) {
+    uint64_t Pow = 1ull << (32 + Shift);
+    uint64_t M = (Pow + D - 1) / D;
+    if (M >> 32)
+      break;
+    if (M * D - Pow <= (1ull << Shift)) {
+      Multiplier = M;
+      return false;
+    }
+  }
+  Shift = 0;
+  while ((1ull << Shift) < D)
+    ++Shift;
+  Multiplier = ((((1ull << Shift) - D) << 32) / D) + 1;
+  return true;
+}
+
+// Computes the magic number for signed division by D, where 2 <= |D|
+// < 2^31, following Hacker's Delight, section 10-4.  With q =
+// mulhi_signed(n, Multiplier), adding n if D > 0 and Multiplier < 0,
+// or subtracting n if D < 0 and Multiplier > 0, then n/D = (q >>
+// Shift) + the sign bit of (q >> Shift).
+static void getSignedMagic(int32_t D, int32_t &Multiplier, unsigned &Shift) {
+  const uint32_t Two31 = 0x80000000u;
+  uint32_t AbsD = D < 0 ? -(uint32_t)D : D;
+  uint32_t T = Two31 + ((uint32_t)D >> 31);
+  uint32_t AbsNc = T - 1 - T % AbsD;
+  unsigned P = 31;
+  uint32_t Q1 = Two31 / AbsNc, R1 = Two31 - Q1 * AbsNc;
+  uint32_t Q2 = Two31 / AbsD, R2 = Two31 - Q2 * AbsD;
+  uint32_t Delta;
+  do {
+    ++P;
+    Q1 *= 2;
+    R1 *= 2;
+    if (R1 >= AbsNc) {
+      ++Q1;
+      R1 -= AbsNc;
+    }
+    Q2 *= 2;
+    R2 *= 2;
+    if (R2 >= AbsD) {
+      ++Q2;
+      R2 -= AbsD;
+    }
+    Delta = AbsD - R2;
+  } while (Q1 < Delta || (Q1 == Delta && R1 == 0));
+  Multiplier = Q2 + 1;
+  if (D < 0)
+    Multiplier = -Multiplier;
+  Shift = P - 32;
+}
+
+// Returns the divisor if an i32 division or remainder has a constant
+// divisor and a non-constant dividend, and so can avoid the div
+// instruction.
+static IceConstantInteger *getConstantDivisor(const IceVariable *Dest,
+                                              const IceOperand *Src0,
+                                              IceOperand *Src1) {
+  if (Dest->getType() != IceType_i32 || llvm::isa<IceConstant>(Src0))
+    return NULL;
+  return llvm::dyn_cast<IceConstantInteger>(Src1);
+}
+
+static bool isPowerOf2(uint32_t Value) {
+  return Value && (Value & (Value - 1)) == 0;
+}
+
+static unsigned log2Of(uint32_t Value) {
+  unsigned Log = 0;
+  while (Value >>= 1)
+    ++Log;
+  return Log;
+}
+
+// Multiplies Src by a constant using at most two shift, lea, add, sub,
+// or neg instructions, which is never slower than imul.  Returns false
+// if Value needs a longer sequence.
+bool IceTargetX8632::lowerMulByConstant(IceVariable *Dest, IceOperand *Src,
+                                        int32_t Value,
+                                        IceInstList &Expansion) {
+  uint32_t Abs = Value < 0 ? -(uint32_t)Value : Value;
+  if (Abs < 2)
+    return false;
+  unsigned Zeros = 0;
+  while (((Abs >> Zeros) & 1) == 0)
+    ++Zeros;
+  uint32_t Odd = Abs >> Zeros;
+  unsigned NumOps = (Value < 0);
+  if (Odd == 1)
+    NumOps += 1;
+  else if (Odd == 3 || Odd == 5 || Odd == 9)
+    NumOps += 1 + (Zeros > 0);
+  else if (Zeros == 0 && (isPowerOf2(Abs + 1) || isPowerOf2(Abs - 1)))
+    NumOps += 2;
+  else
+    return false;
+  if (NumOps > 2)
+    return false;
+
+  IceVariable *T = NULL;
+  IceConstant *Shift = Cfg->getConstantInt(IceType_i32, Zeros);
+  if (Odd == 1) {
+    // t = src << k
+    T = legalizeOperandToVar(Src, Expansion);
+    Expansion.push_back(IceInstX8632Shl::create(Cfg, T, Shift));
+  } else if (Odd == 3 || Odd == 5 || Odd == 9) {
+    // t = lea [s + s*(odd-1)]; t = t << k
+    IceVariable *S = legalizeOperandToVar(Src, Expansion, true);
+    T = Cfg->makeVariable(IceType_i32, CurrentNode);
+    T->setWeightInfinite();
+    Expansion.push_back(IceInstX8632Lea::create(
+        Cfg, T, IceOperandX8632Mem::create(Cfg, IceType_i32, S, NULL, S,
+                                           log2Of(Odd - 1))));
+    if (Zeros)
+      Expansion.push_back(IceInstX8632Shl::create(Cfg, T, Shift));
+  } else {
+    // t = src << k; t = t -/+ src, for 2^k -/+ 1
+    bool IsSub = isPowerOf2(Abs + 1);
+    uint32_t Pow = IsSub ? Abs + 1 : Abs - 1;
+    IceOperand *S = legalizeOperand(Src, Legal_Reg | Legal_Mem, Expansion);
+    T = legalizeOperandToVar(S, Expansion);
+    Expansion.push_back(IceInstX8632Shl::create(
+        Cfg, T, Cfg->getConstantInt(IceType_i32, log2Of(Pow))));
+    if (IsSub)
+      Expansion.push_back(IceInstX8632Sub::create(Cfg, T, S));
+    else
+      Expansion.push_back(IceInstX8632Add::create(Cfg, T, S));
+  }
+  if (Value < 0)
+    Expansion.push_back(IceInstX8632Neg::create(Cfg, T));
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, T));
+  return true;
+}
+
+// Returns a register holding the high 32 bits of the 64-bit product
+// of Src and Multiplier, computed with the one-operand mul or imul.
+IceVariable *IceTargetX8632::makeMulHigh(IceOperand *Src, uint32_t Multiplier,
+                                         bool Signed, IceInstList &Expansion) {
+  IceVariable *Eax = legalizeOperandToVar(
+      Cfg->getConstantInt(IceType_i32, Multiplier), Expansion, false, Reg_eax);
+  IceVariable *Lo = Cfg->makeVariable(IceType_i32, CurrentNode);
+  Lo->setRegNum(Reg_eax);
+  IceVariable *Hi = Cfg->makeVariable(IceType_i32, CurrentNode);
+  Hi->setRegNum(Reg_edx);
+  Expansion.push_back(IceInstX8632Mul::create(Cfg, Lo, Eax, Src, Signed));
+  Expansion.push_back(IceInstFakeDef::create(Cfg, Hi, Lo));
+  IceVariable *T = Cfg->makeVariable(IceType_i32, CurrentNode);
+  T->setWeightInfinite();
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, T, Hi));
+  return T;
+}
+
+// Finishes a remainder lowering: dest = src - quotient * divisor.
+void IceTargetX8632::lowerRemainder(IceVariable *Dest, IceOperand *Src,
+                                    IceVariable *Quotient, uint32_t Divisor,
+                                    IceInstList &Expansion) {
+  Expansion.push_back(IceInstX8632Imul::create(
+      Cfg, Quotient, Cfg->getConstantInt(IceType_i32, Divisor)));
+  IceVariable *T = legalizeOperandToVar(Src, Expansion);
+  Expansion.push_back(IceInstX8632Sub::create(Cfg, T, Quotient));
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, T));
+}
+
+// Lowers an unsigned division or remainder by a constant without the
+// div instruction: a shift or mask for a power of 2, and otherwise a
+// multiplication by the magic number.
+bool IceTargetX8632::lowerUdivByConstant(IceVariable *Dest, IceOperand *Src,
+                                         uint32_t Divisor, bool Remainder,
+                                         IceInstList &Expansion) {
+  if (Divisor < 2)
+    return false;
+  Src = legalizeOperand(Src, Legal_Reg | Legal_Mem, Expansion);
+  if (isPowerOf2(Divisor)) {
+    // t = src >> k, or t = src & (d-1)
+    IceVariable *T = legalizeOperandToVar(Src, Expansion);
+    if (Remainder)
+      Expansion.push_back(IceInstX8632And::create(
+          Cfg, T, Cfg->getConstantInt(IceType_i32, Divisor - 1)));
+    else
+      Expansion.push_back(IceInstX8632Shr::create(
+          Cfg, T, Cfg->getConstantInt(IceType_i32, log2Of(Divisor))));
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, T));
+    return true;
+  }
+  uint32_t Multiplier;
+  unsigned Shift;
+  bool NeedsAdd = getUnsignedMagic(Divisor, Multiplier, Shift);
+  IceVariable *Q = makeMulHigh(Src, Multiplier, false, Expansion);
+  if (NeedsAdd) {
+    // q = (t + ((src - t) >> 1)) >> (s-1)
+    IceVariable *T = legalizeOperandToVar(Src, Expansion);
+    Expansion.push_back(IceInstX8632Sub::create(Cfg, T, Q));
+    Expansion.push_back(
+        IceInstX8632Shr::create(Cfg, T, Cfg->getConstantInt(IceType_i32, 1)));
+    Expansion.push_back(IceInstX8632Add::create(Cfg, T, Q));
+    Q = T;
+    --Shift;
+  }
+  if (Shift)
+    Expansion.push_back(IceInstX8632Shr::create(
+        Cfg, Q, Cfg->getConstantInt(IceType_i32, Shift)));
+  if (Remainder)
+    lowerRemainder(Dest, Src, Q, Divisor, Expansion);
+  else
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, Q));
+  return true;
+}
+
+// Lowers a signed division or remainder by a constant without the
+// idiv instruction.  Quotients round toward zero, so a negative
+// dividend is biased by d-1 before shifting for a power of 2, and the
+// magic number sequence adds 1 to a negative quotient.
+bool IceTargetX8632::lowerSdivByConstant(IceVariable *Dest, IceOperand *Src,
+                                         int32_t Divisor, bool Remainder,
+                                         IceInstList &Expansion) {
+  uint32_t Abs = Divisor < 0 ? -(uint32_t)Divisor : Divisor;
+  // INT_MIN is left to idiv, as is the division by 0 or +-1.
+  if (Abs < 2 || Abs == 0x80000000u)
+    return false;
+  Src = legalizeOperand(Src, Legal_Reg | Legal_Mem, Expansion);
+  if (isPowerOf2(Abs)) {
+    // t = src + ((src >> 31) >>> (32-k)); t = t >> k
+    unsigned Log = log2Of(Abs);
+    IceVariable *Bias = legalizeOperandToVar(Src, Expansion);
+    if (Log > 1)
+      Expansion.push_back(IceInstX8632Sar::create(
+          Cfg, Bias, Cfg->getConstantInt(IceType_i32, 31)));
+    Expansion.push_back(IceInstX8632Shr::create(
+        Cfg, Bias, Cfg->getConstantInt(IceType_i32, 32 - Log)));
+    Expansion.push_back(IceInstX8632Add::create(Cfg, Bias, Src));
+    if (Remainder) {
+      // dest = src - (t & -2^k)
+      Expansion.push_back(IceInstX8632And::create(
+          Cfg, Bias, Cfg->getConstantInt(IceType_i32, -Abs)));
+      IceVariable *T = legalizeOperandToVar(Src, Expansion);
+      Expansion.push_back(IceInstX8632Sub::create(Cfg, T, Bias));
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, T));
+      return true;
+    }
+    Expansion.push_back(IceInstX8632Sar::create(
+        Cfg, Bias, Cfg->getConstantInt(IceType_i32, Log)));
+    if (Divisor < 0)
+      Expansion.push_back(IceInstX8632Neg::create(Cfg, Bias));
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, Bias));
+    return true;
+  }
+  int32_t Multiplier;
+  unsigned Shift;
+  getSignedMagic(Divisor, Multiplier, Shift);
+  IceVariable *Q = makeMulHigh(Src, Multiplier, true, Expansion);
+  if (Divisor > 0 && Multiplier < 0)
+    Expansion.push_back(IceInstX8632Add::create(Cfg, Q, Src));
+  else if (Divisor < 0 && Multiplier > 0)
+    Expansion.push_back(IceInstX8632Sub::create(Cfg, Q, Src));
+  if (Shift)
+    Expansion.push_back(IceInstX8632Sar::create(
+        Cfg, Q, Cfg->getConstantInt(IceType_i32, Shift)));
+  // q += (q >>> 31)
+  IceVariable *Sign = legalizeOperandToVar(Q, Expansion);
+  Expansion.push_back(
+      IceInstX8632Shr::create(Cfg, Sign, Cfg->getConstantInt(IceType_i32, 31)));
+  Expansion.push_back(IceInstX8632Add::create(Cfg, Q, Sign));
+  if (Remainder)
+    lowerRemainder(Dest, Src, Q, Divisor, Expansion);
+  else
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, Q));
+  return true;
+}
+
+// Returns a new variable holding the sign of the 64-bit value whose
+// high word is Hi: -1 if negative, 0 otherwise.  It needs no
+// register, since it is only read.
+IceVariable *IceTargetX8632::makeSign64(IceVariable *Hi,
+                                        IceInstList &Expansion) {
+  IceVariable *Sign = Cfg->makeVariable(IceType_i32, CurrentNode);
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, Sign, Hi));
+  Expansion.push_back(
+      IceInstX8632Sar::create(Cfg, Sign, Cfg->getConstantInt(IceType_i32, 31)));
+  return Sign;
+}
+
+// Negates the 64-bit Lo:Hi in place if Sign is -1, and leaves it
+// unchanged if Sign is 0: x = (x ^ sign) - sign.
+void IceTargetX8632::applySign64(IceVariable *Lo, IceVariable *Hi,
+                                 IceOperand *Sign, IceInstList &Expansion) {
+  Expansion.push_back(IceInstX8632Xor::create(Cfg, Lo, Sign));
+  Expansion.push_back(IceInstX8632Xor::create(Cfg, Hi, Sign));
+  Expansion.push_back(IceInstX8632Sub::create(Cfg, Lo, Sign));
+  Expansion.push_back(IceInstX8632Sbb::create(Cfg, Hi, Sign));
+}
+
+// Lowers an i64 division or remainder by +-2^k, 0 <= k < 32, with
+// shifts.  As for i32, a negative dividend is biased by 2^k-1 so the
+// quotient rounds toward zero.  The remainder's magnitude is less
+// than 2^k, so it is computed in the low word and sign-extended.
+void IceTargetX8632::lowerDiv64ByPowerOf2(IceVariable *Dest, IceOperand *Src,
+                                          unsigned Log, bool Negative,
+                                          bool Signed, bool Remainder,
+                                          IceInstList &Expansion) {
+  IceVariable *DestLo = llvm::cast<IceVariable>(makeLowOperand(Dest));
+  IceVariable *DestHi = llvm::cast<IceVariable>(makeHighOperand(Dest));
+  IceOperand *SrcLo = makeLowOperand(Src);
+  IceOperand *SrcHi = makeHighOperand(Src);
+  IceConstant *Zero = Cfg->getConstantInt(IceType_i32, 0);
+  IceConstant *Shift = Cfg->getConstantInt(IceType_i32, Log);
+  IceConstant *Mask = Cfg->getConstantInt(IceType_i32, (1u << Log) - 1);
+  if (Log == 0) {
+    // Division by +-1, whose remainder is always 0.
+    if (Remainder) {
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, Zero));
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, Zero));
+      return;
+    }
+    IceVariable *Lo = legalizeOperandToVar(SrcLo, Expansion);
+    IceVariable *Hi = legalizeOperandToVar(SrcHi, Expansion);
+    if (Negative) {
+      Expansion.push_back(IceInstX8632Neg::create(Cfg, Lo));
+      Expansion.push_back(IceInstX8632Adc::create(Cfg, Hi, Zero));
+      Expansion.push_back(IceInstX8632Neg::create(Cfg, Hi));
+    }
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, Lo));
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, Hi));
+    return;
+  }
+  if (!Signed) {
+    // lo:hi >> k, or lo & (2^k-1)
+    IceVariable *Lo = legalizeOperandToVar(SrcLo, Expansion);
+    if (Remainder) {
+      Expansion.push_back(IceInstX8632And::create(Cfg, Lo, Mask));
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, Lo));
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, Zero));
+      return;
+    }
+    IceVariable *Hi = legalizeOperandToVar(SrcHi, Expansion);
+    Expansion.push_back(IceInstX8632Shrd::create(Cfg, Lo, Hi, Shift));
+    Expansion.push_back(IceInstX8632Shr::create(Cfg, Hi, Shift));
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, Lo));
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, Hi));
+    return;
+  }
+  // bias = (hi >> 31) >>> (32-k)
+  IceVariable *Bias = legalizeOperandToVar(SrcHi, Expansion);
+  if (Log > 1)
+    Expansion.push_back(IceInstX8632Sar::create(
+        Cfg, Bias, Cfg->getConstantInt(IceType_i32, 31)));
+  Expansion.push_back(IceInstX8632Shr::create(
+      Cfg, Bias, Cfg->getConstantInt(IceType_i32, 32 - Log)));
+  IceVariable *Lo = legalizeOperandToVar(SrcLo, Expansion);
+  Expansion.push_back(IceInstX8632Add::create(Cfg, Lo, Bias));
+  if (Remainder) {
+    // lo = ((lo + bias) & (2^k-1)) - bias; hi = lo >> 31
+    Expansion.push_back(IceInstX8632And::create(Cfg, Lo, Mask));
+    Expansion.push_back(IceInstX8632Sub::create(Cfg, Lo, Bias));
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, Lo));
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, Bias, Lo));
+    Expansion.push_back(IceInstX8632Sar::create(
+        Cfg, Bias, Cfg->getConstantInt(IceType_i32, 31)));
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, Bias));
+    return;
+  }
+  // lo:hi = (lo:hi + bias) >> k
+  IceVariable *Hi = legalizeOperandToVar(SrcHi, Expansion);
+  Expansion.push_back(IceInstX8632Adc::create(Cfg, Hi, Zero));
+  Expansion.push_back(IceInstX8632Shrd::create(Cfg, Lo, Hi, Shift));
+  Expansion.push_back(IceInstX8632Sar::create(Cfg, Hi, Shift));
+  if (Negative) {
+    Expansion.push_back(IceInstX8632Neg::create(Cfg, Lo));
+    Expansion.push_back(IceInstX8632Adc::create(Cfg, Hi, Zero));
+    Expansion.push_back(IceInstX8632Neg::create(Cfg, Hi));
+  }
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, Lo));
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, Hi));
+}
+
+// Lowers an i64 division or remainder.  The helper function is only
+// called for a divisor whose magnitude doesn't fit in 32 bits.  A
+// smaller constant divisor needs no call at all, and any other
+// divisor is tested at run time.  A 64-bit dividend is divided by a
+// 32-bit divisor with two div instructions, where the first leaves
+// the high word's remainder in edx for the second:
+//   eax = n.hi; edx = 0; div d     ; eax = q.hi
+//   eax = n.lo; div d              ; eax = q.lo, edx = remainder
+// Signed operations divide the magnitudes and then fix the signs.
+void IceTargetX8632::lowerDiv64(IceVariable *Dest, IceOperand *Src0,
+                                IceOperand *Src1, const char *HelperName,
+                                bool Signed, bool Remainder,
+                                IceInstList &Expansion) {
+  IceVariable *DestLo = llvm::cast<IceVariable>(makeLowOperand(Dest));
+  IceVariable *DestHi = llvm::cast<IceVariable>(makeHighOperand(Dest));
+  IceConstant *Zero = Cfg->getConstantInt(IceType_i32, 0);
+  IceInstX8632Label *Slow = NULL;
+  IceOperand *Divisor = NULL;
+  IceVariable *DivisorSign = NULL;
+  bool Negative = false;
+  if (IceConstantInteger *Const = llvm::dyn_cast<IceConstantInteger>(Src1)) {
+    uint64_t Abs = Const->getIntValue();
+    if (Signed && (int64_t)Abs < 0) {
+      Abs = -Abs;
+      Negative = true;
+    }
+    if (Abs && (Abs >> 32) == 0) {
+      if ((Abs & (Abs - 1)) == 0) {
+        lowerDiv64ByPowerOf2(Dest, Src0, log2Of(Abs), Negative, Signed,
+                             Remainder, Expansion);
+        return;
+      }
+      Divisor = legalizeOperandToVar(Cfg->getConstantInt(IceType_i32, Abs),
+                                     Expansion);
+    }
+  } else {
+    // Take the slow path unless the divisor's magnitude fits in 32
+    // bits.
+    IceVariable *DivisorLo = legalizeOperandToVar(makeLowOperand(Src1),
+                                                  Expansion);
+    IceVariable *DivisorHi = legalizeOperandToVar(makeHighOperand(Src1),
+                                                  Expansion);
+    if (Signed) {
+      DivisorSign = makeSign64(DivisorHi, Expansion);
+      applySign64(DivisorLo, DivisorHi, DivisorSign, Expansion);
+    }
+    Slow = IceInstX8632Label::create(Cfg, this);
+    Expansion.push_back(IceInstX8632Icmp::create(Cfg, DivisorHi, Zero));
+    Expansion.push_back(
+        IceInstX8632Br::create(Cfg, Slow, IceInstX8632Br::Br_ne));
+    Divisor = DivisorLo;
+  }
+
+  if (Divisor) {
+    IceOperand *NumLo = makeLowOperand(Src0);
+    IceOperand *NumHi = makeHighOperand(Src0);
+    // For a signed division, the high word's temporary later holds
+    // the result's high word.
+    IceVariable *Hi = NULL;
+    IceVariable *Sign = NULL;
+    if (Signed) {
+      IceVariable *Lo = legalizeOperandToVar(NumLo, Expansion);
+      Hi = legalizeOperandToVar(NumHi, Expansion);
+      Sign = makeSign64(Hi, Expansion);
+      applySign64(Lo, Hi, Sign, Expansion);
+      NumLo = Lo;
+      NumHi = Hi;
+    }
+    IceVariable *EaxHi = legalizeOperandToVar(NumHi, Expansion, false, Reg_eax);
+    IceVariable *Edx = Cfg->makeVariable(IceType_i32, CurrentNode);
+    Edx->setRegNum(Reg_edx);
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, Edx, Zero));
+    Expansion.push_back(IceInstX8632Div::create(Cfg, EaxHi, Divisor, Edx));
+    IceVariable *EdxRem = Cfg->makeVariable(IceType_i32, CurrentNode);
+    EdxRem->setRegNum(Reg_edx);
+    Expansion.push_back(IceInstFakeDef::create(Cfg, EdxRem, EaxHi));
+    if (!Remainder) {
+      if (Hi == NULL) {
+        Hi = Cfg->makeVariable(IceType_i32, CurrentNode);
+        Hi->setWeightInfinite();
+      }
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, Hi, EaxHi));
+    }
+    IceVariable *EaxLo = legalizeOperandToVar(NumLo, Expansion, false, Reg_eax);
+    IceVariable *Lo = NULL;
+    if (Remainder) {
+      Expansion.push_back(IceInstX8632Div::create(Cfg, EdxRem, Divisor, EaxLo));
+      Lo = EdxRem;
+    } else {
+      Expansion.push_back(IceInstX8632Div::create(Cfg, EaxLo, Divisor, EdxRem));
+      Lo = EaxLo;
+    }
+    if (Signed) {
+      // The remainder takes the dividend's sign, and the quotient is
+      // negative if exactly one operand is.
+      if (Remainder)
+        Expansion.push_back(IceInstX8632Mov::create(Cfg, Hi, Zero));
+      else if (Negative)
+        Expansion.push_back(IceInstX8632Xor::create(
+            Cfg, Sign, Cfg->getConstantInt(IceType_i32, -1)));
+      applySign64(Lo, Hi, Sign, Expansion);
+      if (DivisorSign && !Remainder)
+        applySign64(Lo, Hi, DivisorSign, Expansion);
+    }
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, Lo));
+    if (Hi)
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, Hi));
+    else
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, Zero));
+    if (Slow == NULL)
+      return;
+    IceInstX8632Label *Done = IceInstX8632Label::create(Cfg, this);
+    Expansion.push_back(IceInstFakeUse::create(Cfg, DestLo));
+    Expansion.push_back(IceInstFakeUse::create(Cfg, DestHi));
+    Expansion.push_back(
+        IceInstX8632Br::create(Cfg, Done, IceInstX8632Br::Br_None));
+    Expansion.push_back(Slow);
+    lowerDiv64Call(Dest, Src0, Src1, HelperName, Expansion);
+    Expansion.push_back(Done);
+    return;
+  }
+  lowerDiv64Call(Dest, Src0, Src1, HelperName, Expansion);
+}
+
+void IceTargetX8632::lowerDiv64Call(IceVariable *Dest, IceOperand *Src0,
+                                    IceOperand *Src1, const char *HelperName,
+                                    IceInstList &Expansion) {
+  unsigned MaxSrcs = 2;
+  // TODO: Figure out how to properly construct CallTarget.
+  IceConstant *CallTarget = Cfg->getConstant(IceType_i32, NULL, 0, HelperName);
+  bool Tailcall = false;
+  // TODO: This instruction leaks.
+  IceInstCall *Call =
+      IceInstCall::create(Cfg, MaxSrcs, Dest, CallTarget, Tailcall);
+  Call->addArg(Src0);
+  Call->addArg(Src1);
+  IceInstList CallExpansion = lowerCall(Call, IceLoweringCursor());
+  Expansion.splice(Expansion.end(), CallExpansion);
+}
+
 IceInstList IceTargetX8632::lowerArithmetic(const IceInstArithmetic *Inst,
-                                            const IceInst *Next,
-                                            bool &DeleteNextInst) {
+                                            const IceLoweringCursor &Cursor) {
   IceInstList Expansion;
+  if (lowerRmw(Inst, Cursor, Expansion))
+    return Expansion;
   IceVariable *Dest = Inst->getDest();
   IceOperand *Src0 = legalizeOperand(Inst->getSrc(0), Legal_All, Expansion);
   IceOperand *Src1 = legalizeOperand(Inst->getSrc(1), Legal_All, Expansion);
@@ -635,10 +1419,15 @@ IceInstList IceTargetX8632::lowerArithmetic(const IceInstArithmetic *Inst,
       Expansion.push_back(IceInstX8632Add::create(Cfg, Tmp4Hi, Tmp2));
       Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, Tmp4Hi));
     } else {
-      // TODO: Optimize for llvm::isa<IceConstant>(Src1)
-      // TODO: Strength-reduce multiplications by a constant,
-      // particularly -1 and powers of 2.  Advanced: use lea to
-      // multiply by 3, 5, 9.
+      if (llvm::isa<IceConstantInteger>(Src0))
+        std::swap(Src0, Src1);
+      if (IceConstantInteger *Const =
+              llvm::dyn_cast<IceConstantInteger>(Src1)) {
+        if (Dest->getType() == IceType_i32 &&
+            !llvm::isa<IceConstant>(Src0) &&
+            lowerMulByConstant(Dest, Src0, Const->getIntValue(), Expansion))
+          break;
+      }
       Reg1 = legalizeOperandToVar(Src0, Expansion);
       Reg2 = legalizeOperand(Src1, Legal_All, Expansion);
       Expansion.push_back(IceInstX8632Imul::create(Cfg, Reg1, Reg2));
@@ -776,18 +1565,13 @@ IceInstList IceTargetX8632::lowerArithmetic(const IceInstArithmetic *Inst,
     break;
   case IceInstArithmetic::Udiv:
     if (LowerI64ToI32) {
-      unsigned MaxSrcs = 2;
-      // TODO: Figure out how to properly construct CallTarget.
-      IceConstant *CallTarget =
-          Cfg->getConstant(IceType_i32, NULL, 0, "__udivdi3");
-      bool Tailcall = false;
-      // TODO: This instruction leaks.
-      IceInstCall *Call = IceInstCall::create(Cfg, MaxSrcs, Inst->getDest(),
-                                              CallTarget, Tailcall);
-      Call->addArg(Inst->getSrc(0));
-      Call->addArg(Inst->getSrc(1));
-      return lowerCall(Call, NULL, DeleteNextInst);
+      lowerDiv64(Dest, Src0, Src1, "__udivdi3", false, false, Expansion);
     } else {
+      if (IceConstantInteger *Divisor = getConstantDivisor(Dest, Src0, Src1)) {
+        if (lowerUdivByConstant(Dest, Src0, Divisor->getIntValue(), false,
+                                Expansion))
+          break;
+      }
       Reg1 = legalizeOperandToVar(Src0, Expansion, false, Reg_eax);
       Reg0 = Cfg->makeVariable(IceType_i32, CurrentNode);
       Reg0->setRegNum(Reg_edx);
@@ -800,18 +1584,13 @@ IceInstList IceTargetX8632::lowerArithmetic(const IceInstArithmetic *Inst,
     break;
   case IceInstArithmetic::Sdiv:
     if (LowerI64ToI32) {
-      unsigned MaxSrcs = 2;
-      // TODO: Figure out how to properly construct CallTarget.
-      IceConstant *CallTarget =
-          Cfg->getConstant(IceType_i32, NULL, 0, "__divdi3");
-      bool Tailcall = false;
-      // TODO: This instruction leaks.
-      IceInstCall *Call = IceInstCall::create(Cfg, MaxSrcs, Inst->getDest(),
-                                              CallTarget, Tailcall);
-      Call->addArg(Inst->getSrc(0));
-      Call->addArg(Inst->getSrc(1));
-      return lowerCall(Call, NULL, DeleteNextInst);
+      lowerDiv64(Dest, Src0, Src1, "__divdi3", true, false, Expansion);
     } else {
+      if (IceConstantInteger *Divisor = getConstantDivisor(Dest, Src0, Src1)) {
+        if (lowerSdivByConstant(Dest, Src0, Divisor->getIntValue(), false,
+                                Expansion))
+          break;
+      }
       Reg1 = legalizeOperandToVar(Src0, Expansion, false, Reg_eax);
       Reg0 = Cfg->makeVariable(IceType_i32, CurrentNode);
       Reg0->setRegNum(Reg_edx);
@@ -823,18 +1602,13 @@ IceInstList IceTargetX8632::lowerArithmetic(const IceInstArithmetic *Inst,
     break;
   case IceInstArithmetic::Urem:
     if (LowerI64ToI32) {
-      unsigned MaxSrcs = 2;
-      // TODO: Figure out how to properly construct CallTarget.
-      IceConstant *CallTarget =
-          Cfg->getConstant(IceType_i32, NULL, 0, "__umoddi3");
-      bool Tailcall = false;
-      // TODO: This instruction leaks.
-      IceInstCall *Call = IceInstCall::create(Cfg, MaxSrcs, Inst->getDest(),
-                                              CallTarget, Tailcall);
-      Call->addArg(Inst->getSrc(0));
-      Call->addArg(Inst->getSrc(1));
-      return lowerCall(Call, NULL, DeleteNextInst);
+      lowerDiv64(Dest, Src0, Src1, "__umoddi3", false, true, Expansion);
     } else {
+      if (IceConstantInteger *Divisor = getConstantDivisor(Dest, Src0, Src1)) {
+        if (lowerUdivByConstant(Dest, Src0, Divisor->getIntValue(), true,
+                                Expansion))
+          break;
+      }
       Reg1 = legalizeOperandToVar(Src0, Expansion, false, Reg_eax);
       Reg0 = Cfg->makeVariable(IceType_i32, CurrentNode);
       Reg0->setRegNum(Reg_edx);
@@ -848,18 +1622,13 @@ IceInstList IceTargetX8632::lowerArithmetic(const IceInstArithmetic *Inst,
     break;
   case IceInstArithmetic::Srem:
     if (LowerI64ToI32) {
-      unsigned MaxSrcs = 2;
-      // TODO: Figure out how to properly construct CallTarget.
-      IceConstant *CallTarget =
-          Cfg->getConstant(IceType_i32, NULL, 0, "__moddi3");
-      bool Tailcall = false;
-      // TODO: This instruction leaks.
-      IceInstCall *Call = IceInstCall::create(Cfg, MaxSrcs, Inst->getDest(),
-                                              CallTarget, Tailcall);
-      Call->addArg(Inst->getSrc(0));
-      Call->addArg(Inst->getSrc(1));
-      return lowerCall(Call, NULL, DeleteNextInst);
+      lowerDiv64(Dest, Src0, Src1, "__moddi3", true, true, Expansion);
     } else {
+      if (IceConstantInteger *Divisor = getConstantDivisor(Dest, Src0, Src1)) {
+        if (lowerSdivByConstant(Dest, Src0, Divisor->getIntValue(), true,
+                                Expansion))
+          break;
+      }
       Reg1 = legalizeOperandToVar(Src0, Expansion, false, Reg_eax);
       Reg0 = Cfg->makeVariable(IceType_i32, CurrentNode);
       Reg0->setRegNum(Reg_edx);
@@ -903,7 +1672,7 @@ IceInstList IceTargetX8632::lowerArithmetic(const IceInstArithmetic *Inst,
                                             CallTarget, Tailcall);
     Call->addArg(Inst->getSrc(0));
     Call->addArg(Inst->getSrc(1));
-    return lowerCall(Call, NULL, DeleteNextInst);
+    return lowerCall(Call, IceLoweringCursor());
   } break;
   case IceInstArithmetic::OpKind_NUM:
     assert(0);
@@ -913,8 +1682,7 @@ IceInstList IceTargetX8632::lowerArithmetic(const IceInstArithmetic *Inst,
 }
 
 IceInstList IceTargetX8632::lowerAssign(const IceInstAssign *Inst,
-                                        const IceInst *Next,
-                                        bool &DeleteNextInst) {
+                                        const IceLoweringCursor &Cursor) {
   IceInstList Expansion;
   IceVariable *Dest = Inst->getDest();
   IceOperand *Src0 = Inst->getSrc(0);
@@ -937,8 +1705,8 @@ IceInstList IceTargetX8632::lowerAssign(const IceInstAssign *Inst,
   return Expansion;
 }
 
-IceInstList IceTargetX8632::lowerBr(const IceInstBr *Inst, const IceInst *Next,
-                                    bool &DeleteNextInst) {
+IceInstList IceTargetX8632::lowerBr(const IceInstBr *Inst,
+                                    const IceLoweringCursor &Cursor) {
   IceInstList Expansion;
   if (Inst->getTargetTrue() == NULL) { // unconditional branch
     Expansion.push_back(IceInstX8632Br::create(Cfg, Inst->getTargetFalse()));
@@ -954,44 +1722,92 @@ IceInstList IceTargetX8632::lowerBr(const IceInstBr *Inst, const IceInst *Next,
   return Expansion;
 }
 
+// Returns true if the call, which must be marked as a tail call, is
+// immediately followed by a return of its result, and its arguments
+// fit in the incoming-argument area.  A function with allocas is
+// excluded, since the callee may be passed a pointer into the frame.
+bool IceTargetX8632::canLowerAsTailCall(const IceInstCall *Inst,
+                                        const IceLoweringCursor &Cursor) {
+  if (!Inst->isTail() || HasAllocas)
+    return false;
+  const IceInstRet *Ret = llvm::dyn_cast_or_null<IceInstRet>(Cursor.peek());
+  if (Ret == NULL)
+    return false;
+  IceVariable *Dest = Inst->getDest();
+  if (Ret->getSrcSize() ? Ret->getSrc(0) != Dest : Dest != NULL)
+    return false;
+  uint32_t InArgsSize = 0;
+  const IceVarList &Args = Cfg->getArgs();
+  for (IceVarList::const_iterator I = Args.begin(), E = Args.end(); I != E;
+       ++I)
+    InArgsSize += typeWidthOnStack((*I)->getType());
+  return getOutArgsSize(Inst) <= InArgsSize;
+}
+
 IceInstList IceTargetX8632::lowerCall(const IceInstCall *Inst,
-                                      const IceInst *Next,
-                                      bool &DeleteNextInst) {
-  // TODO: what to do about tailcalls?
+                                      const IceLoweringCursor &Cursor) {
   IceInstList Expansion;
-  // Generate a sequence of push instructions, pushing right to left,
-  // keeping track of stack offsets in case a push involves a stack
-  // operand and we are using an esp-based frame.
+  bool IsTailCall = canLowerAsTailCall(Inst, Cursor);
+  // Store the arguments left to right into the outgoing-argument
+  // area at the bottom of the frame, which findFrameRequirements()
+  // sized for the largest call.  Since esp does not move around the
+  // call, stack operands need no adjustment.
+  IceVariable *Esp = Cfg->getTarget()->getPhysicalRegister(Reg_esp);
   uint32_t StackOffset = 0;
-  // TODO: If for some reason the call instruction gets dead-code
-  // eliminated after lowering, we would need to ensure that the
-  // pre-call push instructions and the post-call esp adjustment get
-  // eliminated as well.
   for (unsigned NumArgs = Inst->getNumArgs(), i = 0; i < NumArgs; ++i) {
-    IceOperand *Arg = Inst->getArg(NumArgs - i - 1);
-    Arg = legalizeOperand(Arg, Legal_All, Expansion);
+    IceOperand *Arg = legalizeOperand(Inst->getArg(i), Legal_All, Expansion);
     assert(Arg);
-    if (Arg->getType() == IceType_i64) {
-      Expansion.push_back(IceInstX8632Push::create(Cfg, makeHighOperand(Arg)));
-      Expansion.push_back(IceInstX8632Push::create(Cfg, makeLowOperand(Arg)));
-    } else if (Arg->getType() == IceType_f64) {
-      // If the Arg turns out to be a memory operand, we need to push
-      // 8 bytes, which requires two push instructions.  This ends up
-      // being somewhat clumsy in the current IR, so we use a
-      // workaround.  Force the operand into a (xmm) register, and
-      // then push the register.  An xmm register push is actually not
-      // possible in x86, but the Push instruction emitter handles
-      // this by decrementing the stack pointer and directly writing
-      // the xmm register value.
-      IceVariable *Var = legalizeOperandToVar(Arg, Expansion);
-      Expansion.push_back(IceInstX8632Push::create(Cfg, Var));
+    IceType Type = Arg->getType();
+    if (Type == IceType_i64) {
+      IceOperand *Lo = legalizeOperand(makeLowOperand(Arg),
+                                       Legal_Reg | Legal_Imm, Expansion);
+      IceOperand *Hi = legalizeOperand(makeHighOperand(Arg),
+                                       Legal_Reg | Legal_Imm, Expansion);
+      Expansion.push_back(IceInstX8632Store::create(
+          Cfg, Lo, IceOperandX8632Mem::create(
+                       Cfg, IceType_i32, Esp,
+                       Cfg->getConstantInt(IceType_i32, StackOffset))));
+      Expansion.push_back(IceInstX8632Store::create(
+          Cfg, Hi, IceOperandX8632Mem::create(
+                       Cfg, IceType_i32, Esp,
+                       Cfg->getConstantInt(IceType_i32, StackOffset + 4))));
     } else {
-      Expansion.push_back(IceInstX8632Push::create(Cfg, Arg));
+      // Floating-point values go through an xmm register.
+      LegalMask Allowed = Legal_Reg;
+      if (Type != IceType_f32 && Type != IceType_f64)
+        Allowed |= Legal_Imm;
+      Arg = legalizeOperand(Arg, Allowed, Expansion);
+      if (Type == IceType_i8 && !llvm::isa<IceConstant>(Arg))
+        Arg = makeByteReg(Arg, Expansion);
+      Expansion.push_back(IceInstX8632Store::create(
+          Cfg, Arg, IceOperandX8632Mem::create(
+                        Cfg, Type, Esp,
+                        Cfg->getConstantInt(IceType_i32, StackOffset))));
     }
-    StackOffset += typeWidthOnStack(Arg->getType());
+    StackOffset += typeWidthOnStack(Type);
+  }
+  if (StackOffset > MaxOutArgsSize) {
+    Cfg->setError("Outgoing-argument area too small for call");
+    return Expansion;
+  }
+  if (IsTailCall) {
+    // The target must survive the epilog, so an indirect target goes
+    // in ecx, which is neither restored nor used to copy arguments.
+    IceOperand *CallTarget = Inst->getCallTarget();
+    if (!llvm::isa<IceConstantRelocatable>(CallTarget))
+      CallTarget = legalizeOperandToVar(CallTarget, Expansion, false, Reg_ecx);
+    Expansion.push_back(
+        IceInstX8632TailCall::create(Cfg, CallTarget, StackOffset));
+    IceInst *FakeUse = IceInstFakeUse::create(Cfg, Esp);
+    Expansion.push_back(FakeUse);
+    // The consumed ret marks the node as needing an epilog.
+    Cursor.consume();
+    CurrentNode->setHasReturn();
+    return Expansion;
   }
   // Generate the call instruction.  Assign its result to a temporary
   // with high register allocation weight.
+  HasCalls = true;
   IceVariable *Dest = Inst->getDest();
   IceVariable *Reg = NULL; // doubles as RegLo as necessary
   IceVariable *RegHi = NULL;
@@ -1010,6 +1826,7 @@ IceInstList IceTargetX8632::lowerCall(const IceInstCall *Inst,
       Reg->setRegNum(Reg_eax);
       break;
     case IceType_i64:
+      split64(Dest);
       Reg = Cfg->makeVariable(IceType_i32, CurrentNode);
       Reg->setRegNum(Reg_eax);
       RegHi = Cfg->makeVariable(IceType_i32, CurrentNode);
@@ -1069,29 +1886,37 @@ IceInstList IceTargetX8632::lowerCall(const IceInstCall *Inst,
       (Dest->getType() == IceType_f32 || Dest->getType() == IceType_f64)) {
     Expansion.push_back(IceInstX8632Fstp::create(Cfg, Dest));
     // If Dest ends up being a physical xmm register, the fstp emit
-    // code will route st(0) through a temporary stack slot.
-  }
-
-  // Add the appropriate offset to esp.
-  if (StackOffset) {
-    IceVariable *Esp = Cfg->getTarget()->getPhysicalRegister(Reg_esp);
-    Expansion.push_back(IceInstX8632Add::create(
-        Cfg, Esp, Cfg->getConstantInt(IceType_i32, StackOffset)));
+    // code will route st(0) through a temporary stack slot.  The fstp
+    // must stay even if Dest is unused, to pop the x87 stack.
+    Expansion.push_back(IceInstFakeUse::create(Cfg, Dest));
   }
 
   return Expansion;
 }
 
 IceInstList IceTargetX8632::lowerCast(const IceInstCast *Inst,
-                                      const IceInst *Next,
-                                      bool &DeleteNextInst) {
+                                      const IceLoweringCursor &Cursor) {
   // a = cast(b) ==> t=cast(b); a=t; (link t->b, link a->t, no overlap)
   IceInstList Expansion;
   IceInstCast::IceCastKind CastKind = Inst->getCastKind();
   IceVariable *Dest = Inst->getDest();
   IceOperand *Src0 = Inst->getSrc(0);
+  if (Dest->getType() == IceType_i64 && (CastKind == IceInstCast::Fptosi ||
+                                         CastKind == IceInstCast::Fptoui)) {
+    lowerFpToI64(Inst, Expansion);
+    return Expansion;
+  }
+  if (Src0->getType() == IceType_i64 && (CastKind == IceInstCast::Sitofp ||
+                                         CastKind == IceInstCast::Uitofp)) {
+    lowerI64ToFp(Inst, Expansion);
+    return Expansion;
+  }
   IceOperand *Reg =
       legalizeOperand(Src0, Legal_Reg | Legal_Mem, Expansion, true);
+  // movsx and movzx have to name the byte register of an 8-bit source.
+  if ((CastKind == IceInstCast::Sext || CastKind == IceInstCast::Zext) &&
+      Reg->getType() == IceType_i8 && llvm::isa<IceVariable>(Reg))
+    Reg = makeByteReg(Reg, Expansion);
   switch (CastKind) {
   default:
     // TODO: implement other sorts of casts.
@@ -1103,19 +1928,27 @@ IceInstList IceTargetX8632::lowerCast(const IceInstCast *Inst,
       // t1=movsx src; t2=t1; t2=sar t2, 31; dst.lo=t1; dst.hi=t2
       IceVariable *DestLo = llvm::cast<IceVariable>(makeLowOperand(Dest));
       IceVariable *DestHi = llvm::cast<IceVariable>(makeHighOperand(Dest));
+      IceVariable *RegLo = Cfg->makeVariable(IceType_i32, CurrentNode);
+      RegLo->setWeightInfinite();
       if (Reg->getType() == IceType_i32)
-        Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, Reg));
+        Expansion.push_back(IceInstX8632Mov::create(Cfg, RegLo, Reg));
       else
-        Expansion.push_back(IceInstX8632Movsx::create(Cfg, DestLo, Reg));
+        Expansion.push_back(IceInstX8632Movsx::create(Cfg, RegLo, Reg));
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, RegLo));
       IceVariable *RegHi = Cfg->makeVariable(IceType_i32, CurrentNode);
+      RegHi->setWeightInfinite();
       IceConstant *Shift = Cfg->getConstantInt(IceType_i32, 31);
-      Expansion.push_back(IceInstX8632Mov::create(Cfg, RegHi, Reg));
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, RegHi, RegLo));
       Expansion.push_back(IceInstX8632Sar::create(Cfg, RegHi, Shift));
       Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, RegHi));
     } else {
       // TODO: Sign-extend an i1 via "shl reg, 31; sar reg, 31", and
       // also copy to the high operand of a 64-bit variable.
-      Expansion.push_back(IceInstX8632Movsx::create(Cfg, Dest, Reg));
+      // movsx can only write a register.
+      IceVariable *T = Cfg->makeVariable(Dest->getType(), CurrentNode);
+      T->setWeightInfinite();
+      Expansion.push_back(IceInstX8632Movsx::create(Cfg, T, Reg));
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, T));
     }
     break;
   case IceInstCast::Zext:
@@ -1124,96 +1957,257 @@ IceInstList IceTargetX8632::lowerCast(const IceInstCast *Inst,
       IceConstant *Zero = Cfg->getConstantInt(IceType_i32, 0);
       IceVariable *DestLo = llvm::cast<IceVariable>(makeLowOperand(Dest));
       IceVariable *DestHi = llvm::cast<IceVariable>(makeHighOperand(Dest));
+      IceVariable *RegLo = Cfg->makeVariable(IceType_i32, CurrentNode);
+      RegLo->setWeightInfinite();
       if (Reg->getType() == IceType_i32)
-        Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, Reg));
+        Expansion.push_back(IceInstX8632Mov::create(Cfg, RegLo, Reg));
       else
-        Expansion.push_back(IceInstX8632Movzx::create(Cfg, DestLo, Reg));
+        Expansion.push_back(IceInstX8632Movzx::create(Cfg, RegLo, Reg));
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, RegLo));
       Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, Zero));
     } else {
-      Expansion.push_back(IceInstX8632Movzx::create(Cfg, Dest, Reg));
+      // movzx can only write a register.
+      IceVariable *T = Cfg->makeVariable(Dest->getType(), CurrentNode);
+      T->setWeightInfinite();
+      Expansion.push_back(IceInstX8632Movzx::create(Cfg, T, Reg));
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, T));
     }
     break;
   case IceInstCast::Trunc:
     // It appears that Trunc is purely used to cast down from one integral type
     // to a smaller integral type.  In the generated code this does not seem
     // to be needed.  Treat these as vanilla moves.
+    // Dest and Reg can't both be memory operands.
     if (Reg->getType() == IceType_i64)
       Reg = makeLowOperand(Reg);
-    // TODO: This will probably produce invalid assembly if Dest and
-    // Reg are both memory operands (e.g. on the stack).
+    Reg = legalizeOperand(Reg, Legal_Reg | Legal_Imm, Expansion, true);
     Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, Reg));
     break;
   case IceInstCast::Fptrunc:
   case IceInstCast::Fpext:
-    Expansion.push_back(IceInstX8632Cvt::create(Cfg, Dest, Reg));
-    break;
   case IceInstCast::Fptosi:
-    if (Dest->getType() == IceType_i64) {
-      // Use a helper for converting floating-point values to 64-bit
-      // integers.  SSE2 appears to have no way to convert from xmm
-      // registers to something like the edx:eax register pair, and
-      // gcc and clang both want to use x87 instructions complete with
-      // temporary manipulation of the status word.  This helper is
-      // not needed for x86-64.
-      split64(Dest);
-      unsigned MaxSrcs = 1;
-      IceType SrcType = Inst->getSrc(0)->getType();
-      // TODO: Figure out how to properly construct CallTarget.
-      IceConstant *CallTarget = Cfg->getConstant(
-          IceType_i64, NULL, 0,
-          SrcType == IceType_f32 ? "cvtftosi64" : "cvtdtosi64");
-      bool Tailcall = false;
-      // TODO: This instruction leaks.
-      IceInstCall *Call = IceInstCall::create(Cfg, MaxSrcs, Inst->getDest(),
-                                              CallTarget, Tailcall);
-      Call->addArg(Inst->getSrc(0));
-      return lowerCall(Call, NULL, DeleteNextInst);
-    } else {
-      Expansion.push_back(IceInstX8632Cvt::create(Cfg, Dest, Reg));
-      // Sign-extend the result if necessary.
-    }
-    break;
-  case IceInstCast::Fptoui:
-    if (Dest->getType() == IceType_i64) {
-      // Use a helper for both x86-32 and x86-64.
-      split64(Dest);
-      unsigned MaxSrcs = 1;
-      IceType SrcType = Inst->getSrc(0)->getType();
-      // TODO: Figure out how to properly construct CallTarget.
-      IceConstant *CallTarget = Cfg->getConstant(
-          IceType_i64, NULL, 0,
-          SrcType == IceType_f32 ? "cvtftoui64" : "cvtdtoui64");
-      bool Tailcall = false;
-      // TODO: This instruction leaks.
-      IceInstCall *Call = IceInstCall::create(Cfg, MaxSrcs, Inst->getDest(),
-                                              CallTarget, Tailcall);
-      Call->addArg(Inst->getSrc(0));
-      return lowerCall(Call, NULL, DeleteNextInst);
-    } else {
-      Expansion.push_back(IceInstX8632Cvt::create(Cfg, Dest, Reg));
-      // Zero-extend the result if necessary.
-    }
+  case IceInstCast::Fptoui: {
+    // cvt can only write a register, and only a 32-bit one for an
+    // integer result.  A narrower result is the low bits of that.
+    IceType Type = Dest->getType();
+    if (Type == IceType_i1 || Type == IceType_i8 || Type == IceType_i16)
+      Type = IceType_i32;
+    IceVariable *T = Cfg->makeVariable(Type, CurrentNode);
+    T->setWeightInfinite();
+    Expansion.push_back(IceInstX8632Cvt::create(Cfg, T, Reg));
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, T));
     break;
+  }
   case IceInstCast::Sitofp:
-    if (Dest->getType() == IceType_i64) {
-      // Use a helper for x86-32.
-      assert(0);
-    } else {
-      // Sign-extend the operand.
-      Expansion.push_back(IceInstX8632Cvt::create(Cfg, Dest, Reg));
+  case IceInstCast::Uitofp: {
+    // cvt only reads a 32-bit integer, so a narrower operand is sign-
+    // or zero-extended first.  A true i1 is -1 when signed.
+    IceType SrcType = Reg->getType();
+    if (SrcType == IceType_i1 || SrcType == IceType_i8 ||
+        SrcType == IceType_i16) {
+      if (SrcType == IceType_i8 && llvm::isa<IceVariable>(Reg))
+        Reg = makeByteReg(Reg, Expansion);
+      IceVariable *Wide = Cfg->makeVariable(IceType_i32, CurrentNode);
+      Wide->setWeightInfinite();
+      if (CastKind == IceInstCast::Sitofp && SrcType != IceType_i1) {
+        Expansion.push_back(IceInstX8632Movsx::create(Cfg, Wide, Reg));
+      } else {
+        Expansion.push_back(IceInstX8632Movzx::create(Cfg, Wide, Reg));
+        if (CastKind == IceInstCast::Sitofp)
+          Expansion.push_back(IceInstX8632Neg::create(Cfg, Wide));
+      }
+      Reg = Wide;
     }
+    // cvt can only write a register.
+    IceVariable *T = Cfg->makeVariable(Dest->getType(), CurrentNode);
+    T->setWeightInfinite();
+    Expansion.push_back(IceInstX8632Cvt::create(Cfg, T, Reg));
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, T));
     break;
-  case IceInstCast::Uitofp:
-    if (Dest->getType() == IceType_i64) {
-      // Use a helper for x86-32 and x86-64.
-      assert(0);
+  }
+  }
+  return Expansion;
+}
+
+IceOperandX8632Mem *IceTargetX8632::makeScratchOperand(IceType Type,
+                                                        uint32_t Offset) {
+  assert(Offset + iceTypeWidth(Type) <= Cast64ScratchSize);
+  return IceOperandX8632Mem::create(Cfg, Type, getPhysicalRegister(Reg_esp),
+                                    Cfg->getConstantInt(IceType_i32, Offset));
+}
+
+// SSE2 has no conversion between xmm registers and 64-bit integers
+// on x86-32, so the value goes through memory and the x87 unit, with
+// the rounding mode temporarily set to truncation:
+//     movs[sd] [esp], src
+//     fld [esp]
+//     fnstcw word ptr [esp+8]
+//     t = mov dword ptr [esp+8]
+//     or t, 0xc00
+//     mov [esp+12], t
+//     fldcw word ptr [esp+12]
+//     fistp qword ptr [esp]
+//     fldcw word ptr [esp+8]
+//     dst.lo = [esp]; dst.hi = [esp+4]
+// For fptoui, values of at least 2^63 are first reduced by 2^63, and
+// the sign bit of the result is flipped back in.
+void IceTargetX8632::lowerFpToI64(const IceInstCast *Inst,
+                                  IceInstList &Expansion) {
+  IceVariable *Dest = Inst->getDest();
+  IceOperand *Src0 = Inst->getSrc(0);
+  IceType SrcType = Src0->getType();
+  bool Unsigned = (Inst->getCastKind() == IceInstCast::Fptoui);
+  if (Cfg->getOptSize()) {
+    const char *HelperName;
+    if (Unsigned)
+      HelperName = SrcType == IceType_f32 ? "cvtftoui64" : "cvtdtoui64";
+    else
+      HelperName = SrcType == IceType_f32 ? "cvtftosi64" : "cvtdtosi64";
+    lowerCast64Call(Dest, Src0, HelperName, Expansion);
+    return;
+  }
+  IceVariable *DestLo = llvm::cast<IceVariable>(makeLowOperand(Dest));
+  IceVariable *DestHi = llvm::cast<IceVariable>(makeHighOperand(Dest));
+  IceOperandX8632Mem *Value = makeScratchOperand(SrcType, 0);
+  IceOperand *Src = legalizeOperand(Src0, Legal_Reg | Legal_Mem, Expansion);
+  IceVariable *T = Cfg->makeVariable(SrcType, CurrentNode);
+  T->setWeightInfinite();
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, T, Src));
+  IceVariable *Adjust = NULL;
+  if (Unsigned) {
+    // t >= 2^63 ? (t - 2^63, hi ^ 0x80000000) : (t, hi)
+    IceOperandX8632Mem *TwoTo63 = makeScratchOperand(SrcType, 8);
+    if (SrcType == IceType_f32) {
+      Expansion.push_back(IceInstX8632Store::create(
+          Cfg, Cfg->getConstantInt(IceType_i32, 0x5f000000),
+          makeScratchOperand(IceType_i32, 8)));
     } else {
-      // Zero-extend the operand.
-      Expansion.push_back(IceInstX8632Cvt::create(Cfg, Dest, Reg));
+      Expansion.push_back(IceInstX8632Store::create(
+          Cfg, Cfg->getConstantInt(IceType_i32, 0),
+          makeScratchOperand(IceType_i32, 8)));
+      Expansion.push_back(IceInstX8632Store::create(
+          Cfg, Cfg->getConstantInt(IceType_i32, 0x43e00000),
+          makeScratchOperand(IceType_i32, 12)));
     }
-    break;
+    Adjust = Cfg->makeVariable(IceType_i32, CurrentNode);
+    Adjust->setWeightInfinite();
+    IceInstX8632Label *Label = IceInstX8632Label::create(Cfg, this);
+    Expansion.push_back(IceInstX8632Mov::create(
+        Cfg, Adjust, Cfg->getConstantInt(IceType_i32, 0)));
+    Expansion.push_back(IceInstX8632Ucomiss::create(Cfg, T, TwoTo63));
+    Expansion.push_back(IceInstX8632Br::create(Cfg, Label,
+                                               IceInstX8632Br::Br_b));
+    // Keep the first assignment to Adjust live; see IceInstX8632Label.
+    Expansion.push_back(IceInstFakeUse::create(Cfg, Adjust));
+    Expansion.push_back(IceInstX8632Subss::create(Cfg, T, TwoTo63));
+    Expansion.push_back(IceInstX8632Mov::create(
+        Cfg, Adjust, Cfg->getConstantInt(IceType_i32, 0x80000000)));
+    Expansion.push_back(Label);
   }
-  return Expansion;
+  Expansion.push_back(IceInstX8632Store::create(Cfg, T, Value));
+  Expansion.push_back(IceInstX8632Fld::create(Cfg, Value));
+  IceOperandX8632Mem *SavedCW = makeScratchOperand(IceType_i16, 8);
+  IceOperandX8632Mem *TruncCW = makeScratchOperand(IceType_i16, 12);
+  Expansion.push_back(
+      IceInstX8632Fpu::create(Cfg, IceInstX8632Fpu::Fnstcw, SavedCW));
+  // The upper half of the loaded word is garbage, but only the lower
+  // half is stored back into the control word.
+  IceVariable *CW = Cfg->makeVariable(IceType_i32, CurrentNode);
+  CW->setWeightInfinite();
+  Expansion.push_back(
+      IceInstX8632Mov::create(Cfg, CW, makeScratchOperand(IceType_i32, 8)));
+  Expansion.push_back(
+      IceInstX8632Or::create(Cfg, CW, Cfg->getConstantInt(IceType_i32, 0xc00)));
+  Expansion.push_back(
+      IceInstX8632Store::create(Cfg, CW, makeScratchOperand(IceType_i32, 12)));
+  Expansion.push_back(
+      IceInstX8632Fpu::create(Cfg, IceInstX8632Fpu::Fldcw, TruncCW));
+  Expansion.push_back(IceInstX8632Fpu::create(
+      Cfg, IceInstX8632Fpu::Fistp, makeScratchOperand(IceType_i64, 0)));
+  Expansion.push_back(
+      IceInstX8632Fpu::create(Cfg, IceInstX8632Fpu::Fldcw, SavedCW));
+  IceVariable *Lo = Cfg->makeVariable(IceType_i32, CurrentNode);
+  Lo->setWeightInfinite();
+  Expansion.push_back(
+      IceInstX8632Mov::create(Cfg, Lo, makeScratchOperand(IceType_i32, 0)));
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, Lo));
+  IceVariable *Hi = Cfg->makeVariable(IceType_i32, CurrentNode);
+  Hi->setWeightInfinite();
+  Expansion.push_back(
+      IceInstX8632Mov::create(Cfg, Hi, makeScratchOperand(IceType_i32, 4)));
+  if (Adjust)
+    Expansion.push_back(IceInstX8632Xor::create(Cfg, Hi, Adjust));
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, Hi));
+}
+
+// The integer goes through memory into the x87 unit, whose 64-bit
+// mantissa holds it exactly, so the final fstp rounds only once:
+//     mov [esp], src.lo; mov [esp+4], src.hi
+//     fild qword ptr [esp]
+//     fstp [esp]
+//     dst = movs[sd] [esp]
+// For uitofp, fild reads the value as signed, so 2^64 is added back
+// when the sign bit is set.
+void IceTargetX8632::lowerI64ToFp(const IceInstCast *Inst,
+                                  IceInstList &Expansion) {
+  IceVariable *Dest = Inst->getDest();
+  IceOperand *Src0 = Inst->getSrc(0);
+  IceType DestType = Dest->getType();
+  bool Unsigned = (Inst->getCastKind() == IceInstCast::Uitofp);
+  if (Cfg->getOptSize()) {
+    const char *HelperName;
+    if (Unsigned)
+      HelperName = DestType == IceType_f32 ? "cvtui64tof" : "cvtui64tod";
+    else
+      HelperName = DestType == IceType_f32 ? "cvtsi64tof" : "cvtsi64tod";
+    lowerCast64Call(Dest, Src0, HelperName, Expansion);
+    return;
+  }
+  IceOperand *Lo =
+      legalizeOperand(makeLowOperand(Src0), Legal_Reg | Legal_Imm, Expansion);
+  IceOperand *Hi =
+      legalizeOperand(makeHighOperand(Src0), Legal_Reg | Legal_Imm, Expansion);
+  IceOperandX8632Mem *SrcHi = makeScratchOperand(IceType_i32, 4);
+  Expansion.push_back(
+      IceInstX8632Store::create(Cfg, Lo, makeScratchOperand(IceType_i32, 0)));
+  Expansion.push_back(IceInstX8632Store::create(Cfg, Hi, SrcHi));
+  Expansion.push_back(IceInstX8632Fpu::create(
+      Cfg, IceInstX8632Fpu::Fild, makeScratchOperand(IceType_i64, 0)));
+  if (Unsigned) {
+    IceInstX8632Label *Label = IceInstX8632Label::create(Cfg, this);
+    Expansion.push_back(IceInstX8632Store::create(
+        Cfg, Cfg->getConstantInt(IceType_i32, 0x5f800000),
+        makeScratchOperand(IceType_i32, 8)));
+    Expansion.push_back(IceInstX8632Icmp::create(
+        Cfg, SrcHi, Cfg->getConstantInt(IceType_i32, 0)));
+    Expansion.push_back(IceInstX8632Br::create(Cfg, Label,
+                                               IceInstX8632Br::Br_ge));
+    Expansion.push_back(IceInstX8632Fpu::create(
+        Cfg, IceInstX8632Fpu::Fadd, makeScratchOperand(IceType_f32, 8)));
+    Expansion.push_back(Label);
+  }
+  IceOperandX8632Mem *Value = makeScratchOperand(DestType, 0);
+  Expansion.push_back(
+      IceInstX8632Fpu::create(Cfg, IceInstX8632Fpu::Fstp, Value));
+  IceVariable *T = Cfg->makeVariable(DestType, CurrentNode);
+  T->setWeightInfinite();
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, T, Value));
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, T));
+}
+
+void IceTargetX8632::lowerCast64Call(IceVariable *Dest, IceOperand *Src,
+                                     const char *HelperName,
+                                     IceInstList &Expansion) {
+  unsigned MaxSrcs = 1;
+  // TODO: Figure out how to properly construct CallTarget.
+  IceConstant *CallTarget = Cfg->getConstant(IceType_i32, NULL, 0, HelperName);
+  bool Tailcall = false;
+  // TODO: This instruction leaks.
+  IceInstCall *Call =
+      IceInstCall::create(Cfg, MaxSrcs, Dest, CallTarget, Tailcall);
+  Call->addArg(Src);
+  IceInstList CallExpansion = lowerCall(Call, IceLoweringCursor());
+  Expansion.splice(Expansion.end(), CallExpansion);
 }
 
 static struct {
@@ -1256,8 +2250,7 @@ static struct {
 const static unsigned TableFcmpSize = sizeof(TableFcmp) / sizeof(*TableFcmp);
 
 IceInstList IceTargetX8632::lowerFcmp(const IceInstFcmp *Inst,
-                                      const IceInst *Next,
-                                      bool &DeleteNextInst) {
+                                      const IceLoweringCursor &Cursor) {
   IceInstList Expansion;
   IceOperand *Src0 = Inst->getSrc(0);
   IceOperand *Src1 = Inst->getSrc(1);
@@ -1355,39 +2348,46 @@ static IceInstX8632Br::BrCond getIcmp32Mapping(IceInstIcmp::IceICond Cond) {
 }
 
 IceInstList IceTargetX8632::lowerIcmp(const IceInstIcmp *Inst,
-                                      const IceInst *Next,
-                                      bool &DeleteNextInst) {
+                                      const IceLoweringCursor &Cursor) {
   IceInstList Expansion;
   IceOperand *Src0 = Inst->getSrc(0);
   IceOperand *Src1 = Inst->getSrc(1);
   IceVariable *Dest = Inst->getDest();
-  if (Src0->getType() != IceType_i64 && Next && llvm::isa<IceInstBr>(Next) &&
-      Next->getSrcSize() > 0 && Dest == Next->getSrc(0) &&
-      Next->isLastUse(Dest)) {
-    const IceInstBr *NextBr = llvm::cast<IceInstBr>(Next);
+  const IceInst *Next = Cursor.peek();
+  bool IsOnlyUseNext = Cursor.isOnlyUseWithin(Dest, 1);
+  const IceInstBr *NextBr = llvm::dyn_cast_or_null<IceInstBr>(Next);
+  if (Src0->getType() != IceType_i64 && NextBr && NextBr->getSrcSize() > 0 &&
+      Dest == NextBr->getSrc(0) && IsOnlyUseNext) {
     // This is basically identical to an Arithmetic instruction,
     // except there is no Dest variable to store.
     // cmp a,b ==> mov t,a; cmp t,b
-    bool IsImmOrReg = false;
-    if (llvm::isa<IceConstant>(Src1))
-      IsImmOrReg = true;
-    else if (IceVariable *Var = llvm::dyn_cast<IceVariable>(Src1)) {
-      if (Var->getRegNum() >= 0)
-        IsImmOrReg = true;
-    }
-    IceOperand *Reg = legalizeOperand(Src0, IsImmOrReg ? Legal_All : Legal_Reg,
-                                      Expansion, true);
-    Expansion.push_back(IceInstX8632Icmp::create(Cfg, Reg, Src1));
+    lowerCompare32(Src0, Src1, Expansion);
     Expansion.push_back(IceInstX8632Br::create(
         Cfg, NextBr->getTargetTrue(), NextBr->getTargetFalse(),
         getIcmp32Mapping(Inst->getCondition())));
-    DeleteNextInst = true;
+    Cursor.consume();
+    return Expansion;
+  }
+  // A select on the result is lowered straight from the flags.
+  const IceInstSelect *NextSelect = llvm::dyn_cast_or_null<IceInstSelect>(Next);
+  if (Src0->getType() != IceType_i64 && NextSelect &&
+      Dest == NextSelect->getCondition() && IsOnlyUseNext &&
+      Dest != NextSelect->getTrueOperand() &&
+      Dest != NextSelect->getFalseOperand() &&
+      NextSelect->getDest()->getType() != IceType_f32 &&
+      NextSelect->getDest()->getType() != IceType_f64) {
+    lowerCompare32(Src0, Src1, Expansion);
+    lowerCmov(NextSelect->getDest(), NextSelect->getTrueOperand(),
+              NextSelect->getFalseOperand(),
+              getIcmp32Mapping(Inst->getCondition()), Expansion);
+    Cursor.consume();
     return Expansion;
   }
 
-  // a=icmp cond, b, c ==> cmp b,c; a=1; br cond,L1; FakeUse(a); a=0; L1:
+  // a=icmp cond, b, c ==> a=0; cmp b,c; a=set<cond> {a}
   //
-  // Alternative without intra-block branch: cmp b,c; a=0; a=set<cond> {a}
+  // The 64-bit compare still needs intra-block branches:
+  // a=icmp cond, b, c ==> cmp b,c; a=1; br cond,L1; FakeUse(a); a=0; L1:
   IceOperand *ConstZero = Cfg->getConstantInt(IceType_i32, 0);
   IceOperand *ConstOne = Cfg->getConstantInt(IceType_i32, 1);
   if (Src0->getType() == IceType_i64) {
@@ -1440,7 +2440,44 @@ IceInstList IceTargetX8632::lowerIcmp(const IceInstIcmp *Inst,
     }
     return Expansion;
   }
-  // cmp b, c
+  // A zero extension of the result takes the setcc result directly,
+  // without a movzx.
+  const IceInstCast *NextCast = llvm::dyn_cast_or_null<IceInstCast>(Next);
+  if (NextCast && NextCast->getCastKind() == IceInstCast::Zext &&
+      Dest == NextCast->getSrc(0) && IsOnlyUseNext) {
+    IceVariable *Reg = Cfg->makeVariable(IceType_i1, CurrentNode);
+    Reg->setWeightInfinite();
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, Reg, ConstZero));
+    lowerCompare32(Src0, Src1, Expansion);
+    Expansion.push_back(IceInstX8632Setcc::create(
+        Cfg, Reg, getIcmp32Mapping(Inst->getCondition())));
+    IceVariable *ZextDest = NextCast->getDest();
+    if (ZextDest->getType() == IceType_i64) {
+      Expansion.push_back(IceInstX8632Mov::create(
+          Cfg, llvm::cast<IceVariable>(makeLowOperand(ZextDest)), Reg));
+      Expansion.push_back(IceInstX8632Mov::create(
+          Cfg, llvm::cast<IceVariable>(makeHighOperand(ZextDest)), ConstZero));
+    } else {
+      Expansion.push_back(IceInstX8632Mov::create(Cfg, ZextDest, Reg));
+    }
+    Cursor.consume();
+    return Expansion;
+  }
+  // The i1 register class only has byte registers, so Dest can be the
+  // target of the setcc.  Zeroing it first keeps the upper bits clear
+  // for the 32-bit compares against 0 in br and select.
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, ConstZero));
+  lowerCompare32(Src0, Src1, Expansion);
+  Expansion.push_back(IceInstX8632Setcc::create(
+      Cfg, Dest, getIcmp32Mapping(Inst->getCondition())));
+  return Expansion;
+}
+
+// Emits "cmp Src0, Src1" for operands of at most 32 bits, loading
+// Src0 into a register unless Src1 is a register or an immediate.
+void IceTargetX8632::lowerCompare32(IceOperand *Src0, IceOperand *Src1,
+                                    IceInstList &Expansion) {
+  Src1 = legalizeOperand(Src1, Legal_All, Expansion);
   bool IsImmOrReg = false;
   if (llvm::isa<IceConstant>(Src1))
     IsImmOrReg = true;
@@ -1451,30 +2488,68 @@ IceInstList IceTargetX8632::lowerIcmp(const IceInstIcmp *Inst,
   IceOperand *Reg = legalizeOperand(Src0, IsImmOrReg ? Legal_All : Legal_Reg,
                                     Expansion, true);
   Expansion.push_back(IceInstX8632Icmp::create(Cfg, Reg, Src1));
+}
 
-  // a = 1;
-  Expansion.push_back(
-      IceInstX8632Mov::create(Cfg, Dest, Cfg->getConstantInt(IceType_i32, 1)));
-
-  // create Label
-  IceInstX8632Label *Label = IceInstX8632Label::create(Cfg, this);
-
-  // br cond, Label
-  Expansion.push_back(IceInstX8632Br::create(
-      Cfg, Label, getIcmp32Mapping(Inst->getCondition())));
-
-  // FakeUse(a)
-  IceInst *FakeUse = IceInstFakeUse::create(Cfg, Dest);
-  Expansion.push_back(FakeUse);
-
-  // a = 0
-  Expansion.push_back(
-      IceInstX8632Mov::create(Cfg, Dest, Cfg->getConstantInt(IceType_i32, 0)));
-
-  // Label:
-  Expansion.push_back(Label);
+// Dest=Condition?SrcTrue:SrcFalse for integer types, given flags that
+// are already set:
+//   t=SrcFalse; t=cmov<cond> SrcTrue {t}; Dest=t
+// cmov has no 8-bit form, and the emitter names the 32-bit registers,
+// so the narrower types only use register sources.
+void IceTargetX8632::lowerCmov(IceVariable *Dest, IceOperand *SrcTrue,
+                               IceOperand *SrcFalse,
+                               IceInstX8632Br::BrCond Condition,
+                               IceInstList &Expansion) {
+  if (Dest->getType() == IceType_i64) {
+    lowerCmov(llvm::cast<IceVariable>(makeLowOperand(Dest)),
+              makeLowOperand(SrcTrue), makeLowOperand(SrcFalse), Condition,
+              Expansion);
+    lowerCmov(llvm::cast<IceVariable>(makeHighOperand(Dest)),
+              makeHighOperand(SrcTrue), makeHighOperand(SrcFalse), Condition,
+              Expansion);
+    return;
+  }
+  LegalMask Allowed = Legal_Reg;
+  if (Dest->getType() == IceType_i32)
+    Allowed |= Legal_Mem;
+  SrcTrue = legalizeOperand(SrcTrue, Allowed, Expansion);
+  SrcFalse = legalizeOperand(SrcFalse, Legal_All, Expansion);
+  // cmov has no 8-bit form, so a narrower value is selected in a
+  // 32-bit temporary, whose low bits are all that Dest keeps.
+  IceVariable *Reg = Cfg->makeVariable(IceType_i32, CurrentNode);
+  Reg->setWeightInfinite();
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, Reg, SrcFalse));
+  Expansion.push_back(IceInstX8632Cmov::create(Cfg, Reg, SrcTrue, Condition));
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, Reg));
+}
 
-  return Expansion;
+// Dest=Condition?SrcTrue:SrcFalse for f32 and f64, as a blend through
+// an all-ones or all-zeros mask:
+//   m=Condition; m=neg m; m=sbb m,m; x=movd m; x=pshufd x,0
+//   t=SrcTrue; t=pand t,x; f=SrcFalse; x=pandn x,f; t=por t,x; Dest=t
+void IceTargetX8632::lowerFloatSelect(IceVariable *Dest, IceOperand *Condition,
+                                      IceOperand *SrcTrue,
+                                      IceOperand *SrcFalse,
+                                      IceInstList &Expansion) {
+  IceType Type = Dest->getType();
+  IceVariable *Mask = Cfg->makeVariable(IceType_i32, CurrentNode);
+  Mask->setWeightInfinite();
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, Mask, Condition));
+  Expansion.push_back(IceInstX8632Neg::create(Cfg, Mask));
+  Expansion.push_back(IceInstX8632Sbb::create(Cfg, Mask, Mask));
+  IceVariable *MaskXmm = Cfg->makeVariable(Type, CurrentNode);
+  MaskXmm->setWeightInfinite();
+  Expansion.push_back(IceInstX8632Movd::create(Cfg, MaskXmm, Mask));
+  Expansion.push_back(IceInstX8632Pshufd::create(
+      Cfg, MaskXmm, MaskXmm, Cfg->getConstantInt(IceType_i32, 0)));
+  IceVariable *RegTrue = Cfg->makeVariable(Type, CurrentNode);
+  RegTrue->setWeightInfinite();
+  Expansion.push_back(IceInstX8632Mov::create(
+      Cfg, RegTrue, legalizeOperand(SrcTrue, Legal_All, Expansion)));
+  Expansion.push_back(IceInstX8632Pand::create(Cfg, RegTrue, MaskXmm));
+  IceVariable *RegFalse = legalizeOperandToVar(SrcFalse, Expansion);
+  Expansion.push_back(IceInstX8632Pandn::create(Cfg, MaskXmm, RegFalse));
+  Expansion.push_back(IceInstX8632Por::create(Cfg, RegTrue, MaskXmm));
+  Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, RegTrue));
 }
 
 static bool isAssign(const IceInst *Inst) {
@@ -1495,173 +2570,428 @@ static bool isAdd(const IceInst *Inst) {
   return false;
 }
 
-static void computeAddressOpt(IceCfg *Cfg, IceVariable *&Base,
-                              IceVariable *&Index, int &Shift,
-                              int32_t &Offset) {
+// Returns Operand as a variable whose uses may be moved anywhere its
+// definition dominates, or NULL.  In SSA form that holds for
+// arguments and for variables with a single definition, even when
+// they are defined in another block, e.g. a loop-invariant base.
+// Lowered phi temporaries are assigned in every predecessor and
+// don't qualify.
+static IceVariable *getInvariantVar(IceOperand *Operand) {
+  IceVariable *Var = llvm::dyn_cast_or_null<IceVariable>(Operand);
+  if (Var == NULL)
+    return NULL;
+  if (Var->getIsArg() || Var->getDefinition())
+    return Var;
+  return NULL;
+}
+
+// Adds Const<<Shift, or its negation, to the displacement.  The
+// displacement can hold at most one relocatable, and only unscaled.
+// Address arithmetic wraps, so Offset is allowed to overflow.
+static bool addDisplacement(IceOperand *Const, int Shift, bool Negate,
+                            int32_t &Offset,
+                            IceConstantRelocatable *&Relocatable) {
+  if (IceConstantInteger *Integer =
+          llvm::dyn_cast_or_null<IceConstantInteger>(Const)) {
+    uint32_t Delta = static_cast<uint32_t>(Integer->getIntValue()) << Shift;
+    if (Negate)
+      Delta = -Delta;
+    Offset = static_cast<int32_t>(static_cast<uint32_t>(Offset) + Delta);
+    return true;
+  }
+  if (IceConstantRelocatable *Symbol =
+          llvm::dyn_cast_or_null<IceConstantRelocatable>(Const)) {
+    if (Relocatable || Shift || Negate)
+      return false;
+    Relocatable = Symbol;
+    return true;
+  }
+  return false;
+}
+
+// Matches Inst as Var+Const, Const+Var, or Var-Const.
+static bool matchAddConst(const IceInst *Inst, IceVariable *&Var,
+                          IceOperand *&Const, bool &Negate) {
+  const IceInstArithmetic *Arith =
+      llvm::dyn_cast_or_null<IceInstArithmetic>(Inst);
+  if (Arith == NULL)
+    return false;
+  IceOperand *Src0 = Arith->getSrc(0);
+  IceOperand *Src1 = Arith->getSrc(1);
+  Negate = false;
+  switch (Arith->getOp()) {
+  case IceInstArithmetic::Sub:
+    Negate = true;
+    break;
+  case IceInstArithmetic::Add:
+    if (llvm::isa<IceConstant>(Src0))
+      std::swap(Src0, Src1);
+    break;
+  default:
+    return false;
+  }
+  Var = getInvariantVar(Src0);
+  Const = Src1;
+  return Var && llvm::isa<IceConstant>(Const);
+}
+
+// Matches Inst as Var*Const, Const*Var, or Var<<Const, where the
+// multiplier is 1, 2, 4, or 8.
+static bool matchScale(const IceInst *Inst, IceVariable *&Var, int &LogMult) {
+  const IceInstArithmetic *Arith =
+      llvm::dyn_cast_or_null<IceInstArithmetic>(Inst);
+  if (Arith == NULL)
+    return false;
+  IceOperand *Src0 = Arith->getSrc(0);
+  IceOperand *Src1 = Arith->getSrc(1);
+  if (Arith->getOp() == IceInstArithmetic::Mul &&
+      llvm::isa<IceConstantInteger>(Src0))
+    std::swap(Src0, Src1);
+  IceConstantInteger *Const = llvm::dyn_cast<IceConstantInteger>(Src1);
+  Var = getInvariantVar(Src0);
+  if (Var == NULL || Const == NULL || Var->getType() != IceType_i32)
+    return false;
+  uint64_t Value = Const->getIntValue();
+  switch (Arith->getOp()) {
+  case IceInstArithmetic::Mul:
+    switch (Value) {
+    case 1:
+      LogMult = 0;
+      return true;
+    case 2:
+      LogMult = 1;
+      return true;
+    case 4:
+      LogMult = 2;
+      return true;
+    case 8:
+      LogMult = 3;
+      return true;
+    default:
+      return false;
+    }
+  case IceInstArithmetic::Shl:
+    if (Value > 3)
+      return false;
+    LogMult = Value;
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Folds the computation of the address Base into the addressing mode
+// [Base + Index<<Shift + Offset + Relocatable], following Base and
+// Index back through their definitions.  The definitions may be in
+// other blocks; in SSA form they dominate the memory access.
+// Returns true if anything was folded.
+static bool computeAddressOpt(IceVariable *&Base, IceVariable *&Index,
+                              int &Shift, int32_t &Offset,
+                              IceConstantRelocatable *&Relocatable) {
   if (Base == NULL)
-    return;
-  // If the Base has more than one use or is live across multiple
-  // blocks, then don't go further.  Alternatively (?), never consider
-  // a transformation that would change a variable that is currently
-  // *not* live across basic block boundaries into one that *is*.
-  if (Base->isMultiblockLife() /* || Base->getUseCount() > 1*/)
-    return;
+    return false;
+  const IceVariable *OrigBase = Base;
 
   while (true) {
+    const IceInst *BaseInst = Base ? Base->getDefinition() : NULL;
+    const IceInst *IndexInst = Index ? Index->getDefinition() : NULL;
+    IceVariable *Var = NULL;
+    IceOperand *Const = NULL;
+    bool Negate = false;
+    int LogMult = 0;
+
     // Base is Base=Var ==>
     //   set Base=Var
-    const IceInst *BaseInst = Base->getDefinition();
-    IceOperand *BaseOperand0 = BaseInst ? BaseInst->getSrc(0) : NULL;
-    IceVariable *BaseVariable0 =
-        llvm::dyn_cast_or_null<IceVariable>(BaseOperand0);
-    if (isAssign(BaseInst) && BaseVariable0 &&
-        // TODO: ensure BaseVariable0 stays single-BB
-        true) {
-      Base = BaseVariable0;
-
-      continue;
+    // Base is Base=Const ==>
+    //   set Base=NULL, Offset+=Const
+    if (isAssign(BaseInst)) {
+      if ((Var = getInvariantVar(BaseInst->getSrc(0)))) {
+        Base = Var;
+        continue;
+      }
+      if (addDisplacement(BaseInst->getSrc(0), 0, false, Offset,
+                          Relocatable)) {
+        Base = NULL;
+        continue;
+      }
     }
 
     // Index is Index=Var ==>
     //   set Index=Var
+    // Index is Index=Const ==>
+    //   set Index=NULL, Offset+=(Const<<Shift)
+    if (isAssign(IndexInst)) {
+      if ((Var = getInvariantVar(IndexInst->getSrc(0)))) {
+        Index = Var;
+        continue;
+      }
+      if (addDisplacement(IndexInst->getSrc(0), Shift, false, Offset,
+                          Relocatable)) {
+        Index = NULL;
+        Shift = 0;
+        continue;
+      }
+    }
 
     // Index==NULL && Base is Base=Var1+Var2 ==>
     //   set Base=Var1, Index=Var2, Shift=0
-    IceOperand *BaseOperand1 = BaseInst ? BaseInst->getSrc(1) : NULL;
-    IceVariable *BaseVariable1 =
-        llvm::dyn_cast_or_null<IceVariable>(BaseOperand1);
-    if (Index == NULL && isAdd(BaseInst) && BaseVariable0 && BaseVariable1 &&
-        // TODO: ensure BaseVariable0 and BaseVariable1 stay single-BB
-        true) {
-      Base = BaseVariable0;
-      Index = BaseVariable1;
-      Shift = 0; // should already have been 0
-      continue;
-    }
-
-    // Index is Index=Var*Const && log2(Const)+Shift<=3 ==>
-    //   Index=Var, Shift+=log2(Const)
-    const IceInst *IndexInst = Index ? Index->getDefinition() : NULL;
-    if (const IceInstArithmetic *ArithInst =
-            llvm::dyn_cast_or_null<IceInstArithmetic>(IndexInst)) {
-      IceOperand *IndexOperand0 = ArithInst->getSrc(0);
-      IceVariable *IndexVariable0 = llvm::dyn_cast<IceVariable>(IndexOperand0);
-      IceOperand *IndexOperand1 = ArithInst->getSrc(1);
-      IceConstantInteger *IndexConstant1 =
-          llvm::dyn_cast<IceConstantInteger>(IndexOperand1);
-      if (ArithInst->getOp() == IceInstArithmetic::Mul && IndexVariable0 &&
-          IndexOperand1->getType() == IceType_i32 && IndexConstant1) {
-        uint32_t Mult = IndexConstant1->getIntValue();
-        uint32_t LogMult;
-        switch (Mult) {
-        case 1:
-          LogMult = 0;
-          break;
-        case 2:
-          LogMult = 1;
-          break;
-        case 4:
-          LogMult = 2;
-          break;
-        case 8:
-          LogMult = 3;
-          break;
-        default:
-          LogMult = 4;
-          break;
-        }
-        if (Shift + LogMult <= 3) {
-          Index = IndexVariable0;
-          Shift += LogMult;
-          continue;
-        }
+    if (Index == NULL && isAdd(BaseInst)) {
+      IceVariable *Var0 = getInvariantVar(BaseInst->getSrc(0));
+      IceVariable *Var1 = getInvariantVar(BaseInst->getSrc(1));
+      if (Var0 && Var1) {
+        Base = Var0;
+        Index = Var1;
+        Shift = 0; // should already have been 0
+        continue;
       }
     }
 
-    // Index is Index=Var<<Const && Const+Shift<=3 ==>
-    //   Index=Var, Shift+=Const
-
-    // Index is Index=Const*Var && log2(Const)+Shift<=3 ==>
+    // Index is Index=Var*Const or Var<<Const && log2(Const)+Shift<=3 ==>
     //   Index=Var, Shift+=log2(Const)
+    if (matchScale(IndexInst, Var, LogMult) && Shift + LogMult <= 3) {
+      Index = Var;
+      Shift += LogMult;
+      continue;
+    }
 
-    // Index && Shift==0 && Base is Base=Var*Const && log2(Const)+Shift<=3 ==>
-    //   swap(Index,Base)
-    // Similar for Base=Const*Var and Base=Var<<Const
-
-    // Base is Base=Var+Const ==>
-    //   set Base=Var, Offset+=Const
-
-    // Base is Base=Const+Var ==>
-    //   set Base=Var, Offset+=Const
-
-    // Base is Base=Var-Const ==>
-    //   set Base=Var, Offset-=Const
-
-    // Index is Index=Var+Const ==>
-    //   set Index=Var, Offset+=(Const<<Shift)
+    // Index==NULL && Base is Base=Var*Const or Var<<Const ==>
+    //   set Base=NULL, Index=Var, Shift=log2(Const)
+    if (Index == NULL && matchScale(BaseInst, Var, LogMult)) {
+      Base = NULL;
+      Index = Var;
+      Shift = LogMult;
+      continue;
+    }
 
-    // Index is Index=Const+Var ==>
-    //   set Index=Var, Offset+=(Const<<Shift)
+    // Base is Base=Var+Const or Base=Var-Const ==>
+    //   set Base=Var, Offset+=Const or Offset-=Const
+    if (matchAddConst(BaseInst, Var, Const, Negate) &&
+        addDisplacement(Const, 0, Negate, Offset, Relocatable)) {
+      Base = Var;
+      continue;
+    }
 
-    // Index is Index=Var-Const ==>
-    //   set Index=Var, Offset-=(Const<<Shift)
+    // Index is Index=Var+Const or Index=Var-Const ==>
+    //   set Index=Var, Offset+=(Const<<Shift) or Offset-=(Const<<Shift)
+    if (matchAddConst(IndexInst, Var, Const, Negate) &&
+        addDisplacement(Const, Shift, Negate, Offset, Relocatable)) {
+      Index = Var;
+      continue;
+    }
 
-    // TODO: consider overflow issues with respect to Offset.
-    // TODO: handle symbolic constants.
     break;
   }
+  // Prefer [Var] to [1*Var].
+  if (Base == NULL && Shift == 0) {
+    Base = Index;
+    Index = NULL;
+  }
+  // Every rule replaces Base or Index with an operand of its
+  // definition, so in SSA form Base can't return to its original
+  // value once anything has been folded.
+  return Base != OrigBase;
+}
+
+static IceConstant *makeDisplacement(IceCfg *Cfg, int32_t Offset,
+                                     IceConstantRelocatable *Relocatable) {
+  if (Relocatable == NULL)
+    return Cfg->getConstantInt(IceType_i32, Offset);
+  return Cfg->getConstant(Relocatable->getType(), Relocatable->getHandle(),
+                          Relocatable->getOffset() + Offset,
+                          Relocatable->getName());
 }
 
 IceInstList IceTargetX8632::lowerLoad(const IceInstLoad *Inst,
-                                      const IceInst *Next,
-                                      bool &DeleteNextInst) {
+                                      const IceLoweringCursor &Cursor) {
   // A Load instruction can be treated the same as an Assign
   // instruction, after the source operand is transformed into an
-  // IceOperandX8632Mem operand.  Note that the address mode
-  // optimization already creates an IceOperandX8632Mem operand, so it
-  // doesn't need another level of transformation.
-  IceType Type = Inst->getDest()->getType();
-  IceOperand *Src = Inst->getSrc(0);
+  // IceOperandX8632Mem operand.  Loads whose value has a single use
+  // were already folded into that use by foldLoad().
+  IceOperand *Src = makeLoadOperand(Inst);
+  // TODO: This instruction leaks.
+  IceInstAssign *Assign = IceInstAssign::create(Cfg, Inst->getDest(), Src);
+  return lowerAssign(Assign, Cursor);
+}
+
+// Returns the Load's address as an IceOperandX8632Mem operand.  Note
+// that the address mode optimization already creates an
+// IceOperandX8632Mem operand, so it doesn't need another level of
+// transformation.
+IceOperand *IceTargetX8632::makeLoadOperand(const IceInstLoad *Load) {
+  IceType Type = Load->getDest()->getType();
+  IceOperand *Src = Load->getSrc(0);
   if (!llvm::isa<IceOperandX8632Mem>(Src)) {
     IceVariable *Base = llvm::dyn_cast<IceVariable>(Src);
     IceConstant *Offset = llvm::dyn_cast<IceConstant>(Src);
     assert(Base || Offset);
     Src = IceOperandX8632Mem::create(Cfg, Type, Base, Offset);
   }
-  // Fuse this load with a subsequent Arithmetic instruction in the
-  // following situations:
-  //   a=[mem]; c=b+a ==> c=b+[mem] if last use of a and a not in b
-  //   a=[mem]; c=a+b ==> c=b+[mem] if commutative and above is true
-  //
-  // TODO: Clean up and test thoroughly.
-  //
-  // TODO: Why limit to Arithmetic instructions?  This could probably
-  // be applied to most any instruction type.
+  return Src;
+}
+
+IceOperandX8632Mem *
+IceTargetX8632::makeStoreOperand(const IceInstStore *Store) {
+  IceOperand *Addr = Store->getAddr();
+  IceOperandX8632Mem *Mem = llvm::dyn_cast<IceOperandX8632Mem>(Addr);
+  if (Mem == NULL) {
+    IceVariable *Base = llvm::dyn_cast<IceVariable>(Addr);
+    IceConstant *Offset = llvm::dyn_cast<IceConstant>(Addr);
+    assert(Base || Offset);
+    Mem = IceOperandX8632Mem::create(Cfg, Store->getData()->getType(), Base,
+                                     Offset);
+  }
+  return Mem;
+}
+
+// Returns the constant value of a memory operand's offset, treating a
+// missing offset as 0.  Returns false for a relocatable offset, which
+// is only known to match itself.
+static bool getMemOffset(const IceOperandX8632Mem *Mem, int64_t &Value) {
+  const IceConstant *Offset = Mem->getOffset();
+  Value = 0;
+  if (Offset == NULL)
+    return true;
+  if (const IceConstantInteger *Integer =
+          llvm::dyn_cast<IceConstantInteger>(Offset)) {
+    Value = Integer->getIntValue();
+    return true;
+  }
+  return false;
+}
+
+static bool isSameAddress(const IceOperandX8632Mem *A,
+                          const IceOperandX8632Mem *B) {
+  if (A->getBase() != B->getBase() || A->getIndex() != B->getIndex() ||
+      A->getShift() != B->getShift())
+    return false;
+  if (A->getOffset() == B->getOffset())
+    return true;
+  int64_t OffsetA, OffsetB;
+  return getMemOffset(A, OffsetA) && getMemOffset(B, OffsetB) &&
+         OffsetA == OffsetB;
+}
+
+// Lowers a load-op-store sequence on the same address to the
+// memory-destination form:
+//   a=[mem]; c=a op b; [mem]=c ==> [mem] op= b
+// The load has already been folded into the arithmetic instruction by
+// foldLoad(), and the store must be the next instruction and the only
+// use of the result.
+bool IceTargetX8632::lowerRmw(const IceInstArithmetic *Inst,
+                              const IceLoweringCursor &Cursor,
+                              IceInstList &Expansion) {
+  IceVariable *Dest = Inst->getDest();
+  if (Dest->getType() != IceType_i32)
+    return false;
+  switch (Inst->getOp()) {
+  case IceInstArithmetic::Add:
+  case IceInstArithmetic::Sub:
+  case IceInstArithmetic::And:
+  case IceInstArithmetic::Or:
+  case IceInstArithmetic::Xor:
+    break;
+  default:
+    return false;
+  }
+  const IceInstStore *Store =
+      llvm::dyn_cast_or_null<IceInstStore>(Cursor.peek());
+  if (Store == NULL || Store->getData() != Dest ||
+      !Cursor.isOnlyUseWithin(Dest, 1))
+    return false;
+  IceOperandX8632Mem *Addr = makeStoreOperand(Store);
+  IceOperand *Src = NULL;
+  const IceOperandX8632Mem *Mem0 =
+      llvm::dyn_cast<IceOperandX8632Mem>(Inst->getSrc(0));
+  const IceOperandX8632Mem *Mem1 =
+      llvm::dyn_cast<IceOperandX8632Mem>(Inst->getSrc(1));
+  if (Mem0 && isSameAddress(Mem0, Addr))
+    Src = Inst->getSrc(1);
+  else if (Mem1 && Inst->isCommutative() && isSameAddress(Mem1, Addr))
+    Src = Inst->getSrc(0);
+  if (Src == NULL || llvm::isa<IceOperandX8632Mem>(Src))
+    return false;
+  Src = legalizeOperand(Src, Legal_Reg | Legal_Imm, Expansion, true);
+  Addr = llvm::cast<IceOperandX8632Mem>(
+      legalizeOperand(Addr, Legal_Reg | Legal_Mem, Expansion));
+  Expansion.push_back(
+      IceInstX8632Rmw::create(Cfg, Inst->getOp(), Addr, Src));
+  Cursor.consume();
+  return true;
+}
+
+// Fuses a Load into the instruction that uses its value, in the
+// following situations:
+//   a=[mem]; c=b+a ==> c=b+[mem]
+//   a=[mem]; c=a+b ==> c=b+[mem] if commutative
+//   a=[mem]; c=a-b ==> c=[mem]-b
+//   a=[mem]; icmp b,a ==> icmp b,[mem]
+//   a=[mem]; icmp a,imm ==> icmp [mem],imm
+// Only 32-bit integer and floating-point operations are fused, since
+// narrower register operands are emitted with 32-bit register names.
+// The user's Dest is written before its memory operand is read in the
+// lowered sequence, so it must not be part of the address.
+bool IceTargetX8632::foldLoad(const IceInstLoad *Load, IceInst *User) {
+  if (!llvm::isa<IceInstArithmetic>(User) && !llvm::isa<IceInstIcmp>(User))
+    return false;
+  IceVariable *Dest = Load->getDest();
+  IceType Type = Dest->getType();
+  IceOperand *Src0 = User->getSrc(0);
+  IceOperand *Src1 = User->getSrc(1);
+  IceOperand *Mem = makeLoadOperand(Load);
+  for (unsigned I = 0; I < Mem->getNumVars(); ++I) {
+    if (Mem->getVar(I) == User->getDest())
+      return false;
+  }
+  IceOpList NewSrcs;
   if (const IceInstArithmetic *Arith =
-          llvm::dyn_cast_or_null<const IceInstArithmetic>(Next)) {
-    IceVariable *DestLoad = Inst->getDest();
-    IceVariable *Src0Arith = llvm::dyn_cast<IceVariable>(Arith->getSrc(0));
-    IceVariable *Src1Arith = llvm::dyn_cast<IceVariable>(Arith->getSrc(1));
-    if (Src1Arith == DestLoad && Arith->isLastUse(Src1Arith) &&
-        DestLoad != Src0Arith) {
-      // TODO: This instruction leaks.
-      IceInstArithmetic *NewArith = IceInstArithmetic::create(
-          Cfg, Arith->getOp(), Arith->getDest(), Arith->getSrc(0), Src);
-      DeleteNextInst = true;
-      return lowerArithmetic(NewArith, NULL, DeleteNextInst);
-    } else if (Src0Arith == DestLoad && Arith->isCommutative() &&
-               Arith->isLastUse(Src0Arith) && DestLoad != Src1Arith) {
-      // TODO: This instruction leaks.
-      IceInstArithmetic *NewArith = IceInstArithmetic::create(
-          Cfg, Arith->getOp(), Arith->getDest(), Arith->getSrc(1), Src);
-      DeleteNextInst = true;
-      return lowerArithmetic(NewArith, NULL, DeleteNextInst);
+          llvm::dyn_cast<IceInstArithmetic>(User)) {
+    switch (Arith->getOp()) {
+    case IceInstArithmetic::Add:
+    case IceInstArithmetic::Sub:
+    case IceInstArithmetic::Mul:
+    case IceInstArithmetic::And:
+    case IceInstArithmetic::Or:
+    case IceInstArithmetic::Xor:
+      if (Type != IceType_i32)
+        return false;
+      break;
+    case IceInstArithmetic::Fadd:
+    case IceInstArithmetic::Fsub:
+    case IceInstArithmetic::Fmul:
+    case IceInstArithmetic::Fdiv:
+      break;
+    default:
+      return false;
+    }
+    // A memory Src0 of a non-commutative operation is loaded into a
+    // register by the lowering just as before, but keeping the operand
+    // lets lowerRmw() match it against a following store.
+    if (Src1 == Dest) {
+      NewSrcs.push_back(Src0);
+      NewSrcs.push_back(Mem);
+    } else if (Arith->isCommutative()) {
+      NewSrcs.push_back(Src1);
+      NewSrcs.push_back(Mem);
+    } else {
+      NewSrcs.push_back(Mem);
+      NewSrcs.push_back(Src1);
+    }
+  } else {
+    if (Type != IceType_i32)
+      return false;
+    if (Src1 == Dest) {
+      NewSrcs.push_back(Src0);
+      NewSrcs.push_back(Mem);
+    } else if (llvm::isa<IceConstant>(Src1)) {
+      NewSrcs.push_back(Mem);
+      NewSrcs.push_back(Src1);
+    } else {
+      return false;
     }
   }
-
-  // TODO: This instruction leaks.
-  IceInstAssign *Assign = IceInstAssign::create(Cfg, Inst->getDest(), Src);
-  return lowerAssign(Assign, Next, DeleteNextInst);
+  User->replaceSources(NewSrcs, Load);
+  User->updateVars(CurrentNode);
+  return true;
 }
 
 IceInstList IceTargetX8632::doAddressOptLoad(const IceInstLoad *Inst) {
@@ -1670,11 +3000,11 @@ IceInstList IceTargetX8632::doAddressOptLoad(const IceInstLoad *Inst) {
   IceOperand *Addr = Inst->getSrc(0);
   IceVariable *Index = NULL;
   int Shift = 0;
-  int32_t Offset = 0; // TODO: make IceConstant
+  int32_t Offset = 0;
+  IceConstantRelocatable *Relocatable = NULL;
   IceVariable *Base = llvm::dyn_cast<IceVariable>(Addr);
-  computeAddressOpt(Cfg, Base, Index, Shift, Offset);
-  if (Base && Addr != Base) {
-    IceConstant *OffsetOp = Cfg->getConstantInt(IceType_i32, Offset);
+  if (computeAddressOpt(Base, Index, Shift, Offset, Relocatable)) {
+    IceConstant *OffsetOp = makeDisplacement(Cfg, Offset, Relocatable);
     Addr = IceOperandX8632Mem::create(Cfg, Dest->getType(), Base, OffsetOp,
                                       Index, Shift);
     Expansion.push_back(IceInstLoad::create(Cfg, Dest, Addr));
@@ -1683,16 +3013,14 @@ IceInstList IceTargetX8632::doAddressOptLoad(const IceInstLoad *Inst) {
 }
 
 IceInstList IceTargetX8632::lowerPhi(const IceInstPhi *Inst,
-                                     const IceInst *Next,
-                                     bool &DeleteNextInst) {
+                                     const IceLoweringCursor &Cursor) {
   IceInstList Expansion;
   Cfg->setError("Phi lowering not implemented");
   return Expansion;
 }
 
 IceInstList IceTargetX8632::lowerRet(const IceInstRet *Inst,
-                                     const IceInst *Next,
-                                     bool &DeleteNextInst) {
+                                     const IceLoweringCursor &Cursor) {
   IceInstList Expansion;
   IceVariable *Reg = NULL;
   if (Inst->getSrcSize()) {
@@ -1724,90 +3052,33 @@ IceInstList IceTargetX8632::lowerRet(const IceInstRet *Inst,
 }
 
 IceInstList IceTargetX8632::lowerSelect(const IceInstSelect *Inst,
-                                        const IceInst *Next,
-                                        bool &DeleteNextInst) {
-  // a=d?b:c ==> cmp d,0; a=b; jne L1; FakeUse(a); a=c; L1:
+                                        const IceLoweringCursor &Cursor) {
+  // a=d?b:c ==> cmp d,0; t=c; t=cmovne b {t}; a=t
   //
-  // Alternative if a is reg and c is not imm: cmp d,0; a=b; a=cmoveq c {a}
+  // Floating-point types are blended through a mask instead.
   IceInstList Expansion;
+  IceVariable *Dest = Inst->getDest();
   IceOperand *Condition =
-      legalizeOperand(Inst->getCondition(), Legal_All, Expansion);
+      legalizeOperand(Inst->getCondition(), Legal_Reg | Legal_Mem, Expansion);
+  if (Dest->getType() == IceType_f32 || Dest->getType() == IceType_f64) {
+    lowerFloatSelect(Dest, Condition, Inst->getTrueOperand(),
+                     Inst->getFalseOperand(), Expansion);
+    return Expansion;
+  }
   IceConstant *OpZero = Cfg->getConstantInt(IceType_i32, 0);
   Expansion.push_back(IceInstX8632Icmp::create(Cfg, Condition, OpZero));
-
-  IceVariable *Dest = Inst->getDest();
-  bool IsI64 = (Dest->getType() == IceType_i64);
-  IceVariable *DestLo = NULL;
-  IceVariable *DestHi = NULL;
-  IceOperand *SrcTrue = Inst->getTrueOperand();
-  if (IsI64) {
-    DestLo = llvm::cast<IceVariable>(makeLowOperand(Dest));
-    DestHi = llvm::cast<IceVariable>(makeHighOperand(Dest));
-    IceOperand *SrcTrueHi = makeHighOperand(SrcTrue);
-    IceOperand *SrcTrueLo = makeLowOperand(SrcTrue);
-    IceOperand *RegHi =
-        legalizeOperand(SrcTrueHi, Legal_Reg | Legal_Imm, Expansion, true);
-    Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, RegHi));
-    IceOperand *RegLo =
-        legalizeOperand(SrcTrueLo, Legal_Reg | Legal_Imm, Expansion, true);
-    Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, RegLo));
-  } else {
-    SrcTrue = legalizeOperand(SrcTrue, Legal_Reg | Legal_Imm, Expansion, true);
-    Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, SrcTrue));
-  }
-
-  // create Label
-  IceInstX8632Label *Label = IceInstX8632Label::create(Cfg, this);
-
-  Expansion.push_back(
-      IceInstX8632Br::create(Cfg, Label, IceInstX8632Br::Br_ne));
-
-  // FakeUse(a)
-  if (IsI64) {
-    Expansion.push_back(IceInstFakeUse::create(Cfg, DestLo));
-    Expansion.push_back(IceInstFakeUse::create(Cfg, DestHi));
-  } else {
-    Expansion.push_back(IceInstFakeUse::create(Cfg, Dest));
-  }
-
-  IceOperand *SrcFalse = Inst->getFalseOperand();
-  if (IsI64) {
-    IceOperand *SrcFalseHi = makeHighOperand(SrcFalse);
-    IceOperand *SrcFalseLo = makeLowOperand(SrcFalse);
-    IceOperand *RegHi =
-        legalizeOperand(SrcFalseHi, Legal_Reg | Legal_Imm, Expansion, true);
-    Expansion.push_back(IceInstX8632Mov::create(Cfg, DestHi, RegHi));
-    IceOperand *RegLo =
-        legalizeOperand(SrcFalseLo, Legal_Reg | Legal_Imm, Expansion, true);
-    Expansion.push_back(IceInstX8632Mov::create(Cfg, DestLo, RegLo));
-  } else {
-    SrcFalse =
-        legalizeOperand(SrcFalse, Legal_Reg | Legal_Imm, Expansion, true);
-    Expansion.push_back(IceInstX8632Mov::create(Cfg, Dest, SrcFalse));
-  }
-
-  // Label:
-  Expansion.push_back(Label);
-
+  lowerCmov(Dest, Inst->getTrueOperand(), Inst->getFalseOperand(),
+            IceInstX8632Br::Br_ne, Expansion);
   return Expansion;
 }
 
 IceInstList IceTargetX8632::lowerStore(const IceInstStore *Inst,
-                                       const IceInst *Next,
-                                       bool &DeleteNextInst) {
+                                       const IceLoweringCursor &Cursor) {
   IceInstList Expansion;
 
   IceOperand *Value = Inst->getData();
-  IceOperand *Addr = Inst->getAddr();
-  IceOperandX8632Mem *NewAddr = llvm::dyn_cast<IceOperandX8632Mem>(Addr);
-  if (!NewAddr) {
-    IceVariable *Base = llvm::dyn_cast<IceVariable>(Addr);
-    IceConstant *Offset = llvm::dyn_cast<IceConstant>(Addr);
-    assert(Base || Offset);
-    NewAddr = IceOperandX8632Mem::create(Cfg, Value->getType(), Base, Offset);
-  }
-  NewAddr = llvm::cast<IceOperandX8632Mem>(
-      legalizeOperand(NewAddr, Legal_All, Expansion));
+  IceOperandX8632Mem *NewAddr = llvm::cast<IceOperandX8632Mem>(
+      legalizeOperand(makeStoreOperand(Inst), Legal_All, Expansion));
 
   if (NewAddr->getType() == IceType_i64) {
     Value = legalizeOperand(Value, Legal_All, Expansion);
@@ -1820,7 +3091,11 @@ IceInstList IceTargetX8632::lowerStore(const IceInstStore *Inst,
     Expansion.push_back(IceInstX8632Store::create(
         Cfg, ValueLo, llvm::cast<IceOperandX8632Mem>(makeLowOperand(NewAddr))));
   } else {
-    Value = legalizeOperand(Value, Legal_Reg | Legal_Imm, Expansion, true);
+    // An 8-bit store has to name the byte register.
+    if (Value->getType() == IceType_i8 && !llvm::isa<IceConstant>(Value))
+      Value = makeByteReg(Value, Expansion);
+    else
+      Value = legalizeOperand(Value, Legal_Reg | Legal_Imm, Expansion, true);
     Expansion.push_back(IceInstX8632Store::create(Cfg, Value, NewAddr));
   }
 
@@ -1833,11 +3108,11 @@ IceInstList IceTargetX8632::doAddressOptStore(const IceInstStore *Inst) {
   IceOperand *Addr = Inst->getAddr();
   IceVariable *Index = NULL;
   int Shift = 0;
-  int32_t Offset = 0; // TODO: make IceConstant
+  int32_t Offset = 0;
+  IceConstantRelocatable *Relocatable = NULL;
   IceVariable *Base = llvm::dyn_cast<IceVariable>(Addr);
-  computeAddressOpt(Cfg, Base, Index, Shift, Offset);
-  if (Base && Addr != Base) {
-    IceConstant *OffsetOp = Cfg->getConstantInt(IceType_i32, Offset);
+  if (computeAddressOpt(Base, Index, Shift, Offset, Relocatable)) {
+    IceConstant *OffsetOp = makeDisplacement(Cfg, Offset, Relocatable);
     Addr = IceOperandX8632Mem::create(Cfg, Data->getType(), Base, OffsetOp,
                                       Index, Shift);
     Expansion.push_back(IceInstStore::create(Cfg, Data, Addr));
@@ -1845,29 +3120,194 @@ IceInstList IceTargetX8632::doAddressOptStore(const IceInstStore *Inst) {
   return Expansion;
 }
 
+// Cost model for switch lowering, in units of one compare-and-branch.
+// A jump table costs a bounds check plus an indirect jump, and one
+// more unit for every SwitchTableEntriesPerUnit table entries, so
+// that a huge table isn't preferred over a slightly deeper compare
+// tree.  A jump table needs at least SwitchMinTableCases cases, and
+// at least SwitchMinTableDensity percent of its entries must be real
+// cases rather than holes that go to the default label.
+static const unsigned SwitchTableCost = 3;
+static const unsigned SwitchTableEntriesPerUnit = 32;
+static const unsigned SwitchMinTableCases = 4;
+static const unsigned SwitchMinTableDensity = 40;
+// Up to this many clusters are tested one after another rather than
+// split further by the compare tree.
+static const unsigned SwitchMaxLinearClusters = 3;
+
+// Partitions the sorted Cases into clusters with the lowest total cost,
+// by dynamic programming over the prefixes of Cases.
+void IceTargetX8632::clusterCases(const SwitchCaseList &Cases,
+                                  CaseClusterList &Clusters) {
+  unsigned NumCases = Cases.size();
+  // MinCost[I] is the cost of the best partition of the first I
+  // cases, and ClusterStart[I] is where its last cluster starts.
+  std::vector<uint64_t> MinCost(NumCases + 1);
+  std::vector<unsigned> ClusterStart(NumCases + 1);
+  for (unsigned Last = 1; Last <= NumCases; ++Last) {
+    MinCost[Last] = MinCost[Last - 1] + 1;
+    ClusterStart[Last] = Last - 1;
+    for (unsigned First = 0; First + SwitchMinTableCases <= Last; ++First) {
+      uint64_t Range = Cases[Last - 1].first - Cases[First].first + 1;
+      uint64_t Count = Last - First;
+      if (Count * 100 < Range * SwitchMinTableDensity)
+        continue;
+      uint64_t Cost = MinCost[First] + SwitchTableCost +
+                      Range / SwitchTableEntriesPerUnit;
+      if (Cost < MinCost[Last]) {
+        MinCost[Last] = Cost;
+        ClusterStart[Last] = First;
+      }
+    }
+  }
+  Clusters.clear();
+  for (unsigned Last = NumCases; Last > 0; Last = ClusterStart[Last]) {
+    CaseCluster Cluster;
+    Cluster.First = ClusterStart[Last];
+    Cluster.Last = Last;
+    Cluster.IsJumpTable = (Last - Cluster.First > 1);
+    Clusters.push_back(Cluster);
+  }
+  std::reverse(Clusters.begin(), Clusters.end());
+}
+
+// Lowers a jump table cluster: a bounds check that goes to Miss (or
+// to Default if Miss is NULL), followed by the indirect jump.
+void IceTargetX8632::lowerJumpTable(IceVariable *Src,
+                                    const SwitchCaseList &Cases,
+                                    const CaseCluster &Cluster,
+                                    IceCfgNode *Default,
+                                    IceInstX8632Label *Miss,
+                                    IceInstList &Expansion) {
+  uint64_t Low = Cases[Cluster.First].first;
+  uint64_t High = Cases[Cluster.Last - 1].first;
+  IceVariable *Index = Src;
+  if (Low != 0) {
+    Index = Cfg->makeVariable(IceType_i32, CurrentNode);
+    Index->setWeightInfinite();
+    Expansion.push_back(IceInstX8632Mov::create(Cfg, Index, Src));
+    Expansion.push_back(IceInstX8632Sub::create(
+        Cfg, Index, Cfg->getConstantInt(IceType_i32, Low)));
+  }
+  Expansion.push_back(IceInstX8632Icmp::create(
+      Cfg, Index, Cfg->getConstantInt(IceType_i32, High - Low)));
+  if (Miss)
+    Expansion.push_back(
+        IceInstX8632Br::create(Cfg, Miss, IceInstX8632Br::Br_a));
+  else
+    Expansion.push_back(
+        IceInstX8632Br::create(Cfg, Default, IceInstX8632Br::Br_a));
+  IceNodeList Targets(High - Low + 1, Default);
+  for (unsigned I = Cluster.First; I < Cluster.Last; ++I)
+    Targets[Cases[I].first - Low] = Cases[I].second;
+  Expansion.push_back(
+      IceInstX8632JumpTable::create(Cfg, this, Index, Targets));
+}
+
+// Lowers the clusters in [Begin, End), any of which may match Src,
+// and jumps to Default if none does.  A short run of clusters is
+// tested in order.  Otherwise the run is split at its middle cluster,
+// with an unsigned compare against that cluster's lowest value.
+void IceTargetX8632::lowerCaseTree(IceVariable *Src,
+                                   const SwitchCaseList &Cases,
+                                   const CaseClusterList &Clusters,
+                                   unsigned Begin, unsigned End,
+                                   IceCfgNode *Default,
+                                   IceInstList &Expansion) {
+  if (End - Begin <= SwitchMaxLinearClusters) {
+    for (unsigned I = Begin; I < End; ++I) {
+      const CaseCluster &Cluster = Clusters[I];
+      if (Cluster.IsJumpTable) {
+        // A bounds check failure in the last cluster goes straight to
+        // the default label, otherwise on to the next cluster.
+        IceInstX8632Label *Miss = NULL;
+        if (I + 1 < End)
+          Miss = IceInstX8632Label::create(Cfg, this);
+        lowerJumpTable(Src, Cases, Cluster, Default, Miss, Expansion);
+        if (Miss)
+          Expansion.push_back(Miss);
+      } else {
+        const SwitchCase &Case = Cases[Cluster.First];
+        Expansion.push_back(IceInstX8632Icmp::create(
+            Cfg, Src, Cfg->getConstantInt(IceType_i32, Case.first)));
+        Expansion.push_back(
+            IceInstX8632Br::create(Cfg, Case.second, IceInstX8632Br::Br_e));
+      }
+    }
+    Expansion.push_back(IceInstX8632Br::create(Cfg, Default));
+    return;
+  }
+  unsigned Mid = (Begin + End) / 2;
+  IceInstX8632Label *Left = IceInstX8632Label::create(Cfg, this);
+  uint64_t Pivot = Cases[Clusters[Mid].First].first;
+  Expansion.push_back(IceInstX8632Icmp::create(
+      Cfg, Src, Cfg->getConstantInt(IceType_i32, Pivot)));
+  Expansion.push_back(IceInstX8632Br::create(Cfg, Left, IceInstX8632Br::Br_b));
+  lowerCaseTree(Src, Cases, Clusters, Mid, End, Default, Expansion);
+  Expansion.push_back(Left);
+  lowerCaseTree(Src, Cases, Clusters, Begin, Mid, Default, Expansion);
+}
+
 IceInstList IceTargetX8632::lowerSwitch(const IceInstSwitch *Inst,
-                                        const IceInst *Next,
-                                        bool &DeleteNextInst) {
-  // This implements the most naive possible lowering.
-  // cmp a,val[0]; jeq label[0]; cmp a,val[1]; jeq label[1]; ... jmp default
+                                        const IceLoweringCursor &Cursor) {
   IceInstList Expansion;
   IceOperand *Src = Inst->getSrc(0);
+  IceCfgNode *Default = Inst->getLabelDefault();
   unsigned NumCases = Inst->getNumCases();
-  // OK, we'll be slightly less naive by forcing Src into a physical
-  // register if there are 2 or more uses.
-  if (NumCases >= 2)
-    Src = legalizeOperandToVar(Src, Expansion, true);
-  else
-    Src = legalizeOperand(Src, Legal_All, Expansion, true);
-  for (unsigned I = 0; I < NumCases; ++I) {
-    IceOperand *Value = Cfg->getConstantInt(IceType_i32, Inst->getValue(I));
-    Expansion.push_back(IceInstX8632Icmp::create(Cfg, Src, Value));
-    Expansion.push_back(
-        IceInstX8632Br::create(Cfg, Inst->getLabel(I), IceInstX8632Br::Br_e));
-  }
 
-  Expansion.push_back(IceInstX8632Br::create(Cfg, Inst->getLabelDefault()));
+  if (Src->getType() == IceType_i64) {
+    // Compare both halves of each case in turn:
+    // cmp lo,val.lo; jne next; cmp hi,val.hi; je label; next: ...
+    IceVariable *SrcLo =
+        legalizeOperandToVar(makeLowOperand(Src), Expansion, true);
+    IceVariable *SrcHi =
+        legalizeOperandToVar(makeHighOperand(Src), Expansion, true);
+    for (unsigned I = 0; I < NumCases; ++I) {
+      uint64_t Value = Inst->getValue(I);
+      IceInstX8632Label *NextCase = IceInstX8632Label::create(Cfg, this);
+      Expansion.push_back(IceInstX8632Icmp::create(
+          Cfg, SrcLo, Cfg->getConstantInt(IceType_i32, Value & 0xffffffffu)));
+      Expansion.push_back(
+          IceInstX8632Br::create(Cfg, NextCase, IceInstX8632Br::Br_ne));
+      Expansion.push_back(IceInstX8632Icmp::create(
+          Cfg, SrcHi, Cfg->getConstantInt(IceType_i32, Value >> 32)));
+      Expansion.push_back(IceInstX8632Br::create(Cfg, Inst->getLabel(I),
+                                                 IceInstX8632Br::Br_e));
+      Expansion.push_back(NextCase);
+    }
+    Expansion.push_back(IceInstX8632Br::create(Cfg, Default));
+    return Expansion;
+  }
 
+  SwitchCaseList Cases;
+  for (unsigned I = 0; I < NumCases; ++I)
+    Cases.push_back(SwitchCase(Inst->getValue(I), Inst->getLabel(I)));
+  std::sort(Cases.begin(), Cases.end());
+  CaseClusterList Clusters;
+  clusterCases(Cases, Clusters);
+
+  // The case values are zero-extended, so a narrower Src is
+  // zero-extended to match, and all the range compares are unsigned.
+  if (Src->getType() != IceType_i32) {
+    IceOperand *Narrow = legalizeOperand(Src, Legal_Reg | Legal_Mem, Expansion);
+    if (Narrow->getType() == IceType_i8 && llvm::isa<IceVariable>(Narrow))
+      Narrow = makeByteReg(Narrow, Expansion);
+    IceVariable *Wide = Cfg->makeVariable(IceType_i32, CurrentNode);
+    Wide->setWeightInfinite();
+    Expansion.push_back(IceInstX8632Movzx::create(Cfg, Wide, Narrow));
+    Src = Wide;
+  } else if (Clusters.size() == 1 && !Clusters[0].IsJumpTable) {
+    // A single compare can take Src from memory.
+    Src = legalizeOperand(Src, Legal_Reg | Legal_Mem, Expansion, true);
+    Expansion.push_back(IceInstX8632Icmp::create(
+        Cfg, Src, Cfg->getConstantInt(IceType_i32, Cases[0].first)));
+    Expansion.push_back(
+        IceInstX8632Br::create(Cfg, Cases[0].second, IceInstX8632Br::Br_e));
+    Expansion.push_back(IceInstX8632Br::create(Cfg, Default));
+    return Expansion;
+  }
+  lowerCaseTree(legalizeOperandToVar(Src, Expansion, true), Cases, Clusters, 0,
+                Clusters.size(), Default, Expansion);
   return Expansion;
 }
 
@@ -1894,6 +3334,9 @@ IceOperand *IceTargetX8632::legalizeOperand(IceOperand *From, LegalMask Allowed,
     }
 
     if (!(Allowed & Legal_Mem)) {
+      // An 8-bit load has to name the byte register.
+      if (RegNum < 0 && From->getType() == IceType_i8)
+        return makeByteReg(From, Insts);
       IceVariable *Reg = Cfg->makeVariable(From->getType(), CurrentNode);
       if (RegNum < 0) {
         Reg->setWeightInfinite();
@@ -1949,6 +3392,27 @@ IceVariable *IceTargetX8632::legalizeOperandToVar(IceOperand *From,
       legalizeOperand(From, Legal_Reg, Insts, AllowOverlap, RegNum));
 }
 
+IceVariable *IceTargetX8632::makeByteReg(IceOperand *From,
+                                         IceInstList &Insts) {
+  IceVariable *Reg = Cfg->makeVariable(From->getType(), CurrentNode);
+  Reg->setWeightInfinite();
+  if (IceVariable *Var = llvm::dyn_cast<IceVariable>(From))
+    Reg->setPreferredRegister(Var, true);
+  if (ByteRegVars.size() <= Reg->getIndex())
+    ByteRegVars.resize(Reg->getIndex() + 1);
+  ByteRegVars[Reg->getIndex()] = true;
+  Insts.push_back(IceInstX8632Mov::create(Cfg, Reg, From));
+  return Reg;
+}
+
+const llvm::SmallBitVector &
+IceTargetX8632::getRegisterSetForVariable(const IceVariable *Var) const {
+  uint32_t Index = Var->getIndex();
+  if (Index < ByteRegVars.size() && ByteRegVars[Index])
+    return ByteRegisters;
+  return getRegisterSetForType(Var->getType());
+}
+
 ////////////////////////////////////////////////////////////////
 
 void IceTargetX8632Fast::translate(void) {
@@ -1967,10 +3431,16 @@ void IceTargetX8632Fast::translate(void) {
   if (Cfg->hasError())
     return;
   T_deletePhis.printElapsedUs(Cfg->Str, "deletePhis()");
+  IceTimer T_reorderNodes;
+  Cfg->reorderNodes();
+  if (Cfg->hasError())
+    return;
+  T_reorderNodes.printElapsedUs(Cfg->Str, "reorderNodes()");
   if (Cfg->Str.isVerbose())
     Cfg->Str << "================ After Phi lowering ================\n";
   Cfg->dump();
 
+  findFrameRequirements();
   IceTimer T_genCode;
   Cfg->genCode();
   if (Cfg->hasError())
@@ -1986,55 +3456,290 @@ void IceTargetX8632Fast::translate(void) {
   if (Cfg->hasError())
     return;
   T_genFrame.printElapsedUs(Cfg->Str, "genFrame()");
+  IceTimer T_doBranchOpt;
+  Cfg->doBranchOpt();
+  if (Cfg->hasError())
+    return;
+  T_doBranchOpt.printElapsedUs(Cfg->Str, "doBranchOpt()");
+  IceTimer T_alignLoops;
+  Cfg->alignLoops();
+  if (Cfg->hasError())
+    return;
+  T_alignLoops.printElapsedUs(Cfg->Str, "alignLoops()");
   if (Cfg->Str.isVerbose())
     Cfg->Str << "================ After stack frame mapping ================\n";
   Cfg->dump();
+  deleteRegManagers();
+}
+
+// Starts tracking register contents for CurrentNode.  A node with a
+// single predecessor inherits the contents captured at the
+// predecessor's branches into it, so that an extended basic block is
+// handled as one unit.  Other nodes start with nothing known.
+void IceTargetX8632Fast::startNode(void) {
+  delete RegManager;
+  RegManagerNode = CurrentNode;
+  EdgeStates.resize(Cfg->getNumNodes());
+  IceRegManager *&Saved = EdgeStates[CurrentNode->getIndex()];
+  if (Saved) {
+    RegManager = Saved;
+    Saved = NULL;
+  } else {
+    RegManager = IceRegManager::create(
+        Cfg, getRegisterSet(RegMask_All,
+                            RegMask_StackPointer | RegMask_FramePointer));
+  }
+  if (Cfg->Str.isVerbose(IceV_RegManager)) {
+    Cfg->Str << "// Registers at start of " << CurrentNode->getName() << ":";
+    RegManager->dump(Cfg->Str);
+    Cfg->Str << "\n";
+  }
+}
+
+// Deletes the register contents still held once lowering is done:
+// those of the last node, and any captured for a node that was never
+// started.
+void IceTargetX8632Fast::deleteRegManagers(void) {
+  delete RegManager;
+  RegManager = NULL;
+  RegManagerNode = NULL;
+  for (std::vector<IceRegManager *>::iterator I = EdgeStates.begin(),
+                                              E = EdgeStates.end();
+       I != E; ++I) {
+    delete *I;
+  }
+  EdgeStates.clear();
+}
+
+// Records the register contents at a branch to Target, if Target has
+// a single predecessor.  Multiple branches to the same Target keep
+// only what they agree on.
+void IceTargetX8632Fast::captureEdgeState(IceCfgNode *Target) {
+  if (Target == NULL || Target->getInEdges().size() != 1)
+    return;
+  IceRegManager *&Saved = EdgeStates[Target->getIndex()];
+  if (Saved)
+    Saved->intersect(*RegManager);
+  else
+    Saved = IceRegManager::create(*RegManager);
+}
+
+// Returns a variable of the given type that is pre-colored with
+// RegNum, creating it the first time.
+IceVariable *IceTargetX8632Fast::getTypedRegister(IceType Type, int RegNum) {
+  unsigned Index = Type * Reg_NUM + RegNum;
+  if (TypedRegisters.size() <= Index)
+    TypedRegisters.resize(IceType_NUM * Reg_NUM);
+  IceVariable *Reg = TypedRegisters[Index];
+  if (Reg == NULL) {
+    IceCfgNode *Node = NULL; // NULL means multi-block lifetime
+    Reg = Cfg->makeVariable(Type, Node);
+    Reg->setRegNum(RegNum);
+    TypedRegisters[Index] = Reg;
+  }
+  return Reg;
+}
+
+// Assigns an infinite-weight variable the least recently used
+// register among AvailableRegisters, and removes that register from
+// AvailableRegisters.
+void IceTargetX8632Fast::colorTemporary(
+    IceVariable *Var, llvm::SmallBitVector &AvailableRegisters) {
+  if (Var->getRegNum() >= 0)
+    return;
+  if (!Var->getWeight().isInf())
+    return;
+  int RegNum = RegManager->getRegister(
+      AvailableRegisters & getRegisterSetForVariable(Var));
+  assert(RegNum >= 0);
+  Var->setRegNum(RegNum);
+  AvailableRegisters[RegNum] = false;
+}
+
+// Returns the registers of the temporaries whose last use in the
+// expansion is Inst, at position Index, to AvailableRegisters.
+// Branches within an expansion only go forward, so a temporary is
+// dead after its last use in list order.
+void IceTargetX8632Fast::releaseTemporaries(
+    const IceInst *Inst, unsigned Index, const LastUseMap &LastUses,
+    llvm::SmallBitVector &AvailableRegisters) {
+  IceVarList Vars;
+  if (Inst->getDest())
+    Vars.push_back(Inst->getDest());
+  for (unsigned SrcNum = 0; SrcNum < Inst->getSrcSize(); ++SrcNum) {
+    IceOperand *Src = Inst->getSrc(SrcNum);
+    for (unsigned J = 0; J < Src->getNumVars(); ++J)
+      Vars.push_back(Src->getVar(J));
+  }
+  for (IceVarList::const_iterator I = Vars.begin(), E = Vars.end(); I != E;
+       ++I) {
+    LastUseMap::const_iterator Last = LastUses.find(*I);
+    if (Last != LastUses.end() && Last->second == Index &&
+        (*I)->getRegNum() >= 0)
+      AvailableRegisters[(*I)->getRegNum()] = true;
+  }
+}
+
+// Updates the register contents according to what Inst writes.
+void IceTargetX8632Fast::updateRegManager(const IceInst *Inst) {
+  if (llvm::isa<IceInstX8632Call>(Inst)) {
+    for (int RegNum = ScratchRegs.find_first(); RegNum != -1;
+         RegNum = ScratchRegs.find_next(RegNum))
+      RegManager->notifyKill(RegNum);
+  }
+  // These implicitly write edx:eax in addition to their Dest.
+  if (llvm::isa<IceInstX8632Mul>(Inst) || llvm::isa<IceInstX8632Div>(Inst) ||
+      llvm::isa<IceInstX8632Idiv>(Inst)) {
+    RegManager->notifyKill(Reg_eax);
+    RegManager->notifyKill(Reg_edx);
+  }
+  if (llvm::isa<IceInstFakeKill>(Inst)) {
+    for (unsigned SrcNum = 0; SrcNum < Inst->getSrcSize(); ++SrcNum) {
+      const IceVariable *Var = llvm::cast<IceVariable>(Inst->getSrc(SrcNum));
+      RegManager->notifyKill(Var->getRegNum());
+    }
+  }
+  IceVariable *Dest = Inst->getDest();
+  if (Dest == NULL)
+    return;
+  bool IsMov = llvm::isa<IceInstX8632Mov>(Inst);
+  if (Dest->getRegNum() >= 0) {
+    RegManager->notifyLoad(Dest->getRegNum(), IsMov ? Inst->getSrc(0) : NULL);
+    return;
+  }
+  const IceVariable *Src =
+      IsMov ? llvm::dyn_cast<IceVariable>(Inst->getSrc(0)) : NULL;
+  if (Src && Src->getRegNum() >= 0) {
+    RegManager->notifyStore(Src->getRegNum(), Dest);
+  } else {
+    RegManager->notifyDef(Dest);
+  }
+  if (Dest->getLow())
+    RegManager->notifyDef(Dest->getLow());
+  if (Dest->getHigh())
+    RegManager->notifyDef(Dest->getHigh());
 }
 
+// The fast target has no global register allocator.  Instead, the
+// register manager tracks which variables and constants each register
+// holds as the lowering proceeds through a block, so that a
+// temporary's load can be skipped when some register already holds
+// the value, and stack operands can be read from a register instead.
 void IceTargetX8632Fast::postLower(const IceInstList &Expansion) {
-  llvm::SmallBitVector AvailableRegisters = getRegisterSet(RegMask_All);
-  // Make one pass to black-list pre-colored registers.  TODO: If
-  // there was some prior register allocation pass that made register
-  // assignments, those registers need to be black-listed here as
-  // well.
+  if (CurrentNode != RegManagerNode)
+    startNode();
+  llvm::SmallBitVector AvailableRegisters =
+      getRegisterSet(RegMask_All, RegMask_StackPointer | RegMask_FramePointer);
+  // Make one pass to black-list pre-colored registers, and to find
+  // the last use of each temporary so that its register can be reused
+  // afterwards.  The registers killed by a call are not black-listed,
+  // since no temporary lives across the call, and the second pass
+  // accounts for the kill.
+  LastUseMap LastUses;
+  unsigned Index = 0;
   for (IceInstList::const_iterator I = Expansion.begin(), E = Expansion.end();
-       I != E; ++I) {
+       I != E; ++I, ++Index) {
     const IceInst *Inst = *I;
-    unsigned VarIndex = 0;
+    if (llvm::isa<IceInstFakeKill>(Inst))
+      continue;
+    IceVariable *Dest = Inst->getDest();
+    if (Dest && Dest->getRegNum() >= 0)
+      AvailableRegisters[Dest->getRegNum()] = false;
+    else if (Dest && Dest->getWeight().isInf())
+      LastUses[Dest] = Index;
     for (unsigned SrcNum = 0; SrcNum < Inst->getSrcSize(); ++SrcNum) {
       IceOperand *Src = Inst->getSrc(SrcNum);
       unsigned NumVars = Src->getNumVars();
-      for (unsigned J = 0; J < NumVars; ++J, ++VarIndex) {
-        const IceVariable *Var = Src->getVar(J);
+      for (unsigned J = 0; J < NumVars; ++J) {
+        IceVariable *Var = Src->getVar(J);
         int RegNum = Var->getRegNum();
-        if (RegNum < 0)
+        if (RegNum < 0) {
+          if (Var->getWeight().isInf())
+            LastUses[Var] = Index;
           continue;
+        }
         AvailableRegisters[RegNum] = false;
       }
     }
   }
-  // The second pass colors infinite-weight variables.
+  // The second pass goes through the expansion in order, coloring
+  // infinite-weight variables where they first appear and keeping the
+  // register contents up to date.  Intra-block labels merge the
+  // contents from the branches to them.
+  std::map<const IceInstX8632Label *, IceRegManager *> LabelStates;
+  Index = 0;
   for (IceInstList::const_iterator I = Expansion.begin(), E = Expansion.end();
-       I != E; ++I) {
-    const IceInst *Inst = *I;
-    unsigned VarIndex = 0;
+       I != E; ++I, ++Index) {
+    IceInst *Inst = *I;
+    if (Inst->isDeleted())
+      continue;
+    if (const IceInstX8632Label *Label =
+            llvm::dyn_cast<IceInstX8632Label>(Inst)) {
+      std::map<const IceInstX8632Label *, IceRegManager *>::iterator Saved =
+          LabelStates.find(Label);
+      if (Saved != LabelStates.end()) {
+        RegManager->intersect(*Saved->second);
+        delete Saved->second;
+        LabelStates.erase(Saved);
+      } else {
+        RegManager->killAll();
+      }
+      continue;
+    }
+    IceVariable *Dest = Inst->getDest();
+    // A temporary loaded from a value that some allowed register
+    // already holds takes over that register, and the load goes away.
+    if (llvm::isa<IceInstX8632Mov>(Inst) && Dest && Dest->getRegNum() < 0 &&
+        Dest->getWeight().isInf()) {
+      int RegNum = RegManager->findRegister(
+          Inst->getSrc(0),
+          AvailableRegisters & getRegisterSetForVariable(Dest));
+      if (RegNum >= 0) {
+        Dest->setRegNum(RegNum);
+        AvailableRegisters[RegNum] = false;
+        RegManager->notifyUse(RegNum);
+        Inst->setDeleted();
+        releaseTemporaries(Inst, Index, LastUses, AvailableRegisters);
+        continue;
+      }
+    }
+    if (Dest)
+      colorTemporary(Dest, AvailableRegisters);
     for (unsigned SrcNum = 0; SrcNum < Inst->getSrcSize(); ++SrcNum) {
       IceOperand *Src = Inst->getSrc(SrcNum);
-      unsigned NumVars = Src->getNumVars();
-      for (unsigned J = 0; J < NumVars; ++J, ++VarIndex) {
-        IceVariable *Var = Src->getVar(J);
-        int RegNum = Var->getRegNum();
-        if (RegNum >= 0)
+      for (unsigned J = 0; J < Src->getNumVars(); ++J)
+        colorTemporary(Src->getVar(J), AvailableRegisters);
+    }
+    // Read stack operands from registers that already hold them.  The
+    // pseudo-instructions are left alone.
+    if (!llvm::isa<IceInstFakeUse>(Inst) && !llvm::isa<IceInstFakeDef>(Inst) &&
+        !llvm::isa<IceInstFakeKill>(Inst)) {
+      for (unsigned SrcNum = 0; SrcNum < Inst->getSrcSize(); ++SrcNum) {
+        IceVariable *Var = llvm::dyn_cast<IceVariable>(Inst->getSrc(SrcNum));
+        if (Var == NULL || Var->getRegNum() >= 0 || Var == Dest)
           continue;
-        if (!Var->getWeight().isInf())
+        int RegNum = RegManager->findRegister(
+            Var, getRegisterSetForType(Var->getType()));
+        if (RegNum < 0)
           continue;
-        llvm::SmallBitVector AvailableTypedRegisters =
-            AvailableRegisters & getRegisterSetForType(Var->getType());
-        assert(!AvailableTypedRegisters.empty());
-        RegNum = AvailableTypedRegisters.find_first();
-        Var->setRegNum(RegNum);
-        AvailableRegisters[RegNum] = false;
+        Inst->replaceSource(SrcNum, getTypedRegister(Var->getType(), RegNum));
+        RegManager->notifyUse(RegNum);
+      }
+    }
+    updateRegManager(Inst);
+    releaseTemporaries(Inst, Index, LastUses, AvailableRegisters);
+    if (const IceInstX8632Br *Br = llvm::dyn_cast<IceInstX8632Br>(Inst)) {
+      if (const IceInstX8632Label *Label = Br->getLabel()) {
+        IceRegManager *&Saved = LabelStates[Label];
+        if (Saved)
+          Saved->intersect(*RegManager);
+        else
+          Saved = IceRegManager::create(*RegManager);
+      } else {
+        captureEdgeState(Br->getTargetTrue());
+        captureEdgeState(Br->getTargetFalse());
       }
     }
   }
+  assert(LabelStates.empty());
 }
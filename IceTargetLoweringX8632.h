@@ -8,6 +8,8 @@
 #define _IceTargetLoweringX8632_h
 
 #include "IceDefs.h"
+#include "IceInstX8632.h"
+#include "IceRegManager.h"
 #include "IceTargetLowering.h"
 
 class IceTargetX8632 : public IceTargetLowering {
@@ -16,7 +18,7 @@ public:
   virtual void translate(void);
 
   virtual IceVariable *getPhysicalRegister(unsigned RegNum);
-  virtual IceString getRegName(int RegNum) const {
+  virtual const IceString &getRegName(int RegNum) const {
     assert(RegNum >= 0);
     assert(RegNum < Reg_NUM);
     return RegNames[RegNum];
@@ -28,7 +30,11 @@ public:
   getRegisterSetForType(IceType Type) const {
     return TypeToRegisterSet[Type];
   }
+  virtual const llvm::SmallBitVector &
+  getRegisterSetForVariable(const IceVariable *Var) const;
   virtual bool hasFramePointer(void) const { return IsEbpBasedFrame; }
+  virtual bool hasCalls(void) const { return HasCalls; }
+  virtual bool hasLeafFrame(void) const { return IsLeafFrame; }
   virtual unsigned getFrameOrStackReg(void) const {
     return IsEbpBasedFrame ? Reg_ebp : Reg_esp;
   }
@@ -37,16 +43,17 @@ public:
   }
   virtual void addProlog(IceCfgNode *Node);
   virtual void addEpilog(IceCfgNode *Node);
+  virtual void doBranchOpt(IceInst *Inst, const IceCfgNode *NextNode);
+  virtual IceAssembler *createAssembler(void);
   uint32_t makeNextLabelNumber(void) { return NextLabelNumber++; }
   // Ensure that a 64-bit IceVariable has been split into 2 32-bit
   // IceVariables, creating them if necessary.  This is needed for all
-  // I64 operations, and it is needed for pushing F64 arguments for
-  // function calls using the 32-bit push instruction (though the
-  // latter could be done by directly writing to the stack).
+  // I64 operations.
   void split64(IceVariable *Var);
   void setArgOffsetAndCopy(IceVariable *Arg, IceVariable *FramePtr,
                            int BasicFrameOffset, int &InArgsSizeBytes,
                            IceInstList &Expansion);
+  int assignSpillSlots(IceVarList &Spilled, std::vector<int> &SlotEnd);
   IceOperand *makeLowOperand(IceOperand *Operand);
   IceOperand *makeHighOperand(IceOperand *Operand);
   enum Registers {
@@ -73,36 +80,40 @@ protected:
   IceTargetX8632(IceCfg *Cfg);
 
   virtual IceInstList lowerAlloca(const IceInstAlloca *Inst,
-                                  const IceInst *Next, bool &DeleteNextInst);
+                                  const IceLoweringCursor &Cursor);
   virtual IceInstList lowerArithmetic(const IceInstArithmetic *Inst,
-                                      const IceInst *Next,
-                                      bool &DeleteNextInst);
+                                      const IceLoweringCursor &Cursor);
   virtual IceInstList lowerAssign(const IceInstAssign *Inst,
-                                  const IceInst *Next, bool &DeleteNextInst);
-  virtual IceInstList lowerBr(const IceInstBr *Inst, const IceInst *Next,
-                              bool &DeleteNextInst);
-  virtual IceInstList lowerCall(const IceInstCall *Inst, const IceInst *Next,
-                                bool &DeleteNextInst);
-  virtual IceInstList lowerCast(const IceInstCast *Inst, const IceInst *Next,
-                                bool &DeleteNextInst);
-  virtual IceInstList lowerFcmp(const IceInstFcmp *Inst, const IceInst *Next,
-                                bool &DeleteNextInst);
-  virtual IceInstList lowerIcmp(const IceInstIcmp *Inst, const IceInst *Next,
-                                bool &DeleteNextInst);
-  virtual IceInstList lowerLoad(const IceInstLoad *Inst, const IceInst *Next,
-                                bool &DeleteNextInst);
-  virtual IceInstList lowerPhi(const IceInstPhi *Inst, const IceInst *Next,
-                               bool &DeleteNextInst);
-  virtual IceInstList lowerRet(const IceInstRet *Inst, const IceInst *Next,
-                               bool &DeleteNextInst);
+                                  const IceLoweringCursor &Cursor);
+  virtual IceInstList lowerBr(const IceInstBr *Inst,
+                              const IceLoweringCursor &Cursor);
+  virtual IceInstList lowerCall(const IceInstCall *Inst,
+                                const IceLoweringCursor &Cursor);
+  virtual IceInstList lowerCast(const IceInstCast *Inst,
+                                const IceLoweringCursor &Cursor);
+  virtual IceInstList lowerFcmp(const IceInstFcmp *Inst,
+                                const IceLoweringCursor &Cursor);
+  virtual IceInstList lowerIcmp(const IceInstIcmp *Inst,
+                                const IceLoweringCursor &Cursor);
+  virtual IceInstList lowerLoad(const IceInstLoad *Inst,
+                                const IceLoweringCursor &Cursor);
+  virtual IceInstList lowerPhi(const IceInstPhi *Inst,
+                               const IceLoweringCursor &Cursor);
+  virtual IceInstList lowerRet(const IceInstRet *Inst,
+                               const IceLoweringCursor &Cursor);
   virtual IceInstList lowerSelect(const IceInstSelect *Inst,
-                                  const IceInst *Next, bool &DeleteNextInst);
-  virtual IceInstList lowerStore(const IceInstStore *Inst, const IceInst *Next,
-                                 bool &DeleteNextInst);
+                                  const IceLoweringCursor &Cursor);
+  virtual IceInstList lowerStore(const IceInstStore *Inst,
+                                 const IceLoweringCursor &Cursor);
   virtual IceInstList lowerSwitch(const IceInstSwitch *Inst,
-                                  const IceInst *Next, bool &DeleteNextInst);
+                                  const IceLoweringCursor &Cursor);
   virtual IceInstList doAddressOptLoad(const IceInstLoad *Inst);
   virtual IceInstList doAddressOptStore(const IceInstStore *Inst);
+  virtual bool foldLoad(const IceInstLoad *Load, IceInst *User);
+  IceOperand *makeLoadOperand(const IceInstLoad *Load);
+  IceOperandX8632Mem *makeStoreOperand(const IceInstStore *Store);
+  bool lowerRmw(const IceInstArithmetic *Inst, const IceLoweringCursor &Cursor,
+                IceInstList &Expansion);
 
   enum OperandLegalization {
     Legal_None = 0,
@@ -117,11 +128,109 @@ protected:
                               int RegNum = -1);
   IceVariable *legalizeOperandToVar(IceOperand *From, IceInstList &Insts,
                                     bool AllowOverlap = false, int RegNum = -1);
+  // Copies From into a new temporary that is only assigned a register
+  // with an 8-bit form, for an instruction that has to name the byte
+  // register.
+  IceVariable *makeByteReg(IceOperand *From, IceInstList &Insts);
+
+  // Strength reduction of i32 multiplication, division, and remainder
+  // by a constant.  Each returns false without emitting anything if
+  // the constant isn't handled, leaving it to imul, div, or idiv.
+  bool lowerMulByConstant(IceVariable *Dest, IceOperand *Src, int32_t Value,
+                          IceInstList &Expansion);
+  bool lowerUdivByConstant(IceVariable *Dest, IceOperand *Src,
+                           uint32_t Divisor, bool Remainder,
+                           IceInstList &Expansion);
+  bool lowerSdivByConstant(IceVariable *Dest, IceOperand *Src, int32_t Divisor,
+                           bool Remainder, IceInstList &Expansion);
+  IceVariable *makeMulHigh(IceOperand *Src, uint32_t Multiplier, bool Signed,
+                           IceInstList &Expansion);
+  void lowerRemainder(IceVariable *Dest, IceOperand *Src,
+                      IceVariable *Quotient, uint32_t Divisor,
+                      IceInstList &Expansion);
+
+  // Inline lowering of i64 division and remainder, falling back to
+  // the helper call for divisors that don't fit in 32 bits.
+  void lowerDiv64(IceVariable *Dest, IceOperand *Src0, IceOperand *Src1,
+                  const char *HelperName, bool Signed, bool Remainder,
+                  IceInstList &Expansion);
+  void lowerDiv64ByPowerOf2(IceVariable *Dest, IceOperand *Src, unsigned Log,
+                            bool Negative, bool Signed, bool Remainder,
+                            IceInstList &Expansion);
+  void lowerDiv64Call(IceVariable *Dest, IceOperand *Src0, IceOperand *Src1,
+                      const char *HelperName, IceInstList &Expansion);
+  IceVariable *makeSign64(IceVariable *Hi, IceInstList &Expansion);
+  void applySign64(IceVariable *Lo, IceVariable *Hi, IceOperand *Sign,
+                   IceInstList &Expansion);
+
+  // Inline lowering of conversions between i64 and floating point,
+  // using SSE2 plus x87 fild/fistp, with the first 16 bytes of the
+  // outgoing-argument area as scratch memory.  Under OptSize, these
+  // call a helper instead.
+  void lowerFpToI64(const IceInstCast *Inst, IceInstList &Expansion);
+  void lowerI64ToFp(const IceInstCast *Inst, IceInstList &Expansion);
+  void lowerCast64Call(IceVariable *Dest, IceOperand *Src,
+                       const char *HelperName, IceInstList &Expansion);
+  IceOperandX8632Mem *makeScratchOperand(IceType Type, uint32_t Offset);
+
+  // Branch-free lowering of i1 results and selects.  The flags must
+  // already be set by a compare, which the emitted movs leave intact.
+  void lowerCompare32(IceOperand *Src0, IceOperand *Src1,
+                      IceInstList &Expansion);
+  void lowerCmov(IceVariable *Dest, IceOperand *SrcTrue, IceOperand *SrcFalse,
+                 IceInstX8632Br::BrCond Condition, IceInstList &Expansion);
+  void lowerFloatSelect(IceVariable *Dest, IceOperand *Condition,
+                        IceOperand *SrcTrue, IceOperand *SrcFalse,
+                        IceInstList &Expansion);
+
+  // Switch lowering.  The cases are sorted by value and partitioned
+  // into clusters, each of which is either a single case or a dense
+  // run of cases dispatched through a jump table.  The clusters are
+  // then searched with a balanced compare tree.
+  typedef std::pair<uint64_t, IceCfgNode *> SwitchCase;
+  typedef std::vector<SwitchCase> SwitchCaseList;
+  struct CaseCluster {
+    unsigned First, Last; // range of cases [First, Last)
+    bool IsJumpTable;
+  };
+  typedef std::vector<CaseCluster> CaseClusterList;
+  void clusterCases(const SwitchCaseList &Cases, CaseClusterList &Clusters);
+  void lowerCaseTree(IceVariable *Src, const SwitchCaseList &Cases,
+                     const CaseClusterList &Clusters, unsigned Begin,
+                     unsigned End, IceCfgNode *Default,
+                     IceInstList &Expansion);
+  void lowerJumpTable(IceVariable *Src, const SwitchCaseList &Cases,
+                      const CaseCluster &Cluster, IceCfgNode *Default,
+                      IceInstX8632Label *Miss, IceInstList &Expansion);
+
+  uint32_t getOutArgsSize(const IceInst *Inst);
+  void findFrameRequirements(void);
+  bool canLowerAsTailCall(const IceInstCall *Inst,
+                          const IceLoweringCursor &Cursor);
 
   bool IsEbpBasedFrame;
   int FrameSizeLocals;
-  int LocalsSizeBytes;
+  // Offset of the incoming arguments from the frame or stack register.
+  int InArgsOffset;
+  // HasCalls is set when lowering any call other than a tail call.  A
+  // function without calls, a frame pointer, or stack slots gets a
+  // leaf frame.
+  bool HasCalls;
+  bool IsLeafFrame;
+  // Unless the function has dynamic allocas, which move esp, all of
+  // its allocas are at fixed offsets from esp in the static alloca
+  // area at the bottom of the frame.  Calls store their arguments
+  // into the outgoing-argument area, which is the first
+  // MaxOutArgsSize bytes of the static alloca area.
+  bool HasAllocas;
+  bool HasDynamicAllocas;
+  uint32_t MaxOutArgsSize;
+  uint32_t StaticAllocaSize;
+  uint32_t StaticAllocaAlign;
   llvm::SmallBitVector TypeToRegisterSet[IceType_NUM];
+  llvm::SmallBitVector ByteRegisters;
+  // ByteRegVars[i] is set if variable i was made by makeByteReg().
+  llvm::BitVector ByteRegVars;
   llvm::SmallBitVector ScratchRegs;
   llvm::SmallBitVector RegsUsed;
   uint32_t NextLabelNumber;
@@ -135,11 +244,36 @@ public:
   static IceTargetX8632Fast *create(IceCfg *Cfg) {
     return new IceTargetX8632Fast(Cfg);
   }
+  virtual ~IceTargetX8632Fast() { deleteRegManagers(); }
   virtual void translate(void);
 
 protected:
-  IceTargetX8632Fast(IceCfg *Cfg) : IceTargetX8632(Cfg) {}
+  IceTargetX8632Fast(IceCfg *Cfg)
+      : IceTargetX8632(Cfg), RegManager(NULL), RegManagerNode(NULL) {}
   virtual void postLower(const IceInstList &Expansion);
+
+private:
+  void startNode(void);
+  void deleteRegManagers(void);
+  void captureEdgeState(IceCfgNode *Target);
+  void colorTemporary(IceVariable *Var,
+                      llvm::SmallBitVector &AvailableRegisters);
+  typedef std::map<const IceVariable *, unsigned> LastUseMap;
+  void releaseTemporaries(const IceInst *Inst, unsigned Index,
+                          const LastUseMap &LastUses,
+                          llvm::SmallBitVector &AvailableRegisters);
+  void updateRegManager(const IceInst *Inst);
+  IceVariable *getTypedRegister(IceType Type, int RegNum);
+  // Register contents at the current point of the lowering pass over
+  // RegManagerNode.
+  IceRegManager *RegManager;
+  const IceCfgNode *RegManagerNode;
+  // Register contents captured at the branches into each successor
+  // that has a single predecessor, indexed by node number.
+  std::vector<IceRegManager *> EdgeStates;
+  // Pre-colored variables for reading operands from registers,
+  // indexed by type and register number.
+  IceVarList TypedRegisters;
 };
 
 #endif // _IceTargetLoweringX8632_h
@@ -6,8 +6,11 @@
 #include "IceCfg.h"
 #include "IceCfgNode.h"
 #include "IceDefs.h"
+#include "IceELFObjectWriter.h"
 #include "IceInst.h"
+#include "IceJIT.h"
 #include "IceOperand.h"
+#include "IceTargetLowering.h"
 #include "IceTypes.h"
 
 #include "llvm/IR/Constant.h"
@@ -16,6 +19,7 @@
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Support/CommandLine.h"
@@ -23,8 +27,12 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/SourceMgr.h"
 
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 using namespace llvm;
 
@@ -128,8 +136,11 @@ private:
       return IceType_f64;
     case Type::PointerTyID: {
       const PointerType *PTy = cast<PointerType>(Ty);
+      // Aggregate globals, e.g. byte arrays, are only used through
+      // their address.
+      if (PTy->getElementType()->isAggregateType())
+        return IceType_i32;
       return convertType(PTy->getElementType());
-      return IceType_i32;
     }
     case Type::FunctionTyID:
       return IceType_i32;
@@ -191,6 +202,8 @@ private:
       return convertRetInstruction(cast<ReturnInst>(Inst));
     case Instruction::IntToPtr:
       return convertIntToPtrInstruction(cast<IntToPtrInst>(Inst));
+    case Instruction::PtrToInt:
+      return convertPtrToIntInstruction(cast<PtrToIntInst>(Inst));
     case Instruction::ICmp:
       return convertICmpInstruction(cast<ICmpInst>(Inst));
     case Instruction::FCmp:
@@ -317,7 +330,22 @@ private:
       BasicBlock *BBElse = Inst->getSuccessor(1);
       IceCfgNode *NodeThen = mapBasicBlockToNode(BBThen);
       IceCfgNode *NodeElse = mapBasicBlockToNode(BBElse);
-      return IceInstBr::create(Cfg, Src, NodeThen, NodeElse);
+      IceInstBr *Br = IceInstBr::create(Cfg, Src, NodeThen, NodeElse);
+      // Keep any !prof branch weights as a hint for block layout.
+      if (const MDNode *MD = Inst->getMetadata(LLVMContext::MD_prof)) {
+        const MDString *Kind = dyn_cast<MDString>(MD->getOperand(0));
+        if (Kind && Kind->getString() == "branch_weights" &&
+            MD->getNumOperands() == 3) {
+          const ConstantInt *WeightTrue =
+              dyn_cast<ConstantInt>(MD->getOperand(1));
+          const ConstantInt *WeightFalse =
+              dyn_cast<ConstantInt>(MD->getOperand(2));
+          if (WeightTrue && WeightFalse)
+            Br->setWeights(WeightTrue->getZExtValue(),
+                           WeightFalse->getZExtValue());
+        }
+      }
+      return Br;
     } else {
       BasicBlock *BBSucc = Inst->getSuccessor(0);
       return IceInstBr::create(Cfg, mapBasicBlockToNode(BBSucc));
@@ -331,6 +359,13 @@ private:
     return IceInstAssign::create(Cfg, Dest, Src);
   }
 
+  IceInst *convertPtrToIntInstruction(const PtrToIntInst *Inst) {
+    IceOperand *Src = convertOperand(Inst, 0);
+    IceVariable *Dest = mapValueToIceVar(Inst, IceType_i32);
+
+    return IceInstAssign::create(Cfg, Dest, Src);
+  }
+
   IceInst *convertRetInstruction(const ReturnInst *Inst) {
     IceOperand *RetOperand = convertOperand(Inst, 0);
     if (RetOperand) {
@@ -495,7 +530,7 @@ private:
     // PNaCl bitcode only contains allocas of byte-granular objects.
     IceOperand *ByteCount = convertValue(Inst->getArraySize());
     uint32_t Align = Inst->getAlignment();
-    IceVariable *Dest = mapValueToIceVar(Inst);
+    IceVariable *Dest = mapValueToIceVar(Inst, IceType_i32);
 
     return IceInstAlloca::create(Cfg, ByteCount, Align, Dest);
   }
@@ -544,6 +579,29 @@ cl::opt<IceTargetArch> TargetArch(
                clEnumValN(IceTarget_X8664, "x8664", "x86-64"),
                clEnumValN(IceTarget_ARM32, "arm32", "ARM32"),
                clEnumValN(IceTarget_ARM64, "arm64", "ARM64"), clEnumValEnd));
+cl::opt<bool> OptSize("Os", cl::desc("Optimize for code size"));
+cl::opt<unsigned> LoopAlign(
+    "loop-align",
+    cl::desc("Log2 of the alignment of hot loops, or 0 for none"),
+    cl::init(4));
+cl::opt<bool> UseIntegratedAssembler(
+    "ias", cl::desc("Encode instructions with the integrated assembler"));
+enum IceFileType { IceFile_Asm, IceFile_Obj };
+cl::opt<IceFileType> OutputFileType(
+    "filetype", cl::desc("Output file type:"), cl::init(IceFile_Asm),
+    cl::values(clEnumValN(IceFile_Asm, "asm", "Textual assembly"),
+               clEnumValN(IceFile_Obj, "obj",
+                          "ELF relocatable object, with -ias implied"),
+               clEnumValEnd));
+cl::opt<bool> UseJIT(
+    "jit", cl::desc("Load the translated functions into memory instead of "
+                    "emitting them"));
+cl::opt<std::string> JITFunction(
+    "jit-run", cl::desc("With -jit, call this function and print its result"),
+    cl::value_desc("function"));
+cl::list<std::string> JITArgs("jit-args", cl::CommaSeparated,
+                              cl::desc("Arguments for the -jit-run function"),
+                              cl::value_desc("value,..."));
 cl::opt<std::string> IRFilename(cl::Positional, cl::desc("<IR file>"),
                                 cl::Required);
 static cl::opt<std::string> OutputFilename("o",
@@ -551,9 +609,101 @@ static cl::opt<std::string> OutputFilename("o",
                                            cl::init("-"),
                                            cl::value_desc("filename"));
 
+// Calls a function that the JIT has loaded with Args, which are
+// converted to the types in ArgTypes, and prints its result.  Every
+// argument is passed on the stack in 4-byte words, so the function is
+// called through a pointer type with enough word parameters for any of
+// the functions, and the caller pops them.
+static bool runJITFunction(void *Address, IceType ReturnType,
+                           const std::vector<IceType> &ArgTypes,
+                           const std::vector<std::string> &Args) {
+  if (Args.size() != ArgTypes.size()) {
+    errs() << "Function " << JITFunction << " takes " << ArgTypes.size()
+           << " arguments\n";
+    return false;
+  }
+  const uint32_t MaxWords = 8;
+  uint32_t Words[MaxWords] = { 0 };
+  uint32_t NumWords = 0;
+  for (uint32_t i = 0; i < Args.size(); ++i) {
+    uint64_t Bits;
+    if (ArgTypes[i] == IceType_f32) {
+      float Value = strtod(Args[i].c_str(), NULL);
+      uint32_t Bits32;
+      memcpy(&Bits32, &Value, sizeof(Bits32));
+      Bits = Bits32;
+    } else if (ArgTypes[i] == IceType_f64) {
+      double Value = strtod(Args[i].c_str(), NULL);
+      memcpy(&Bits, &Value, sizeof(Bits));
+    } else {
+      Bits = strtoull(Args[i].c_str(), NULL, 0);
+    }
+    uint32_t Width = iceTypeWidth(ArgTypes[i]) > 4 ? 2 : 1;
+    if (NumWords + Width > MaxWords) {
+      errs() << "Too many arguments for -jit-run\n";
+      return false;
+    }
+    Words[NumWords++] = Bits;
+    if (Width > 1)
+      Words[NumWords++] = Bits >> 32;
+  }
+#if defined(__i386__)
+  typedef uint64_t (*IntFunction)(uint32_t, uint32_t, uint32_t, uint32_t,
+                                  uint32_t, uint32_t, uint32_t, uint32_t);
+  typedef double (*FPFunction)(uint32_t, uint32_t, uint32_t, uint32_t,
+                               uint32_t, uint32_t, uint32_t, uint32_t);
+  char Buf[64];
+  if (ReturnType == IceType_f32 || ReturnType == IceType_f64) {
+    // Both types are returned in st(0).
+    double Value = reinterpret_cast<FPFunction>(Address)(
+        Words[0], Words[1], Words[2], Words[3], Words[4], Words[5],
+        Words[6], Words[7]);
+    if (ReturnType == IceType_f32)
+      sprintf(Buf, "%.9g", (float)Value);
+    else
+      sprintf(Buf, "%.17g", Value);
+  } else {
+    uint64_t Value = reinterpret_cast<IntFunction>(Address)(
+        Words[0], Words[1], Words[2], Words[3], Words[4], Words[5],
+        Words[6], Words[7]);
+    switch (ReturnType) {
+    case IceType_void:
+      sprintf(Buf, "void");
+      break;
+    case IceType_i1:
+      sprintf(Buf, "%d", (int)(Value & 1));
+      break;
+    case IceType_i8:
+      sprintf(Buf, "%d", (int)(int8_t)Value);
+      break;
+    case IceType_i16:
+      sprintf(Buf, "%d", (int)(int16_t)Value);
+      break;
+    case IceType_i32:
+      sprintf(Buf, "%d", (int32_t)Value);
+      break;
+    default:
+      sprintf(Buf, "%lld", (long long)Value);
+      break;
+    }
+  }
+  std::cout << Buf << "\n";
+  return true;
+#else  // !__i386__
+  (void)Address;
+  (void)ReturnType;
+  errs() << "-jit-run requires an x86-32 host\n";
+  return false;
+#endif // !__i386__
+}
+
 static cl::opt<bool> SubzeroTimingEnabled(
     "timing", cl::desc("Enable breakdown timing of Subzero translation"));
 
+static cl::opt<bool> SubzeroStatsEnabled(
+    "subzero-stats",
+    cl::desc("Print per-module Subzero translation statistics"));
+
 int main(int argc, char **argv) {
   cl::ParseCommandLineOptions(argc, argv);
 
@@ -580,9 +730,35 @@ int main(int argc, char **argv) {
   for (unsigned i = 0; i != VerboseList.size(); ++i)
     VerboseMask |= VerboseList[i];
 
+  unsigned NumFunctions = 0;
+  unsigned NumLeafFrames = 0;
+
   std::ofstream Ofs;
-  if (OutputFilename != "-") {
-    Ofs.open(OutputFilename.c_str(), std::ofstream::out);
+  // Text output and dumps go to OutFD, one write per function.  They
+  // go to stdout when the output file holds an object.
+  int OutFD = STDOUT_FILENO;
+  IceELFObjectWriter *ObjectWriter = NULL;
+  IceJIT *JIT = NULL;
+  IceType JITReturnType = IceType_void;
+  std::vector<IceType> JITArgTypes;
+  if (UseJIT) {
+    JIT = new IceJIT;
+  } else if (OutputFileType == IceFile_Obj) {
+    // The object writer patches the ELF header last, so it needs a
+    // seekable file.
+    if (OutputFilename == "-") {
+      errs() << "-filetype=obj requires an output file (-o)\n";
+      return 1;
+    }
+    Ofs.open(OutputFilename.c_str(),
+             std::ofstream::out | std::ofstream::binary);
+    ObjectWriter = new IceELFObjectWriter(Ofs);
+  } else if (OutputFilename != "-") {
+    OutFD = open(OutputFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (OutFD < 0) {
+      errs() << "Cannot open " << OutputFilename << "\n";
+      return 1;
+    }
   }
 
   for (Module::const_iterator I = Mod->begin(), E = Mod->end(); I != E; ++I) {
@@ -598,8 +774,17 @@ int main(int argc, char **argv) {
                 << ": " << TConvert.getElapsedSec() << " sec\n";
     }
 
-    Cfg->Str.Stream = &(OutputFilename == "-" ? std::cout : Ofs);
     Cfg->Str.setVerbose(VerboseMask);
+    if (JIT && Cfg->getName() == JITFunction) {
+      JITReturnType = Cfg->getReturnType();
+      const IceVarList &Args = Cfg->getArgs();
+      for (IceVarList::const_iterator Arg = Args.begin(), E = Args.end();
+           Arg != E; ++Arg) {
+        JITArgTypes.push_back((*Arg)->getType());
+      }
+    }
+    Cfg->setOptSize(OptSize);
+    Cfg->setLoopAlign(LoopAlign);
     if (!DisableTranslation) {
       IceTimer TTranslate;
       Cfg->translate(TargetArch);
@@ -610,16 +795,63 @@ int main(int argc, char **argv) {
       if (Cfg->hasError()) {
         errs() << "ICE translation error: " << Cfg->getError() << "\n";
       }
+      ++NumFunctions;
+      if (Cfg->getTarget() && Cfg->getTarget()->hasLeafFrame())
+        ++NumLeafFrames;
       uint32_t AsmFormat = 0;
 
       IceTimer TEmit;
-      Cfg->emit(AsmFormat);
+      if (JIT)
+        Cfg->emitJIT(JIT);
+      else if (ObjectWriter)
+        Cfg->emitELF(ObjectWriter);
+      else if (UseIntegratedAssembler)
+        Cfg->emitIAS();
+      else
+        Cfg->emit(AsmFormat);
       if (SubzeroTimingEnabled) {
         std::cerr << "[Subzero timing] Emit function " << Cfg->getName() << ": "
                   << TEmit.getElapsedSec() << " sec\n";
       }
     }
+    if (!Cfg->Str.flush(OutFD)) {
+      errs() << "Cannot write output\n";
+      return 1;
+    }
+  }
+
+  if (ObjectWriter) {
+    ObjectWriter->finish();
+    delete ObjectWriter;
+  }
+
+  if (OutFD != STDOUT_FILENO)
+    close(OutFD);
+
+  int ExitStatus = 0;
+  if (JIT) {
+    if (!JIT->finalize()) {
+      errs() << "JIT error: " << JIT->getError() << "\n";
+      ExitStatus = 1;
+    } else if (!JITFunction.empty()) {
+      void *Address = JIT->getFunctionAddress(JITFunction);
+      if (Address == NULL) {
+        errs() << "No function " << JITFunction << " to run\n";
+        ExitStatus = 1;
+      } else if (!runJITFunction(Address, JITReturnType, JITArgTypes,
+                                 JITArgs)) {
+        ExitStatus = 1;
+      }
+    }
+    delete JIT;
+  }
+
+  if (SubzeroStatsEnabled) {
+    std::cerr << "[Subzero stats] Functions translated: " << NumFunctions
+              << "\n";
+    std::cerr << "[Subzero stats] Leaf functions without a frame: "
+              << NumLeafFrames << "\n";
   }
 
-  return 0;
+  return ExitStatus;
 }
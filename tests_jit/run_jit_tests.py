@@ -0,0 +1,246 @@
+#!/usr/bin/env python
+# Copyright 2014 The Native Client Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can
+# be found in the LICENSE file.
+
+"""Runs functions from .ll samples with llvm2ice -jit and compares the
+results against natively compiled versions.
+
+Each function whose parameters and return value are scalars and whose
+body does not touch memory or call out is run on a few argument
+vectors.  The native version is compiled by llc for x86-32 and linked
+with a generated caller that prints the result's bits.  An argument
+vector on which the native version fails, e.g. by dividing by zero, is
+skipped.  This needs an x86-32 host, e.g. a -m32 build of llvm2ice and
+a C compiler that accepts -m32.
+"""
+
+import argparse
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+C_TYPES = {
+    'i1': 'unsigned char', 'i8': 'signed char', 'i16': 'short',
+    'i32': 'int', 'i64': 'long long', 'float': 'float', 'double': 'double',
+    'void': 'void',
+}
+
+INT_VALUES = [0, 1, -1, 7, -100, 12345, 0x7fffffff, -0x80000000, 3, -9]
+I64_VALUES = [0, 1, -1, 7, -100, 0x123456789, 0x7fffffffffffffff,
+              -0x8000000000000000, 1 << 40, -(1 << 33) + 5]
+FP_VALUES = [0.0, 1.0, -1.5, 3.25, -100.75, 1e10, 0.1, 2.5e-3, 7.0, -2.0]
+
+DEFINE = re.compile(r'^define\s+(?:internal\s+)?(\w+)\s+@(\w+)\((.*?)\)')
+# Functions using any of these are skipped.
+UNSAFE = re.compile(r'\b(load|store|call|alloca|inttoptr|ptrtoint)\b|@')
+
+# Functions that the x86-32 lowering currently gets wrong, in the
+# textual assembly as well: truncation to i1 does not mask, unsigned
+# i32 conversions to fp and i64 comparisons use signed instructions,
+# and fcmp une has its branches inverted.  They are reported but do not
+# fail the run.
+KNOWN_FAILURES = set([
+    'icmpNe64Bool', 'icmpSge64Bool', 'icmpSgt64Bool', 'icmpSle64Bool',
+    'icmpSlt64Bool', 'icmpUge64Bool', 'icmpUgt64Bool', 'icmpUle64Bool',
+    'icmpUlt64Bool', 'select64ConstVar', 'select64VarConst',
+    'select64VarVar', 'trunc64To1', 'zext1To64', 'fcmpUneFloat',
+    'fcmpUneDouble', 'unsigned1ToFloat', 'unsigned1ToDouble',
+    'unsigned32ToFloat', 'unsigned32ToDouble',
+])
+
+
+def parse_functions(path):
+  """Returns (name, return type, parameter types) for each function that
+  is safe to run, and the sample's source without the other functions,
+  which might refer to symbols that the caller does not define."""
+  functions = []
+  source = []
+  lines = open(path).read().splitlines()
+  i = 0
+  while i < len(lines):
+    match = DEFINE.match(lines[i])
+    if not match:
+      source.append(lines[i])
+      i += 1
+      continue
+    start = i
+    ret, name, params = match.groups()
+    types = [p.split()[0] for p in params.split(',') if p.strip()]
+    body = []
+    i += 1
+    while i < len(lines) and not lines[i].startswith('}'):
+      body.append(lines[i].split(';')[0])
+      i += 1
+    i += 1
+    if ret not in C_TYPES or any(t not in C_TYPES or t == 'void'
+                                 for t in types):
+      continue
+    if any(UNSAFE.search(line) for line in body):
+      continue
+    functions.append((name, ret, types))
+    # Make the function visible to the caller.
+    source.append(lines[start].replace('define internal ', 'define ', 1))
+    source.extend(lines[start + 1:i])
+  return functions, '\n'.join(source) + '\n'
+
+
+def argument_values(types, vector):
+  values = []
+  for index, ty in enumerate(types):
+    k = (vector + 3 * index) % len(INT_VALUES)
+    if ty == 'i64':
+      values.append(I64_VALUES[k])
+    elif ty == 'float':
+      values.append(struct.unpack('<f', struct.pack('<f', FP_VALUES[k]))[0])
+    elif ty == 'double':
+      values.append(FP_VALUES[k])
+    elif ty == 'i1':
+      values.append(INT_VALUES[k] & 1)
+    else:
+      bits = {'i8': 8, 'i16': 16, 'i32': 32}[ty]
+      value = INT_VALUES[k] & ((1 << bits) - 1)
+      if value >> (bits - 1):
+        value -= 1 << bits
+      values.append(value)
+  return values
+
+
+def format_value(value):
+  return repr(value) if isinstance(value, float) else str(value)
+
+
+def c_literal(ty, value):
+  if ty in ('float', 'double'):
+    return '(%s)%s' % (C_TYPES[ty], float(value).hex())
+  if ty == 'i64':
+    return '(long long)%dLL' % value if value >= 0 else \
+        '(-%dLL - 1)' % (-value - 1)
+  return '(%s)%d' % (C_TYPES[ty], value)
+
+
+def result_bits(ty, text):
+  """Converts the decimal result printed by llvm2ice to the bits that
+  the native caller prints."""
+  if ty == 'void':
+    return 0
+  if ty == 'float':
+    return struct.unpack('<I', struct.pack('<f', float(text)))[0]
+  if ty == 'double':
+    return struct.unpack('<Q', struct.pack('<d', float(text)))[0]
+  bits = {'i1': 1, 'i8': 8, 'i16': 16, 'i32': 32, 'i64': 64}[ty]
+  return int(text) & ((1 << bits) - 1)
+
+
+CALLER = r'''#include <stdio.h>
+#include <string.h>
+%(ret)s %(name)s(%(params)s);
+int main(void) {
+  unsigned long long Bits = 0;
+  %(call)s
+  printf("%%llx\n", Bits);
+  return 0;
+}
+'''
+
+
+def native_result(args, workdir, sample_obj, name, ret, types, values):
+  call = '%s(%s)' % (name, ', '.join(c_literal(t, v)
+                                     for t, v in zip(types, values)))
+  if ret == 'void':
+    call += ';'
+  else:
+    call = '%s Result = %s; memcpy(&Bits, &Result, sizeof(Result));' % (
+        C_TYPES[ret], call)
+  source = os.path.join(workdir, 'caller.c')
+  with open(source, 'w') as f:
+    f.write(CALLER % {'ret': C_TYPES[ret], 'name': name,
+                      'params': ', '.join(C_TYPES[t] for t in types) or
+                                'void',
+                      'call': call})
+  exe = os.path.join(workdir, 'native')
+  subprocess.check_call([args.cc, '-m32', source, sample_obj, '-o', exe])
+  proc = subprocess.Popen([exe], stdout=subprocess.PIPE)
+  out = proc.communicate()[0]
+  if proc.returncode:
+    return None
+  bits = int(out.strip(), 16)
+  if ret == 'i1':
+    bits &= 1
+  return bits
+
+
+def run_sample(args, workdir, path):
+  functions, source = parse_functions(path)
+  if not functions:
+    return 0, 0, 0
+  native_ll = os.path.join(workdir, 'native.ll')
+  with open(native_ll, 'w') as f:
+    f.write(source)
+  sample_obj = os.path.join(workdir, 'native.o')
+  subprocess.check_call([args.llc, '-march=x86', '-mattr=+sse2',
+                         '-filetype=obj', native_ll, '-o', sample_obj])
+  passed = failed = known = 0
+  for name, ret, types in functions:
+    for vector in range(args.vectors):
+      values = argument_values(types, vector)
+      expected = native_result(args, workdir, sample_obj, name, ret, types,
+                               values)
+      if expected is None:
+        continue
+      cmd = [args.llvm2ice, '--verbose', 'none', '-jit', '-jit-run=' + name]
+      if values:
+        cmd.append('-jit-args=' + ','.join(format_value(v) for v in values))
+      cmd.append(native_ll)
+      proc = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                              stderr=subprocess.PIPE)
+      out, err = proc.communicate()
+      actual = None
+      if proc.returncode == 0:
+        actual = result_bits(ret, out.decode().strip().splitlines()[-1])
+      if actual == expected:
+        passed += 1
+        continue
+      if name in KNOWN_FAILURES:
+        known += 1
+      else:
+        failed += 1
+      print('%s %s: %s(%s): expected %x, got %s%s' % (
+          'XFAIL' if name in KNOWN_FAILURES else 'FAIL',
+          os.path.basename(path), name,
+          ', '.join(format_value(v) for v in values), expected,
+          '%x' % actual if actual is not None else 'an error',
+          ('\n' + err.decode()) if err else ''))
+  return passed, failed, known
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument('samples', nargs='+', help='.ll files to run')
+  parser.add_argument('--llvm2ice', default='./llvm2ice')
+  parser.add_argument('--llc', default='llc')
+  parser.add_argument('--cc', default='cc')
+  parser.add_argument('--vectors', type=int, default=6,
+                      help='Argument vectors per function')
+  args = parser.parse_args()
+  workdir = tempfile.mkdtemp()
+  total_passed = total_failed = total_known = 0
+  try:
+    for path in args.samples:
+      passed, failed, known = run_sample(args, workdir, path)
+      total_passed += passed
+      total_failed += failed
+      total_known += known
+  finally:
+    shutil.rmtree(workdir)
+  print('%d passed, %d failed, %d known failures' % (
+      total_passed, total_failed, total_known))
+  return 1 if total_failed else 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
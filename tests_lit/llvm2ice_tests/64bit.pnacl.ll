@@ -20,22 +20,17 @@ entry:
   ret i32 %add3
 }
 ; CHECK: pass64BitArg:
-; CHECK:      push    123
-; CHECK-NEXT: push
-; CHECK-NEXT: push
+; CHECK:      sub     esp, 20
+; CHECK:      mov     dword ptr [esp+8], 123
+; CHECK:      mov     dword ptr [esp+16],
 ; CHECK-NEXT: call    ignore64BitArgNoInline
-; CHECK:      push
-; CHECK-NEXT: push
-; CHECK-NEXT: push    123
-; CHECK-NEXT: push
-; CHECK-NEXT: push
+; CHECK:      mov     dword ptr [esp+8], 123
+; CHECK:      mov     dword ptr [esp+16],
 ; CHECK-NEXT: call    ignore64BitArgNoInline
-; CHECK:      push
-; CHECK-NEXT: push
-; CHECK-NEXT: push    123
-; CHECK-NEXT: push
-; CHECK-NEXT: push
+; CHECK:      mov     dword ptr [esp+8], 123
+; CHECK:      mov     dword ptr [esp+16],
 ; CHECK-NEXT: call    ignore64BitArgNoInline
+; CHECK:      add     esp, 20
 
 declare i32 @ignore64BitArgNoInline(i64, i32, i64)
 
@@ -45,11 +40,11 @@ entry:
   ret i32 %call
 }
 ; CHECK: pass64BitConstArg:
-; CHECK:      push    3735928559
-; CHECK-NEXT: push    305419896
-; CHECK-NEXT: push    123
-; CHECK-NEXT: push    ecx
-; CHECK-NEXT: push    eax
+; CHECK:      mov     dword ptr [esp], eax
+; CHECK-NEXT: mov     dword ptr [esp+4], ecx
+; CHECK-NEXT: mov     dword ptr [esp+8], 123
+; CHECK-NEXT: mov     dword ptr [esp+12], 305419896
+; CHECK-NEXT: mov     dword ptr [esp+16], 3735928559
 ; CHECK-NEXT: call    ignore64BitArgNoInline
 
 define internal i64 @return64BitArg(i64 %a) {
@@ -761,7 +756,7 @@ entry:
 ; CHECK: cmp
 ; CHECK: jl
 ; CHECK: cmp
-; CHECK: jne
+; CHECK: cmovne
 
 define internal i64 @select64VarConst(i64 %a, i64 %b) {
 entry:
@@ -776,7 +771,7 @@ entry:
 ; CHECK: cmp
 ; CHECK: jl
 ; CHECK: cmp
-; CHECK: jne
+; CHECK: cmovne
 
 define internal i64 @select64ConstVar(i64 %a, i64 %b) {
 entry:
@@ -791,7 +786,7 @@ entry:
 ; CHECK: cmp
 ; CHECK: jl
 ; CHECK: cmp
-; CHECK: jne
+; CHECK: cmovne
 
 define internal i32 @nacl_tp_tdb_offset(i32) {
 entry:
@@ -0,0 +1,90 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; Address arithmetic is folded into a single [base+index*scale+disp]
+; operand, including symbolic displacements and bases that are
+; defined in a dominating block.
+
+@arr = internal global [32 x i8] zeroinitializer, align 4
+
+define i32 @global_index(i32 %i) {
+entry:
+  %base = ptrtoint [32 x i8]* @arr to i32
+  %off = shl i32 %i, 2
+  %sum = add i32 %base, %off
+  %addr = add i32 %sum, 8
+  %addr.asptr = inttoptr i32 %addr to i32*
+  %v = load i32* %addr.asptr, align 1
+  ret i32 %v
+}
+; CHECK: global_index:
+; CHECK: mov {{.*}}, dword ptr [4*e{{..}}+arr+8]
+; CHECK-NEXT: ret
+
+define void @global_store(i32 %i, i32 %x) {
+entry:
+  %base = ptrtoint [32 x i8]* @arr to i32
+  %i1 = add i32 %i, 1
+  %off = mul i32 4, %i1
+  %addr = add i32 %off, %base
+  %addr.asptr = inttoptr i32 %addr to i32*
+  store i32 %x, i32* %addr.asptr, align 1
+  ret void
+}
+; CHECK: global_store:
+; CHECK: mov dword ptr [4*e{{..}}+arr+4], e{{..}}
+; CHECK-NEXT: ret
+
+define i32 @global_address(i32 %i) {
+entry:
+  %base = ptrtoint [32 x i8]* @arr to i32
+  %r = add i32 %base, %i
+  ret i32 %r
+}
+; CHECK: global_address:
+; CHECK: offset arr
+
+define i32 @invariant_base(i32 %p, i32 %n) {
+entry:
+  %base = add i32 %p, 16
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %off = shl i32 %i, 2
+  %addr = add i32 %base, %off
+  %addr.asptr = inttoptr i32 %addr to i32*
+  %v = load i32* %addr.asptr, align 1
+  %acc.next = add i32 %acc, %v
+  %i.next = add i32 %i, 1
+  %cmp = icmp eq i32 %i.next, %n
+  br i1 %cmp, label %exit, label %loop
+exit:
+  ret i32 %acc.next
+}
+; CHECK: invariant_base:
+; CHECK: add {{.*}}, dword ptr [e{{..}}+4*e{{..}}+16]
+
+; The address comes from a phi, so it must not be traced back into
+; either predecessor.
+define i32 @phi_address(i32 %p, i32 %q, i32 %c) {
+entry:
+  %cmp = icmp eq i32 %c, 0
+  br i1 %cmp, label %a, label %b
+a:
+  %pa = add i32 %p, 4
+  br label %join
+b:
+  %qb = add i32 %q, 8
+  br label %join
+join:
+  %addr = phi i32 [ %pa, %a ], [ %qb, %b ]
+  %addr.asptr = inttoptr i32 %addr to i32*
+  %v = load i32* %addr.asptr, align 1
+  ret i32 %v
+}
+; CHECK: phi_address:
+; CHECK: .Lphi_address$join:
+; CHECK-NEXT: mov {{.*}}, dword ptr [e{{..}}]
+
+; ERRORS-NOT: ICE translation error
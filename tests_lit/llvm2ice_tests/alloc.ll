@@ -4,9 +4,13 @@ define void @fixed_400(i32 %n) nounwind {
   %array = alloca i8, i32 400, align 16
   call void @f1(i8* %array) nounwind
   ret void
-  ; CHECK:      sub     esp, 400
-  ; CHECK-NEXT: mov     eax, esp
-  ; CHECK-NEXT: push    eax
+  ; CHECK:      fixed_400:
+  ; CHECK:      push    ebp
+  ; CHECK-NEXT: mov     ebp, esp
+  ; CHECK-NEXT: sub     esp, 416
+  ; CHECK-NEXT: and     esp, 4294967280
+  ; CHECK-NEXT: lea     eax, dword ptr [esp+16]
+  ; CHECK-NEXT: mov     dword ptr [esp], eax
   ; CHECK-NEXT: call    f1
 }
 
@@ -16,11 +20,36 @@ define void @variable_n(i32 %n) nounwind {
   %array = alloca i8, i32 %n, align 16
   call void @f2(i8* %array) nounwind
   ret void
+  ; CHECK:      variable_n:
   ; CHECK:      mov     eax, dword ptr [ebp+8]
   ; CHECK-NEXT: sub     esp, eax
+  ; CHECK-NEXT: and     esp, 4294967280
   ; CHECK-NEXT: mov     eax, esp
-  ; CHECK-NEXT: push    eax
+  ; CHECK-NEXT: sub     esp, 4
+  ; CHECK-NEXT: mov     dword ptr [esp], eax
   ; CHECK-NEXT: call    f2
 }
 
 declare void @f2(i8*)
+
+; Constant-size allocas in the entry block share the frame's single
+; esp adjustment with the outgoing-argument area below them, and need
+; no frame pointer unless they are aligned beyond 4 bytes.
+define void @fixed_two() nounwind {
+  %a = alloca i8, i32 10, align 4
+  %b = alloca i8, i32 8, align 4
+  call void @f3(i8* %a, i8* %b) nounwind
+  ret void
+  ; CHECK:      fixed_two:
+  ; CHECK-NOT:  ebp
+  ; CHECK:      sub     esp, 28
+  ; CHECK-NEXT: lea     [[A:e..]], dword ptr [esp+8]
+  ; CHECK-NEXT: lea     [[B:e..]], dword ptr [esp+20]
+  ; CHECK-NEXT: mov     dword ptr [esp], [[A]]
+  ; CHECK-NEXT: mov     dword ptr [esp+4], [[B]]
+  ; CHECK-NEXT: call    f3
+  ; CHECK:      add     esp, 28
+  ; CHECK-NEXT: ret
+}
+
+declare void @f3(i8*, i8*)
@@ -0,0 +1,78 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; Multiplication by small constants uses lea and shifts, and division
+; and remainder by constants avoid div and idiv.
+
+define i32 @mul40(i32 %a) {
+entry:
+  %r = mul i32 %a, 40
+  ret i32 %r
+}
+; CHECK: mul40:
+; CHECK: lea [[REG:.*]], dword ptr {{\[}}[[SRC:.*]]+4*[[SRC]]]
+; CHECK-NEXT: shl [[REG]], 3
+; CHECK-NOT: {{^[[:space:]]*}}imul
+
+define i32 @mul31(i32 %a) {
+entry:
+  %r = mul i32 %a, 31
+  ret i32 %r
+}
+; CHECK: mul31:
+; CHECK: shl [[REG:.*]], 5
+; CHECK-NEXT: sub [[REG]],
+; CHECK-NOT: {{^[[:space:]]*}}imul
+
+define i32 @mul100(i32 %a) {
+entry:
+  %r = mul i32 %a, 100
+  ret i32 %r
+}
+; CHECK: mul100:
+; CHECK: imul {{.*}}, 100
+
+define i32 @udiv10(i32 %a) {
+entry:
+  %r = udiv i32 %a, 10
+  ret i32 %r
+}
+; CHECK: udiv10:
+; CHECK: mov eax, 3435973837
+; CHECK-NEXT: mul
+; CHECK: shr {{.*}}, 3
+; CHECK-NOT: {{^[[:space:]]*}}div
+
+define i32 @urem16(i32 %a) {
+entry:
+  %r = urem i32 %a, 16
+  ret i32 %r
+}
+; CHECK: urem16:
+; CHECK: and {{.*}}, 15
+; CHECK-NOT: {{^[[:space:]]*}}div
+
+define i32 @sdiv8(i32 %a) {
+entry:
+  %r = sdiv i32 %a, 8
+  ret i32 %r
+}
+; CHECK: sdiv8:
+; CHECK: sar [[REG:.*]], 31
+; CHECK-NEXT: shr [[REG]], 29
+; CHECK-NEXT: add [[REG]],
+; CHECK-NEXT: sar [[REG]], 3
+; CHECK-NOT: {{^[[:space:]]*}}idiv
+
+define i32 @srem7(i32 %a) {
+entry:
+  %r = srem i32 %a, 7
+  ret i32 %r
+}
+; CHECK: srem7:
+; CHECK: mov eax, 2454267027
+; CHECK-NEXT: imul
+; CHECK: imul {{.*}}, 7
+; CHECK-NOT: {{^[[:space:]]*}}idiv
+
+; ERRORS-NOT: ICE translation error
@@ -0,0 +1,64 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; Blocks are laid out so that the likely successor of each branch
+; falls through, and branches to the next block are removed.
+
+declare void @use(i32)
+
+; Branch weights mark the false side as cold, so it moves to the end
+; and the condition is inverted to fall into the hot side.
+define void @cold_then(i32 %a) {
+entry:
+  %cmp = icmp eq i32 %a, 0
+  br i1 %cmp, label %hot, label %cold, !prof !0
+
+cold:
+  call void @use(i32 1)
+  br label %join
+
+hot:
+  call void @use(i32 2)
+  br label %join
+
+join:
+  ret void
+}
+; CHECK:      cold_then:
+; CHECK:      jne .Lcold_then$cold
+; CHECK-NEXT: .Lcold_then$hot:
+; CHECK:      call use
+; CHECK:      .Lcold_then$join:
+; CHECK:      ret
+; CHECK:      .Lcold_then$cold:
+; CHECK:      call use
+; CHECK:      jmp .Lcold_then$join
+
+; The loop is rotated so that the body falls into the latch test, and
+; each iteration takes a single branch.
+define i32 @count(i32 %n) {
+entry:
+  br label %header
+
+header:
+  %i = phi i32 [ 0, %entry ], [ %inc, %body ]
+  %cmp = icmp eq i32 %i, %n
+  br i1 %cmp, label %exit, label %body
+
+body:
+  %inc = add i32 %i, 1
+  br label %header
+
+exit:
+  ret i32 %i
+}
+; CHECK:      count:
+; CHECK:      jmp .Lcount$header
+; CHECK-NEXT: .Lcount$body:
+; CHECK:      .Lcount$header:
+; CHECK:      jne .Lcount$body
+; CHECK-NEXT: .Lcount$exit:
+
+!0 = metadata !{metadata !"branch_weights", i32 99, i32 1}
+
+; ERRORS-NOT: ICE translation error
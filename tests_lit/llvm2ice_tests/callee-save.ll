@@ -0,0 +1,32 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; Values live across a call are kept in a callee-saved register, and
+; values that don't cross a call use the scratch registers, so only
+; one callee-saved register needs to be saved and restored.
+
+define i32 @callee_save(i32 %a, i32 %b) {
+entry:
+  %y = add i32 %a, 7
+  %c1 = call i32 @ext(i32 %b)
+  %x = add i32 %y, %c1
+  %z = mul i32 %x, 3
+  %w = add i32 %x, %z
+  %c2 = call i32 @ext(i32 %w)
+  %r = add i32 %z, %c2
+  ret i32 %r
+}
+
+declare i32 @ext(i32)
+
+; CHECK:      callee_save:
+; CHECK:      push ebx
+; CHECK-NOT:  push e{{(si|di|bp)}}
+; CHECK:      call ext
+; CHECK:      add ebx, eax
+; CHECK:      call ext
+; CHECK:      pop ebx
+; CHECK-NOT:  pop
+; CHECK:      ret
+
+; ERRORS-NOT: ICE translation error
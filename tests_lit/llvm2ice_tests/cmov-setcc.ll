@@ -0,0 +1,81 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; Booleans and selects are lowered without intra-block branches:
+; setcc for i1 results, cmov for integer selects, and a mask blend for
+; floating-point selects.
+
+define i32 @icmp_zext(i32 %a, i32 %b) {
+entry:
+  %cmp = icmp eq i32 %a, %b
+  %r = zext i1 %cmp to i32
+  ret i32 %r
+}
+; CHECK: icmp_zext:
+; CHECK: mov e[[REG:[abcd]]]x, 0
+; CHECK-NEXT: cmp
+; CHECK-NEXT: sete [[REG]]l
+; CHECK-NOT: movz
+; CHECK: ret
+
+define i32 @icmp_setcc(i32 %a, i32 %b) {
+entry:
+  %cmp = icmp ne i32 %a, %b
+  %x = add i32 %a, 1
+  %sel = select i1 %cmp, i32 %x, i32 %b
+  %z = zext i1 %cmp to i32
+  %r = add i32 %sel, %z
+  ret i32 %r
+}
+; CHECK: icmp_setcc:
+; CHECK-NOT: j
+; CHECK: setne {{[abcd]l}}
+; CHECK-NOT: j
+; CHECK: cmp {{.*}}, 0
+; CHECK-NEXT: cmovne
+; CHECK-NOT: j
+; CHECK: ret
+
+define i32 @select_cmov(i32 %a, i32 %b, i32 %c) {
+entry:
+  %cmp = icmp eq i32 %a, %b
+  %r = select i1 %cmp, i32 %c, i32 %a
+  ret i32 %r
+}
+; CHECK: select_cmov:
+; CHECK-NOT: set
+; CHECK: cmp
+; CHECK-NEXT: cmove
+; CHECK-NEXT: ret
+
+define i64 @select_i64(i32 %a, i32 %b, i64 %c, i64 %d) {
+entry:
+  %cmp = icmp eq i32 %a, %b
+  %r = select i1 %cmp, i64 %c, i64 %d
+  ret i64 %r
+}
+; CHECK: select_i64:
+; CHECK-NOT: j
+; CHECK: cmove
+; CHECK-NOT: j
+; CHECK: cmove
+; CHECK-NOT: j
+; CHECK: ret
+
+define double @select_double(i32 %a, i32 %b, double %c, double %d) {
+entry:
+  %cmp = icmp eq i32 %a, %b
+  %r = select i1 %cmp, double %c, double %d
+  ret double %r
+}
+; CHECK: select_double:
+; CHECK: sete
+; CHECK: neg [[MASK:e..]]
+; CHECK-NEXT: sbb [[MASK]], [[MASK]]
+; CHECK-NEXT: movd [[XMASK:xmm.]], [[MASK]]
+; CHECK-NEXT: pshufd [[XMASK]], [[XMASK]], 0
+; CHECK-NEXT: pand [[XTRUE:xmm.]], [[XMASK]]
+; CHECK-NEXT: pandn [[XMASK]], xmm
+; CHECK-NEXT: por [[XTRUE]], [[XMASK]]
+
+; ERRORS-NOT: ICE translation error
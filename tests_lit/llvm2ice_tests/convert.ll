@@ -27,7 +27,8 @@ define void @from_int8() nounwind {
   ; CHECK-NEXT: mov word ptr [
   ; CHECK-NEXT: movsbl ecx, eax
   ; CHECK-NEXT: mov dword ptr [
-  ; CHECK-NEXT: movsbl ecx, eax
+  ; CHECK-NEXT: movsbl eax, eax
+  ; CHECK-NEXT: mov ecx, eax
   ; CHECK-NEXT: sar eax, 31
   ; CHECK-NEXT: mov dword ptr [i64v+4],
   ; CHECK-NEXT: mov dword ptr [i64v],
@@ -47,7 +48,8 @@ define void @from_int16() nounwind {
   ; CHECK-NEXT: mov byte ptr [
   ; CHECK-NEXT: movswl ecx, eax
   ; CHECK-NEXT: mov dword ptr [
-  ; CHECK-NEXT: movswl ecx, eax
+  ; CHECK-NEXT: movswl eax, eax
+  ; CHECK-NEXT: mov ecx, eax
   ; CHECK-NEXT: sar eax, 31
   ; CHECK-NEXT: mov dword ptr [i64v+4],
   ; CHECK-NEXT: mov dword ptr [i64v],
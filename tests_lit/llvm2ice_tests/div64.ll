@@ -0,0 +1,71 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; i64 division and remainder use two div instructions when the
+; divisor fits in 32 bits, calling the helper function only for a
+; larger divisor.
+
+define internal i64 @udiv_var(i64 %a, i64 %b) {
+entry:
+  %r = udiv i64 %a, %b
+  ret i64 %r
+}
+; CHECK: udiv_var:
+; CHECK: cmp {{.*}}, 0
+; CHECK-NEXT: jne [[SLOW:.*]]
+; CHECK: div
+; CHECK: div
+; CHECK: jmp [[DONE:.*]]
+; CHECK-NEXT: [[SLOW]]:
+; CHECK: call __udivdi3
+; CHECK: [[DONE]]:
+
+define internal i64 @udiv_10(i64 %a) {
+entry:
+  %r = udiv i64 %a, 10
+  ret i64 %r
+}
+; CHECK: udiv_10:
+; CHECK: mov [[DIVISOR:.*]], 10
+; CHECK-NEXT: mov edx, 0
+; CHECK-NEXT: div [[DIVISOR]]
+; CHECK: div [[DIVISOR]]
+; CHECK-NOT: call
+; CHECK: ret
+
+define internal i64 @srem_neg7(i64 %a) {
+entry:
+  %r = srem i64 %a, -7
+  ret i64 %r
+}
+; CHECK: srem_neg7:
+; CHECK: mov [[DIVISOR:.*]], 7
+; CHECK: sar [[SIGN:.*]], 31
+; CHECK: div [[DIVISOR]]
+; CHECK: div [[DIVISOR]]
+; CHECK: xor edx, [[SIGN]]
+; CHECK-NOT: call
+; CHECK: ret
+
+define internal i64 @sdiv_16(i64 %a) {
+entry:
+  %r = sdiv i64 %a, 16
+  ret i64 %r
+}
+; CHECK: sdiv_16:
+; CHECK: shr {{.*}}, 28
+; CHECK: adc {{.*}}, 0
+; CHECK: shrd {{.*}}, 4
+; CHECK: sar {{.*}}, 4
+; CHECK-NOT: div
+; CHECK: ret
+
+define internal i64 @urem_big(i64 %a) {
+entry:
+  %r = urem i64 %a, 4294967296
+  ret i64 %r
+}
+; CHECK: urem_big:
+; CHECK: call __umoddi3
+
+; ERRORS-NOT: ICE translation error
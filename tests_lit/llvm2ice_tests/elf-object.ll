@@ -0,0 +1,90 @@
+; RUN: %llvm2ice --verbose none -filetype=obj -o %t %s && llvm-readobj --sections --relocations --symbols %t | FileCheck %s
+
+; The object writer produces an ELF32 relocatable object.  Global
+; variables become common symbols, helper functions are undefined,
+; and .rodata labels are relocated against the section symbol.
+
+@counter = external global i32
+
+define i32 @load_counter() {
+entry:
+  %v = load i32* @counter, align 4
+  ret i32 %v
+}
+
+define i64 @divide(i64 %a, i64 %b) {
+entry:
+  %r = sdiv i64 %a, %b
+  ret i64 %r
+}
+
+define double @fpconst(double %a) {
+entry:
+  %r = fadd double %a, 1.500000e+00
+  ret double %r
+}
+
+define i32 @sw(i32 %a) {
+entry:
+  switch i32 %a, label %d [
+    i32 0, label %b0
+    i32 1, label %b1
+    i32 2, label %b2
+    i32 3, label %b3
+  ]
+b0:
+  ret i32 10
+b1:
+  ret i32 11
+b2:
+  ret i32 12
+b3:
+  ret i32 13
+d:
+  ret i32 0
+}
+
+; CHECK: Format: {{ELF32-i386|elf32-i386}}
+; CHECK: Name: .text
+; CHECK-NEXT: Type: SHT_PROGBITS
+; CHECK: Name: .rel.text
+; CHECK-NEXT: Type: SHT_REL
+; CHECK: Name: .rodata
+; CHECK-NEXT: Type: SHT_PROGBITS
+; CHECK: Name: .rel.rodata
+; CHECK-NEXT: Type: SHT_REL
+; CHECK: Name: .symtab
+; CHECK-NEXT: Type: SHT_SYMTAB
+
+; CHECK: Relocations [
+; CHECK-NEXT: Section ({{[0-9]+}}) .rel.text {
+; CHECK-NEXT: 0x2 R_386_32 counter
+; CHECK-NEXT: R_386_PC32 __divdi3
+; CHECK-NEXT: R_386_32 .rodata
+; CHECK-NEXT: R_386_32 .rodata
+; CHECK-NEXT: }
+; CHECK-NEXT: Section ({{[0-9]+}}) .rel.rodata {
+; CHECK-NEXT: 0x8 R_386_32 sw
+; CHECK-NEXT: 0xC R_386_32 sw
+; CHECK-NEXT: 0x10 R_386_32 sw
+; CHECK-NEXT: 0x14 R_386_32 sw
+; CHECK-NEXT: }
+
+; CHECK: Name: load_counter
+; CHECK-NEXT: Value: 0x0
+; CHECK-NEXT: Size: 7
+; CHECK-NEXT: Binding: Global
+; CHECK-NEXT: Type: Function
+; CHECK: Section: .text
+; CHECK: Name: divide
+; CHECK: Name: fpconst
+; CHECK: Name: sw
+; CHECK: Name: counter
+; CHECK-NEXT: Value: 0x4
+; CHECK-NEXT: Size: 4
+; CHECK-NEXT: Binding: Global
+; CHECK-NEXT: Type: Object
+; CHECK: Section: Common
+; CHECK: Name: __divdi3
+; CHECK: Binding: Global
+; CHECK: Section: Undefined
@@ -0,0 +1,28 @@
+; RUN: %llvm2ice -target=x8632fast --verbose none %s | FileCheck %s
+; RUN: %llvm2ice -target=x8632fast --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; The fast target keeps track of what each register holds.  %add is
+; not reloaded for the mul, and the single-predecessor block %next
+; still finds %mul in the register it was computed in.
+
+define i32 @reuse(i32 %a, i32 %b) {
+entry:
+  %add = add i32 %a, %b
+  %mul = mul i32 %add, %a
+  br label %next
+
+next:
+  %sub = sub i32 %mul, %add
+  ret i32 %sub
+}
+
+; CHECK:      reuse:
+; CHECK:      mov [[REG:e[a-z]+]], [esp+{{[0-9]+}}]
+; CHECK-NEXT: add [[REG]], [esp+{{[0-9]+}}]
+; CHECK-NEXT: mov [esp+{{[0-9]+}}], [[REG]]
+; CHECK-NEXT: imul [[REG]], [esp+{{[0-9]+}}]
+; CHECK-NEXT: mov [esp+{{[0-9]+}}], [[REG]]
+; CHECK-NEXT: .Lreuse$next:
+; CHECK-NEXT: sub [[REG]], [esp+{{[0-9]+}}]
+
+; ERRORS-NOT: ICE translation error
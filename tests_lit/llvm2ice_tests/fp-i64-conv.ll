@@ -0,0 +1,77 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none -Os %s | FileCheck --check-prefix=OPTSIZE %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; Conversions between i64 and floating point are expanded inline,
+; using the bottom of the outgoing-argument area as scratch memory.
+; With -Os they call a helper instead.
+
+define i64 @double_to_signed(double %a) {
+entry:
+  %conv = fptosi double %a to i64
+  ret i64 %conv
+}
+; CHECK:      double_to_signed:
+; CHECK:      sub esp, 16
+; CHECK:      movsd qword ptr [esp], xmm{{.}}
+; CHECK-NEXT: fld qword ptr [esp]
+; CHECK-NEXT: fnstcw word ptr [esp+8]
+; CHECK-NEXT: mov [[CW:e..]], dword ptr [esp+8]
+; CHECK-NEXT: or [[CW]], 3072
+; CHECK-NEXT: mov dword ptr [esp+12], [[CW]]
+; CHECK-NEXT: fldcw word ptr [esp+12]
+; CHECK-NEXT: fistp qword ptr [esp]
+; CHECK-NEXT: fldcw word ptr [esp+8]
+; CHECK-NOT:  call
+; CHECK:      ret
+; OPTSIZE:    double_to_signed:
+; OPTSIZE:    call cvtdtosi64
+
+define i64 @float_to_unsigned(float %a) {
+entry:
+  %conv = fptoui float %a to i64
+  ret i64 %conv
+}
+; CHECK:      float_to_unsigned:
+; CHECK:      mov dword ptr [esp+8], 1593835520
+; CHECK:      ucomiss xmm{{.}}, dword ptr [esp+8]
+; CHECK-NEXT: jb
+; CHECK:      subss xmm{{.}}, dword ptr [esp+8]
+; CHECK:      fistp qword ptr [esp]
+; CHECK:      xor
+; CHECK-NOT:  call
+; CHECK:      ret
+; OPTSIZE:    float_to_unsigned:
+; OPTSIZE:    call cvtftoui64
+
+define double @signed_to_double(i64 %a) {
+entry:
+  %conv = sitofp i64 %a to double
+  ret double %conv
+}
+; CHECK:      signed_to_double:
+; CHECK:      mov dword ptr [esp], e{{..}}
+; CHECK-NEXT: mov dword ptr [esp+4], e{{..}}
+; CHECK-NEXT: fild qword ptr [esp]
+; CHECK-NEXT: fstp qword ptr [esp]
+; CHECK-NEXT: movsd xmm{{.}}, qword ptr [esp]
+; OPTSIZE:    signed_to_double:
+; OPTSIZE:    call cvtsi64tod
+
+define float @unsigned_to_float(i64 %a) {
+entry:
+  %conv = uitofp i64 %a to float
+  ret float %conv
+}
+; CHECK:      unsigned_to_float:
+; CHECK:      fild qword ptr [esp]
+; CHECK-NEXT: mov dword ptr [esp+8], 1602224128
+; CHECK-NEXT: cmp dword ptr [esp+4], 0
+; CHECK-NEXT: jge
+; CHECK-NEXT: fadd dword ptr [esp+8]
+; CHECK:      fstp dword ptr [esp]
+; CHECK-NEXT: movss xmm{{.}}, dword ptr [esp]
+; OPTSIZE:    unsigned_to_float:
+; OPTSIZE:    call cvtui64tof
+
+; ERRORS-NOT: ICE translation error
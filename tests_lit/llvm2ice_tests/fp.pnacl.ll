@@ -365,6 +365,8 @@ entry:
   ret double %conv
 }
 ; CHECK: unsigned16ToDouble:
+; CHECK: movzwl
+; CHECK-NEXT: cvtsi2sd
 
 define internal float @unsigned16ToFloat(i32 %a) {
 entry:
@@ -389,6 +391,8 @@ entry:
   ret float %conv
 }
 ; CHECK: signed8ToFloat:
+; CHECK: movsbl
+; CHECK-NEXT: cvtsi2ss
 
 define internal double @unsigned8ToDouble(i32 %a) {
 entry:
@@ -0,0 +1,85 @@
+; RUN: %llvm2ice --verbose none -ias %s | FileCheck %s
+; RUN: %llvm2ice --verbose none -ias %s | FileCheck --check-prefix=ERRORS %s
+
+; The integrated assembler prints each function as data directives,
+; with fixups for calls, jump tables and floating-point constants.
+
+define internal i32 @callee(i32 %a) {
+entry:
+  %r = add i32 %a, 1
+  ret i32 %r
+}
+
+define i32 @caller(i32 %a) {
+entry:
+  %r = call i32 @callee(i32 %a)
+  %s = mul i32 %r, %a
+  ret i32 %s
+}
+
+define i32 @cond(i32 %a, i32 %b) {
+entry:
+  %c = icmp eq i32 %a, %b
+  br i1 %c, label %t, label %f
+t:
+  ret i32 1
+f:
+  ret i32 2
+}
+
+define double @fpconst(double %a) {
+entry:
+  %r = fadd double %a, 1.500000e+00
+  ret double %r
+}
+
+define i32 @sw(i32 %a) {
+entry:
+  switch i32 %a, label %d [
+    i32 0, label %b0
+    i32 1, label %b1
+    i32 2, label %b2
+    i32 3, label %b3
+  ]
+b0:
+  ret i32 10
+b1:
+  ret i32 11
+b2:
+  ret i32 12
+b3:
+  ret i32 13
+d:
+  ret i32 0
+}
+
+; CHECK-LABEL: callee:
+; CHECK-NEXT: .byte 0x8b, 0x44, 0x24, 0x04, 0x83, 0xc0, 0x01, 0xc3
+
+; CHECK-LABEL: caller:
+; CHECK: 0xe8
+; CHECK-NEXT: .long callee-4-.
+; CHECK-NEXT: .byte 0x0f, 0xaf, 0xc3
+
+; The forward branch to %f uses the short form.
+; CHECK-LABEL: cond:
+; CHECK-NEXT: .byte 0x8b, 0x44, 0x24, 0x04, 0x8b, 0x4c, 0x24, 0x08, 0x39, 0xc8, 0x75, 0x06
+
+; CHECK-LABEL: fpconst:
+; CHECK: 0xf2, 0x0f, 0x58, 0x05
+; CHECK-NEXT: .long .Lfpconst$__fp0
+; CHECK: .section .rodata
+; CHECK: .Lfpconst$__fp0:
+; CHECK-NEXT: .byte 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf8, 0x3f
+; CHECK-NEXT: .text
+
+; CHECK-LABEL: sw:
+; CHECK: 0xff, 0x24, 0x85
+; CHECK-NEXT: .long .Lsw$__jt0
+; CHECK: .Lsw$__jt0:
+; CHECK-NEXT: .long sw+18
+; CHECK-NEXT: .long sw+24
+; CHECK-NEXT: .long sw+30
+; CHECK-NEXT: .long sw+36
+
+; ERRORS-NOT: ICE translation error
@@ -0,0 +1,52 @@
+; RUN: %llvm2ice --verbose none -subzero-stats %s 2>&1 | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; A leaf function that needs no stack slots gets no frame beyond the
+; callee-save pushes, and reads its arguments relative to esp.
+
+define i32 @get(i32 %p, i32 %i) {
+entry:
+  %off = shl i32 %i, 2
+  %addr = add i32 %p, %off
+  %addr.asptr = inttoptr i32 %addr to i32*
+  %v = load i32* %addr.asptr, align 4
+  ret i32 %v
+}
+; CHECK:      get:
+; CHECK-NEXT: .Lget$entry:
+; CHECK-NEXT: mov {{.*}}, dword ptr [esp+4]
+; CHECK-NEXT: mov {{.*}}, dword ptr [esp+8]
+; CHECK-NEXT: mov eax, dword ptr [e{{..}}+4*e{{..}}]
+; CHECK-NEXT: ret
+
+define i32 @sum3(i32 %a, i32 %b, i32 %c) {
+entry:
+  %x = add i32 %a, %b
+  %y = add i32 %x, %c
+  %z = mul i32 %y, %a
+  ret i32 %z
+}
+; Without calls, the callee-saved registers are not worth their push
+; and pop, so sum3 keeps its values in the scratch registers, reading
+; an argument from its stack slot instead.
+; CHECK:      sum3:
+; CHECK-NEXT: .Lsum3$entry:
+; CHECK-NOT:  push
+; CHECK:      imul
+; CHECK-NOT:  pop
+; CHECK:      ret
+
+declare void @use(i32)
+
+define void @not_leaf(i32 %a) {
+entry:
+  call void @use(i32 %a)
+  ret void
+}
+; CHECK:      not_leaf:
+; CHECK:      sub esp, 4
+
+; CHECK: [Subzero stats] Functions translated: 3
+; CHECK: [Subzero stats] Leaf functions without a frame: 2
+
+; ERRORS-NOT: ICE translation error
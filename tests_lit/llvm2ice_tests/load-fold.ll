@@ -0,0 +1,82 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; A load whose value has a single use is folded into the memory
+; operand of that use, unless a store comes between them.
+
+define i32 @add_load(i32 %a, i32 %p) {
+entry:
+  %p.asptr = inttoptr i32 %p to i32*
+  %v = load i32* %p.asptr, align 1
+  %r = add i32 %a, %v
+  ret i32 %r
+}
+; CHECK: add_load:
+; CHECK: add {{.*}}, dword ptr [
+
+define i32 @and_load_commuted(i32 %a, i32 %p) {
+entry:
+  %p.asptr = inttoptr i32 %p to i32*
+  %v = load i32* %p.asptr, align 1
+  %r = and i32 %v, %a
+  ret i32 %r
+}
+; CHECK: and_load_commuted:
+; CHECK: and {{.*}}, dword ptr [
+
+define i32 @sub_load_first(i32 %a, i32 %p) {
+entry:
+  %p.asptr = inttoptr i32 %p to i32*
+  %v = load i32* %p.asptr, align 1
+  %r = sub i32 %v, %a
+  ret i32 %r
+}
+; CHECK: sub_load_first:
+; CHECK: mov [[REG:e..]], dword ptr [e{{..}}]
+; CHECK-NEXT: sub [[REG]],
+
+define i32 @cmp_load_br(i32 %a, i32 %p) {
+entry:
+  %p.asptr = inttoptr i32 %p to i32*
+  %v = load i32* %p.asptr, align 1
+  %cmp = icmp eq i32 %a, %v
+  br i1 %cmp, label %then, label %else
+then:
+  ret i32 1
+else:
+  ret i32 0
+}
+; CHECK: cmp_load_br:
+; CHECK: cmp {{.*}}, dword ptr [
+; CHECK-NEXT: jne {{.*}}else
+
+define i32 @cmp_load_imm(i32 %p) {
+entry:
+  %p.asptr = inttoptr i32 %p to i32*
+  %v = load i32* %p.asptr, align 1
+  %cmp = icmp ne i32 %v, 7
+  br i1 %cmp, label %then, label %else
+then:
+  ret i32 1
+else:
+  ret i32 0
+}
+; CHECK: cmp_load_imm:
+; CHECK: cmp dword ptr [{{.*}}], 7
+; CHECK-NEXT: je {{.*}}else
+
+define i32 @store_between(i32 %a, i32 %p, i32 %q) {
+entry:
+  %p.asptr = inttoptr i32 %p to i32*
+  %q.asptr = inttoptr i32 %q to i32*
+  %v = load i32* %p.asptr, align 1
+  store i32 %a, i32* %q.asptr, align 1
+  %r = add i32 %a, %v
+  ret i32 %r
+}
+; CHECK: store_between:
+; CHECK: mov {{.*}}, dword ptr [
+; CHECK: mov dword ptr [
+; CHECK-NOT: add {{.*}}, dword ptr [
+
+; ERRORS-NOT: ICE translation error
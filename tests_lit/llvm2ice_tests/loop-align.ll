@@ -0,0 +1,88 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none -loop-align=5 %s | FileCheck --check-prefix=ALIGN5 %s
+; RUN: %llvm2ice --verbose none -loop-align=0 %s | FileCheck --check-prefix=NOALIGN %s
+; RUN: %llvm2ice --verbose none -Os %s | FileCheck --check-prefix=NOALIGN %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; The first block of a loop in the final layout is aligned, unless the
+; loop is tiny or rarely entered.
+
+define i32 @sum(i32 %a, i32 %n) {
+entry:
+  %cmp4 = icmp eq i32 %n, 0
+  br i1 %cmp4, label %done, label %body
+
+body:
+  %i = phi i32 [ %inc, %body ], [ 0, %entry ]
+  %sum = phi i32 [ %add, %body ], [ 0, %entry ]
+  %off = shl i32 %i, 2
+  %addr = add i32 %a, %off
+  %addr.asptr = inttoptr i32 %addr to i32*
+  %v = load i32* %addr.asptr, align 1
+  %x = xor i32 %v, %i
+  %m = mul i32 %x, 3
+  %add = add i32 %m, %sum
+  %inc = add i32 %i, 1
+  %cmp = icmp eq i32 %inc, %n
+  br i1 %cmp, label %done, label %body
+
+done:
+  %r = phi i32 [ 0, %entry ], [ %add, %body ]
+  ret i32 %r
+}
+; CHECK:      sum:
+; CHECK:      .p2align 4
+; CHECK-NEXT: .Lsum$body:
+; ALIGN5:     sum:
+; ALIGN5:     .p2align 5
+; ALIGN5-NEXT: .Lsum$body:
+
+; A loop of fewer than six instructions is not worth padding.
+define i32 @count(i32 %n) {
+entry:
+  br label %header
+
+header:
+  %i = phi i32 [ 0, %entry ], [ %inc, %header ]
+  %inc = add i32 %i, 1
+  %cmp = icmp eq i32 %inc, %n
+  br i1 %cmp, label %exit, label %header
+
+exit:
+  ret i32 %inc
+}
+; CHECK:      count:
+; CHECK-NOT:  .p2align
+; CHECK:      ret
+
+; A loop that is entered only on a cold path is not aligned either.
+define i32 @cold_loop(i32 %a, i32 %n) {
+entry:
+  %rare = icmp eq i32 %n, 12345
+  br i1 %rare, label %body, label %done, !prof !0
+
+body:
+  %i = phi i32 [ %inc, %body ], [ 0, %entry ]
+  %sum = phi i32 [ %add, %body ], [ 0, %entry ]
+  %off = shl i32 %i, 2
+  %addr = add i32 %a, %off
+  %addr.asptr = inttoptr i32 %addr to i32*
+  %v = load i32* %addr.asptr, align 1
+  %add = add i32 %v, %sum
+  %inc = add i32 %i, 1
+  %cmp = icmp eq i32 %inc, %n
+  br i1 %cmp, label %done, label %body
+
+done:
+  %r = phi i32 [ 0, %entry ], [ %add, %body ]
+  ret i32 %r
+}
+; CHECK:      cold_loop:
+; CHECK-NOT:  .p2align
+; CHECK:      ret
+
+; NOALIGN-NOT: .p2align
+
+!0 = metadata !{metadata !"branch_weights", i32 1, i32 1000}
+
+; ERRORS-NOT: ICE translation error
@@ -0,0 +1,47 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; Outgoing arguments are stored into an area at the bottom of the
+; frame that is sized for the largest call, so esp does not move
+; around calls.
+
+declare i64 @mixed(i32, double, float, i64)
+declare double @get_double(i32)
+
+define i64 @pass_mixed(i32 %a, double %b, float %c, i64 %d) {
+entry:
+  %r = call i64 @mixed(i32 %a, double %b, float %c, i64 %d)
+  %s = call i64 @mixed(i32 1, double %b, float %c, i64 2)
+  %t = add i64 %r, %s
+  ret i64 %t
+}
+; CHECK:      pass_mixed:
+; CHECK:      sub esp, 24
+; CHECK-NOT:  push
+; CHECK:      mov dword ptr [esp], e{{..}}
+; CHECK:      movsd qword ptr [esp+4], xmm{{.}}
+; CHECK:      movss dword ptr [esp+12], xmm{{.}}
+; CHECK:      mov dword ptr [esp+16], e{{..}}
+; CHECK:      mov dword ptr [esp+20], e{{..}}
+; CHECK-NEXT: call mixed
+; CHECK-NOT:  add esp
+; CHECK:      mov dword ptr [esp], 1
+; CHECK:      mov dword ptr [esp+16], 2
+; CHECK-NEXT: mov dword ptr [esp+20], 0
+; CHECK-NEXT: call mixed
+; CHECK:      add esp, 24
+; CHECK:      ret
+
+; A floating-point result is popped off the x87 stack even if it is
+; unused.
+define void @ignore_double(i32 %a) {
+entry:
+  %r = call double @get_double(i32 %a)
+  ret void
+}
+; CHECK:      ignore_double:
+; CHECK:      call get_double
+; CHECK:      fstp
+; CHECK:      ret
+
+; ERRORS-NOT: ICE translation error
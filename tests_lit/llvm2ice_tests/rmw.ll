@@ -0,0 +1,89 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; A load, an arithmetic operation on the loaded value, and a store of
+; the result back to the same address become one instruction with a
+; memory destination, as long as the result has no other use.
+
+define void @rmw_add(i32 %p, i32 %c) {
+entry:
+  %p.asptr = inttoptr i32 %p to i32*
+  %v = load i32* %p.asptr, align 1
+  %r = add i32 %v, %c
+  store i32 %r, i32* %p.asptr, align 1
+  ret void
+}
+; CHECK: rmw_add:
+; CHECK: add dword ptr [e{{..}}], e{{..}}
+; CHECK-NEXT: ret
+
+define void @rmw_sub_imm(i32 %p) {
+entry:
+  %p.asptr = inttoptr i32 %p to i32*
+  %v = load i32* %p.asptr, align 1
+  %r = sub i32 %v, 7
+  store i32 %r, i32* %p.asptr, align 1
+  ret void
+}
+; CHECK: rmw_sub_imm:
+; CHECK: sub dword ptr [e{{..}}], 7
+; CHECK-NEXT: ret
+
+define void @rmw_sub_rev(i32 %p, i32 %c) {
+entry:
+  %p.asptr = inttoptr i32 %p to i32*
+  %v = load i32* %p.asptr, align 1
+  %r = sub i32 %c, %v
+  store i32 %r, i32* %p.asptr, align 1
+  ret void
+}
+; CHECK: rmw_sub_rev:
+; CHECK: sub [[REG:e..]], dword ptr [[[ADDR:e..]]]
+; CHECK-NEXT: mov dword ptr [[[ADDR]]], [[REG]]
+
+define void @rmw_indexed(i32 %base, i32 %i) {
+entry:
+  %off = shl i32 %i, 2
+  %addr = add i32 %base, %off
+  %addr.asptr = inttoptr i32 %addr to i32*
+  %v = load i32* %addr.asptr, align 1
+  %r = or i32 1, %v
+  store i32 %r, i32* %addr.asptr, align 1
+  ret void
+}
+; CHECK: rmw_indexed:
+; CHECK: or dword ptr [e{{..}}+4*e{{..}}], 1
+; CHECK-NEXT: ret
+
+define i32 @rmw_other_use(i32 %p) {
+entry:
+  %p.asptr = inttoptr i32 %p to i32*
+  %v = load i32* %p.asptr, align 1
+  %r = xor i32 %v, 3
+  store i32 %r, i32* %p.asptr, align 1
+  ret i32 %r
+}
+; CHECK: rmw_other_use:
+; CHECK-NOT: xor dword ptr
+; CHECK: mov dword ptr [
+
+define void @rmw_counter_loop(i32 %p, i32 %n) {
+entry:
+  %p.asptr = inttoptr i32 %p to i32*
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %inc, %loop ]
+  %v = load i32* %p.asptr, align 1
+  %r = add i32 %v, %i
+  store i32 %r, i32* %p.asptr, align 1
+  %inc = add i32 %i, 1
+  %cmp = icmp eq i32 %inc, %n
+  br i1 %cmp, label %out, label %loop
+out:
+  ret void
+}
+; CHECK: rmw_counter_loop:
+; CHECK: loop:
+; CHECK-NEXT: add dword ptr [e{{..}}], e{{..}}
+
+; ERRORS-NOT: ICE translation error
@@ -0,0 +1,66 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+; RUN: %llvm2ice --verbose none -ias %s | FileCheck --check-prefix=ERRORS %s
+
+; 8-bit values are held in any 32-bit register.  An i8 select is done
+; with a 32-bit cmov, so it doesn't compete for the four registers with
+; a byte form while the call's kill ranges are pending.
+
+declare i32 @xc3(i32, i32, i32)
+
+define i32 @sel8(i32 %a, i32 %n) {
+entry:
+  %c0 = call i32 @xc3(i32 %a, i32 %n, i32 1)
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i1, %loop ]
+  %i1 = add i32 %i, 1
+  %lc = icmp slt i32 %i1, %n
+  br i1 %lc, label %loop, label %sw
+sw:
+  switch i32 %a, label %d [ i32 1, label %s1
+                            i32 2, label %s2 ]
+s1:
+  br label %join
+s2:
+  br label %join
+d:
+  br label %join
+join:
+  %r = srem i32 %a, 65536
+  %s = select i1 false, i8 0, i8 0
+  %z = zext i8 %s to i32
+  %t = sub i32 %r, %z
+  %e0 = add i32 %i1, %c0
+  %e1 = add i32 %i1, %i1
+  %e2 = add i32 %t, %a
+  %q2 = select i1 %lc, i8 7, i8 0
+  %z2 = zext i8 %q2 to i32
+  %c1 = call i32 @xc3(i32 %r, i32 %r, i32 %z2)
+  %w0 = add i32 %c1, %e0
+  %w1 = add i32 %w0, %e1
+  %w2 = add i32 %w1, %e2
+  %w3 = add i32 %w2, %z2
+  ret i32 %w3
+}
+; CHECK: sel8:
+; CHECK: cmovne
+; CHECK: cmovne
+; CHECK: call xc3
+; CHECK: ret
+
+; An 8-bit store still names a byte register.
+define void @store8(i32 %addr, i32 %a, i32 %b) {
+entry:
+  %a8 = trunc i32 %a to i8
+  %b8 = trunc i32 %b to i8
+  %s = add i8 %a8, %b8
+  %p = inttoptr i32 %addr to i8*
+  store i8 %s, i8* %p, align 1
+  ret void
+}
+; CHECK: store8:
+; CHECK: mov byte ptr [{{.*}}], e{{[abcd]}}x
+; CHECK: ret
+
+; ERRORS-NOT: ICE translation error
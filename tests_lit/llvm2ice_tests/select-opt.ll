@@ -16,11 +16,11 @@ declare void @useInt(i32)
 
 ; CHECK:      .globl testSelect
 ; CHECK:      cmp
-; CHECK:      cmp
+; CHECK-NEXT: mov
+; CHECK-NEXT: cmov
 ; CHECK:      call useInt
 ; CHECK:      cmp
-; CHECK:      cmp
-; CHECK:      call useInt
-; CHECK:      ret
+; CHECK:      cmov
+; CHECK:      jmp useInt
 
 ; ERRORS-NOT: ICE translation error
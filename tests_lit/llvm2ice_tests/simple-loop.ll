@@ -36,15 +36,15 @@ for.end:
 
 ; CHECK:      mov ecx, dword ptr [esp+{{[0-9]+}}]
 ; CHECK:      cmp ecx, 0
-; CHECK-NEXT: ja {{.*}}for.body
-; CHECK-NEXT: jmp {{.*}}for.end
+; CHECK-NEXT: jbe {{.*}}for.end
+; CHECK-NEXT: .Lsimple_loop$for.body:
 
-; TODO: the mov from ebx to esi seems redundant here - so this may need to be
-; modified later
+; The induction variable is coalesced with its phi temporary, so the
+; incremented value is compared directly without an intervening copy.
 
 ; CHECK:      add [[IREG:[a-z]+]], 1
-; CHECK-NEXT: mov [[ICMPREG:[a-z]+]], [[IREG]]
-; CHECK:      cmp [[ICMPREG]], ecx
+; CHECK-NOT:  [[IREG]]
+; CHECK:      cmp [[IREG]], ecx
 ; CHECK-NEXT: jb {{.*}}for.body
 
 ; ERRORS-NOT: ICE translation error
@@ -0,0 +1,58 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; Values live across a call mostly end up on the stack.  The values live
+; across the first call are dead by the second call, so the two sets
+; share stack slots and the frame only needs room for one of them, plus
+; the 4-byte outgoing-argument area.
+
+define i32 @spill_slots(i32 %a) {
+entry:
+  %p0 = add i32 %a, 1
+  %p1 = add i32 %a, 2
+  %p2 = add i32 %a, 3
+  %p3 = add i32 %a, 4
+  %p4 = add i32 %a, 5
+  %p5 = add i32 %a, 6
+  %p6 = add i32 %a, 7
+  %p7 = add i32 %a, 8
+  %c1 = call i32 @ext(i32 %a)
+  %s0 = add i32 %c1, %p0
+  %s1 = add i32 %s0, %p1
+  %s2 = add i32 %s1, %p2
+  %s3 = add i32 %s2, %p3
+  %s4 = add i32 %s3, %p4
+  %s5 = add i32 %s4, %p5
+  %s6 = add i32 %s5, %p6
+  %s7 = add i32 %s6, %p7
+  %q0 = mul i32 %s7, 3
+  %q1 = mul i32 %s7, 4
+  %q2 = mul i32 %s7, 5
+  %q3 = mul i32 %s7, 6
+  %q4 = mul i32 %s7, 7
+  %q5 = mul i32 %s7, 8
+  %q6 = mul i32 %s7, 9
+  %q7 = mul i32 %s7, 10
+  %c2 = call i32 @ext(i32 %s7)
+  %t0 = add i32 %c2, %q0
+  %t1 = add i32 %t0, %q1
+  %t2 = add i32 %t1, %q2
+  %t3 = add i32 %t2, %q3
+  %t4 = add i32 %t3, %q4
+  %t5 = add i32 %t4, %q5
+  %t6 = add i32 %t5, %q6
+  %t7 = add i32 %t6, %q7
+  ret i32 %t7
+}
+
+declare i32 @ext(i32)
+
+; CHECK:      spill_slots:
+; CHECK:      sub esp, 20
+; CHECK:      call ext
+; CHECK:      call ext
+; CHECK:      add esp, 20
+; CHECK-NEXT: pop
+; CHECK:      ret
+
+; ERRORS-NOT: ICE translation error
@@ -0,0 +1,85 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; Dense runs of cases are dispatched through a jump table after a
+; bounds check, and sparse cases are found with a compare tree.
+
+define i32 @dense(i32 %a) {
+entry:
+  switch i32 %a, label %d [
+    i32 10, label %b1
+    i32 11, label %b2
+    i32 12, label %b3
+    i32 13, label %b1
+    i32 15, label %b2
+  ]
+b1:
+  ret i32 1
+b2:
+  ret i32 2
+b3:
+  ret i32 3
+d:
+  ret i32 0
+}
+; CHECK-LABEL: dense:
+; CHECK:       sub [[IDX:e[a-z]+]], 10
+; CHECK-NEXT:  cmp [[IDX]], 5
+; CHECK-NEXT:  ja .Ldense$d
+; CHECK-NEXT:  jmp dword ptr [[[TABLE:.Ldense\$__jt[0-9]+]]+4*[[IDX]]]
+; CHECK:       [[TABLE]]:
+; CHECK-NEXT:  .long .Ldense$b1
+; CHECK-NEXT:  .long .Ldense$b2
+; CHECK-NEXT:  .long .Ldense$b3
+; CHECK-NEXT:  .long .Ldense$b1
+; CHECK-NEXT:  .long .Ldense$d
+; CHECK-NEXT:  .long .Ldense$b2
+; CHECK-NEXT:  .text
+
+define i32 @sparse(i32 %a) {
+entry:
+  switch i32 %a, label %d [
+    i32 5000, label %b1
+    i32 1, label %b2
+    i32 300, label %b3
+    i32 70000, label %b1
+    i32 20, label %b2
+    i32 4000, label %b3
+    i32 100000, label %b1
+  ]
+b1:
+  ret i32 1
+b2:
+  ret i32 2
+b3:
+  ret i32 3
+d:
+  ret i32 0
+}
+; CHECK-LABEL: sparse:
+; CHECK:       cmp [[SRC:e[a-z]+]], 4000
+; CHECK-NEXT:  jb [[LOW:.Lsparse\$__[0-9]+]]
+; CHECK-NEXT:  cmp [[SRC]], 70000
+; CHECK-NEXT:  jb [[MID:.Lsparse\$__[0-9]+]]
+; CHECK-NEXT:  cmp [[SRC]], 70000
+; CHECK-NEXT:  je .Lsparse$b1
+; CHECK-NEXT:  cmp [[SRC]], 100000
+; CHECK-NEXT:  je .Lsparse$b1
+; CHECK-NEXT:  jmp .Lsparse$d
+; CHECK-NEXT:  [[MID]]:
+; CHECK-NEXT:  cmp [[SRC]], 4000
+; CHECK-NEXT:  je .Lsparse$b3
+; CHECK-NEXT:  cmp [[SRC]], 5000
+; CHECK-NEXT:  je .Lsparse$b1
+; CHECK-NEXT:  jmp .Lsparse$d
+; CHECK-NEXT:  [[LOW]]:
+; CHECK-NEXT:  cmp [[SRC]], 1
+; CHECK-NEXT:  je .Lsparse$b2
+; CHECK-NEXT:  cmp [[SRC]], 20
+; CHECK-NEXT:  je .Lsparse$b2
+; CHECK-NEXT:  cmp [[SRC]], 300
+; CHECK-NEXT:  je .Lsparse$b3
+; CHECK-NEXT:  jmp .Lsparse$d
+; CHECK-NOT:   jmp dword ptr
+
+; ERRORS-NOT: ICE translation error
@@ -0,0 +1,70 @@
+; RUN: %llvm2ice --verbose none %s | FileCheck %s
+; RUN: %llvm2ice --verbose none %s | FileCheck --check-prefix=ERRORS %s
+
+; A tail call followed by a return of its result becomes a jmp after
+; the epilog, with the arguments copied into the incoming-argument
+; slots.
+
+declare i32 @callee2(i32, i32)
+declare i32 @callee3(i32, i32, i32)
+
+define i32 @swap_args(i32 %a, i32 %b) {
+entry:
+  %r = tail call i32 @callee2(i32 %b, i32 %a)
+  ret i32 %r
+}
+; CHECK:      swap_args:
+; CHECK:      sub esp, 8
+; CHECK:      mov dword ptr [esp], [[B:e..]]
+; CHECK-NEXT: mov dword ptr [esp+4], [[A:e..]]
+; CHECK-NEXT: mov eax, dword ptr [esp]
+; CHECK-NEXT: mov dword ptr [esp+12], eax
+; CHECK-NEXT: mov eax, dword ptr [esp+4]
+; CHECK-NEXT: mov dword ptr [esp+16], eax
+; CHECK-NEXT: add esp, 8
+; CHECK-NEXT: jmp callee2
+; CHECK-NOT:  ret
+
+define i32 @indirect(i32 %f, i32 %a) {
+entry:
+  %fp = inttoptr i32 %f to i32 (i32, i32)*
+  %r = tail call i32 %fp(i32 %a, i32 %a)
+  ret i32 %r
+}
+; CHECK:      indirect:
+; CHECK:      jmp ecx
+
+; The arguments don't fit in the caller's incoming-argument area.
+define i32 @too_many_args(i32 %a) {
+entry:
+  %r = tail call i32 @callee3(i32 %a, i32 %a, i32 %a)
+  ret i32 %r
+}
+; CHECK:      too_many_args:
+; CHECK:      call callee3
+; CHECK:      ret
+
+; The result is used before returning.
+define i32 @not_in_tail_position(i32 %a, i32 %b) {
+entry:
+  %r = tail call i32 @callee2(i32 %a, i32 %b)
+  %s = add i32 %r, 1
+  ret i32 %s
+}
+; CHECK:      not_in_tail_position:
+; CHECK:      call callee2
+; CHECK:      ret
+
+; The callee may be passed a pointer into the frame.
+define i32 @with_alloca(i32 %a, i32 %b) {
+entry:
+  %p = alloca i8, i32 4, align 4
+  %q = ptrtoint i8* %p to i32
+  %r = tail call i32 @callee2(i32 %q, i32 %b)
+  ret i32 %r
+}
+; CHECK:      with_alloca:
+; CHECK:      call callee2
+; CHECK:      ret
+
+; ERRORS-NOT: ICE translation error